@@ -0,0 +1,297 @@
+/**
+ * \file      codec.c
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     Microbenchmark of the conversions of decimals.
+ *
+ * Usage:
+ *
+ *     codec [-n values] [-r rounds]
+ *
+ * For each distribution of values, the benchmark generates `values`
+ * numbers (100000 by default, always the same ones), then times each
+ * conversion over all of them:
+ *
+ * - `from_string`: decNumberFromString();
+ * - `to_string`: decNumberToString();
+ * - `encode`: decInfiniteFromNumber() (which shifts the digits of its
+ *   argument, so each number is copied first: the copy is part of the time);
+ * - `decode`: decInfiniteToNumber().
+ *
+ * The distributions are:
+ *
+ * - `small`: integers from 0 to 999;
+ * - `money`: non-negative amounts with two decimals, up to 10^7;
+ * - `digits18`: 18-digit numbers with exponents from -9 to 0;
+ * - `digits39`: 39-digit numbers, with exponents from -20 to 0;
+ * - `negative`: negative amounts with two decimals, up to 10^7;
+ * - `bigexp`: 12-digit numbers with exponents from -999999 to 999999.
+ *
+ * Each conversion is repeated `rounds` times (5 by default) and the fastest
+ * round is kept. Before timing, every value is checked to survive a round
+ * trip through the encoding (trailing zeros aside), so the benchmark also
+ * fails if the codec is broken.
+ *
+ * The result is printed as one line per distribution and conversion, of
+ * the form `bench=codec dist=D op=O values=N ns_per_op=T`.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "decInfinite.h"
+
+/**
+ * \brief The size of the buffers of the numbers as strings.
+ */
+#define CODEC_STRING_SIZE (DECNUMDIGITS + 14)
+
+/**
+ * \brief The conversions that are timed.
+ */
+typedef enum {
+  CODEC_FROM_STRING,
+  CODEC_TO_STRING,
+  CODEC_ENCODE,
+  CODEC_DECODE,
+  CODEC_NOPS
+} codecOp;
+
+/**
+ * \brief Names of the conversions.
+ */
+static char const* const codecOpName[CODEC_NOPS] = { "from_string", "to_string", "encode", "decode" };
+
+/**
+ * \brief The shapes of the values of a distribution.
+ */
+typedef enum {
+  CODEC_INTEGER,    /**< Integers from 0 to 999.                        */
+  CODEC_MONEY,      /**< Amounts with two decimals, up to 10^7.         */
+  CODEC_DIGITS      /**< A given number of digits and exponent range.   */
+} codecShape;
+
+/**
+ * \brief A distribution of values.
+ */
+typedef struct codecDist {
+  char const* zName;  /**< The name of the distribution.           */
+  codecShape shape;   /**< The shape of the values.                */
+  int nDigit;         /**< The number of digits (CODEC_DIGITS).    */
+  int eMin;           /**< The minimum exponent (CODEC_DIGITS).    */
+  int eMax;           /**< The maximum exponent (CODEC_DIGITS).    */
+  int isNegative;     /**< Whether the values are negative.        */
+} codecDist;
+
+static codecDist const codecDists[] = {
+  { "small",    CODEC_INTEGER, 0,  0,       0,      0 },
+  { "money",    CODEC_MONEY,   0,  0,       0,      0 },
+  { "digits18", CODEC_DIGITS,  18, -9,      0,      0 },
+  { "digits39", CODEC_DIGITS,  39, -20,     0,      0 },
+  { "negative", CODEC_MONEY,   0,  0,       0,      1 },
+  { "bigexp",   CODEC_DIGITS,  12, -999999, 999999, 0 },
+};
+
+/**
+ * \brief The values of a distribution, in all the formats.
+ */
+typedef struct codecData {
+  int n;                                /**< The number of values.    */
+  char (*aString)[CODEC_STRING_SIZE];   /**< As strings.              */
+  decNumber* aNumber;                   /**< As decNumbers.           */
+  uint8_t (*aBytes)[DECINF_MAXSIZE];    /**< Encoded.                 */
+  size_t* aLen;                         /**< The encoded lengths.     */
+  decNumber* aOut;                      /**< The output of decoding.  */
+} codecData;
+
+/**
+ * \brief Keeps the results of the timed loops alive.
+ */
+static volatile size_t codecSink;
+
+/**
+ * \brief State of the pseudo-random number generator (xorshift64).
+ */
+static uint64_t codecState = 88172645463325252ull;
+
+static uint64_t codecRandom(void) {
+  codecState ^= codecState << 13;
+  codecState ^= codecState >> 7;
+  codecState ^= codecState << 17;
+  return codecState;
+}
+
+static void usage(char const* zProg) {
+  fprintf(stderr, "Usage: %s [-n values] [-r rounds]\n", zProg);
+  exit(EXIT_FAILURE);
+}
+
+/**
+ * \brief Returns the time elapsed since \a start, in nanoseconds.
+ */
+static double elapsedNs(struct timespec const* start) {
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return (double)(end.tv_sec - start->tv_sec) * 1e9 + (double)(end.tv_nsec - start->tv_nsec);
+}
+
+/**
+ * \brief Writes a value of the given distribution into \a z.
+ */
+static void codecGenerate(codecDist const* d, char* z) {
+  int p = 0;
+  if (d->isNegative) z[p++] = '-';
+  if (d->shape == CODEC_INTEGER) {
+    snprintf(z + p, CODEC_STRING_SIZE - (size_t)p, "%llu", (unsigned long long)(codecRandom() % 1000));
+    return;
+  }
+  if (d->shape == CODEC_MONEY) {
+    uint64_t const cents = codecRandom() % 1000000000u;
+    snprintf(z + p, CODEC_STRING_SIZE - (size_t)p, "%llu.%02llu",
+             (unsigned long long)(cents / 100), (unsigned long long)(cents % 100));
+    return;
+  }
+  for (int i = 0; i < d->nDigit; i++)
+    z[p++] = (char)('0' + (i == 0 ? 1 + codecRandom() % 9 : codecRandom() % 10));
+  int const exponent = d->eMin + (int)(codecRandom() % (uint64_t)(d->eMax - d->eMin + 1));
+  snprintf(z + p, CODEC_STRING_SIZE - (size_t)p, "E%d", exponent);
+}
+
+/**
+ * \brief Allocates the arrays of \a data.
+ *
+ * \return `0` on success; `1` if there is not enough memory.
+ */
+static int codecAlloc(codecData* data, int n) {
+  data->n = n;
+  data->aString = malloc(sizeof(*data->aString) * (size_t)n);
+  data->aNumber = malloc(sizeof(*data->aNumber) * (size_t)n);
+  data->aBytes = malloc(sizeof(*data->aBytes) * (size_t)n);
+  data->aLen = malloc(sizeof(*data->aLen) * (size_t)n);
+  data->aOut = malloc(sizeof(*data->aOut) * (size_t)n);
+  return !data->aString || !data->aNumber || !data->aBytes || !data->aLen || !data->aOut;
+}
+
+static void codecFree(codecData* data) {
+  free(data->aString);
+  free(data->aNumber);
+  free(data->aBytes);
+  free(data->aLen);
+  free(data->aOut);
+}
+
+/**
+ * \brief Fills \a data with values of the given distribution and checks
+ *        that they survive a round trip through the encoding.
+ *
+ * \return `0` on success; `1` if a value does not survive (it is reported).
+ */
+static int codecSetup(codecData* data, codecDist const* d, decContext* decCtx) {
+  for (int i = 0; i < data->n; i++) {
+    decNumber copy;
+    decNumber result;
+    codecGenerate(d, data->aString[i]);
+    decNumberFromString(&data->aNumber[i], data->aString[i], decCtx);
+    copy = data->aNumber[i];
+    data->aLen[i] = decInfiniteFromNumber(DECINF_MAXSIZE, data->aBytes[i], &copy);
+    if (decInfiniteToNumber(data->aLen[i], data->aBytes[i], &data->aOut[i]) == 0
+        || !decNumberIsZero(decNumberCompare(&result, &data->aNumber[i], &data->aOut[i], decCtx))) {
+      fprintf(stderr, "%s: %s does not survive a round trip\n", d->zName, data->aString[i]);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * \brief Runs a conversion over all the values once.
+ *
+ * \return The time taken, in nanoseconds.
+ */
+static double codecRun(codecData* data, codecOp op, decContext* decCtx) {
+  char z[CODEC_STRING_SIZE];
+  size_t sink = 0;
+  struct timespec start;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  switch (op) {
+    case CODEC_FROM_STRING:
+      for (int i = 0; i < data->n; i++) {
+        decNumberFromString(&data->aOut[i], data->aString[i], decCtx);
+        sink += (size_t)data->aOut[i].digits;
+      }
+      break;
+    case CODEC_TO_STRING:
+      for (int i = 0; i < data->n; i++) {
+        decNumberToString(&data->aNumber[i], z);
+        sink += (size_t)z[0];
+      }
+      break;
+    case CODEC_ENCODE:
+      for (int i = 0; i < data->n; i++) {
+        decNumber copy = data->aNumber[i];
+        sink += decInfiniteFromNumber(DECINF_MAXSIZE, data->aBytes[i], &copy);
+      }
+      break;
+    case CODEC_DECODE:
+      for (int i = 0; i < data->n; i++) {
+        decInfiniteToNumber(data->aLen[i], data->aBytes[i], &data->aOut[i]);
+        sink += (size_t)data->aOut[i].digits;
+      }
+      break;
+    default:
+      break;
+  }
+  double const ns = elapsedNs(&start);
+  codecSink += sink;
+  return ns;
+}
+
+int main(int argc, char* argv[]) {
+  int nValue = 100000;
+  int nRound = 5;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) nValue = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) nRound = atoi(argv[++i]);
+    else usage(argv[0]);
+  }
+  if (nValue <= 0 || nRound <= 0) usage(argv[0]);
+
+  decContext decCtx;
+  decContextDefault(&decCtx, DEC_INIT_BASE);
+  decCtx.digits = DECNUMDIGITS;
+
+  codecData data;
+  if (codecAlloc(&data, nValue)) {
+    fprintf(stderr, "Out of memory\n");
+    codecFree(&data);
+    return EXIT_FAILURE;
+  }
+  int nFailed = 0;
+  for (size_t k = 0; k < sizeof(codecDists) / sizeof(codecDists[0]); k++) {
+    codecDist const* d = &codecDists[k];
+    if (codecSetup(&data, d, &decCtx)) {
+      nFailed++;
+      continue;
+    }
+    for (int op = 0; op < CODEC_NOPS; op++) {
+      double best = 0.0;
+      for (int r = 0; r < nRound; r++) {
+        double const ns = codecRun(&data, (codecOp)op, &decCtx);
+        if (r == 0 || ns < best) best = ns;
+      }
+      printf("bench=codec dist=%s op=%s values=%d ns_per_op=%.1f\n", d->zName, codecOpName[op], nValue, best / nValue);
+      fflush(stdout);
+    }
+  }
+  codecFree(&data);
+  return nFailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,268 @@
+/**
+ * \file      concurrency.c
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     Benchmark of decimal aggregates on many connections at once.
+ *
+ * Usage:
+ *
+ *     concurrency [-n rows] [-t threads] [-q queries] [-f file] [-x extension]
+ *
+ * The benchmark fills a table of `rows` random decimals (100000 by default)
+ * in a WAL database (`bench_concurrency.db` by default), then runs the same
+ * workload with 1, 2, 4, ... up to `threads` threads (64 by default). Each
+ * thread opens its own connection, loads the extension, sets its own
+ * precision, and executes `queries` aggregate queries (200 by default), each
+ * computing `decSum()`, `decAvg()`, `decMin()` and `decMax()` over a range of
+ * 1000 rows. Every result is compared with the one computed beforehand by a
+ * single connection, so that a race on the extension state shows up as a
+ * mismatch rather than as a wrong throughput.
+ *
+ * The result is printed as one line per thread count, of the form
+ * `bench=concurrency threads=T queries=Q mismatches=M qps=X speedup=S`,
+ * where the speedup is relative to the single-threaded run.
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sqlite3.h"
+
+#define RANGE_ROWS 1000 /**< The number of rows aggregated by each query. */
+#define NRANGES    64   /**< The number of distinct ranges.              */
+
+static char const* const zQuery =
+  "select decStr(decSum(x)) || ' ' || decStr(decAvg(x)) || ' ' || decStr(decMin(x)) || ' ' || decStr(decMax(x)) "
+  "from t where rowid between ?1 and ?1 + ?2 - 1";
+
+/**
+ * \brief Parameters shared by all the threads of a run.
+ */
+typedef struct benchRun {
+  char const* zFile;          /**< The database file.                       */
+  char const* zExt;           /**< The extension to load.                   */
+  int nRow;                   /**< The number of rows in the table.         */
+  int nQuery;                 /**< The number of queries per thread.        */
+  char* azExpected[NRANGES];  /**< The expected result for each range.      */
+  pthread_mutex_t mutex;      /**< Protects nReady and isStarted.           */
+  pthread_cond_t cond;        /**< Signals a change of nReady or isStarted. */
+  int nReady;                 /**< The number of connected threads.         */
+  int isStarted;              /**< Whether the threads may start querying.  */
+} benchRun;
+
+/**
+ * \brief State of a thread.
+ */
+typedef struct benchThread {
+  pthread_t thread;
+  benchRun* run;
+  int id;
+  int nMismatch;              /**< The number of wrong or failed queries.   */
+} benchThread;
+
+static void usage(char const* zProg) {
+  fprintf(stderr, "Usage: %s [-n rows] [-t threads] [-q queries] [-f file] [-x extension]\n", zProg);
+  exit(EXIT_FAILURE);
+}
+
+/**
+ * \brief Returns the time elapsed since \a start, in nanoseconds.
+ */
+static double elapsedNs(struct timespec const* start) {
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return (double)(end.tv_sec - start->tv_sec) * 1e9 + (double)(end.tv_nsec - start->tv_nsec);
+}
+
+/**
+ * \brief Opens a connection to the benchmark database and loads the extension.
+ *
+ * \return A connection, or `0` on error (which is reported).
+ */
+static sqlite3* openDatabase(char const* zFile, char const* zExt) {
+  sqlite3* db;
+  char* zErrMsg = 0;
+  if (sqlite3_open(zFile, &db) != SQLITE_OK) {
+    fprintf(stderr, "Cannot open %s: %s\n", zFile, sqlite3_errmsg(db));
+    sqlite3_close(db);
+    return 0;
+  }
+  sqlite3_db_config(db, SQLITE_DBCONFIG_ENABLE_LOAD_EXTENSION, 1, 0);
+  if (sqlite3_load_extension(db, zExt, "sqlite3_decimal_init", &zErrMsg) != SQLITE_OK) {
+    fprintf(stderr, "Cannot load %s: %s\n", zExt, zErrMsg);
+    sqlite3_free(zErrMsg);
+    sqlite3_close(db);
+    return 0;
+  }
+  sqlite3_busy_timeout(db, 10000);
+  return db;
+}
+
+/**
+ * \brief Returns the first row of the aggregate query for the given range.
+ *
+ * \return A string to be freed with sqlite3_free(), or `0` on error.
+ */
+static char* queryRange(sqlite3_stmt* pStmt, int iRange) {
+  char* zResult = 0;
+  sqlite3_bind_int(pStmt, 1, 1 + iRange * RANGE_ROWS);
+  sqlite3_bind_int(pStmt, 2, RANGE_ROWS);
+  if (sqlite3_step(pStmt) == SQLITE_ROW)
+    zResult = sqlite3_mprintf("%s", sqlite3_column_text(pStmt, 0));
+  sqlite3_reset(pStmt);
+  return zResult;
+}
+
+static void* benchThreadMain(void* pArg) {
+  benchThread* t = (benchThread*)pArg;
+  benchRun* run = t->run;
+  sqlite3_stmt* pStmt = 0;
+  int nRange = run->nRow / RANGE_ROWS < NRANGES ? run->nRow / RANGE_ROWS : NRANGES;
+
+  sqlite3* db = openDatabase(run->zFile, run->zExt);
+  // A per-thread precision (large enough not to round any result) makes a
+  // context shared between connections visible as a failure.
+  char zSql[64];
+  snprintf(zSql, sizeof(zSql), "update decContext set prec = %d", 33 + 3 * (t->id % 3));
+  if (db == 0 || sqlite3_exec(db, zSql, 0, 0, 0) != SQLITE_OK ||
+      sqlite3_prepare_v2(db, zQuery, -1, &pStmt, 0) != SQLITE_OK)
+    t->nMismatch = run->nQuery;
+
+  pthread_mutex_lock(&run->mutex);
+  run->nReady++;
+  pthread_cond_broadcast(&run->cond);
+  while (!run->isStarted) pthread_cond_wait(&run->cond, &run->mutex);
+  pthread_mutex_unlock(&run->mutex);
+
+  for (int i = 0; pStmt && i < run->nQuery; i++) {
+    int const iRange = (t->id + i) % nRange;
+    char* zResult = queryRange(pStmt, iRange);
+    if (zResult == 0 || strcmp(zResult, run->azExpected[iRange]) != 0) t->nMismatch++;
+    sqlite3_free(zResult);
+  }
+  sqlite3_finalize(pStmt);
+  sqlite3_close(db);
+  return 0;
+}
+
+/**
+ * \brief Runs the workload with the given number of threads.
+ *
+ * \return The number of queries per second, or a negative value if the
+ *         threads cannot be started.
+ */
+static double runThreads(benchRun* run, int nThread, int* pnMismatch) {
+  benchThread* aThread = calloc((size_t)nThread, sizeof(benchThread));
+  int nStarted = 0;
+
+  if (aThread == 0) return -1.0;
+  run->nReady = 0;
+  run->isStarted = 0;
+  for (; nStarted < nThread; nStarted++) {
+    aThread[nStarted].run = run;
+    aThread[nStarted].id = nStarted;
+    if (pthread_create(&aThread[nStarted].thread, 0, benchThreadMain, &aThread[nStarted]) != 0) break;
+  }
+  // Connecting is not part of the measure: start the clock when all the
+  // threads are ready to query.
+  pthread_mutex_lock(&run->mutex);
+  while (run->nReady < nStarted) pthread_cond_wait(&run->cond, &run->mutex);
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  run->isStarted = 1;
+  pthread_cond_broadcast(&run->cond);
+  pthread_mutex_unlock(&run->mutex);
+
+  *pnMismatch = 0;
+  for (int i = 0; i < nStarted; i++) {
+    pthread_join(aThread[i].thread, 0);
+    *pnMismatch += aThread[i].nMismatch;
+  }
+  double const ns = elapsedNs(&start);
+  free(aThread);
+  if (nStarted < nThread) return -1.0;
+  return (double)nThread * run->nQuery * 1e9 / ns;
+}
+
+/**
+ * \brief Creates the benchmark table and computes the expected results.
+ *
+ * \return `0` on success; `1` on error (which is reported).
+ */
+static int setup(benchRun* run) {
+  sqlite3_stmt* pStmt;
+  char zSql[160];
+
+  remove(run->zFile);
+  sqlite3* db = openDatabase(run->zFile, run->zExt);
+  if (db == 0) return 1;
+  snprintf(zSql, sizeof(zSql),
+           "pragma journal_mode = wal;"
+           "create table t(x);"
+           "insert into t select value from decRandom(%d, 15, -6, 2, 42);", run->nRow);
+  int rc = sqlite3_exec(db, zSql, 0, 0, 0);
+  if (rc == SQLITE_OK) rc = sqlite3_prepare_v2(db, zQuery, -1, &pStmt, 0);
+  if (rc != SQLITE_OK) {
+    fprintf(stderr, "%s\n", sqlite3_errmsg(db));
+    sqlite3_close(db);
+    return 1;
+  }
+  for (int i = 0; i < NRANGES && rc == SQLITE_OK; i++)
+    if ((run->azExpected[i] = queryRange(pStmt, i)) == 0) rc = SQLITE_ERROR;
+  sqlite3_finalize(pStmt);
+  sqlite3_close(db);
+  return rc != SQLITE_OK;
+}
+
+int main(int argc, char* argv[]) {
+  benchRun run = { .zFile = "bench_concurrency.db", .zExt = "./libsqlite3decimal", .nRow = 100000, .nQuery = 200 };
+  int nMaxThread = 64;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) run.nRow = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) nMaxThread = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) run.nQuery = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) run.zFile = argv[++i];
+    else if (strcmp(argv[i], "-x") == 0 && i + 1 < argc) run.zExt = argv[++i];
+    else usage(argv[0]);
+  }
+  if (run.nRow < RANGE_ROWS || nMaxThread <= 0 || run.nQuery <= 0) usage(argv[0]);
+  if (setup(&run)) return EXIT_FAILURE;
+
+  pthread_mutex_init(&run.mutex, 0);
+  pthread_cond_init(&run.cond, 0);
+  int nFailed = 0;
+  double qps1 = 0.0;
+  for (int nThread = 1; nThread <= nMaxThread; nThread = nThread < nMaxThread && 2 * nThread > nMaxThread ? nMaxThread : 2 * nThread) {
+    int nMismatch;
+    double const qps = runThreads(&run, nThread, &nMismatch);
+    if (qps < 0) {
+      fprintf(stderr, "Cannot start %d threads\n", nThread);
+      nFailed++;
+      break;
+    }
+    if (nThread == 1) qps1 = qps;
+    printf("bench=concurrency threads=%d queries=%d mismatches=%d qps=%.1f speedup=%.2f\n",
+           nThread, nThread * run.nQuery, nMismatch, qps, qps / qps1);
+    fflush(stdout);
+    if (nMismatch) nFailed++;
+  }
+  pthread_cond_destroy(&run.cond);
+  pthread_mutex_destroy(&run.mutex);
+  for (int i = 0; i < NRANGES; i++) sqlite3_free(run.azExpected[i]);
+  remove(run.zFile);
+  char zAux[FILENAME_MAX];
+  snprintf(zAux, sizeof(zAux), "%s-wal", run.zFile);
+  remove(zAux);
+  snprintf(zAux, sizeof(zAux), "%s-shm", run.zFile);
+  remove(zAux);
+  return nFailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
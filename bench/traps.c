@@ -0,0 +1,123 @@
+/**
+ * \file      traps.c
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     Benchmark of error-heavy workloads.
+ *
+ * Usage:
+ *
+ *     traps [-n rows] [-e percent] [-x extension]
+ *
+ * Each workload evaluates one statement per row, as an application that
+ * converts or computes values one at a time does, and a given percentage
+ * of the rows (10% by default) makes the statement fail with a trapped
+ * condition:
+ *
+ * - `div`: `decDiv(x, y)`, where `y` is zero in the failing rows
+ *   (`Division by zero`);
+ * - `dec`: `dec(x)`, where `x` is not a number in the failing rows
+ *   (`Conversion syntax`).
+ *
+ * The result is printed as one line per workload, of the form
+ * `bench=traps workload=div rows=N errors=M ns_per_row=T`.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sqlite3.h"
+
+static void usage(char const* zProg) {
+  fprintf(stderr, "Usage: %s [-n rows] [-e percent] [-x extension]\n", zProg);
+  exit(EXIT_FAILURE);
+}
+
+/**
+ * \brief Returns the time elapsed since \a start, in nanoseconds.
+ */
+static double elapsedNs(struct timespec const* start) {
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return (double)(end.tv_sec - start->tv_sec) * 1e9 + (double)(end.tv_nsec - start->tv_nsec);
+}
+
+/**
+ * \brief Runs a workload and prints its result.
+ *
+ * \return `0` on success; `1` if the statement cannot be prepared or fails
+ *         in a row that should not.
+ */
+static int runWorkload(sqlite3* db, char const* zName, char const* zSql, int nRow, int percent) {
+  sqlite3_stmt* pStmt;
+  char zArg[32];
+  int nError = 0;
+
+  if (sqlite3_prepare_v2(db, zSql, -1, &pStmt, 0) != SQLITE_OK) {
+    fprintf(stderr, "%s\n", sqlite3_errmsg(db));
+    return 1;
+  }
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < nRow; i++) {
+    int const isBad = (i % 100) < percent;
+    snprintf(zArg, sizeof(zArg), "%d.%02d", i, i % 100);
+    sqlite3_bind_text(pStmt, 1, zArg, -1, SQLITE_TRANSIENT);
+    if (strcmp(zName, "div") == 0)
+      sqlite3_bind_text(pStmt, 2, isBad ? "0" : "7.5", -1, SQLITE_STATIC);
+    else if (isBad)
+      sqlite3_bind_text(pStmt, 1, "n/a", -1, SQLITE_STATIC);
+    int rc = sqlite3_step(pStmt);
+    sqlite3_reset(pStmt);
+    if (rc != SQLITE_ROW) {
+      if (!isBad) {
+        fprintf(stderr, "Row %d: %s\n", i, sqlite3_errmsg(db));
+        sqlite3_finalize(pStmt);
+        return 1;
+      }
+      nError++;
+    }
+  }
+  double const ns = elapsedNs(&start);
+  sqlite3_finalize(pStmt);
+  printf("bench=traps workload=%s rows=%d errors=%d ns_per_row=%.1f\n", zName, nRow, nError, ns / nRow);
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
+  char const* zExt = "./libsqlite3decimal";
+  int nRow = 1000000;
+  int percent = 10;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) nRow = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) percent = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-x") == 0 && i + 1 < argc) zExt = argv[++i];
+    else usage(argv[0]);
+  }
+  if (nRow <= 0 || percent < 0 || percent > 100) usage(argv[0]);
+
+  sqlite3* db;
+  char* zErrMsg = 0;
+  int rc = sqlite3_open(":memory:", &db);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_db_config(db, SQLITE_DBCONFIG_ENABLE_LOAD_EXTENSION, 1, 0);
+  if (rc == SQLITE_OK && sqlite3_load_extension(db, zExt, "sqlite3_decimal_init", &zErrMsg) != SQLITE_OK) {
+    fprintf(stderr, "Cannot load %s: %s\n", zExt, zErrMsg);
+    sqlite3_free(zErrMsg);
+    sqlite3_close(db);
+    return EXIT_FAILURE;
+  }
+
+  int nFailed = 0;
+  nFailed += runWorkload(db, "div", "select decDiv(?1, ?2)", nRow, percent);
+  nFailed += runWorkload(db, "dec", "select dec(?1)", nRow, percent);
+  sqlite3_close(db);
+  return nFailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
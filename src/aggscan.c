@@ -0,0 +1,610 @@
+/**
+ * \file      aggscan.c
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     Batch-mode aggregation of a decimal column.
+ *
+ * `decAggScan(table, column, op [, where])` computes `decSum()`, `decAvg()`,
+ * `decMin()` or `decMax()` of a column in a single call, returning one row
+ * with the result (`value`) and the number of aggregated values (`count`).
+ *
+ * The values are read by a prepared statement and collected in batches of
+ * #AGGSCAN_BATCH_SIZE encoded values, which are then decoded and reduced in
+ * a tight loop. Sums use a 128-bit integer accumulator for as long as the
+ * partial sums are exact, i.e., for as long as the aggregate function
+ * computing the same sum one value at a time would not round; from then on,
+ * values are added with decNumber. Minima and maxima are computed on the
+ * encoded values, which are order-preserving, and only the result is decoded
+ * (until a NaN is met). Hence, the results are the same as those of the
+ * corresponding aggregate functions, except that a malformed blob is reported
+ * by min and max only if it is the result.
+ */
+#include <string.h>
+#include "impl_decinfinite.h"
+
+#ifndef SQLITE_OMIT_VIRTUALTABLE
+
+/**
+ * \brief The number of values decoded and reduced at a time.
+ */
+#define AGGSCAN_BATCH_SIZE 1024
+
+#if defined(__SIZEOF_INT128__)
+/**
+ * \brief Whether a 128-bit integer accumulator is available.
+ */
+#define AGGSCAN_HAVE_INT128 1
+__extension__ typedef __int128 aggscanInt128;
+__extension__ typedef unsigned __int128 aggscanUInt128;
+#endif
+
+/** \brief Column index of the `value` column of decAggScan. */
+#define AGGSCAN_COLUMN_VALUE 0
+/** \brief Column index of the `count` column of decAggScan. */
+#define AGGSCAN_COLUMN_COUNT 1
+/** \brief Column index of the first hidden column of decAggScan. */
+#define AGGSCAN_COLUMN_TAB   2
+/** \brief Number of arguments of decAggScan. */
+#define AGGSCAN_NARGS        4
+
+/**
+ * \brief The aggregate operations.
+ */
+typedef enum {
+  AGGSCAN_SUM,
+  AGGSCAN_AVG,
+  AGGSCAN_MIN,
+  AGGSCAN_MAX
+} aggscanOp;
+
+/**
+ * \brief The state of an aggregation.
+ */
+typedef struct aggscanState {
+  decContext* decCtx;      /**< The context used for all the operations.    */
+  aggscanOp op;            /**< The aggregate operation.                    */
+  uint32_t count;          /**< The number of values aggregated so far.     */
+  decNumber value;         /**< The aggregate, unless kept in best or acc.  */
+  int inBest;              /**< Whether the min/max is (still) in best.     */
+  int bestLen;             /**< The length of best.                         */
+  uint8_t best[DECINF_MAXSIZE]; /**< The encoded min/max (if inBest is set). */
+#if AGGSCAN_HAVE_INT128
+  int inAcc;               /**< Whether the sum is (still) in acc.          */
+  aggscanInt128 acc;       /**< The sum's coefficient (when inAcc is set).  */
+  int32_t exponent;        /**< The exponent of acc.                        */
+  aggscanInt128 limit;     /**< Partial sums must be smaller than this.     */
+#endif
+} aggscanState;
+
+/**
+ * \brief A batch of encoded values.
+ */
+typedef struct aggscanBatch {
+  int n;                                                 /**< Number of values.  */
+  int aLen[AGGSCAN_BATCH_SIZE];                          /**< Their lengths.     */
+  uint8_t aBytes[AGGSCAN_BATCH_SIZE][DECINF_MAXSIZE];    /**< The values.        */
+} aggscanBatch;
+
+#pragma mark Reduction
+
+#if AGGSCAN_HAVE_INT128
+
+/**
+ * \brief Converts the 128-bit accumulator into a decNumber.
+ */
+static void aggscanAccToNumber(aggscanState* s) {
+  aggscanInt128 a = s->acc;
+  aggscanUInt128 u = a < 0 ? -(aggscanUInt128)a : (aggscanUInt128)a;
+  decNumber* dn = &s->value;
+
+  decNumberZero(dn);
+  if (a < 0) dn->bits = DECNEG;
+  if (u > 0) {
+    Unit* up = dn->lsu;
+    for (; u > 0; u /= 1000) *up++ = (Unit)(u % 1000);
+    --up;
+    dn->digits = DECDPUN * (int32_t)(up - dn->lsu) + (*up > 99 ? 3 : *up > 9 ? 2 : 1);
+  }
+  dn->exponent = s->exponent;
+  s->inAcc = 0;
+}
+
+/**
+ * \brief Adds `coeff x 10^exponent` to the 128-bit accumulator, if the
+ *        result is exact.
+ *
+ * \return `1` if the value has been added; `0` if the sum must continue with
+ *         decNumber.
+ */
+static int aggscanAccAdd(aggscanState* s, int64_t coeff, int32_t exponent) {
+  aggscanInt128 const limit10 = s->limit / 10;
+  aggscanInt128 c = coeff;
+  if (s->count == 0) { // The first value sets the exponent
+    s->exponent = exponent;
+    s->acc = c;
+    return 1;
+  }
+  if (exponent < s->exponent) { // Rescale the accumulator
+    aggscanInt128 a = s->acc;
+    for (int32_t k = s->exponent - exponent; k > 0; k--) {
+      if (a >= limit10 || a <= -limit10) return 0;
+      a *= 10;
+    }
+    s->acc = a;
+    s->exponent = exponent;
+  }
+  else { // Rescale the value
+    for (int32_t k = exponent - s->exponent; k > 0; k--) {
+      if (c >= limit10 || c <= -limit10) return 0;
+      c *= 10;
+    }
+  }
+  aggscanInt128 sum = s->acc + c;
+  if (sum >= s->limit || sum <= -s->limit) return 0;
+  s->acc = sum;
+  return 1;
+}
+
+#endif /* AGGSCAN_HAVE_INT128 */
+
+/**
+ * \brief Adds a decoded value to an aggregate.
+ */
+static void aggscanReduce(aggscanState* s, decNumber const* dn) {
+#if AGGSCAN_HAVE_INT128
+  if (s->inAcc) { // The value does not fit the accumulator
+    if (s->count > 0) aggscanAccToNumber(s);
+    else s->inAcc = 0;
+  }
+#endif
+  if (s->count == 0)
+    s->value = *dn;
+  else switch (s->op) {
+    case AGGSCAN_SUM:
+    case AGGSCAN_AVG:
+      decNumberAdd(&s->value, &s->value, dn, s->decCtx);
+      break;
+    case AGGSCAN_MIN:
+      decNumberMin(&s->value, &s->value, dn, s->decCtx);
+      break;
+    case AGGSCAN_MAX:
+      decNumberMax(&s->value, &s->value, dn, s->decCtx);
+      break;
+  }
+  s->count++;
+}
+
+/**
+ * \brief Decodes the encoded minimum or maximum into the aggregate.
+ */
+static void aggscanBestToNumber(aggscanState* s) {
+  if (s->count > 0 && !decInfiniteToNumber((size_t)s->bestLen, s->best, &s->value)) {
+    decNumberZero(&s->value);
+    s->value.bits = DECNAN;
+    decContextSetStatusQuiet(s->decCtx, DEC_Conversion_syntax);
+  }
+  s->inBest = 0;
+}
+
+/**
+ * \brief Reduces a batch of values to their minimum or maximum without
+ *        decoding them.
+ *
+ * The encoding is order-preserving, so the values are compared as byte
+ * strings until the first NaN, whose comparison is not an ordering.
+ *
+ * \return The number of values reduced.
+ */
+static int aggscanReduceBestBatch(aggscanState* s, aggscanBatch* batch) {
+  int const sign = (s->op == AGGSCAN_MAX) ? 1 : -1;
+  int i;
+  for (i = 0; i < batch->n; i++) {
+    int len = batch->aLen[i];
+    uint8_t const* bytes = batch->aBytes[i];
+    if (len == 1 && (bytes[0] == 0x00 || bytes[0] == 0xE0)) { // NaN
+      aggscanBestToNumber(s);
+      break;
+    }
+    if (s->count > 0) {
+      int n = len < s->bestLen ? len : s->bestLen;
+      int cmp = memcmp(bytes, s->best, (size_t)n);
+      if (cmp == 0) cmp = len - s->bestLen;
+      if (cmp * sign <= 0) {
+        s->count++;
+        continue;
+      }
+    }
+    memcpy(s->best, bytes, (size_t)len);
+    s->bestLen = len;
+    s->count++;
+  }
+  return i;
+}
+
+/**
+ * \brief Decodes and reduces a batch of values.
+ *
+ * \return `SQLITE_OK`, or `SQLITE_ERROR` if a trapped condition occurs.
+ */
+static int aggscanReduceBatch(aggscanState* s, aggscanBatch* batch) {
+  decContext* decCtx = s->decCtx;
+  int i = s->inBest ? aggscanReduceBestBatch(s, batch) : 0;
+  for (; i < batch->n; i++) {
+    decNumber dn;
+#if AGGSCAN_HAVE_INT128
+    if (s->inAcc) {
+      int64_t coeff;
+      int32_t exponent;
+      if (decInfiniteToInt64((size_t)batch->aLen[i], batch->aBytes[i], &coeff, &exponent)
+          && aggscanAccAdd(s, coeff, exponent)) {
+        s->count++;
+        continue;
+      }
+    }
+#endif
+    if (!decInfiniteToNumber((size_t)batch->aLen[i], batch->aBytes[i], &dn)) {
+      decNumberZero(&dn);
+      dn.bits = DECNAN;
+      decContextSetStatusQuiet(decCtx, DEC_Conversion_syntax);
+    }
+    if (decContextGetStatus(decCtx) & decCtx->traps) return SQLITE_ERROR;
+    aggscanReduce(s, &dn);
+  }
+  batch->n = 0;
+  return SQLITE_OK;
+}
+
+/**
+ * \brief Adds a value read from the database to a batch.
+ *
+ * Blobs that may be decInfinite encodings are copied as they are; other
+ * values (including DPD blobs and blobs of invalid length) are converted as
+ * decSum() does, so a value that is not a decimal becomes `NaN` and sets
+ * `Conversion syntax`.
+ *
+ * \return `SQLITE_OK`, or `SQLITE_ERROR` if the value cannot be converted or
+ *         a trapped condition occurs.
+ */
+static int aggscanCollect(aggscanBatch* batch, sqlite3_value* value, decContext* decCtx) {
+  int i = batch->n;
+  int len = sqlite3_value_type(value) == SQLITE_BLOB ? sqlite3_value_bytes(value) : 0;
+  uint8_t const* bytes = len > 0 ? sqlite3_value_blob(value) : 0;
+  if (len > 0 && len <= DECINF_MAXSIZE && bytes[0] != DECIMAL_DPD_TAG) {
+    memcpy(batch->aBytes[i], bytes, (size_t)len);
+    batch->aLen[i] = len;
+  }
+  else {
+    decNumber dn;
+    if (decNumberFromSQLite3Value(&dn, value, decCtx) == 0) return SQLITE_ERROR;
+    if (decContextGetStatus(decCtx) & decCtx->traps) return SQLITE_ERROR;
+    batch->aLen[i] = (int)decInfiniteFromNumber(DECINF_MAXSIZE, batch->aBytes[i], &dn);
+  }
+  batch->n++;
+  return SQLITE_OK;
+}
+
+/**
+ * \brief Computes the result of an aggregation after the last value.
+ */
+static void aggscanFinalize(aggscanState* s) {
+  if (s->inBest) aggscanBestToNumber(s);
+#if AGGSCAN_HAVE_INT128
+  if (s->inAcc && s->count > 0) aggscanAccToNumber(s);
+#endif
+  if (s->count == 0) {
+    decNumberZero(&s->value);
+    switch (s->op) {
+      case AGGSCAN_SUM: break;
+      case AGGSCAN_AVG: s->value.bits = DECNAN; break;
+      case AGGSCAN_MIN: s->value.bits = DECNEG | DECINF; break;
+      case AGGSCAN_MAX: s->value.bits = DECINF; break;
+    }
+  }
+  else if (s->op == AGGSCAN_AVG) {
+    decNumber count;
+    decNumberFromUInt32(&count, s->count);
+    decNumberDivide(&s->value, &s->value, &count, s->decCtx);
+  }
+}
+
+#pragma mark Virtual table
+
+/**
+ * \brief SQL definition of the decAggScan virtual table.
+ */
+#define SQLITE_DECIMAL_AGGSCAN_TABLE \
+  "create table x(value blob, count integer, tab hidden, col hidden, op hidden, cond hidden)"
+
+typedef struct decimalAggScanVTab decimalAggScanVTab;
+
+/**
+ * \brief A decAggScan virtual table.
+ */
+struct decimalAggScanVTab {
+  sqlite3_vtab base;  /**< Base class - must be first. */
+  sqlite3* db;        /**< The database connection.    */
+  decContext* decCtx; /**< The shared context.         */
+};
+
+typedef struct decimalAggScanCursor decimalAggScanCursor;
+
+/**
+ * \brief A cursor over decAggScan.
+ */
+struct decimalAggScanCursor {
+  sqlite3_vtab_cursor base;                 /**< Base class - must be first. */
+  int isEof;                                /**< Whether the row was read.   */
+  decNumber value;                          /**< The result.                 */
+  uint32_t count;                           /**< The number of values.       */
+  sqlite3_value* aArg[AGGSCAN_NARGS];       /**< The arguments.              */
+};
+
+static int decimalAggScanConnect(sqlite3* db, void* pAux, int argc, char const* const* argv,
+                                 sqlite3_vtab** ppVtab, char** pzErr) {
+  (void)argc;
+  (void)argv;
+  (void)pzErr;
+
+  decimalAggScanVTab* pVtab;
+  int rc;
+
+  rc = sqlite3_declare_vtab(db, SQLITE_DECIMAL_AGGSCAN_TABLE);
+  if (rc == SQLITE_OK) {
+    pVtab = sqlite3_malloc(sizeof(*pVtab));
+    *ppVtab = (sqlite3_vtab*)pVtab;
+    if (pVtab == 0) return SQLITE_NOMEM;
+    memset(pVtab, 0, sizeof(*pVtab));
+    pVtab->db = db;
+    pVtab->decCtx = pAux;
+  }
+  return rc;
+}
+
+static int decimalAggScanDisconnect(sqlite3_vtab* pVtab) {
+  sqlite3_free(pVtab);
+  return SQLITE_OK;
+}
+
+static int decimalAggScanOpen(sqlite3_vtab* p, sqlite3_vtab_cursor** ppCursor) {
+  (void)p;
+  decimalAggScanCursor* pCur;
+  pCur = sqlite3_malloc(sizeof(*pCur));
+  if (pCur == 0) return SQLITE_NOMEM;
+  memset(pCur, 0, sizeof(*pCur));
+  pCur->isEof = 1;
+  *ppCursor = &pCur->base;
+  return SQLITE_OK;
+}
+
+static void aggscanFreeArgs(decimalAggScanCursor* pCur) {
+  for (int i = 0; i < AGGSCAN_NARGS; i++) {
+    sqlite3_value_free(pCur->aArg[i]);
+    pCur->aArg[i] = 0;
+  }
+}
+
+static int decimalAggScanClose(sqlite3_vtab_cursor* cur) {
+  aggscanFreeArgs((decimalAggScanCursor*)cur);
+  sqlite3_free(cur);
+  return SQLITE_OK;
+}
+
+static int decimalAggScanNext(sqlite3_vtab_cursor* cur) {
+  ((decimalAggScanCursor*)cur)->isEof = 1;
+  return SQLITE_OK;
+}
+
+static int decimalAggScanEof(sqlite3_vtab_cursor* cur) {
+  return ((decimalAggScanCursor*)cur)->isEof;
+}
+
+static int decimalAggScanColumn(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int i) {
+  decimalAggScanCursor* pCur = (decimalAggScanCursor*)cur;
+  if (i == AGGSCAN_COLUMN_VALUE) {
+    decNumber value = pCur->value; // Encoding modifies its input
+    decNumberToSQLite3Blob(ctx, &value);
+  }
+  else if (i == AGGSCAN_COLUMN_COUNT)
+    sqlite3_result_int64(ctx, pCur->count);
+  else if (pCur->aArg[i - AGGSCAN_COLUMN_TAB])
+    sqlite3_result_value(ctx, pCur->aArg[i - AGGSCAN_COLUMN_TAB]);
+  return SQLITE_OK;
+}
+
+static int decimalAggScanRowid(sqlite3_vtab_cursor* cur, sqlite_int64* pRowid) {
+  (void)cur;
+  *pRowid = 1;
+  return SQLITE_OK;
+}
+
+/**
+ * \brief Runs the aggregation.
+ *
+ * \a idxNum has a bit for each argument that is given, in column order.
+ */
+static int decimalAggScanFilter(sqlite3_vtab_cursor* cur, int idxNum, char const* idxStr,
+                                int argc, sqlite3_value** argv) {
+  (void)idxStr;
+  (void)argc;
+
+  decimalAggScanCursor* pCur = (decimalAggScanCursor*)cur;
+  decimalAggScanVTab* pVtab = (decimalAggScanVTab*)cur->pVtab;
+  aggscanState state; // On the stack, as 128-bit integers need 16-byte alignment
+  aggscanState* s = &state;
+  aggscanBatch* batch = 0;
+  sqlite3_stmt* pStmt = 0;
+  char* zSql;
+  int rc;
+  int j = 0;
+
+  aggscanFreeArgs(pCur);
+  for (int i = 0; i < AGGSCAN_NARGS; i++) {
+    if (!(idxNum & (1 << i))) continue;
+    pCur->aArg[i] = sqlite3_value_dup(argv[j++]);
+    if (pCur->aArg[i] == 0 && sqlite3_value_type(argv[j - 1]) != SQLITE_NULL) return SQLITE_NOMEM;
+  }
+  for (int i = 0; i < AGGSCAN_NARGS - 1; i++) {
+    if (pCur->aArg[i] == 0 || sqlite3_value_type(pCur->aArg[i]) == SQLITE_NULL) {
+      pVtab->base.zErrMsg = sqlite3_mprintf("The table, column and operation of decAggScan are required");
+      return SQLITE_ERROR;
+    }
+  }
+
+  memset(s, 0, sizeof(*s));
+  s->decCtx = pVtab->decCtx;
+  char const* zOp = (char const*)sqlite3_value_text(pCur->aArg[2]);
+  if (sqlite3_stricmp(zOp, "sum") == 0) s->op = AGGSCAN_SUM;
+  else if (sqlite3_stricmp(zOp, "avg") == 0) s->op = AGGSCAN_AVG;
+  else if (sqlite3_stricmp(zOp, "min") == 0) s->op = AGGSCAN_MIN;
+  else if (sqlite3_stricmp(zOp, "max") == 0) s->op = AGGSCAN_MAX;
+  else {
+    pVtab->base.zErrMsg = sqlite3_mprintf("Unknown aggregate operation: %s", zOp);
+    return SQLITE_ERROR;
+  }
+  s->inBest = (s->op == AGGSCAN_MIN || s->op == AGGSCAN_MAX);
+#if AGGSCAN_HAVE_INT128
+  s->inAcc = (s->op == AGGSCAN_SUM || s->op == AGGSCAN_AVG);
+  s->limit = 1;
+  for (int32_t k = s->decCtx->digits < 38 ? s->decCtx->digits : 38; k > 0; k--) s->limit *= 10;
+#endif
+
+  char const* zTab = (char const*)sqlite3_value_text(pCur->aArg[0]);
+  char const* zCol = (char const*)sqlite3_value_text(pCur->aArg[1]);
+  sqlite3_value* pWhere = pCur->aArg[3];
+  if (pWhere && sqlite3_value_type(pWhere) != SQLITE_NULL)
+    zSql = sqlite3_mprintf("select \"%w\".\"%w\" from \"%w\" where (%s)", zTab, zCol, zTab,
+                           sqlite3_value_text(pWhere));
+  else // The column is qualified, so that it cannot be taken for a string
+    zSql = sqlite3_mprintf("select \"%w\".\"%w\" from \"%w\"", zTab, zCol, zTab);
+  if (zSql == 0) return SQLITE_NOMEM;
+  rc = sqlite3_prepare_v2(pVtab->db, zSql, -1, &pStmt, 0);
+  sqlite3_free(zSql);
+  if (rc != SQLITE_OK) {
+    pVtab->base.zErrMsg = sqlite3_mprintf("%s", sqlite3_errmsg(pVtab->db));
+    return rc;
+  }
+
+  batch = sqlite3_malloc(sizeof(*batch));
+  if (batch == 0) {
+    sqlite3_finalize(pStmt);
+    return SQLITE_NOMEM;
+  }
+  batch->n = 0;
+
+  int isDecError = 0; // Whether a value cannot be converted or trapped
+  while ((rc = sqlite3_step(pStmt)) == SQLITE_ROW) {
+    sqlite3_value* value = sqlite3_column_value(pStmt, 0);
+    if (sqlite3_value_type(value) == SQLITE_NULL) continue;
+    if (aggscanCollect(batch, value, s->decCtx) != SQLITE_OK
+        || (batch->n == AGGSCAN_BATCH_SIZE && aggscanReduceBatch(s, batch) != SQLITE_OK)) {
+      isDecError = 1;
+      break;
+    }
+  }
+  if (rc == SQLITE_DONE) {
+    rc = SQLITE_OK;
+    isDecError = (aggscanReduceBatch(s, batch) != SQLITE_OK);
+  }
+  else if (!isDecError)
+    pVtab->base.zErrMsg = sqlite3_mprintf("%s", sqlite3_errmsg(pVtab->db));
+  sqlite3_free(batch);
+  sqlite3_finalize(pStmt);
+
+  if (isDecError) {
+    if (decimalCheckTraps(s->decCtx, &pVtab->base.zErrMsg) == SQLITE_OK)
+      pVtab->base.zErrMsg = sqlite3_mprintf("Cannot create decimal from the given type");
+    rc = SQLITE_ERROR;
+  }
+  else if (rc == SQLITE_OK) {
+    aggscanFinalize(s);
+    rc = decimalCheckTraps(s->decCtx, &pVtab->base.zErrMsg);
+    pCur->value = s->value;
+    pCur->count = s->count;
+  }
+  pCur->isEof = (rc != SQLITE_OK);
+  return rc;
+}
+
+/**
+ * \brief Implementation of the xBestIndex method for decAggScan.
+ *
+ * The table, the column and the operation are required; the condition is
+ * optional.
+ */
+static int decimalAggScanBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
+  int aIdx[AGGSCAN_NARGS] = { -1, -1, -1, -1 };
+  int idxNum = 0;
+  int unusable = 0;
+
+  for (int i = 0; i < pIdxInfo->nConstraint; i++) {
+    struct sqlite3_index_constraint const* pCons = &pIdxInfo->aConstraint[i];
+    if (pCons->iColumn < AGGSCAN_COLUMN_TAB) continue;
+    if (pCons->op != SQLITE_INDEX_CONSTRAINT_EQ) continue;
+    int k = pCons->iColumn - AGGSCAN_COLUMN_TAB;
+    if (!pCons->usable) {
+      unusable |= (1 << k);
+      continue;
+    }
+    aIdx[k] = i;
+    idxNum |= (1 << k);
+  }
+
+  if (unusable & ~idxNum) return SQLITE_CONSTRAINT;
+  if ((idxNum & 0x7) != 0x7) {
+    sqlite3_free(tab->zErrMsg);
+    tab->zErrMsg = sqlite3_mprintf("The table, column and operation of decAggScan are required");
+    return SQLITE_ERROR;
+  }
+
+  int nArg = 0;
+  for (int k = 0; k < AGGSCAN_NARGS; k++) {
+    if (aIdx[k] < 0) continue;
+    pIdxInfo->aConstraintUsage[aIdx[k]].argvIndex = ++nArg;
+    pIdxInfo->aConstraintUsage[aIdx[k]].omit = 1;
+  }
+  pIdxInfo->idxNum = idxNum;
+  pIdxInfo->estimatedCost = 1000000.0;
+  pIdxInfo->estimatedRows = 1;
+  pIdxInfo->idxFlags = SQLITE_INDEX_SCAN_UNIQUE;
+  return SQLITE_OK;
+}
+
+/**
+ * \brief An eponymous-only virtual table module that implements the
+ *        decAggScan() table-valued function.
+ */
+sqlite3_module decimalAggScanModule = {
+  0,
+  0,
+  decimalAggScanConnect,
+  decimalAggScanBestIndex,
+  decimalAggScanDisconnect,
+  decimalAggScanDisconnect,
+  decimalAggScanOpen,
+  decimalAggScanClose,
+  decimalAggScanFilter,
+  decimalAggScanNext,
+  decimalAggScanEof,
+  decimalAggScanColumn,
+  decimalAggScanRowid,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+};
+
+#endif /* SQLITE_OMIT_VIRTUALTABLE */
@@ -0,0 +1,1141 @@
+/**
+ * \file      arrow.c
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     Import and export of decimal columns in the Apache Arrow IPC
+ *            file format.
+ *
+ * `decArrowExport(query, path)` writes the result of a query to an Arrow
+ * file, and
+ *
+ *     create virtual table t using decArrowScan(path);
+ *
+ * serves the decimal columns of an Arrow file as a read-only table.
+ *
+ * Each column of the query is exported as an Arrow `Decimal128` column or,
+ * when 38 digits are not enough, as a `Decimal256` column. The scale of
+ * a column is the largest number of fractional digits of its values, and
+ * its precision is the smallest one that can hold all the values at that
+ * scale. Values must be finite: NaNs and infinities cannot be exported.
+ * Since the scale must be known before the first value is written, the
+ * values of the query are kept in memory, encoded, until the file is
+ * written.
+ *
+ * The file is written by a small self-contained writer, which produces only
+ * the subset of the format needed here (a schema, record batches without
+ * compression and a footer); the reader accepts files with decimal columns
+ * of any width (32, 64, 128 or 256 bits) written by any Arrow implementation,
+ * as long as they are not compressed. Files are memory-mapped, and values are
+ * converted straight from the mapped record batches.
+ *
+ * \see https://arrow.apache.org/docs/format/Columnar.html
+ */
+#include <stdio.h>
+#include <string.h>
+#include "impl_decinfinite.h"
+#include "mapfile.h"
+
+/**
+ * \brief The signature at the beginning and at the end of an Arrow file.
+ */
+#define ARROW_MAGIC "ARROW1"
+
+/**
+ * \brief Number of rows in each record batch written by decArrowExport().
+ */
+#define ARROW_BATCH_ROWS 65536
+
+/**
+ * \brief Maximum width of a decimal value, in bytes (`Decimal256`).
+ */
+#define ARROW_MAX_WIDTH 32
+
+/**
+ * \brief Maximum precision of a `Decimal128` value.
+ */
+#define ARROW_DEC128_DIGITS 38
+
+/**
+ * \brief Maximum precision of a `Decimal256` value.
+ */
+#define ARROW_DEC256_DIGITS 76
+
+/**
+ * \brief Maximum absolute value of the scale of a column.
+ *
+ * This keeps the exponents of the imported values well within the range
+ * supported by decInfinite.
+ */
+#define ARROW_MAX_SCALE 999999000
+
+/** \brief `MetadataVersion.V5`. */
+#define ARROW_VERSION_V5 4
+/** \brief `MessageHeader.Schema`. */
+#define ARROW_HEADER_SCHEMA 1
+/** \brief `MessageHeader.RecordBatch`. */
+#define ARROW_HEADER_RECORD_BATCH 3
+/** \brief `Type.Decimal`. */
+#define ARROW_TYPE_DECIMAL 7
+
+/**
+ * \brief Rounds a size up to a multiple of 8 bytes.
+ */
+#define ARROW_ALIGN(n) (((n) + 7) & ~(size_t)7)
+
+#pragma mark Little-endian access
+
+static uint16_t arrowGet16(uint8_t const* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t arrowGet32(uint8_t const* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t arrowGet64(uint8_t const* p) {
+  return (uint64_t)arrowGet32(p) | ((uint64_t)arrowGet32(p + 4) << 32);
+}
+
+static void arrowPut16(uint8_t* p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static void arrowPut32(uint8_t* p, uint32_t v) {
+  arrowPut16(p, (uint16_t)v);
+  arrowPut16(p + 2, (uint16_t)(v >> 16));
+}
+
+static void arrowPut64(uint8_t* p, uint64_t v) {
+  arrowPut32(p, (uint32_t)v);
+  arrowPut32(p + 4, (uint32_t)(v >> 32));
+}
+
+#pragma mark Decimal values
+
+/**
+ * \brief Multiplies an unsigned integer by \a m and adds \a a.
+ *
+ * The integer consists of \a n 32-bit limbs, least significant first.
+ */
+static void arrowMulAdd(uint32_t* limb, int n, uint32_t m, uint32_t a) {
+  uint64_t carry = a;
+  for (int i = 0; i < n; i++) {
+    uint64_t x = (uint64_t)limb[i] * m + carry;
+    limb[i] = (uint32_t)x;
+    carry = x >> 32;
+  }
+}
+
+/**
+ * \brief Divides an unsigned integer by \a d.
+ *
+ * \return The remainder.
+ */
+static uint32_t arrowDivMod(uint32_t* limb, int n, uint32_t d) {
+  uint64_t r = 0;
+  for (int i = n - 1; i >= 0; i--) {
+    uint64_t x = (r << 32) | limb[i];
+    limb[i] = (uint32_t)(x / d);
+    r = x % d;
+  }
+  return (uint32_t)r;
+}
+
+/**
+ * \brief Negates a two's complement integer.
+ */
+static void arrowNegate(uint32_t* limb, int n) {
+  uint64_t carry = 1;
+  for (int i = 0; i < n; i++) {
+    uint64_t x = (uint64_t)(uint32_t)~limb[i] + carry;
+    limb[i] = (uint32_t)x;
+    carry = x >> 32;
+  }
+}
+
+/**
+ * \brief Encodes an Arrow decimal value.
+ *
+ * \param p The value: a little-endian two's complement coefficient
+ * \param width The size of the value, in bytes (4, 8, 16 or 32)
+ * \param scale The scale of the value
+ * \param result The output buffer, with space for #DECINF_MAXSIZE bytes
+ * \param decCtx decNumber's context. Values with more digits than its
+ *        precision are rounded, and the conditions raised are set in its
+ *        status, to be checked with decimalCheckTraps().
+ *
+ * \return The length of the encoded value.
+ */
+static size_t arrowDecode(uint8_t const* p, int width, int32_t scale, uint8_t result[DECINF_MAXSIZE], decContext* decCtx) {
+  int isInt64 = (width <= 8);
+  if (width == 16) { // Does the value fit in the lower 64 bits?
+    uint64_t hi = arrowGet64(p + 8);
+    isInt64 = (hi == ((p[7] & 0x80) ? UINT64_MAX : 0));
+  }
+  if (isInt64 && decCtx->digits >= 19) {
+    int64_t coeff = (width == 4) ? (int64_t)(int32_t)arrowGet32(p) : (int64_t)arrowGet64(p);
+    return decInfiniteFromInt64(DECINF_MAXSIZE, result, coeff, -scale);
+  }
+
+  uint32_t limb[ARROW_MAX_WIDTH / 4];
+  int const n = width / 4;
+  for (int i = 0; i < n; i++) limb[i] = arrowGet32(p + 4 * i);
+  int const isNeg = (limb[n - 1] >> 31) != 0;
+  if (isNeg) arrowNegate(limb, n);
+
+  Unit aUnit[(ARROW_DEC256_DIGITS + 2) / 3 + 1];
+  int nUnit = 0;
+  int isZero;
+  do {
+    aUnit[nUnit++] = (Unit)arrowDivMod(limb, n, 1000);
+    isZero = 1;
+    for (int i = 0; i < n && isZero; i++) isZero = (limb[i] == 0);
+  } while (!isZero);
+  Unit const msu = aUnit[nUnit - 1];
+  int32_t const digits = 3 * (nUnit - 1) + (msu > 99 ? 3 : msu > 9 ? 2 : 1);
+
+  decNumber decnum;
+  if (digits <= decCtx->digits) {
+    decNumberZero(&decnum);
+    memcpy(decnum.lsu, aUnit, (size_t)nUnit * sizeof(Unit));
+    decnum.digits = digits;
+    decnum.exponent = -scale;
+    if (isNeg) decnum.bits = DECNEG;
+  }
+  else { // Let decNumber round the value
+    char zNum[ARROW_DEC256_DIGITS + 16];
+    char* z = zNum;
+    z += sprintf(z, "%s%d", isNeg ? "-" : "", msu);
+    for (int i = nUnit - 2; i >= 0; i--) z += sprintf(z, "%03d", aUnit[i]);
+    sprintf(z, "E%d", -scale);
+    decNumberFromString(&decnum, zNum, decCtx);
+  }
+  return decInfiniteFromNumber(DECINF_MAXSIZE, result, &decnum);
+}
+
+/**
+ * \brief Stores the coefficient of a decimal at a given scale.
+ *
+ * \param decnum A finite decimal that is a multiple of `10^-scale`
+ * \param scale The scale
+ * \param width The size of the result, in bytes (16 or 32)
+ * \param out The result: a little-endian two's complement coefficient
+ *
+ * \note The caller must make sure that the coefficient fits.
+ */
+static void arrowEncode(decNumber const* decnum, int32_t scale, int width, uint8_t* out) {
+  uint32_t limb[ARROW_MAX_WIDTH / 4] = { 0 };
+  int const n = width / 4;
+
+  for (Unit const* up = decnum->lsu + D2U(decnum->digits) - 1; up >= decnum->lsu; --up)
+    arrowMulAdd(limb, n, 1000, *up);
+  int32_t shift = decnum->exponent + scale;
+  for (; shift >= 9; shift -= 9) arrowMulAdd(limb, n, 1000000000, 0);
+  for (; shift > 0; shift--) arrowMulAdd(limb, n, 10, 0);
+  for (; shift < 0; shift++) arrowDivMod(limb, n, 10); // Trailing zeros
+  if (decNumberIsNegative(decnum) && !decNumberIsZero(decnum)) arrowNegate(limb, n);
+  for (int i = 0; i < n; i++) arrowPut32(out + 4 * i, limb[i]);
+}
+
+#pragma mark Flatbuffers
+
+/**
+ * \brief A growable buffer.
+ */
+typedef struct arrowBuf {
+  uint8_t* a;     /**< The content of the buffer.           */
+  size_t n;       /**< The number of bytes used.            */
+  size_t nAlloc;  /**< The number of bytes allocated.       */
+  int rc;         /**< `SQLITE_NOMEM` after a failed growth. */
+} arrowBuf;
+
+/**
+ * \brief Appends \a n zero bytes to a buffer.
+ *
+ * \return The offset of the appended bytes, or `0` if out of memory.
+ */
+static size_t arrowReserve(arrowBuf* b, size_t n) {
+  if (b->n + n > b->nAlloc) {
+    size_t nNew = b->nAlloc ? 2 * b->nAlloc : 1024;
+    while (nNew < b->n + n) nNew *= 2;
+    uint8_t* a = sqlite3_realloc64(b->a, nNew);
+    if (a == 0) {
+      b->rc = SQLITE_NOMEM;
+      return 0;
+    }
+    b->a = a;
+    b->nAlloc = nNew;
+  }
+  size_t at = b->n;
+  memset(b->a + at, 0, n);
+  b->n += n;
+  return at;
+}
+
+/**
+ * \brief Appends zero bytes until the size of a buffer is a multiple of \a k.
+ */
+static void arrowPad(arrowBuf* b, size_t k) {
+  if (b->n % k) arrowReserve(b, k - b->n % k);
+}
+
+/**
+ * \brief A field of a flatbuffer table.
+ */
+typedef struct fbSlot {
+  int size;        /**< The size of the field (1, 2, 4, or 8), or `0` if absent. */
+  uint64_t value;  /**< The value of a scalar field.                              */
+  size_t at;       /**< Receives the offset of the field in the buffer.           */
+} fbSlot;
+
+/**
+ * \brief Appends a flatbuffer table, preceded by its vtable.
+ *
+ * Offset fields (strings, vectors, tables) are set to zero: they must be
+ * patched with fbSetOffset() once their targets are appended. Since the
+ * targets follow the table, all offsets are positive, as required.
+ *
+ * \return The offset of the table.
+ */
+static size_t fbTable(arrowBuf* b, int nSlot, fbSlot* aSlot) {
+  size_t const vtSize = 4 + 2 * (size_t)nSlot;
+  uint16_t aOffset[16] = { 0 };
+  size_t size = 4; // soffset to the vtable
+
+  // Larger fields first, each one aligned to its size
+  for (int k = 8; k >= 1; k /= 2) {
+    for (int i = 0; i < nSlot; i++) {
+      if (aSlot[i].size != k) continue;
+      size = (size + (size_t)k - 1) & ~(size_t)(k - 1);
+      aOffset[i] = (uint16_t)size;
+      size += (size_t)k;
+    }
+  }
+  arrowPad(b, 2);
+  size_t const t = ARROW_ALIGN(b->n + vtSize);
+  arrowReserve(b, t - vtSize - b->n);
+  size_t const vt = arrowReserve(b, vtSize);
+  arrowReserve(b, size);
+  if (b->rc) return 0;
+
+  arrowPut16(b->a + vt, (uint16_t)vtSize);
+  arrowPut16(b->a + vt + 2, (uint16_t)size);
+  arrowPut32(b->a + t, (uint32_t)(t - vt));
+  for (int i = 0; i < nSlot; i++) {
+    arrowPut16(b->a + vt + 4 + 2 * i, aOffset[i]);
+    aSlot[i].at = t + aOffset[i];
+    switch (aSlot[i].size) {
+      case 1: b->a[t + aOffset[i]] = (uint8_t)aSlot[i].value; break;
+      case 2: arrowPut16(b->a + t + aOffset[i], (uint16_t)aSlot[i].value); break;
+      case 4: arrowPut32(b->a + t + aOffset[i], (uint32_t)aSlot[i].value); break;
+      case 8: arrowPut64(b->a + t + aOffset[i], aSlot[i].value); break;
+    }
+  }
+  return t;
+}
+
+/**
+ * \brief Sets an offset field to point to \a target.
+ */
+static void fbSetOffset(arrowBuf* b, size_t at, size_t target) {
+  if (b->rc == SQLITE_OK) arrowPut32(b->a + at, (uint32_t)(target - at));
+}
+
+/**
+ * \brief Appends a string.
+ */
+static size_t fbString(arrowBuf* b, char const* z) {
+  size_t const n = strlen(z);
+  arrowPad(b, 4);
+  size_t const at = arrowReserve(b, 4 + n + 1);
+  if (b->rc) return 0;
+  arrowPut32(b->a + at, (uint32_t)n);
+  memcpy(b->a + at + 4, z, n);
+  return at;
+}
+
+/**
+ * \brief Appends a vector of \a n elements of \a size bytes each.
+ *
+ * The elements, which follow the length of the vector, are aligned to
+ * 8 bytes and set to zero.
+ */
+static size_t fbVector(arrowBuf* b, size_t n, size_t size) {
+  arrowPad(b, 4);
+  if ((b->n + 4) % 8) arrowReserve(b, 4);
+  size_t const at = arrowReserve(b, 4 + n * size);
+  if (b->rc) return 0;
+  arrowPut32(b->a + at, (uint32_t)n);
+  return at;
+}
+
+/**
+ * \brief Read-only access to a flatbuffer.
+ *
+ * Out-of-bounds accesses read as zero and set the error flag, so that
+ * a malformed file is detected by checking the flag once.
+ */
+typedef struct fbReader {
+  uint8_t const* a;  /**< The flatbuffer.                         */
+  size_t n;          /**< The size of the flatbuffer.             */
+  int isBad;         /**< Whether an access was out of bounds.    */
+} fbReader;
+
+static int fbCheck(fbReader* r, size_t at, size_t n) {
+  if (at > r->n || n > r->n - at) r->isBad = 1;
+  return !r->isBad;
+}
+
+static uint32_t fbGet32(fbReader* r, size_t at) {
+  return fbCheck(r, at, 4) ? arrowGet32(r->a + at) : 0;
+}
+
+static uint64_t fbGet64(fbReader* r, size_t at) {
+  return fbCheck(r, at, 8) ? arrowGet64(r->a + at) : 0;
+}
+
+/**
+ * \brief Follows an offset.
+ *
+ * \return The target of the offset at \a at, or `0` if \a at is zero (an
+ *         absent field).
+ */
+static size_t fbDeref(fbReader* r, size_t at) {
+  return at ? at + fbGet32(r, at) : 0;
+}
+
+/**
+ * \brief Returns the offset of the root table.
+ */
+static size_t fbRoot(fbReader* r) {
+  return fbGet32(r, 0);
+}
+
+/**
+ * \brief Returns the offset of a field of a table, or `0` if absent.
+ */
+static size_t fbField(fbReader* r, size_t table, int id) {
+  if (table == 0) return 0;
+  size_t const vt = table - (size_t)(int64_t)(int32_t)fbGet32(r, table);
+  if (!fbCheck(r, vt, 4)) return 0;
+  size_t const vtSize = arrowGet16(r->a + vt);
+  if (4 + 2 * (size_t)id + 2 > vtSize || !fbCheck(r, vt, vtSize)) return 0;
+  uint16_t const off = arrowGet16(r->a + vt + 4 + 2 * id);
+  return off ? table + off : 0;
+}
+
+/**
+ * \brief Returns the value of an integer field of a table.
+ */
+static int64_t fbFieldInt(fbReader* r, size_t table, int id, int size, int64_t defaultValue) {
+  size_t const at = fbField(r, table, id);
+  if (at == 0 || !fbCheck(r, at, (size_t)size)) return defaultValue;
+  switch (size) {
+    case 1: return (int8_t)r->a[at];
+    case 2: return (int16_t)arrowGet16(r->a + at);
+    case 4: return (int32_t)arrowGet32(r->a + at);
+    default: return (int64_t)arrowGet64(r->a + at);
+  }
+}
+
+#pragma mark Export
+
+/**
+ * \brief A column being exported.
+ */
+typedef struct arrowColumn {
+  char const* zName;  /**< The name of the column.                        */
+  int32_t minExp;     /**< The minimum exponent of the nonzero values.    */
+  int32_t maxAdj;     /**< The maximum adjusted exponent of the values.   */
+  int32_t scale;      /**< The scale of the column.                       */
+  int32_t precision;  /**< The precision of the column.                   */
+  int width;          /**< The size of a value, in bytes.                 */
+} arrowColumn;
+
+/**
+ * \brief Appends a schema table describing the given columns.
+ */
+static size_t arrowSchema(arrowBuf* b, int nCol, arrowColumn const* aCol) {
+  fbSlot aSchema[] = { { 0, 0, 0 }, { 4, 0, 0 } }; // Little endian; fields
+  size_t const schema = fbTable(b, 2, aSchema);
+  size_t const fields = fbVector(b, (size_t)nCol, 4);
+  fbSetOffset(b, aSchema[1].at, fields);
+  for (int i = 0; i < nCol && b->rc == SQLITE_OK; i++) {
+    // name, nullable, type_type, type, dictionary, children
+    fbSlot aField[] = { { 4, 0, 0 }, { 1, 1, 0 }, { 1, ARROW_TYPE_DECIMAL, 0 }, { 4, 0, 0 }, { 0, 0, 0 }, { 4, 0, 0 } };
+    size_t const field = fbTable(b, 6, aField);
+    fbSetOffset(b, fields + 4 + 4 * (size_t)i, field);
+    fbSetOffset(b, aField[0].at, fbString(b, aCol[i].zName));
+    // precision, scale, bitWidth
+    fbSlot aType[] = {
+      { 4, (uint32_t)aCol[i].precision, 0 }, { 4, (uint32_t)aCol[i].scale, 0 }, { 4, (uint32_t)(8 * aCol[i].width), 0 }
+    };
+    fbSetOffset(b, aField[3].at, fbTable(b, 3, aType));
+    fbSetOffset(b, aField[5].at, fbVector(b, 0, 4));
+  }
+  return schema;
+}
+
+/**
+ * \brief Starts a `Message` flatbuffer.
+ *
+ * \return The offset of the header field, to be set with fbSetOffset().
+ */
+static size_t arrowMessage(arrowBuf* b, int headerType, size_t bodyLength) {
+  b->n = 0;
+  size_t const root = arrowReserve(b, 4);
+  // version, header_type, header, bodyLength
+  fbSlot aMsg[] = { { 2, ARROW_VERSION_V5, 0 }, { 1, (uint64_t)headerType, 0 }, { 4, 0, 0 }, { 8, bodyLength, 0 } };
+  fbSetOffset(b, root, fbTable(b, 4, aMsg));
+  return aMsg[2].at;
+}
+
+/**
+ * \brief State of an export.
+ */
+typedef struct arrowWriter {
+  FILE* out;         /**< The output file.                                  */
+  uint64_t pos;      /**< The current position in the output file.          */
+  arrowBuf meta;     /**< The flatbuffer being built.                       */
+  arrowBuf body;     /**< The body of the current record batch.             */
+  arrowBuf blocks;   /**< The blocks of the record batches (for the footer). */
+} arrowWriter;
+
+static int arrowWrite(arrowWriter* w, void const* p, size_t n) {
+  if (n > 0 && fwrite(p, n, 1, w->out) != 1) return SQLITE_IOERR;
+  w->pos += n;
+  return SQLITE_OK;
+}
+
+/**
+ * \brief Writes an encapsulated message (metadata and body).
+ *
+ * The metadata is preceded by a continuation marker and by its length, and
+ * it is padded so that the body starts at a multiple of 8 bytes.
+ */
+static int arrowWriteMessage(arrowWriter* w, uint8_t const* body, size_t nBody, int isBatch) {
+  uint8_t prefix[8];
+  uint64_t const offset = w->pos;
+  arrowPad(&w->meta, 8);
+  if (w->meta.rc) return w->meta.rc;
+  arrowPut32(prefix, 0xFFFFFFFF);
+  arrowPut32(prefix + 4, (uint32_t)w->meta.n);
+  int rc = arrowWrite(w, prefix, sizeof(prefix));
+  if (rc == SQLITE_OK) rc = arrowWrite(w, w->meta.a, w->meta.n);
+  if (rc == SQLITE_OK) rc = arrowWrite(w, body, nBody);
+  if (rc == SQLITE_OK && isBatch) { // Block: offset, metaDataLength, padding, bodyLength
+    size_t const at = arrowReserve(&w->blocks, 24);
+    if (w->blocks.rc) return w->blocks.rc;
+    arrowPut64(w->blocks.a + at, offset);
+    arrowPut32(w->blocks.a + at + 8, (uint32_t)(sizeof(prefix) + w->meta.n));
+    arrowPut64(w->blocks.a + at + 16, nBody);
+  }
+  return rc;
+}
+
+/**
+ * \brief Writes a record batch.
+ *
+ * \param w The writer
+ * \param nCol The number of columns
+ * \param aCol The columns
+ * \param nRow The number of rows in the batch
+ * \param pCell The encoded values of the batch, row by row: each value is
+ *        preceded by its length, which is zero for `NULL`s
+ *
+ * \return `SQLITE_OK` or an error code.
+ */
+static int arrowWriteBatch(arrowWriter* w, int nCol, arrowColumn const* aCol, size_t nRow, uint8_t const* pCell) {
+  size_t const nValid = ARROW_ALIGN((nRow + 7) / 8);
+  size_t* aNull = sqlite3_malloc64(sizeof(size_t) * (size_t)nCol);
+  size_t* aOffset = sqlite3_malloc64(sizeof(size_t) * (size_t)nCol);
+  int rc = SQLITE_OK;
+
+  if (aNull == 0 || aOffset == 0) {
+    rc = SQLITE_NOMEM;
+    goto batch_end;
+  }
+  w->body.n = 0;
+  for (int j = 0; j < nCol; j++) {
+    aNull[j] = 0;
+    aOffset[j] = arrowReserve(&w->body, nValid);
+    arrowReserve(&w->body, ARROW_ALIGN(nRow * (size_t)aCol[j].width));
+  }
+  if ((rc = w->body.rc) != SQLITE_OK) goto batch_end;
+
+  for (size_t i = 0; i < nRow; i++) {
+    for (int j = 0; j < nCol; j++) {
+      size_t const len = *pCell++;
+      if (len == 0) {
+        aNull[j]++;
+        continue;
+      }
+      decNumber decnum;
+      decInfiniteToNumber(len, pCell, &decnum);
+      pCell += len;
+      uint8_t* validity = w->body.a + aOffset[j];
+      validity[i / 8] |= (uint8_t)(1 << (i % 8));
+      arrowEncode(&decnum, aCol[j].scale, aCol[j].width, validity + nValid + i * (size_t)aCol[j].width);
+    }
+  }
+
+  size_t const header = arrowMessage(&w->meta, ARROW_HEADER_RECORD_BATCH, w->body.n);
+  fbSlot aBatch[] = { { 8, nRow, 0 }, { 4, 0, 0 }, { 4, 0, 0 } }; // length, nodes, buffers
+  fbSetOffset(&w->meta, header, fbTable(&w->meta, 3, aBatch));
+  size_t const nodes = fbVector(&w->meta, (size_t)nCol, 16);
+  fbSetOffset(&w->meta, aBatch[1].at, nodes);
+  size_t const buffers = fbVector(&w->meta, 2 * (size_t)nCol, 16);
+  fbSetOffset(&w->meta, aBatch[2].at, buffers);
+  if ((rc = w->meta.rc) != SQLITE_OK) goto batch_end;
+  for (int j = 0; j < nCol; j++) {
+    uint8_t* node = w->meta.a + nodes + 4 + 16 * (size_t)j;
+    uint8_t* buffer = w->meta.a + buffers + 4 + 32 * (size_t)j;
+    arrowPut64(node, nRow);
+    arrowPut64(node + 8, aNull[j]);
+    arrowPut64(buffer, aOffset[j]);
+    arrowPut64(buffer + 8, nValid);
+    arrowPut64(buffer + 16, aOffset[j] + nValid);
+    arrowPut64(buffer + 24, nRow * (size_t)aCol[j].width);
+  }
+  rc = arrowWriteMessage(w, w->body.a, w->body.n, 1);
+
+batch_end:
+  sqlite3_free(aNull);
+  sqlite3_free(aOffset);
+  return rc;
+}
+
+/**
+ * \brief Writes an Arrow file.
+ *
+ * \param zPath The path of the file
+ * \param nCol The number of columns
+ * \param aCol The columns
+ * \param nRow The number of rows
+ * \param aCell The encoded values, as for arrowWriteBatch()
+ *
+ * \return `SQLITE_OK` or an error code.
+ */
+static int arrowWriteFile(char const* zPath, int nCol, arrowColumn const* aCol, size_t nRow, uint8_t const* aCell) {
+  static uint8_t const magic[8] = ARROW_MAGIC;
+  static uint8_t const eos[8] = { 0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0, 0 };
+  arrowWriter w;
+  int rc;
+
+  memset(&w, 0, sizeof(w));
+  w.out = fopen(zPath, "wb");
+  if (w.out == 0) return SQLITE_CANTOPEN;
+  rc = arrowWrite(&w, magic, sizeof(magic));
+
+  if (rc == SQLITE_OK) {
+    size_t const header = arrowMessage(&w.meta, ARROW_HEADER_SCHEMA, 0);
+    fbSetOffset(&w.meta, header, arrowSchema(&w.meta, nCol, aCol));
+    rc = arrowWriteMessage(&w, 0, 0, 0);
+  }
+  for (size_t i = 0; i < nRow && rc == SQLITE_OK; i += ARROW_BATCH_ROWS) {
+    size_t const n = (nRow - i < ARROW_BATCH_ROWS) ? nRow - i : ARROW_BATCH_ROWS;
+    rc = arrowWriteBatch(&w, nCol, aCol, n, aCell);
+    for (size_t k = 0; k < n * (size_t)nCol; k++) aCell += 1 + *aCell; // Skip the batch
+  }
+  if (rc == SQLITE_OK) rc = arrowWrite(&w, eos, sizeof(eos));
+
+  if (rc == SQLITE_OK) { // Footer: version, schema, dictionaries, recordBatches
+    size_t const nBatch = w.blocks.n / 24;
+    w.meta.n = 0;
+    size_t const root = arrowReserve(&w.meta, 4);
+    fbSlot aFooter[] = { { 2, ARROW_VERSION_V5, 0 }, { 4, 0, 0 }, { 0, 0, 0 }, { 4, 0, 0 } };
+    fbSetOffset(&w.meta, root, fbTable(&w.meta, 4, aFooter));
+    fbSetOffset(&w.meta, aFooter[1].at, arrowSchema(&w.meta, nCol, aCol));
+    size_t const blocks = fbVector(&w.meta, nBatch, 24);
+    fbSetOffset(&w.meta, aFooter[3].at, blocks);
+    if ((rc = w.meta.rc) == SQLITE_OK) {
+      uint8_t trailer[4 + 6];
+      if (nBatch > 0) memcpy(w.meta.a + blocks + 4, w.blocks.a, w.blocks.n);
+      arrowPut32(trailer, (uint32_t)w.meta.n);
+      memcpy(trailer + 4, ARROW_MAGIC, 6);
+      rc = arrowWrite(&w, w.meta.a, w.meta.n);
+      if (rc == SQLITE_OK) rc = arrowWrite(&w, trailer, sizeof(trailer));
+    }
+  }
+
+  sqlite3_free(w.meta.a);
+  sqlite3_free(w.body.a);
+  sqlite3_free(w.blocks.a);
+  if (fclose(w.out) != 0 && rc == SQLITE_OK) rc = SQLITE_IOERR;
+  if (rc != SQLITE_OK) remove(zPath);
+  return rc;
+}
+
+void decimalArrowExport(sqlite3_context* context, int argc, sqlite3_value** argv) {
+  decContext* decCtx = sqlite3_user_data(context);
+  sqlite3* db = sqlite3_context_db_handle(context);
+  sqlite3_stmt* pStmt = 0;
+  arrowColumn* aCol = 0;
+  arrowBuf cells;
+  size_t nRow = 0;
+  char* zErr = 0;
+  int nCol;
+  int rc;
+
+  (void)argc;
+  memset(&cells, 0, sizeof(cells));
+  rc = sqlite3_prepare_v2(db, (char const*)sqlite3_value_text(argv[0]), -1, &pStmt, 0);
+  if (rc != SQLITE_OK) {
+    sqlite3_result_error(context, sqlite3_errmsg(db), -1);
+    return;
+  }
+  nCol = sqlite3_column_count(pStmt);
+  if (pStmt == 0 || nCol == 0) {
+    sqlite3_finalize(pStmt);
+    sqlite3_result_error(context, "The query must return at least one column", -1);
+    return;
+  }
+  aCol = sqlite3_malloc64(sizeof(*aCol) * (size_t)nCol);
+  if (aCol == 0) {
+    rc = SQLITE_NOMEM;
+    goto export_end;
+  }
+  for (int j = 0; j < nCol; j++) {
+    aCol[j].zName = sqlite3_column_name(pStmt, j);
+    aCol[j].minExp = 0;
+    aCol[j].maxAdj = 0;
+  }
+
+  decContext ctx; // Conversion errors are reported as export errors
+  decimalContextCopy(&ctx, decCtx);
+  ctx.traps = 0;
+  while (rc == SQLITE_OK && (rc = sqlite3_step(pStmt)) == SQLITE_ROW) {
+    rc = SQLITE_OK;
+    ++nRow;
+    for (int j = 0; j < nCol; j++) {
+      sqlite3_value* value = sqlite3_column_value(pStmt, j);
+      size_t const at = arrowReserve(&cells, 1 + DECINF_MAXSIZE);
+      if (cells.rc) {
+        rc = cells.rc;
+        break;
+      }
+      cells.n = at + 1;
+      if (sqlite3_value_type(value) == SQLITE_NULL) continue;
+
+      decNumber decnum;
+      decContextZeroStatus(&ctx);
+      if (decNumberFromSQLite3Value(&decnum, value, &ctx) == 0 || decContextTestStatus(&ctx, DEC_Conversion_syntax)) {
+        zErr = sqlite3_mprintf("Invalid decimal in column %s of row %lld", aCol[j].zName, (long long)nRow);
+        rc = SQLITE_ERROR;
+        break;
+      }
+      if (decNumberIsSpecial(&decnum)) {
+        zErr = sqlite3_mprintf("The value in column %s of row %lld is not finite", aCol[j].zName, (long long)nRow);
+        rc = SQLITE_ERROR;
+        break;
+      }
+      if (!decNumberIsZero(&decnum)) {
+        decNumberTrim(&decnum); // Decoded blobs may have trailing zeros
+        int32_t const adj = decnum.exponent + decnum.digits - 1;
+        if (decnum.exponent < aCol[j].minExp) aCol[j].minExp = decnum.exponent;
+        if (adj > aCol[j].maxAdj) aCol[j].maxAdj = adj;
+      }
+      size_t const len = decInfiniteFromNumber(DECINF_MAXSIZE, cells.a + at + 1, &decnum);
+      cells.a[at] = (uint8_t)len;
+      cells.n += len;
+    }
+  }
+  if (rc != SQLITE_DONE) goto export_end;
+
+  for (int j = 0; j < nCol; j++) {
+    aCol[j].scale = -aCol[j].minExp;
+    aCol[j].precision = aCol[j].maxAdj + 1 + aCol[j].scale;
+    if (aCol[j].precision < aCol[j].scale) aCol[j].precision = aCol[j].scale;
+    if (aCol[j].precision < 1) aCol[j].precision = 1;
+    if (aCol[j].precision > ARROW_DEC256_DIGITS) {
+      zErr = sqlite3_mprintf("The values of column %s need %d digits, but at most %d can be stored",
+                             aCol[j].zName, aCol[j].precision, ARROW_DEC256_DIGITS);
+      rc = SQLITE_ERROR;
+      goto export_end;
+    }
+    aCol[j].width = (aCol[j].precision > ARROW_DEC128_DIGITS) ? 32 : 16;
+  }
+
+  rc = arrowWriteFile((char const*)sqlite3_value_text(argv[1]), nCol, aCol, nRow, cells.a);
+  if (rc == SQLITE_CANTOPEN) zErr = sqlite3_mprintf("Cannot write %s", sqlite3_value_text(argv[1]));
+
+export_end:
+  if (rc == SQLITE_OK)
+    sqlite3_result_int64(context, (sqlite3_int64)nRow);
+  else if (zErr) sqlite3_result_error(context, zErr, -1);
+  else if (rc == SQLITE_NOMEM) sqlite3_result_error_nomem(context);
+  else if (rc == SQLITE_IOERR) sqlite3_result_error(context, "I/O error while writing the Arrow file", -1);
+  else sqlite3_result_error(context, sqlite3_errmsg(db), -1);
+  sqlite3_finalize(pStmt);
+  sqlite3_free(aCol);
+  sqlite3_free(cells.a);
+  sqlite3_free(zErr);
+}
+
+#pragma mark Virtual table
+
+#ifndef SQLITE_OMIT_VIRTUALTABLE
+
+/**
+ * \brief A column of an Arrow record batch.
+ */
+typedef struct arrowArray {
+  uint8_t const* validity; /**< The validity bitmap, or `0` if all valid. */
+  uint8_t const* values;   /**< The values.                               */
+} arrowArray;
+
+/**
+ * \brief A record batch of an Arrow file.
+ */
+typedef struct arrowBatch {
+  sqlite3_int64 nRows;     /**< The number of rows.                       */
+  arrowArray* aArray;      /**< The columns.                              */
+} arrowBatch;
+
+typedef struct decimalArrowVTab decimalArrowVTab;
+
+/**
+ * \brief A decArrowScan virtual table.
+ */
+struct decimalArrowVTab {
+  sqlite3_vtab base;        /**< Base class - must be first.          */
+  decContext* decCtx;       /**< decNumber's context.                 */
+  decimalMappedFile file;   /**< The content of the file.             */
+  int nCol;                 /**< The number of columns.               */
+  int* aWidth;              /**< The size of the values of each column. */
+  int32_t* aScale;          /**< The scale of each column.            */
+  int nBatch;               /**< The number of record batches.        */
+  arrowBatch* aBatch;       /**< The record batches.                  */
+  sqlite3_int64 nRows;      /**< The total number of rows.            */
+};
+
+typedef struct decimalArrowCursor decimalArrowCursor;
+
+/**
+ * \brief A cursor over a decArrowScan virtual table.
+ */
+struct decimalArrowCursor {
+  sqlite3_vtab_cursor base; /**< Base class - must be first.          */
+  int iBatch;               /**< The current record batch.            */
+  sqlite3_int64 iRow;       /**< The current row in the batch.        */
+  sqlite3_int64 iRowid;     /**< The current row number (from 1).     */
+};
+
+static int decimalArrowDisconnect(sqlite3_vtab* pVtab) {
+  decimalArrowVTab* p = (decimalArrowVTab*)pVtab;
+  if (p->aBatch) sqlite3_free(p->aBatch[0].aArray);
+  sqlite3_free(p->aBatch);
+  sqlite3_free(p->aWidth);
+  sqlite3_free(p->aScale);
+  decimalUnmapFile(&p->file);
+  sqlite3_free(p);
+  return SQLITE_OK;
+}
+
+/**
+ * \brief Reads the schema of an Arrow file and declares the virtual table.
+ *
+ * \return `SQLITE_OK` or an error code, with an error message.
+ */
+static int arrowReadSchema(sqlite3* db, decimalArrowVTab* p, fbReader* r, size_t schema, char** pzErr) {
+  size_t const fields = fbDeref(r, fbField(r, schema, 1));
+  if (fbFieldInt(r, schema, 0, 2, 0) != 0) {
+    *pzErr = sqlite3_mprintf("Big-endian Arrow files are not supported");
+    return SQLITE_ERROR;
+  }
+  p->nCol = (int)fbGet32(r, fields);
+  if (r->isBad || p->nCol <= 0 || p->nCol > sqlite3_limit(db, SQLITE_LIMIT_COLUMN, -1)) return SQLITE_CORRUPT;
+  p->aWidth = sqlite3_malloc64(sizeof(int) * (size_t)p->nCol);
+  p->aScale = sqlite3_malloc64(sizeof(int32_t) * (size_t)p->nCol);
+  if (p->aWidth == 0 || p->aScale == 0) return SQLITE_NOMEM;
+
+  char* zSql = sqlite3_mprintf("create table x(");
+  for (int j = 0; j < p->nCol && zSql; j++) {
+    size_t const field = fbDeref(r, fields + 4 + 4 * (size_t)j);
+    size_t const name = fbDeref(r, fbField(r, field, 0));
+    size_t const type = fbDeref(r, fbField(r, field, 3));
+    uint32_t const nName = name ? fbGet32(r, name) : 0;
+    if (r->isBad || !fbCheck(r, name + 4, nName)) break;
+    char const* zName = (char const*)r->a + name + 4;
+
+    int const bitWidth = (int)fbFieldInt(r, type, 2, 4, 128);
+    int32_t const scale = (int32_t)fbFieldInt(r, type, 1, 4, 0);
+    if (fbFieldInt(r, field, 2, 1, 0) != ARROW_TYPE_DECIMAL || fbField(r, field, 4) != 0 ||
+        (bitWidth != 32 && bitWidth != 64 && bitWidth != 128 && bitWidth != 256)) {
+      *pzErr = sqlite3_mprintf("Column %.*s is not a decimal column", (int)nName, zName);
+      sqlite3_free(zSql);
+      return SQLITE_ERROR;
+    }
+    if (scale > ARROW_MAX_SCALE || scale < -ARROW_MAX_SCALE) {
+      *pzErr = sqlite3_mprintf("The scale of column %.*s is out of range", (int)nName, zName);
+      sqlite3_free(zSql);
+      return SQLITE_ERROR;
+    }
+    p->aWidth[j] = bitWidth / 8;
+    p->aScale[j] = scale;
+    zSql = sqlite3_mprintf("%z%s\"%.*w\" blob", zSql, j ? ", " : "", (int)nName, zName);
+  }
+  if (r->isBad) {
+    sqlite3_free(zSql);
+    return SQLITE_CORRUPT;
+  }
+  if (zSql) zSql = sqlite3_mprintf("%z)", zSql);
+  if (zSql == 0) return SQLITE_NOMEM;
+  int rc = sqlite3_declare_vtab(db, zSql);
+  if (rc != SQLITE_OK) *pzErr = sqlite3_mprintf("%s", sqlite3_errmsg(db));
+  sqlite3_free(zSql);
+  return rc;
+}
+
+/**
+ * \brief Finds the record batches of an Arrow file.
+ *
+ * \return `SQLITE_OK` or an error code, with an error message.
+ */
+static int arrowReadBatches(decimalArrowVTab* p, fbReader* file, fbReader* r, size_t blocks, char** pzErr) {
+  uint32_t const nBatch = blocks ? fbGet32(r, blocks) : 0;
+  if (r->isBad || nBatch > (r->n - blocks) / 24) return SQLITE_CORRUPT;
+  p->nBatch = (int)nBatch;
+  p->aBatch = sqlite3_malloc64(sizeof(arrowBatch) * (nBatch + 1));
+  if (p->aBatch == 0) return SQLITE_NOMEM;
+  arrowArray* aArray = sqlite3_malloc64(sizeof(arrowArray) * (nBatch * (size_t)p->nCol + 1));
+  p->aBatch[0].aArray = aArray; // Freed by xDisconnect
+  if (aArray == 0) return SQLITE_NOMEM;
+
+  for (uint32_t i = 0; i < nBatch; i++) {
+    size_t const block = blocks + 4 + 24 * (size_t)i;
+    uint64_t const offset = fbGet64(r, block);
+    uint32_t const nMeta = fbGet32(r, block + 8);
+    uint64_t const nBody = fbGet64(r, block + 16);
+    if (r->isBad || !fbCheck(file, offset, nMeta) || !fbCheck(file, offset + nMeta, nBody)) return SQLITE_CORRUPT;
+
+    // The message is preceded by an optional continuation marker and its length
+    size_t skip = (arrowGet32(file->a + offset) == 0xFFFFFFFF) ? 8 : 4;
+    if (nMeta < skip) return SQLITE_CORRUPT;
+    fbReader msg = { file->a + offset + skip, nMeta - skip, 0 };
+    fbReader body = { file->a + offset + nMeta, (size_t)nBody, 0 };
+    size_t const root = fbRoot(&msg);
+    size_t const batch = fbDeref(&msg, fbField(&msg, root, 2));
+    if (fbFieldInt(&msg, root, 1, 1, 0) != ARROW_HEADER_RECORD_BATCH || batch == 0 || msg.isBad)
+      return SQLITE_CORRUPT;
+    if (fbField(&msg, batch, 3) != 0) {
+      *pzErr = sqlite3_mprintf("Compressed Arrow files are not supported");
+      return SQLITE_ERROR;
+    }
+
+    sqlite3_int64 const nRows = fbFieldInt(&msg, batch, 0, 8, 0);
+    size_t const buffers = fbDeref(&msg, fbField(&msg, batch, 2));
+    if (nRows < 0 || buffers == 0 || fbGet32(&msg, buffers) < 2 * (uint32_t)p->nCol) return SQLITE_CORRUPT;
+    arrowBatch* pBatch = &p->aBatch[i];
+    pBatch->nRows = nRows;
+    pBatch->aArray = aArray + (size_t)i * (size_t)p->nCol;
+    for (int j = 0; j < p->nCol; j++) {
+      size_t const buffer = buffers + 4 + 32 * (size_t)j;
+      uint64_t const validityOffset = fbGet64(&msg, buffer);
+      uint64_t const validityLength = fbGet64(&msg, buffer + 8);
+      uint64_t const valuesOffset = fbGet64(&msg, buffer + 16);
+      uint64_t const valuesLength = fbGet64(&msg, buffer + 24);
+      if (msg.isBad || valuesLength < (uint64_t)nRows * (uint64_t)p->aWidth[j] || !fbCheck(&body, valuesOffset, valuesLength)
+          || (validityLength > 0 && (validityLength < ((uint64_t)nRows + 7) / 8 || !fbCheck(&body, validityOffset, validityLength))))
+        return SQLITE_CORRUPT;
+      pBatch->aArray[j].validity = validityLength ? body.a + validityOffset : 0;
+      pBatch->aArray[j].values = body.a + valuesOffset;
+    }
+    p->nRows += nRows;
+  }
+  return SQLITE_OK;
+}
+
+static int decimalArrowConnect(sqlite3* db, void* pAux, int argc, char const* const* argv,
+                               sqlite3_vtab** ppVtab, char** pzErr) {
+  decimalArrowVTab* pVtab;
+  char* zFile;
+  int rc;
+
+  if (argc != 4) {
+    *pzErr = sqlite3_mprintf("Usage: %s(filename)", argv[0]);
+    return SQLITE_ERROR;
+  }
+  pVtab = sqlite3_malloc(sizeof(*pVtab));
+  zFile = sqlite3_mprintf("%s", argv[3]);
+  if (pVtab == 0 || zFile == 0) {
+    sqlite3_free(pVtab);
+    sqlite3_free(zFile);
+    return SQLITE_NOMEM;
+  }
+  memset(pVtab, 0, sizeof(*pVtab));
+  pVtab->decCtx = pAux;
+  size_t n = strlen(zFile);
+  if (n >= 2 && (zFile[0] == '\'' || zFile[0] == '"') && zFile[n - 1] == zFile[0]) {
+    memmove(zFile, zFile + 1, n - 2);
+    zFile[n - 2] = '\0';
+  }
+
+  rc = decimalMapFile(zFile, 1, &pVtab->file);
+  if (rc != SQLITE_OK)
+    *pzErr = sqlite3_mprintf("Cannot read %s", zFile);
+  else {
+    fbReader file = { (uint8_t const*)pVtab->file.zData, (size_t)pVtab->file.nData, 0 };
+    size_t const nMagic = sizeof(ARROW_MAGIC) - 1;
+    if (file.n < 2 * 8 + 4 || memcmp(file.a, ARROW_MAGIC, nMagic) != 0 || memcmp(file.a + file.n - nMagic, ARROW_MAGIC, nMagic) != 0) {
+      *pzErr = sqlite3_mprintf("Not an Arrow file: %s", zFile);
+      rc = SQLITE_ERROR;
+    }
+    else {
+      uint32_t const nFooter = arrowGet32(file.a + file.n - nMagic - 4);
+      rc = SQLITE_CORRUPT;
+      if (nFooter <= file.n - nMagic - 4 - 8) {
+        fbReader footer = { file.a + file.n - nMagic - 4 - nFooter, nFooter, 0 };
+        size_t const root = fbRoot(&footer);
+        rc = arrowReadSchema(db, pVtab, &footer, fbDeref(&footer, fbField(&footer, root, 1)), pzErr);
+        if (rc == SQLITE_OK)
+          rc = arrowReadBatches(pVtab, &file, &footer, fbDeref(&footer, fbField(&footer, root, 3)), pzErr);
+      }
+      if (rc == SQLITE_CORRUPT) {
+        sqlite3_free(*pzErr);
+        *pzErr = sqlite3_mprintf("Malformed Arrow file: %s", zFile);
+        rc = SQLITE_ERROR;
+      }
+    }
+  }
+  sqlite3_free(zFile);
+  if (rc != SQLITE_OK) {
+    decimalArrowDisconnect(&pVtab->base);
+    return rc;
+  }
+  *ppVtab = &pVtab->base;
+  return SQLITE_OK;
+}
+
+/**
+ * \brief Implementation of xCreate, which must differ from xConnect so that
+ *        the module is not eponymous.
+ */
+static int decimalArrowCreate(sqlite3* db, void* pAux, int argc, char const* const* argv,
+                              sqlite3_vtab** ppVtab, char** pzErr) {
+  return decimalArrowConnect(db, pAux, argc, argv, ppVtab, pzErr);
+}
+
+static int decimalArrowOpen(sqlite3_vtab* p, sqlite3_vtab_cursor** ppCursor) {
+  (void)p;
+  decimalArrowCursor* pCur;
+  pCur = sqlite3_malloc(sizeof(*pCur));
+  if (pCur == 0) return SQLITE_NOMEM;
+  memset(pCur, 0, sizeof(*pCur));
+  *ppCursor = &pCur->base;
+  return SQLITE_OK;
+}
+
+static int decimalArrowClose(sqlite3_vtab_cursor* cur) {
+  sqlite3_free(cur);
+  return SQLITE_OK;
+}
+
+/**
+ * \brief Skips empty record batches.
+ */
+static void arrowSkipEmpty(decimalArrowCursor* pCur, decimalArrowVTab const* pVtab) {
+  while (pCur->iBatch < pVtab->nBatch && pCur->iRow >= pVtab->aBatch[pCur->iBatch].nRows) {
+    pCur->iBatch++;
+    pCur->iRow = 0;
+  }
+}
+
+static int decimalArrowNext(sqlite3_vtab_cursor* cur) {
+  decimalArrowCursor* pCur = (decimalArrowCursor*)cur;
+  pCur->iRow++;
+  pCur->iRowid++;
+  arrowSkipEmpty(pCur, (decimalArrowVTab*)cur->pVtab);
+  return SQLITE_OK;
+}
+
+static int decimalArrowEof(sqlite3_vtab_cursor* cur) {
+  decimalArrowCursor* pCur = (decimalArrowCursor*)cur;
+  return pCur->iBatch >= ((decimalArrowVTab*)cur->pVtab)->nBatch;
+}
+
+static int decimalArrowColumn(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int i) {
+  decimalArrowCursor* pCur = (decimalArrowCursor*)cur;
+  decimalArrowVTab* pVtab = (decimalArrowVTab*)cur->pVtab;
+  arrowArray const* pArray = &pVtab->aBatch[pCur->iBatch].aArray[i];
+  sqlite3_int64 const k = pCur->iRow;
+
+  if (pArray->validity && !(pArray->validity[k / 8] & (1 << (k % 8)))) return SQLITE_OK; // NULL
+  uint8_t bytes[DECINF_MAXSIZE];
+  size_t len = arrowDecode(pArray->values + k * pVtab->aWidth[i], pVtab->aWidth[i], pVtab->aScale[i], bytes, pVtab->decCtx);
+  char* zErr = 0;
+  if (decimalCheckTraps(pVtab->decCtx, &zErr) != SQLITE_OK) {
+    sqlite3_result_error(ctx, zErr ? zErr : "Decimal error", -1);
+    sqlite3_free(zErr);
+    return SQLITE_ERROR;
+  }
+  sqlite3_result_blob(ctx, bytes, (int)len, SQLITE_TRANSIENT);
+  return SQLITE_OK;
+}
+
+static int decimalArrowRowid(sqlite3_vtab_cursor* cur, sqlite_int64* pRowid) {
+  *pRowid = ((decimalArrowCursor*)cur)->iRowid;
+  return SQLITE_OK;
+}
+
+static int decimalArrowFilter(sqlite3_vtab_cursor* cur, int idxNum, char const* idxStr,
+                              int argc, sqlite3_value** argv) {
+  (void)idxNum;
+  (void)idxStr;
+  (void)argc;
+  (void)argv;
+
+  decimalArrowCursor* pCur = (decimalArrowCursor*)cur;
+  pCur->iBatch = 0;
+  pCur->iRow = 0;
+  pCur->iRowid = 1;
+  arrowSkipEmpty(pCur, (decimalArrowVTab*)cur->pVtab);
+  return SQLITE_OK;
+}
+
+static int decimalArrowBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
+  decimalArrowVTab* pVtab = (decimalArrowVTab*)tab;
+  pIdxInfo->estimatedCost = (double)pVtab->nRows + 1.0;
+  pIdxInfo->estimatedRows = pVtab->nRows + 1;
+  return SQLITE_OK;
+}
+
+/**
+ * \brief A virtual table module that serves the decimal columns of Arrow files.
+ */
+sqlite3_module decimalArrowModule = {
+  0,
+  decimalArrowCreate,
+  decimalArrowConnect,
+  decimalArrowBestIndex,
+  decimalArrowDisconnect,
+  decimalArrowDisconnect,
+  decimalArrowOpen,
+  decimalArrowClose,
+  decimalArrowFilter,
+  decimalArrowNext,
+  decimalArrowEof,
+  decimalArrowColumn,
+  decimalArrowRowid,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+};
+
+#endif /* SQLITE_OMIT_VIRTUALTABLE */
@@ -0,0 +1,21 @@
+#ifndef _AUTOCONFIG_H
+#define _AUTOCONFIG_H
+#define HAVE_DLOPEN 1
+#define HAVE_INT16_T 1
+#define HAVE_INTTYPES_H 1
+#define HAVE_LITTLE_ENDIAN 1
+#define HAVE_MADVISE 1
+#define HAVE_MMAP 1
+#define HAVE_PTHREAD_CREATE 1
+#define HAVE_PTHREAD_H 1
+#define HAVE_STDATOMIC_H 1
+#define HAVE_STDINT_H 1
+#define HAVE_STDLIB_H 1
+#define HAVE_SYS_MMAN_H 1
+#define HAVE_SYS_PARAM_H 1
+/* #undef HAVE_SYS_SDT_H */
+#define HAVE_SYS_TYPES_H 1
+#define HAVE_UINT16_T 1
+#define HAVE_UINT32_T 1
+#define HAVE_UINT8_T 1
+#endif
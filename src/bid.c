@@ -0,0 +1,248 @@
+/**
+ * \file      bid.c
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     Conversions between IEEE 754 decimal128 (BID) and decimals.
+ *
+ * The binary integer decimal (BID) encoding of decimal128 is the one used,
+ * for instance, by MongoDB and by Intel's decimal floating-point library.
+ * A number takes 16 bytes, least significant byte first:
+ *
+ * - bit 127 is the sign;
+ * - if bits 126-125 are not `11`, bits 126-113 are the biased exponent and
+ *   bits 112-0 are the binary coefficient;
+ * - otherwise, bits 126-122 are `11110` for infinities and `11111` for NaNs;
+ *   other values encode a coefficient greater than `10^34 - 1`, which is
+ *   non-canonical and read as zero, as are coefficients of the first form
+ *   greater than `10^34 - 1`.
+ *
+ * The coefficient is converted to and from the three-digit units of
+ * a decNumber with 128-bit arithmetic on four 32-bit limbs, nine digits at
+ * a time, so no string conversion takes place.
+ */
+#include <string.h>
+#include "impl_decinfinite.h"
+#include "decimal.h"
+
+/** \brief Length of a BID decimal128, in bytes. */
+#define BID128_BYTES 16
+/** \brief Exponent bias of decimal128. */
+#define BID128_BIAS 6176
+/** \brief Maximum number of digits of decimal128. */
+#define BID128_PMAX 34
+/** \brief Mask of the high 64 bits of a coefficient. */
+#define BID128_COEFF_HI 0x0001FFFFFFFFFFFFull
+/** \brief High 64 bits of `10^34 - 1`. */
+#define BID128_MAX_HI 0x0001ED09BEAD87C0ull
+/** \brief Low 64 bits of `10^34 - 1`. */
+#define BID128_MAX_LO 0x378D8E63FFFFFFFFull
+
+/**
+ * \brief Decodes a BID decimal128.
+ *
+ * \param p The encoded number (#BID128_BYTES bytes, little-endian)
+ * \param decnum The output decimal
+ *
+ * \return \a decnum
+ */
+static decNumber* bidToNumber(uint8_t const* p, decNumber* decnum) {
+  uint64_t lo = 0;
+  uint64_t hi = 0;
+  for (int i = 7; i >= 0; i--) {
+    lo = (lo << 8) | p[i];
+    hi = (hi << 8) | p[i + 8];
+  }
+
+  decNumberZero(decnum);
+  if (hi >> 63) decnum->bits = DECNEG;
+  if (((hi >> 61) & 3) == 3) {
+    if (((hi >> 58) & 0x1F) == 0x1F) {
+      decnum->bits |= DECNAN;
+      return decnum;
+    }
+    if (((hi >> 58) & 0x1F) == 0x1E) {
+      decnum->bits |= DECINF;
+      return decnum;
+    }
+    decnum->exponent = (int32_t)((hi >> 47) & 0x3FFF) - BID128_BIAS; // Non-canonical zero
+    return decnum;
+  }
+  decnum->exponent = (int32_t)((hi >> 49) & 0x3FFF) - BID128_BIAS;
+  hi &= BID128_COEFF_HI;
+  if (hi > BID128_MAX_HI || (hi == BID128_MAX_HI && lo > BID128_MAX_LO)) return decnum; // Non-canonical zero
+
+  uint32_t limb[4] = { (uint32_t)lo, (uint32_t)(lo >> 32), (uint32_t)hi, (uint32_t)(hi >> 32) };
+  Unit* up = decnum->lsu;
+  while (limb[0] | limb[1] | limb[2] | limb[3]) {
+    uint64_t r = 0; // Divide by 10^9
+    for (int i = 3; i >= 0; i--) {
+      uint64_t x = (r << 32) | limb[i];
+      limb[i] = (uint32_t)(x / 1000000000u);
+      r = x % 1000000000u;
+    }
+    *up++ = (Unit)(r % 1000);
+    *up++ = (Unit)(r / 1000 % 1000);
+    *up++ = (Unit)(r / 1000000);
+  }
+  if (up > decnum->lsu) {
+    while (up > decnum->lsu + 1 && up[-1] == 0) --up;
+    --up;
+    decnum->digits = DECDPUN * (int32_t)(up - decnum->lsu) + (*up > 99 ? 3 : *up > 9 ? 2 : 1);
+  }
+  return decnum;
+}
+
+/**
+ * \brief Encodes a decimal as a BID decimal128.
+ *
+ * \param decnum A decimal with at most #BID128_PMAX digits and an exponent in
+ *        the range of decimal128 (e.g., rounded by decNumberPlus() with
+ *        a decimal128 context)
+ * \param p The output buffer (#BID128_BYTES bytes, little-endian)
+ */
+static void bidFromNumber(decNumber const* decnum, uint8_t* p) {
+  uint64_t lo = 0;
+  uint64_t hi = decNumberIsNegative(decnum) ? (1ull << 63) : 0;
+
+  if (decNumberIsNaN(decnum))
+    hi |= 0x7C00000000000000ull;
+  else if (decNumberIsInfinite(decnum))
+    hi |= 0x7800000000000000ull;
+  else {
+    uint32_t limb[4] = { 0, 0, 0, 0 };
+    for (Unit const* up = decnum->lsu + D2U(decnum->digits) - 1; up >= decnum->lsu; --up) {
+      uint64_t carry = *up; // Multiply by 1000 and add the unit
+      for (int i = 0; i < 4; i++) {
+        uint64_t x = (uint64_t)limb[i] * 1000 + carry;
+        limb[i] = (uint32_t)x;
+        carry = x >> 32;
+      }
+    }
+    lo = ((uint64_t)limb[1] << 32) | limb[0];
+    hi |= ((uint64_t)(decnum->exponent + BID128_BIAS) << 49) | ((uint64_t)limb[3] << 32) | limb[2];
+  }
+  for (int i = 0; i < 8; i++) {
+    p[i] = (uint8_t)(lo >> (8 * i));
+    p[i + 8] = (uint8_t)(hi >> (8 * i));
+  }
+}
+
+/**
+ * \brief Rounds a decimal to the precision and range of decimal128.
+ *
+ * Trailing zeros are removed as far as the exponent range allows, because
+ * decoded decimals have their coefficients padded to a multiple of three
+ * digits.
+ *
+ * \param decnum The decimal, which is rounded in place
+ * \param round The rounding mode
+ *
+ * \return The status flags raised by rounding.
+ */
+static uint32_t bidRound(decNumber* decnum, enum rounding round) {
+  decContext ctx128;
+  decContextDefault(&ctx128, DEC_INIT_DECIMAL128);
+  ctx128.round = round;
+  decNumberReduce(decnum, decnum, &ctx128);
+  decNumberPlus(decnum, decnum, &ctx128); // Fit the exponent again
+  return ctx128.status;
+}
+
+#pragma mark SQL functions
+
+void decimalFromBID128(sqlite3_context* context, sqlite3_value* value) {
+  decNumber decnum;
+
+  if (sqlite3_value_type(value) != SQLITE_BLOB || sqlite3_value_bytes(value) != BID128_BYTES) {
+    sqlite3_result_error(context, "A BID decimal128 number must be a blob of 16 bytes", -1);
+    return;
+  }
+  bidToNumber(sqlite3_value_blob(value), &decnum);
+  decNumberToSQLite3Blob(context, &decnum);
+}
+
+void decimalToBID128(sqlite3_context* context, sqlite3_value* value) {
+  decContext* decCtx = sqlite3_user_data(context);
+  decNumber decnum;
+  uint8_t bytes[BID128_BYTES];
+
+  if (decNumberFromSQLite3Value(&decnum, value, decCtx) == 0) {
+    sqlite3_result_error(context, "Cannot create decimal from the given type", -1);
+    return;
+  }
+  decContextSetStatusQuiet(decCtx, bidRound(&decnum, decCtx->round));
+
+  char* zErr = 0;
+  if (decimalCheckTraps(decCtx, &zErr) != SQLITE_OK) {
+    sqlite3_result_error(context, zErr ? zErr : "Decimal error", -1);
+    sqlite3_free(zErr);
+    return;
+  }
+  bidFromNumber(&decnum, bytes);
+  sqlite3_result_blob(context, bytes, BID128_BYTES, SQLITE_TRANSIENT);
+}
+
+#pragma mark C interface
+
+int sqlite3_decimal_from_bid128(unsigned char const* aBid, int nValue, unsigned char* aOut, int nOut, int* aOffset,
+                                int* pnDone) {
+  decNumber decnum;
+  int i = 0;
+  int rc = SQLITE_OK;
+
+  if (nValue < 0 || nOut < 0)
+    rc = SQLITE_MISUSE;
+  else {
+    aOffset[0] = 0;
+    for (; i < nValue; i++) {
+      bidToNumber(aBid + (size_t)i * BID128_BYTES, &decnum);
+      if (nOut - aOffset[i] < DECINF_MAXSIZE) { // Encode into a buffer large enough
+        uint8_t bytes[DECINF_MAXSIZE];
+        size_t const len = decInfiniteFromNumber(DECINF_MAXSIZE, bytes, &decnum);
+        if ((size_t)(nOut - aOffset[i]) < len) {
+          rc = SQLITE_FULL;
+          break;
+        }
+        memcpy(aOut + aOffset[i], bytes, len);
+        aOffset[i + 1] = aOffset[i] + (int)len;
+      }
+      else
+        aOffset[i + 1] = aOffset[i] + (int)decInfiniteFromNumber(DECINF_MAXSIZE, aOut + aOffset[i], &decnum);
+    }
+  }
+  if (pnDone) *pnDone = i;
+  return rc;
+}
+
+int sqlite3_decimal_to_bid128(unsigned char const* aIn, int const* aOffset, int nValue, unsigned char* aBid,
+                              int* pnDone) {
+  decNumber decnum;
+  int i = 0;
+  int rc = SQLITE_OK;
+
+  if (nValue < 0)
+    rc = SQLITE_MISUSE;
+  else {
+    for (; i < nValue; i++) {
+      int const len = aOffset[i + 1] - aOffset[i];
+      if (len <= 0 || len > DECINF_MAXSIZE || decInfiniteToNumber((size_t)len, aIn + aOffset[i], &decnum) == 0) {
+        rc = SQLITE_MISMATCH;
+        break;
+      }
+      if (bidRound(&decnum, DEC_ROUND_HALF_UP) & DEC_Overflow) {
+        rc = SQLITE_TOOBIG;
+        break;
+      }
+      bidFromNumber(&decnum, aBid + (size_t)i * BID128_BYTES);
+    }
+  }
+  if (pnDone) *pnDone = i;
+  return rc;
+}
@@ -0,0 +1,175 @@
+/**
+ * \file      collation.c
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     The `DECIMAL` collating sequence for numbers stored as text.
+ *
+ * Numbers (`[sign] digits [. digits] [E [sign] digits]`, and infinities)
+ * are compared by a scanner, which looks at the signs, then at the adjusted
+ * exponents (the exponents of the most significant digits), then at the
+ * digits. No decNumber is built, and numbers of any length are compared
+ * exactly, so that the order is total and transitive. Exponents are
+ * saturated at #COLLATION_MAX_EXPONENT in absolute value.
+ *
+ * Strings that are not numbers, and NaNs, sort after all numbers, in
+ * `memcmp()` order. Numbers with the same value (e.g., `1.0`, `1` and `1E0`)
+ * are equal.
+ */
+#include <string.h>
+#include "impl_decinfinite.h"
+
+/**
+ * \brief Bound of the absolute value of the exponents, beyond which they are
+ *        saturated.
+ */
+#define COLLATION_MAX_EXPONENT 100000000000000000LL
+
+/**
+ * \brief A number, as found by the scanner.
+ *
+ * The digits of the number are those of zInt followed by those of zFrac,
+ * without leading and trailing zeros.
+ */
+typedef struct collationNumber {
+  int sign;           /**< `-1`, `0` or `1` (zero has no sign).            */
+  int isInfinite;     /**< Whether the number is an infinity.              */
+  int64_t exponent;   /**< The adjusted exponent.                          */
+  char const* zInt;   /**< The significant digits of the integer part.     */
+  int nInt;           /**< The length of zInt.                             */
+  char const* zFrac;  /**< The significant digits of the fractional part.  */
+  int nFrac;          /**< The length of zFrac.                            */
+} collationNumber;
+
+/**
+ * \brief Returns whether the text is \a zWord, ignoring case.
+ */
+static int collationIsWord(char const* z, int n, char const* zWord) {
+  int const len = (int)strlen(zWord);
+  if (n != len) return 0;
+  for (int i = 0; i < n; i++)
+    if ((z[i] | 0x20) != zWord[i]) return 0;
+  return 1;
+}
+
+/**
+ * \brief Scans an exponent, saturating it.
+ *
+ * \return A pointer to the first character after the exponent, or `0` if
+ *         there are no digits.
+ */
+static char const* collationScanExponent(char const* p, char const* end, int64_t* exponent) {
+  int isNegative = 0;
+  int64_t e = 0;
+  if (p < end && (*p == '-' || *p == '+')) isNegative = (*p++ == '-');
+  char const* const z = p;
+  for (; p < end && *p >= '0' && *p <= '9'; p++)
+    if (e < COLLATION_MAX_EXPONENT) e = e * 10 + (*p - '0');
+  if (p == z) return 0;
+  if (e > COLLATION_MAX_EXPONENT) e = COLLATION_MAX_EXPONENT;
+  *exponent = isNegative ? -e : e;
+  return p;
+}
+
+/**
+ * \brief Scans a number.
+ *
+ * \return `1` if the text is a number other than a NaN; `0` otherwise.
+ */
+static int collationScan(char const* z, int n, collationNumber* x) {
+  char const* const end = z + n;
+  int isNegative = 0;
+  int64_t exponent = 0;
+
+  if (z < end && (*z == '-' || *z == '+')) isNegative = (*z++ == '-');
+  if (collationIsWord(z, (int)(end - z), "inf") || collationIsWord(z, (int)(end - z), "infinity")) {
+    x->sign = isNegative ? -1 : 1;
+    x->isInfinite = 1;
+    return 1;
+  }
+  char const* p = z;
+  while (p < end && *p >= '0' && *p <= '9') p++;
+  int nDigits = (int)(p - z);
+  x->zInt = z;
+  x->nInt = nDigits;
+  x->zFrac = p;
+  x->nFrac = 0;
+  if (p < end && *p == '.') {
+    x->zFrac = ++p;
+    while (p < end && *p >= '0' && *p <= '9') p++;
+    x->nFrac = (int)(p - x->zFrac);
+    nDigits += x->nFrac;
+  }
+  if (nDigits == 0) return 0;
+  if (p < end && (*p == 'e' || *p == 'E')) p = collationScanExponent(p + 1, end, &exponent);
+  if (p != end) return 0;
+
+  x->isInfinite = 0;
+  while (x->nInt > 0 && *x->zInt == '0') {
+    x->zInt++;
+    x->nInt--;
+  }
+  if (x->nInt > 0) x->exponent = exponent + x->nInt - 1;
+  else {
+    int const nFrac = x->nFrac;
+    while (x->nFrac > 0 && *x->zFrac == '0') {
+      x->zFrac++;
+      x->nFrac--;
+    }
+    x->exponent = exponent - (nFrac - x->nFrac) - 1;
+  }
+  while (x->nFrac > 0 && x->zFrac[x->nFrac - 1] == '0') x->nFrac--;
+  if (x->nFrac == 0)
+    while (x->nInt > 0 && x->zInt[x->nInt - 1] == '0') x->nInt--;
+  x->sign = (x->nInt > 0 || x->nFrac > 0) ? (isNegative ? -1 : 1) : 0; // -0 = 0
+  return 1;
+}
+
+/**
+ * \brief Returns the i-th significant digit of a finite number.
+ */
+static char collationDigit(collationNumber const* x, int i) {
+  return i < x->nInt ? x->zInt[i] : x->zFrac[i - x->nInt];
+}
+
+/**
+ * \brief Compares the magnitudes of two non-zero numbers.
+ */
+static int collationCompareMagnitude(collationNumber const* x, collationNumber const* y) {
+  if (x->isInfinite || y->isInfinite) return x->isInfinite - y->isInfinite;
+  if (x->exponent != y->exponent) return x->exponent < y->exponent ? -1 : 1;
+  int const nx = x->nInt + x->nFrac;
+  int const ny = y->nInt + y->nFrac;
+  int const n = nx < ny ? nx : ny;
+  for (int i = 0; i < n; i++) {
+    char const dx = collationDigit(x, i);
+    char const dy = collationDigit(y, i);
+    if (dx != dy) return dx < dy ? -1 : 1;
+  }
+  return nx == ny ? 0 : (nx < ny ? -1 : 1); // No trailing zeros
+}
+
+int decimalCollate(void* pArg, int n1, void const* z1, int n2, void const* z2) {
+  collationNumber x;
+  collationNumber y;
+  (void)pArg;
+
+  int const isNumber1 = collationScan(z1, n1, &x);
+  int const isNumber2 = collationScan(z2, n2, &y);
+  if (isNumber1 && isNumber2) {
+    if (x.sign != y.sign) return x.sign < y.sign ? -1 : 1;
+    if (x.sign == 0) return 0;
+    int const c = collationCompareMagnitude(&x, &y);
+    return x.sign < 0 ? -c : c;
+  }
+  if (isNumber1 != isNumber2) return isNumber1 ? -1 : 1; // Numbers come first
+
+  int const c = memcmp(z1, z2, (size_t)(n1 < n2 ? n1 : n2));
+  return c != 0 ? c : n1 - n2;
+}
@@ -0,0 +1,736 @@
+/**
+ * \file      columnar.c
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     Columnar snapshots of decimal columns.
+ *
+ * `decColumnarExport(table, column, path [, scale])` writes the values of
+ * a column to a side file, and
+ *
+ *     create virtual table t using decColumnar(path);
+ *
+ * serves the file as a read-only table with a single column, `value`, whose
+ * rowids are those of the source table.
+ *
+ * When a scale is given, each value is stored as a 64-bit integer
+ * coefficient `c` such that the value is `c x 10^-scale`; otherwise, each
+ * value is stored in the IEEE 754 decimal128 format. In either case, values
+ * must be representable exactly, or the export fails.
+ *
+ * The file consists of a header followed by blocks of #COLUMNAR_BLOCK_ROWS
+ * rows. Each block starts with a zone map (the number of rows, the number of
+ * `NULL`s, and the minimum and maximum values, encoded), followed by
+ * a bitmap of `NULL`s, the rowids, and the values. Blocks have a fixed size,
+ * so the table is served straight from the memory-mapped file. Blocks whose
+ * zone map cannot satisfy the constraints on `value` are skipped without
+ * touching their values.
+ *
+ * \note Files use the native byte order: they are meant as local snapshots,
+ *       not as an interchange format.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "impl_decinfinite.h"
+#include "decNumber/decimal128.h"
+#include "mapfile.h"
+
+/**
+ * \brief The signature at the beginning of a columnar file.
+ */
+#define COLUMNAR_MAGIC "DECCOL1"
+
+/**
+ * \brief Marker used to detect files written with a different byte order.
+ */
+#define COLUMNAR_BYTE_ORDER 0x01020304
+
+/**
+ * \brief Number of rows in a block.
+ */
+#define COLUMNAR_BLOCK_ROWS 4096
+
+/**
+ * \brief Rounds a size up to a multiple of 16 bytes.
+ */
+#define COLUMNAR_ALIGN(n) (((n) + 15) & ~(size_t)15)
+
+/**
+ * \brief Storage formats of the values.
+ */
+typedef enum {
+  COLUMNAR_FORMAT_INT64 = 1, /**< Scaled 64-bit integer coefficients. */
+  COLUMNAR_FORMAT_DEC128 = 2 /**< IEEE 754 decimal128.                */
+} columnarFormat;
+
+/**
+ * \brief The header of a columnar file.
+ */
+typedef struct columnarHeader {
+  char magic[8];       /**< #COLUMNAR_MAGIC                                */
+  uint32_t byteOrder;  /**< #COLUMNAR_BYTE_ORDER                           */
+  uint32_t format;     /**< A columnarFormat                               */
+  int32_t exponent;    /**< The exponent of the values in integer format.  */
+  uint32_t blockRows;  /**< The number of rows in each block.              */
+  uint64_t nRows;      /**< The total number of rows.                      */
+  uint64_t nBlocks;    /**< The number of blocks.                          */
+} columnarHeader;
+
+/**
+ * \brief The zone map of a block.
+ */
+typedef struct columnarZone {
+  uint32_t nRows;               /**< The number of rows in the block.      */
+  uint32_t nNull;               /**< The number of `NULL`s in the block.   */
+  uint8_t nMin;                 /**< The length of the encoded minimum.    */
+  uint8_t nMax;                 /**< The length of the encoded maximum.    */
+  uint8_t min[DECINF_MAXSIZE];  /**< The minimum non-null value, encoded.  */
+  uint8_t max[DECINF_MAXSIZE];  /**< The maximum non-null value, encoded.  */
+} columnarZone;
+
+/**
+ * \brief The layout of the blocks of a file.
+ */
+typedef struct columnarLayout {
+  size_t nullOffset;  /**< Offset of the bitmap of `NULL`s in a block. */
+  size_t rowidOffset; /**< Offset of the rowids in a block.             */
+  size_t valueOffset; /**< Offset of the values in a block.             */
+  size_t valueSize;   /**< The size of a value, in bytes.               */
+  size_t blockSize;   /**< The size of a block, in bytes.               */
+} columnarLayout;
+
+static void columnarGetLayout(columnarLayout* layout, uint32_t format, uint32_t blockRows) {
+  layout->valueSize = (format == COLUMNAR_FORMAT_INT64) ? sizeof(int64_t) : sizeof(decimal128);
+  layout->nullOffset = COLUMNAR_ALIGN(sizeof(columnarZone));
+  layout->rowidOffset = layout->nullOffset + COLUMNAR_ALIGN(blockRows / 8);
+  layout->valueOffset = layout->rowidOffset + blockRows * sizeof(int64_t);
+  layout->blockSize = COLUMNAR_ALIGN(layout->valueOffset + blockRows * layout->valueSize);
+}
+
+/**
+ * \brief Compares two blobs as SQLite does.
+ */
+static int columnarBlobCompare(uint8_t const* a, size_t na, uint8_t const* b, size_t nb) {
+  int c = memcmp(a, b, na < nb ? na : nb);
+  return c ? c : (int)na - (int)nb;
+}
+
+#pragma mark Export
+
+/**
+ * \brief State of an export.
+ */
+typedef struct columnarWriter {
+  FILE* out;              /**< The output file.            */
+  columnarHeader header;  /**< The file header.            */
+  columnarLayout layout;  /**< The layout of the blocks.   */
+  uint8_t* block;         /**< The current block.          */
+} columnarWriter;
+
+/**
+ * \brief Writes the current block and starts a new one.
+ */
+static int columnarFlushBlock(columnarWriter* w) {
+  columnarZone* zone = (columnarZone*)w->block;
+  if (zone->nRows == 0) return SQLITE_OK;
+  if (fwrite(w->block, w->layout.blockSize, 1, w->out) != 1) return SQLITE_IOERR;
+  w->header.nRows += zone->nRows;
+  w->header.nBlocks++;
+  memset(w->block, 0, w->layout.blockSize);
+  return SQLITE_OK;
+}
+
+/**
+ * \brief Appends a value to the current block.
+ *
+ * \param w The writer
+ * \param rowid The rowid of the value
+ * \param decnum The value, or `0` for `NULL`
+ * \param decCtx decNumber's context
+ *
+ * \return `1` on success, `0` if the value cannot be stored exactly.
+ */
+static int columnarAppend(columnarWriter* w, sqlite3_int64 rowid, decNumber* decnum, decContext* decCtx) {
+  columnarZone* zone = (columnarZone*)w->block;
+  uint32_t i = zone->nRows;
+
+  ((int64_t*)(w->block + w->layout.rowidOffset))[i] = rowid;
+  if (decnum == 0) {
+    w->block[w->layout.nullOffset + i / 8] |= (uint8_t)(1 << (i % 8));
+    zone->nNull++;
+    zone->nRows++;
+    return 1;
+  }
+
+  uint8_t bytes[DECINF_MAXSIZE];
+  size_t len;
+  if (w->header.format == COLUMNAR_FORMAT_INT64) {
+    int64_t coeff;
+    if (!decNumberToScaledInt64(decnum, w->header.exponent, &coeff)) {
+      decNumber reduced; // Trailing zeros may exceed the scale (e.g., 1.50 with scale 1)
+      decNumberReduce(&reduced, decnum, decCtx);
+      if (!decNumberToScaledInt64(&reduced, w->header.exponent, &coeff)) return 0;
+    }
+    ((int64_t*)(w->block + w->layout.valueOffset))[i] = coeff;
+    len = decInfiniteFromInt64(DECINF_MAXSIZE, bytes, coeff, w->header.exponent);
+  }
+  else {
+    decContext ctx128;
+    decContextDefault(&ctx128, DEC_INIT_DECIMAL128);
+    ctx128.round = decCtx->round;
+    decimal128FromNumber((decimal128*)(w->block + w->layout.valueOffset) + i, decnum, &ctx128);
+    if (decContextTestStatus(&ctx128, DEC_Inexact | DEC_Rounded | DEC_Clamped | DEC_Overflow)) return 0;
+    len = decInfiniteFromNumber(DECINF_MAXSIZE, bytes, decnum);
+  }
+
+  if (zone->nMin == 0 || columnarBlobCompare(bytes, len, zone->min, zone->nMin) < 0) {
+    memcpy(zone->min, bytes, len);
+    zone->nMin = (uint8_t)len;
+  }
+  if (zone->nMax == 0 || columnarBlobCompare(bytes, len, zone->max, zone->nMax) > 0) {
+    memcpy(zone->max, bytes, len);
+    zone->nMax = (uint8_t)len;
+  }
+  zone->nRows++;
+  return 1;
+}
+
+void decimalColumnarExport(sqlite3_context* context, int argc, sqlite3_value** argv) {
+  decContext* decCtx = sqlite3_user_data(context);
+  sqlite3* db = sqlite3_context_db_handle(context);
+  columnarWriter w;
+  sqlite3_stmt* pStmt = 0;
+  char const* zPath;
+  char* zErr = 0;
+  int rc;
+
+  if (argc < 3 || argc > 4) {
+    sqlite3_result_error(context, "Wrong number of arguments", -1);
+    return;
+  }
+  memset(&w, 0, sizeof(w));
+  memcpy(w.header.magic, COLUMNAR_MAGIC, sizeof(COLUMNAR_MAGIC));
+  w.header.byteOrder = COLUMNAR_BYTE_ORDER;
+  w.header.blockRows = COLUMNAR_BLOCK_ROWS;
+  w.header.format = COLUMNAR_FORMAT_DEC128;
+  if (argc == 4) {
+    sqlite3_int64 scale = sqlite3_value_int64(argv[3]);
+    if (scale < 0 || scale > 18) {
+      sqlite3_result_error(context, "The scale must be between 0 and 18", -1);
+      return;
+    }
+    w.header.format = COLUMNAR_FORMAT_INT64;
+    w.header.exponent = -(int32_t)scale;
+  }
+  columnarGetLayout(&w.layout, w.header.format, w.header.blockRows);
+
+  char* zSql = sqlite3_mprintf("select rowid, \"%w\" from \"%w\" order by rowid",
+                               sqlite3_value_text(argv[1]), sqlite3_value_text(argv[0]));
+  if (zSql == 0) {
+    sqlite3_result_error_nomem(context);
+    return;
+  }
+  rc = sqlite3_prepare_v2(db, zSql, -1, &pStmt, 0);
+  sqlite3_free(zSql);
+  if (rc != SQLITE_OK) {
+    sqlite3_result_error(context, sqlite3_errmsg(db), -1);
+    return;
+  }
+
+  zPath = (char const*)sqlite3_value_text(argv[2]);
+  w.block = sqlite3_malloc64(w.layout.blockSize);
+  if (w.block == 0) {
+    rc = SQLITE_NOMEM;
+    goto export_end;
+  }
+  memset(w.block, 0, w.layout.blockSize);
+  w.out = fopen(zPath, "wb");
+  if (w.out == 0) {
+    zErr = sqlite3_mprintf("Cannot write %s", zPath);
+    rc = SQLITE_CANTOPEN;
+    goto export_end;
+  }
+  if (fwrite(&w.header, sizeof(w.header), 1, w.out) != 1) {
+    rc = SQLITE_IOERR;
+    goto export_end;
+  }
+
+  decContext ctx; // Conversion errors are reported as export errors
+  decimalContextCopy(&ctx, decCtx);
+  ctx.traps = 0;
+  while ((rc = sqlite3_step(pStmt)) == SQLITE_ROW) {
+    sqlite3_int64 rowid = sqlite3_column_int64(pStmt, 0);
+    sqlite3_value* value = sqlite3_column_value(pStmt, 1);
+    decNumber decnum;
+    decNumber* pNum = 0;
+
+    if (sqlite3_value_type(value) != SQLITE_NULL) {
+      decContextZeroStatus(&ctx);
+      pNum = decNumberFromSQLite3Value(&decnum, value, &ctx);
+      if (pNum == 0 || decContextTestStatus(&ctx, DEC_Conversion_syntax)) {
+        zErr = sqlite3_mprintf("Invalid decimal at rowid %lld", rowid);
+        rc = SQLITE_ERROR;
+        break;
+      }
+    }
+    if (!columnarAppend(&w, rowid, pNum, &ctx)) {
+      zErr = sqlite3_mprintf("The value at rowid %lld cannot be stored exactly", rowid);
+      rc = SQLITE_ERROR;
+      break;
+    }
+    if (((columnarZone*)w.block)->nRows == w.header.blockRows && (rc = columnarFlushBlock(&w)) != SQLITE_OK)
+      break;
+  }
+  if (rc == SQLITE_DONE) rc = columnarFlushBlock(&w);
+  if (rc == SQLITE_OK && (fseek(w.out, 0, SEEK_SET) != 0 || fwrite(&w.header, sizeof(w.header), 1, w.out) != 1))
+    rc = SQLITE_IOERR;
+
+export_end:
+  sqlite3_finalize(pStmt);
+  sqlite3_free(w.block);
+  if (w.out && fclose(w.out) != 0 && rc == SQLITE_OK) rc = SQLITE_IOERR;
+  if (rc == SQLITE_OK)
+    sqlite3_result_int64(context, (sqlite3_int64)w.header.nRows);
+  else {
+    if (w.out) remove(zPath);
+    if (zErr) sqlite3_result_error(context, zErr, -1);
+    else if (rc == SQLITE_NOMEM) sqlite3_result_error_nomem(context);
+    else if (rc == SQLITE_IOERR) sqlite3_result_error(context, "I/O error while writing the columnar file", -1);
+    else sqlite3_result_error(context, sqlite3_errmsg(db), -1);
+  }
+  sqlite3_free(zErr);
+}
+
+#pragma mark Virtual table
+
+#ifndef SQLITE_OMIT_VIRTUALTABLE
+
+/** \brief Bit of idxNum set when there is a `value =` constraint. */
+#define COLUMNAR_EQ 0x01
+/** \brief Bit of idxNum set when there is a `value >` constraint. */
+#define COLUMNAR_GT 0x02
+/** \brief Bit of idxNum set when there is a `value >=` constraint. */
+#define COLUMNAR_GE 0x04
+/** \brief Bit of idxNum set when there is a `value <` constraint. */
+#define COLUMNAR_LT 0x08
+/** \brief Bit of idxNum set when there is a `value <=` constraint. */
+#define COLUMNAR_LE 0x10
+/** \brief Number of constraint kinds. */
+#define COLUMNAR_NOPS 5
+
+typedef struct decimalColumnarVTab decimalColumnarVTab;
+
+/**
+ * \brief A decColumnar virtual table.
+ */
+struct decimalColumnarVTab {
+  sqlite3_vtab base;             /**< Base class - must be first. */
+  decimalMappedFile file;        /**< The content of the file.    */
+  columnarHeader const* header;  /**< The header of the file.     */
+  columnarLayout layout;         /**< The layout of the blocks.   */
+};
+
+/**
+ * \brief A bound on the values, from a constraint.
+ */
+typedef struct columnarBound {
+  int op;                        /**< One of the COLUMNAR_* bits.  */
+  size_t len;                    /**< The length of the bound.     */
+  uint8_t bytes[DECINF_MAXSIZE]; /**< The bound, as a blob.        */
+} columnarBound;
+
+typedef struct decimalColumnarCursor decimalColumnarCursor;
+
+/**
+ * \brief A cursor over a decColumnar virtual table.
+ */
+struct decimalColumnarCursor {
+  sqlite3_vtab_cursor base;       /**< Base class - must be first.         */
+  uint64_t iBlock;                /**< The current block.                  */
+  uint32_t iRow;                  /**< The current row in the block.       */
+  int isEof;                      /**< Whether the scan is over.           */
+  int isEmpty;                    /**< Whether no row can match.           */
+  int nBound;                     /**< The number of bounds.               */
+  columnarBound aBound[COLUMNAR_NOPS]; /**< Bounds from the constraints.   */
+  int64_t lo;                     /**< Lower bound on integer values.      */
+  int64_t hi;                     /**< Upper bound on integer values.      */
+  columnarZone const* zone;       /**< The zone map of the current block.  */
+  uint8_t const* nulls;           /**< The `NULL`s of the current block.   */
+  int64_t const* rowids;          /**< The rowids of the current block.    */
+  uint8_t const* values;          /**< The values of the current block.    */
+};
+
+static int decimalColumnarDisconnect(sqlite3_vtab* pVtab) {
+  decimalColumnarVTab* p = (decimalColumnarVTab*)pVtab;
+  decimalUnmapFile(&p->file);
+  sqlite3_free(p);
+  return SQLITE_OK;
+}
+
+/**
+ * \brief Checks the zone maps of a file.
+ *
+ * \return `1` if every zone map is consistent with the header, so that the
+ *         cursors can trust it; `0` otherwise.
+ */
+static int columnarCheckZones(decimalColumnarVTab const* pVtab) {
+  columnarHeader const* h = pVtab->header;
+  uint64_t nRows = 0;
+  for (uint64_t i = 0; i < h->nBlocks; i++) {
+    columnarZone const* zone = (columnarZone const*)((uint8_t const*)pVtab->file.zData + sizeof(*h)
+                                                     + i * pVtab->layout.blockSize);
+    if (zone->nRows > h->blockRows || zone->nNull > zone->nRows
+        || zone->nMin > DECINF_MAXSIZE || zone->nMax > DECINF_MAXSIZE)
+      return 0;
+    nRows += zone->nRows;
+  }
+  return nRows == h->nRows;
+}
+
+static int decimalColumnarConnect(sqlite3* db, void* pAux, int argc, char const* const* argv,
+                                  sqlite3_vtab** ppVtab, char** pzErr) {
+  (void)pAux;
+
+  decimalColumnarVTab* pVtab;
+  char* zFile;
+  int rc;
+
+  if (argc != 4) {
+    *pzErr = sqlite3_mprintf("Usage: %s(filename)", argv[0]);
+    return SQLITE_ERROR;
+  }
+  rc = sqlite3_declare_vtab(db, "create table x(value blob)");
+  if (rc != SQLITE_OK) return rc;
+
+  pVtab = sqlite3_malloc(sizeof(*pVtab));
+  zFile = sqlite3_mprintf("%s", argv[3]);
+  if (pVtab == 0 || zFile == 0) {
+    sqlite3_free(pVtab);
+    sqlite3_free(zFile);
+    return SQLITE_NOMEM;
+  }
+  memset(pVtab, 0, sizeof(*pVtab));
+  sqlite3_int64 n = (sqlite3_int64)strlen(zFile);
+  if (n >= 2 && (zFile[0] == '\'' || zFile[0] == '"') && zFile[n - 1] == zFile[0]) {
+    memmove(zFile, zFile + 1, (size_t)n - 2);
+    zFile[n - 2] = '\0';
+  }
+
+  rc = decimalMapFile(zFile, 0, &pVtab->file);
+  if (rc != SQLITE_OK)
+    *pzErr = sqlite3_mprintf("Cannot read %s", zFile);
+  else {
+    columnarHeader const* h = (columnarHeader const*)pVtab->file.zData;
+    if (pVtab->file.nData < (sqlite3_int64)sizeof(*h) || memcmp(h->magic, COLUMNAR_MAGIC, sizeof(COLUMNAR_MAGIC)) != 0
+        || h->byteOrder != COLUMNAR_BYTE_ORDER || h->blockRows == 0 || h->blockRows % 8 != 0
+        || (h->format != COLUMNAR_FORMAT_INT64 && h->format != COLUMNAR_FORMAT_DEC128)) {
+      *pzErr = sqlite3_mprintf("Not a columnar decimal file: %s", zFile);
+      rc = SQLITE_ERROR;
+    }
+    else {
+      columnarGetLayout(&pVtab->layout, h->format, h->blockRows);
+      if (h->nBlocks > ((uint64_t)pVtab->file.nData - sizeof(*h)) / pVtab->layout.blockSize) {
+        *pzErr = sqlite3_mprintf("Truncated columnar decimal file: %s", zFile);
+        rc = SQLITE_ERROR;
+      }
+      else {
+        pVtab->header = h;
+        if (!columnarCheckZones(pVtab)) {
+          *pzErr = sqlite3_mprintf("Corrupt columnar decimal file: %s", zFile);
+          rc = SQLITE_CORRUPT;
+        }
+      }
+    }
+  }
+  sqlite3_free(zFile);
+  if (rc != SQLITE_OK) {
+    decimalColumnarDisconnect(&pVtab->base);
+    return rc;
+  }
+  *ppVtab = &pVtab->base;
+  return SQLITE_OK;
+}
+
+/**
+ * \brief Implementation of xCreate, which must differ from xConnect so that
+ *        the module is not eponymous.
+ */
+static int decimalColumnarCreate(sqlite3* db, void* pAux, int argc, char const* const* argv,
+                                 sqlite3_vtab** ppVtab, char** pzErr) {
+  return decimalColumnarConnect(db, pAux, argc, argv, ppVtab, pzErr);
+}
+
+static int decimalColumnarOpen(sqlite3_vtab* p, sqlite3_vtab_cursor** ppCursor) {
+  (void)p;
+  decimalColumnarCursor* pCur;
+  pCur = sqlite3_malloc(sizeof(*pCur));
+  if (pCur == 0) return SQLITE_NOMEM;
+  memset(pCur, 0, sizeof(*pCur));
+  pCur->isEof = 1;
+  *ppCursor = &pCur->base;
+  return SQLITE_OK;
+}
+
+static int decimalColumnarClose(sqlite3_vtab_cursor* cur) {
+  sqlite3_free(cur);
+  return SQLITE_OK;
+}
+
+/**
+ * \brief Returns whether a block may contain rows satisfying the bounds.
+ */
+static int columnarZoneMatches(decimalColumnarCursor const* pCur, columnarZone const* zone) {
+  if (pCur->nBound == 0) return 1;
+  if (zone->nMin == 0) return 0; // Only NULLs
+  for (int i = 0; i < pCur->nBound; i++) {
+    columnarBound const* b = &pCur->aBound[i];
+    int cmpMin = columnarBlobCompare(zone->min, zone->nMin, b->bytes, b->len);
+    int cmpMax = columnarBlobCompare(zone->max, zone->nMax, b->bytes, b->len);
+    switch (b->op) {
+      case COLUMNAR_EQ: if (cmpMin > 0 || cmpMax < 0) return 0; break;
+      case COLUMNAR_GT: if (cmpMax <= 0) return 0; break;
+      case COLUMNAR_GE: if (cmpMax < 0) return 0; break;
+      case COLUMNAR_LT: if (cmpMin >= 0) return 0; break;
+      case COLUMNAR_LE: if (cmpMin > 0) return 0; break;
+    }
+  }
+  return 1;
+}
+
+static int decimalColumnarNext(sqlite3_vtab_cursor* cur) {
+  decimalColumnarCursor* pCur = (decimalColumnarCursor*)cur;
+  decimalColumnarVTab* pVtab = (decimalColumnarVTab*)cur->pVtab;
+  columnarLayout const* layout = &pVtab->layout;
+
+  ++pCur->iRow;
+  for (;;) {
+    if (pCur->zone == 0 || pCur->iRow >= pCur->zone->nRows) { // Move to the next matching block
+      if (pCur->zone) ++pCur->iBlock;
+      for (; pCur->iBlock < pVtab->header->nBlocks; ++pCur->iBlock) {
+        uint8_t const* block = (uint8_t const*)pVtab->file.zData + sizeof(columnarHeader)
+                               + pCur->iBlock * layout->blockSize;
+        columnarZone const* zone = (columnarZone const*)block;
+        if (!columnarZoneMatches(pCur, zone)) continue;
+        pCur->zone = zone;
+        pCur->nulls = block + layout->nullOffset;
+        pCur->rowids = (int64_t const*)(block + layout->rowidOffset);
+        pCur->values = block + layout->valueOffset;
+        pCur->iRow = 0;
+        break;
+      }
+      if (pCur->iBlock >= pVtab->header->nBlocks) {
+        pCur->isEof = 1;
+        return SQLITE_OK;
+      }
+    }
+
+    uint32_t const n = pCur->zone->nRows;
+    uint32_t i = pCur->iRow;
+    if (pCur->nBound == 0) return SQLITE_OK; // Every row matches
+    if (pVtab->header->format == COLUMNAR_FORMAT_INT64) {
+      int64_t const* v = (int64_t const*)pCur->values;
+      int64_t const lo = pCur->lo;
+      int64_t const hi = pCur->hi;
+      for (; i < n; i++)
+        if (v[i] >= lo && v[i] <= hi && !(pCur->nulls[i / 8] & (1 << (i % 8)))) break;
+    }
+    else {
+      while (i < n && (pCur->nulls[i / 8] & (1 << (i % 8)))) i++;
+    }
+    pCur->iRow = i;
+    if (i < n) return SQLITE_OK;
+  }
+}
+
+static int decimalColumnarEof(sqlite3_vtab_cursor* cur) {
+  return ((decimalColumnarCursor*)cur)->isEof;
+}
+
+static int decimalColumnarColumn(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int i) {
+  (void)i;
+  decimalColumnarCursor* pCur = (decimalColumnarCursor*)cur;
+  decimalColumnarVTab* pVtab = (decimalColumnarVTab*)cur->pVtab;
+  uint32_t k = pCur->iRow;
+
+  if (pCur->nulls[k / 8] & (1 << (k % 8))) return SQLITE_OK; // NULL
+  if (pVtab->header->format == COLUMNAR_FORMAT_INT64) {
+    uint8_t bytes[DECINF_MAXSIZE];
+    size_t len = decInfiniteFromInt64(DECINF_MAXSIZE, bytes, ((int64_t const*)pCur->values)[k],
+                                      pVtab->header->exponent);
+    sqlite3_result_blob(ctx, bytes, (int)len, SQLITE_TRANSIENT);
+  }
+  else {
+    decNumber decnum;
+    decimal128ToNumber((decimal128 const*)pCur->values + k, &decnum);
+    decNumberToSQLite3Blob(ctx, &decnum);
+  }
+  return SQLITE_OK;
+}
+
+static int decimalColumnarRowid(sqlite3_vtab_cursor* cur, sqlite_int64* pRowid) {
+  decimalColumnarCursor* pCur = (decimalColumnarCursor*)cur;
+  *pRowid = pCur->rowids[pCur->iRow];
+  return SQLITE_OK;
+}
+
+/**
+ * \brief Narrows the bounds on integer coefficients using a decimal bound.
+ *
+ * The interval is only narrowed conservatively: SQLite checks the
+ * constraints again on the rows returned by the cursor.
+ */
+static void columnarNarrowInt64(decimalColumnarCursor* pCur, int32_t exponent, columnarBound const* b) {
+  decNumber bound;
+  decNumber quantum;
+  decNumber q;
+  decContext ctx;
+  int64_t c;
+
+  if (!decInfiniteToNumber(b->len, b->bytes, &bound) || decNumberIsNaN(&bound)) return;
+  if (decNumberIsInfinite(&bound)) {
+    if ((b->op & (COLUMNAR_GT | COLUMNAR_GE)) && !decNumberIsNegative(&bound)) pCur->isEmpty = 1;
+    if ((b->op & (COLUMNAR_LT | COLUMNAR_LE)) && decNumberIsNegative(&bound)) pCur->isEmpty = 1;
+    return;
+  }
+  decContextDefault(&ctx, DEC_INIT_BASE);
+  ctx.digits = DECNUMDIGITS;
+  ctx.traps = 0;
+  decNumberZero(&quantum);
+  quantum.exponent = exponent;
+
+  if (b->op & (COLUMNAR_EQ | COLUMNAR_GT | COLUMNAR_GE)) {
+    ctx.round = DEC_ROUND_CEILING;
+    decNumberQuantize(&q, &bound, &quantum, &ctx);
+    if (decNumberToScaledInt64(&q, exponent, &c)) { if (c > pCur->lo) pCur->lo = c; }
+    else if (!decNumberIsNegative(&bound)) pCur->isEmpty = 1; // Above any coefficient
+  }
+  if (b->op & (COLUMNAR_EQ | COLUMNAR_LT | COLUMNAR_LE)) {
+    ctx.round = DEC_ROUND_FLOOR;
+    decContextZeroStatus(&ctx);
+    decNumberQuantize(&q, &bound, &quantum, &ctx);
+    if (decNumberToScaledInt64(&q, exponent, &c)) { if (c < pCur->hi) pCur->hi = c; }
+    else if (decNumberIsNegative(&bound)) pCur->isEmpty = 1; // Below any coefficient
+  }
+}
+
+/**
+ * \brief Implementation of the xFilter method for decColumnar.
+ *
+ * The bits of \a idxNum tell which constraints on `value` are passed, in
+ * bit order. Only blob arguments are used: SQLite checks all the
+ * constraints again, so ignoring a constraint is always safe.
+ */
+static int decimalColumnarFilter(sqlite3_vtab_cursor* cur, int idxNum, char const* idxStr,
+                                 int argc, sqlite3_value** argv) {
+  (void)idxStr;
+  (void)argc;
+
+  decimalColumnarCursor* pCur = (decimalColumnarCursor*)cur;
+  decimalColumnarVTab* pVtab = (decimalColumnarVTab*)cur->pVtab;
+  int j = 0;
+
+  pCur->nBound = 0;
+  pCur->isEmpty = 0;
+  pCur->lo = INT64_MIN;
+  pCur->hi = INT64_MAX;
+  for (int op = 1; op < (1 << COLUMNAR_NOPS); op <<= 1) {
+    if (!(idxNum & op)) continue;
+    sqlite3_value* value = argv[j++];
+    if (sqlite3_value_type(value) == SQLITE_NULL) pCur->isEmpty = 1;
+    if (sqlite3_value_type(value) != SQLITE_BLOB) continue;
+    int len = sqlite3_value_bytes(value);
+    if (len <= 0 || len > DECINF_MAXSIZE) continue;
+    columnarBound* b = &pCur->aBound[pCur->nBound++];
+    b->op = op;
+    b->len = (size_t)len;
+    memcpy(b->bytes, sqlite3_value_blob(value), (size_t)len);
+    if (pVtab->header->format == COLUMNAR_FORMAT_INT64)
+      columnarNarrowInt64(pCur, pVtab->header->exponent, b);
+  }
+
+  pCur->iBlock = 0;
+  pCur->zone = 0;
+  pCur->isEof = pCur->isEmpty;
+  if (pCur->isEof) return SQLITE_OK;
+  pCur->iRow = (uint32_t)-1; // Incremented by xNext
+  return decimalColumnarNext(cur);
+}
+
+/**
+ * \brief Implementation of the xBestIndex method for decColumnar.
+ *
+ * At most one constraint of each kind is used; the constraints are not
+ * omitted, because only blob arguments can be used for pruning.
+ */
+static int decimalColumnarBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
+  decimalColumnarVTab* pVtab = (decimalColumnarVTab*)tab;
+  int aIdx[COLUMNAR_NOPS] = { -1, -1, -1, -1, -1 };
+  int idxNum = 0;
+  double nRows = (double)pVtab->header->nRows + 1.0;
+
+  for (int i = 0; i < pIdxInfo->nConstraint; i++) {
+    struct sqlite3_index_constraint const* pCons = &pIdxInfo->aConstraint[i];
+    int k;
+    if (!pCons->usable || pCons->iColumn != 0) continue;
+    switch (pCons->op) {
+      case SQLITE_INDEX_CONSTRAINT_EQ: k = 0; break;
+      case SQLITE_INDEX_CONSTRAINT_GT: k = 1; break;
+      case SQLITE_INDEX_CONSTRAINT_GE: k = 2; break;
+      case SQLITE_INDEX_CONSTRAINT_LT: k = 3; break;
+      case SQLITE_INDEX_CONSTRAINT_LE: k = 4; break;
+      default: continue;
+    }
+    if (aIdx[k] >= 0) continue;
+    aIdx[k] = i;
+    idxNum |= (1 << k);
+  }
+
+  int nArg = 0;
+  for (int k = 0; k < COLUMNAR_NOPS; k++) {
+    if (aIdx[k] < 0) continue;
+    pIdxInfo->aConstraintUsage[aIdx[k]].argvIndex = ++nArg;
+    nRows /= (k == 0) ? 100.0 : 4.0;
+  }
+  pIdxInfo->idxNum = idxNum;
+  pIdxInfo->estimatedCost = nRows;
+  pIdxInfo->estimatedRows = (sqlite3_int64)nRows + 1;
+  return SQLITE_OK;
+}
+
+/**
+ * \brief A virtual table module that serves columnar decimal files.
+ */
+sqlite3_module decimalColumnarModule = {
+  0,
+  decimalColumnarCreate,
+  decimalColumnarConnect,
+  decimalColumnarBestIndex,
+  decimalColumnarDisconnect,
+  decimalColumnarDisconnect,
+  decimalColumnarOpen,
+  decimalColumnarClose,
+  decimalColumnarFilter,
+  decimalColumnarNext,
+  decimalColumnarEof,
+  decimalColumnarColumn,
+  decimalColumnarRowid,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+};
+
+#endif /* SQLITE_OMIT_VIRTUALTABLE */
@@ -0,0 +1,508 @@
+/**
+ * \file      csv.c
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     A virtual table reading CSV files with decimal columns.
+ *
+ * Usage:
+ *
+ *     create virtual table prices using decCsv(
+ *       'prices.csv', 'sym text, day text, px decimal(18,4)', header
+ *     );
+ *
+ * The first argument is the path of the file, the second argument is the list
+ * of columns, and the optional third argument (`header`) tells that the first
+ * line of the file must be skipped. Columns whose declared type starts with
+ * `DECIMAL` are parsed into encoded decimals; all the other columns are
+ * returned as text.
+ *
+ * The file is memory-mapped when the table is connected and unmapped when it
+ * is disconnected. Rows are split in place and text fields are returned
+ * without copying them (except for quoted fields containing escaped quotes).
+ * Only the fields up to the last column used by a query are delimited, and
+ * a field is parsed only when its value is requested.
+ *
+ * Fields that cannot be parsed as decimals and rows having fewer fields than
+ * the columns being read are counted as rejects, and the missing or invalid
+ * values are returned as `NULL`. The number of rejects found by a scan so far
+ * is available in the hidden column `rejects`.
+ *
+ * \note The file must not be truncated while it is mapped.
+ */
+#include <string.h>
+#include "impl_decinfinite.h"
+#include "mapfile.h"
+
+#ifndef SQLITE_OMIT_VIRTUALTABLE
+
+/**
+ * \brief The maximum number of columns tracked individually by colUsed.
+ */
+#define CSV_MAX_COLUSED 63
+
+/**
+ * \brief Parsing state of a field in the current row.
+ */
+typedef enum {
+  CSV_FIELD_UNPARSED = 0, /**< The field has not been parsed yet.       */
+  CSV_FIELD_VALID,        /**< The field has been parsed successfully.  */
+  CSV_FIELD_REJECTED      /**< The field could not be parsed.           */
+} csvFieldState;
+
+typedef struct decimalCsvVTab decimalCsvVTab;
+
+/**
+ * \brief A decCsv virtual table.
+ */
+struct decimalCsvVTab {
+  sqlite3_vtab base;      /**< Base class - must be first.                   */
+  decContext* decCtx;     /**< The shared context.                           */
+  decimalMappedFile file; /**< The content of the file.                      */
+  sqlite3_int64 iStart;   /**< Offset of the first row (after the header).   */
+  int nCol;               /**< Number of visible columns.                    */
+  uint8_t* aDecimal;      /**< For each column, whether it is DECIMAL.       */
+};
+
+typedef struct decimalCsvCursor decimalCsvCursor;
+
+/**
+ * \brief A cursor over a decCsv virtual table.
+ */
+struct decimalCsvCursor {
+  sqlite3_vtab_cursor base; /**< Base class - must be first.                 */
+  sqlite3_int64 iRow;       /**< Current row number (from 1).                */
+  sqlite3_int64 iNext;      /**< Offset of the next row.                     */
+  sqlite3_int64 nReject;    /**< Number of rejects found so far.             */
+  int isEof;                /**< Whether the scan is over.                   */
+  int nUsed;                /**< Number of fields to delimit in each row.    */
+  int nField;               /**< Number of fields delimited in the row.      */
+  char const** azField;     /**< Start of each field.                        */
+  int* anField;             /**< Length of each field.                       */
+  uint8_t* aEscaped;        /**< Whether a field contains escaped quotes.    */
+  uint8_t* aState;          /**< Parsing state of each field (csvFieldState).*/
+};
+
+#pragma mark Parsing
+
+/**
+ * \brief Removes SQL quotes from a virtual table argument.
+ *
+ * \return A string allocated with `sqlite3_malloc()`, or `0` if out of memory.
+ */
+static char* csvDequote(char const* z) {
+  char q = z[0];
+  if (q != '\'' && q != '"' && q != '`' && q != '[') return sqlite3_mprintf("%s", z);
+  if (q == '[') q = ']';
+
+  size_t n = strlen(z);
+  char* zOut = sqlite3_malloc64(n);
+  if (zOut == 0) return 0;
+  size_t j = 0;
+  for (size_t i = 1; i < n; i++) {
+    if (z[i] == q) {
+      if (z[i + 1] != q) break;
+      ++i;
+    }
+    zOut[j++] = z[i];
+  }
+  zOut[j] = '\0';
+  return zOut;
+}
+
+/**
+ * \brief Returns whether a character may appear in an unquoted identifier.
+ */
+static int csvIsIdChar(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || (c & 0x80);
+}
+
+/**
+ * \brief Finds the columns of a schema and which of them are DECIMAL.
+ *
+ * \param zSchema A comma-separated list of column definitions
+ * \param aDecimal If not null, receives a flag for each column
+ *
+ * \return The number of columns.
+ */
+static int csvParseSchema(char const* zSchema, uint8_t* aDecimal) {
+  int nCol = 0;
+  char const* z = zSchema;
+
+  while (*z) {
+    while (*z == ' ' || *z == '\t' || *z == '\n' || *z == '\r') z++;
+    if (*z == 0) break;
+
+    // Column name
+    if (*z == '"' || *z == '`' || *z == '[' || *z == '\'') {
+      char q = (*z == '[') ? ']' : *z;
+      for (z++; *z && !(*z == q && z[1] != q); z++)
+        if (*z == q) z++;
+      if (*z) z++;
+    }
+    else
+      while (csvIsIdChar(*z)) z++;
+    while (*z == ' ' || *z == '\t' || *z == '\n' || *z == '\r') z++;
+
+    // Declared type
+    int isDecimal = sqlite3_strnicmp(z, "decimal", 7) == 0 && !csvIsIdChar(z[7]);
+    if (aDecimal) aDecimal[nCol] = (uint8_t)isDecimal;
+    ++nCol;
+
+    // Skip to the next column definition
+    int depth = 0;
+    for (; *z && (depth > 0 || *z != ','); z++) {
+      if (*z == '(') ++depth;
+      else if (*z == ')') --depth;
+    }
+    if (*z == ',') z++;
+  }
+  return nCol;
+}
+
+/**
+ * \brief Returns a pointer past the end of the row starting at \a p.
+ *
+ * Quoted fields may contain newlines.
+ */
+static char const* csvSkipRow(char const* p, char const* end) {
+  for (;;) {
+    char const* nl = memchr(p, '\n', (size_t)(end - p));
+    if (nl == 0) nl = end;
+    char const* q = memchr(p, '"', (size_t)(nl - p));
+    if (q == 0) return nl < end ? nl + 1 : end;
+    // Skip the quoted part, which may span several lines
+    q = memchr(q + 1, '"', (size_t)(end - q - 1));
+    if (q == 0) return end;
+    p = q + 1;
+  }
+}
+
+/**
+ * \brief Delimits the fields of the next row.
+ *
+ * Only the first `nUsed` fields are delimited; the rest of the row is skipped.
+ * Empty lines are skipped.
+ */
+static void csvReadRow(decimalCsvCursor* pCur, decimalCsvVTab* pVtab) {
+  char const* p = pVtab->file.zData + pCur->iNext;
+  char const* const end = pVtab->file.zData + pVtab->file.nData;
+
+  while (p < end && (*p == '\n' || *p == '\r')) p++;
+  if (p >= end) {
+    pCur->isEof = 1;
+    return;
+  }
+
+  int i = 0;
+  int eol = 0;
+  while (i < pCur->nUsed && !eol) {
+    char const* z = p;
+    int n;
+    int escaped = 0;
+    if (p < end && *p == '"') {
+      char const* zEnd = end; // Unless the closing quote is found
+      z = ++p;
+      for (;;) {
+        char const* q = memchr(p, '"', (size_t)(end - p));
+        if (q == 0) { p = end; break; }
+        if (q + 1 < end && q[1] == '"') { escaped = 1; p = q + 2; continue; }
+        zEnd = q;
+        p = q + 1;
+        break;
+      }
+      n = (int)(zEnd - z);
+      while (p < end && *p != ',' && *p != '\n') p++;
+    }
+    else {
+      while (p < end && *p != ',' && *p != '\n') p++;
+      n = (int)(p - z);
+      if (n > 0 && z[n - 1] == '\r') --n;
+    }
+    pCur->azField[i] = z;
+    pCur->anField[i] = n;
+    pCur->aEscaped[i] = (uint8_t)escaped;
+    pCur->aState[i] = CSV_FIELD_UNPARSED;
+    ++i;
+    if (p >= end) eol = 1;
+    else if (*p++ == '\n') eol = 1;
+  }
+
+  pCur->nField = i;
+  if (i < pCur->nUsed) ++pCur->nReject; // Too few fields
+  if (!eol) p = csvSkipRow(p, end);
+  pCur->iNext = p - pVtab->file.zData;
+}
+
+#pragma mark Virtual table methods
+
+static int decimalCsvDisconnect(sqlite3_vtab* pVtab) {
+  decimalCsvVTab* p = (decimalCsvVTab*)pVtab;
+  decimalUnmapFile(&p->file);
+  sqlite3_free(p->aDecimal);
+  sqlite3_free(p);
+  return SQLITE_OK;
+}
+
+static int decimalCsvConnect(sqlite3* db, void* pAux, int argc, char const* const* argv,
+                             sqlite3_vtab** ppVtab, char** pzErr) {
+  decimalCsvVTab* pVtab = 0;
+  char* zFile = 0;
+  char* zSchema = 0;
+  char* zSql = 0;
+  int rc = SQLITE_OK;
+
+  if (argc < 5 || argc > 6) {
+    *pzErr = sqlite3_mprintf("Usage: %s(filename, schema [, header])", argv[0]);
+    return SQLITE_ERROR;
+  }
+  zFile = csvDequote(argv[3]);
+  zSchema = csvDequote(argv[4]);
+  pVtab = sqlite3_malloc(sizeof(*pVtab));
+  if (zFile == 0 || zSchema == 0 || pVtab == 0) {
+    rc = SQLITE_NOMEM;
+    goto connect_end;
+  }
+  memset(pVtab, 0, sizeof(*pVtab));
+  pVtab->decCtx = pAux;
+
+  if (argc == 6) {
+    char* zOpt = csvDequote(argv[5]);
+    int isHeader = zOpt && sqlite3_stricmp(zOpt, "header") == 0;
+    sqlite3_free(zOpt);
+    if (!isHeader) {
+      *pzErr = sqlite3_mprintf("Unknown option: %s", argv[5]);
+      rc = SQLITE_ERROR;
+      goto connect_end;
+    }
+    pVtab->iStart = -1; // Computed below
+  }
+
+  pVtab->nCol = csvParseSchema(zSchema, 0);
+  if (pVtab->nCol == 0) {
+    *pzErr = sqlite3_mprintf("The schema of a CSV table must have at least one column");
+    rc = SQLITE_ERROR;
+    goto connect_end;
+  }
+  pVtab->aDecimal = sqlite3_malloc(pVtab->nCol);
+  zSql = sqlite3_mprintf("create table x(%s, rejects hidden)", zSchema);
+  if (pVtab->aDecimal == 0 || zSql == 0) {
+    rc = SQLITE_NOMEM;
+    goto connect_end;
+  }
+  csvParseSchema(zSchema, pVtab->aDecimal);
+
+  rc = sqlite3_declare_vtab(db, zSql);
+  if (rc != SQLITE_OK) {
+    *pzErr = sqlite3_mprintf("%s", sqlite3_errmsg(db));
+    goto connect_end;
+  }
+
+  rc = decimalMapFile(zFile, 1, &pVtab->file);
+  if (rc != SQLITE_OK) {
+    *pzErr = sqlite3_mprintf("Cannot read %s", zFile);
+    goto connect_end;
+  }
+  if (pVtab->iStart < 0 && pVtab->file.nData > 0)
+    pVtab->iStart = csvSkipRow(pVtab->file.zData, pVtab->file.zData + pVtab->file.nData) - pVtab->file.zData;
+  else if (pVtab->iStart < 0)
+    pVtab->iStart = 0;
+
+connect_end:
+  sqlite3_free(zFile);
+  sqlite3_free(zSchema);
+  sqlite3_free(zSql);
+  if (rc != SQLITE_OK) {
+    if (pVtab) decimalCsvDisconnect(&pVtab->base);
+    return rc;
+  }
+  *ppVtab = &pVtab->base;
+  return SQLITE_OK;
+}
+
+/**
+ * \brief Implementation of xCreate, which must differ from xConnect so that
+ *        the module is not eponymous.
+ */
+static int decimalCsvCreate(sqlite3* db, void* pAux, int argc, char const* const* argv,
+                            sqlite3_vtab** ppVtab, char** pzErr) {
+  return decimalCsvConnect(db, pAux, argc, argv, ppVtab, pzErr);
+}
+
+static int decimalCsvOpen(sqlite3_vtab* p, sqlite3_vtab_cursor** ppCursor) {
+  decimalCsvVTab* pVtab = (decimalCsvVTab*)p;
+  decimalCsvCursor* pCur;
+  size_t nCol = (size_t)pVtab->nCol;
+  size_t nByte = sizeof(*pCur) + nCol * (sizeof(char const*) + sizeof(int) + 2);
+
+  pCur = sqlite3_malloc64(nByte);
+  if (pCur == 0) return SQLITE_NOMEM;
+  memset(pCur, 0, nByte);
+  pCur->azField = (char const**)&pCur[1];
+  pCur->anField = (int*)&pCur->azField[nCol];
+  pCur->aEscaped = (uint8_t*)&pCur->anField[nCol];
+  pCur->aState = &pCur->aEscaped[nCol];
+  pCur->isEof = 1;
+  *ppCursor = &pCur->base;
+  return SQLITE_OK;
+}
+
+static int decimalCsvClose(sqlite3_vtab_cursor* cur) {
+  sqlite3_free(cur);
+  return SQLITE_OK;
+}
+
+static int decimalCsvNext(sqlite3_vtab_cursor* cur) {
+  decimalCsvCursor* pCur = (decimalCsvCursor*)cur;
+  csvReadRow(pCur, (decimalCsvVTab*)cur->pVtab);
+  ++pCur->iRow;
+  return SQLITE_OK;
+}
+
+static int decimalCsvEof(sqlite3_vtab_cursor* cur) {
+  return ((decimalCsvCursor*)cur)->isEof;
+}
+
+/**
+ * \brief Returns a quoted field with escaped quotes, unescaped.
+ */
+static void csvResultUnescaped(sqlite3_context* ctx, char const* z, int n) {
+  char* zOut = sqlite3_malloc(n + 1);
+  if (zOut == 0) {
+    sqlite3_result_error_nomem(ctx);
+    return;
+  }
+  int j = 0;
+  for (int i = 0; i < n; i++) {
+    zOut[j++] = z[i];
+    if (z[i] == '"' && i + 1 < n && z[i + 1] == '"') ++i;
+  }
+  sqlite3_result_text(ctx, zOut, j, sqlite3_free);
+}
+
+static int decimalCsvColumn(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int i) {
+  decimalCsvCursor* pCur = (decimalCsvCursor*)cur;
+  decimalCsvVTab* pVtab = (decimalCsvVTab*)cur->pVtab;
+
+  if (i == pVtab->nCol) {
+    sqlite3_result_int64(ctx, pCur->nReject);
+    return SQLITE_OK;
+  }
+  if (i >= pCur->nField) return SQLITE_OK; // NULL
+
+  char const* z = pCur->azField[i];
+  int n = pCur->anField[i];
+
+  if (!pVtab->aDecimal[i]) {
+    if (pCur->aEscaped[i])
+      csvResultUnescaped(ctx, z, n);
+    else // The file stays mapped as long as the table is connected
+      sqlite3_result_text(ctx, z, n, SQLITE_STATIC);
+    return SQLITE_OK;
+  }
+
+  while (n > 0 && (*z == ' ' || *z == '\t')) { z++; n--; }
+  while (n > 0 && (z[n - 1] == ' ' || z[n - 1] == '\t')) n--;
+  if (n == 0 || pCur->aState[i] == CSV_FIELD_REJECTED) return SQLITE_OK; // NULL
+
+  uint8_t bytes[DECINF_MAXSIZE];
+  decContext decCtx; // Conversion errors are counted, not reported
+  decimalContextCopy(&decCtx, pVtab->decCtx);
+  decCtx.traps = 0;
+  size_t len = decimalEncodeText(z, (size_t)n, DECINF_MAXSIZE, bytes, &decCtx);
+  if (len == 0) {
+    if (pCur->aState[i] == CSV_FIELD_UNPARSED) ++pCur->nReject;
+    pCur->aState[i] = CSV_FIELD_REJECTED;
+    return SQLITE_OK;
+  }
+  pCur->aState[i] = CSV_FIELD_VALID;
+  sqlite3_result_blob(ctx, bytes, (int)len, SQLITE_TRANSIENT);
+  return SQLITE_OK;
+}
+
+static int decimalCsvRowid(sqlite3_vtab_cursor* cur, sqlite_int64* pRowid) {
+  *pRowid = ((decimalCsvCursor*)cur)->iRow;
+  return SQLITE_OK;
+}
+
+/**
+ * \brief Implementation of the xFilter method for decCsv.
+ *
+ * \a idxNum is the number of fields to delimit in each row.
+ */
+static int decimalCsvFilter(sqlite3_vtab_cursor* cur, int idxNum, char const* idxStr,
+                            int argc, sqlite3_value** argv) {
+  (void)idxStr;
+  (void)argc;
+  (void)argv;
+
+  decimalCsvCursor* pCur = (decimalCsvCursor*)cur;
+  decimalCsvVTab* pVtab = (decimalCsvVTab*)cur->pVtab;
+  pCur->nUsed = idxNum;
+  pCur->iNext = pVtab->iStart;
+  pCur->iRow = 0;
+  pCur->nReject = 0;
+  pCur->isEof = 0;
+  return decimalCsvNext(cur);
+}
+
+/**
+ * \brief Implementation of the xBestIndex method for decCsv.
+ *
+ * Only the columns used by the query, as reported by `colUsed`, are
+ * delimited when reading a row.
+ */
+static int decimalCsvBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
+  decimalCsvVTab* pVtab = (decimalCsvVTab*)tab;
+  int nUsed = 0;
+
+  for (int i = 0; i < pVtab->nCol; i++) {
+    if (i >= CSV_MAX_COLUSED) { // The last bit stands for all the remaining columns
+      if (pIdxInfo->colUsed & ((sqlite3_uint64)1 << CSV_MAX_COLUSED)) nUsed = pVtab->nCol;
+      break;
+    }
+    if (pIdxInfo->colUsed & ((sqlite3_uint64)1 << i)) nUsed = i + 1;
+  }
+  pIdxInfo->idxNum = nUsed;
+  pIdxInfo->estimatedCost = (double)pVtab->file.nData + 1.0;
+  pIdxInfo->estimatedRows = pVtab->file.nData / 32 + 1;
+  return SQLITE_OK;
+}
+
+/**
+ * \brief A virtual table module that reads CSV files.
+ */
+sqlite3_module decimalCsvModule = {
+  0,
+  decimalCsvCreate,
+  decimalCsvConnect,
+  decimalCsvBestIndex,
+  decimalCsvDisconnect,
+  decimalCsvDisconnect,
+  decimalCsvOpen,
+  decimalCsvClose,
+  decimalCsvFilter,
+  decimalCsvNext,
+  decimalCsvEof,
+  decimalCsvColumn,
+  decimalCsvRowid,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+};
+
+#endif /* SQLITE_OMIT_VIRTUALTABLE */
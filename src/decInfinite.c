@@ -173,6 +173,7 @@
 #include <stdint.h>
 
 #include "decInfinite.h"
+#include "probes.h"
 
 /**
  * \brief Tests if a decNumber, known to be finite, is zero.
@@ -851,7 +852,7 @@ static void decShiftToMost(decNumber* decnum) {
 
 // Conversions
 
-size_t decInfiniteFromNumber(size_t len, uByte result[len], decNumber* decnum) {
+static inline size_t decInfiniteEncode(size_t len, uByte result[len], decNumber* decnum) {
   // Treat special cases (zero, infinities and NaNs) first.
   if (decNumberIsSpecial(decnum)) {
     if (decNumberIsInfinite(decnum))
@@ -898,7 +899,31 @@ size_t decInfiniteFromNumber(size_t len, uByte result[len], decNumber* decnum) {
   return (p.pos - &result[0] + 1);
 }
 
-decNumber* decInfiniteToNumber(size_t len, uint8_t const bytes[len], decNumber* decnum) {
+size_t decInfiniteFromNumber(size_t len, uByte result[len], decNumber* decnum) {
+  Int const digits = decnum->digits; // Encoding shifts the digits in place
+  size_t const n = decInfiniteEncode(len, result, decnum);
+  SQLITE_DECIMAL_PROBE2(encode, n, digits);
+  return n;
+}
+
+size_t decInfiniteFromInt64(size_t len, uByte result[len], int64_t coeff, int32_t exponent) {
+  decNumber decnum;
+  uint64_t u = coeff < 0 ? -(uint64_t)coeff : (uint64_t)coeff;
+
+  decNumberZero(&decnum);
+  if (coeff < 0) decnum.bits = DECNEG;
+  if (u == 0) return decInfiniteFromNumber(len, result, &decnum);
+
+  Unit* up = decnum.lsu;
+  for (; u > 0; u /= 1000) *up++ = (Unit)(u % 1000);
+  --up;
+  decnum.digits = 3 * (int32_t)(up - decnum.lsu) + (*up > 99 ? 3 : *up > 9 ? 2 : 1);
+  decnum.exponent = exponent;
+
+  return decInfiniteFromNumber(len, result, &decnum);
+}
+
+static inline decNumber* decInfiniteDecode(size_t len, uint8_t const bytes[len], decNumber* decnum) {
   assert(len > 0);
 
   if (len == 1) { // Assume zero or special number
@@ -966,6 +991,164 @@ decNumber* decInfiniteToNumber(size_t len, uint8_t const bytes[len], decNumber*
   return decnum;
 }
 
+decNumber* decInfiniteToNumber(size_t len, uint8_t const bytes[len], decNumber* decnum) {
+  decNumber* res = decInfiniteDecode(len, bytes, decnum);
+  SQLITE_DECIMAL_PROBE2(decode, res ? len : 0, res ? res->digits : 0);
+  return res;
+}
+
+int decInfiniteToInt64(size_t len, uint8_t const bytes[len], int64_t* coeff, int32_t* exponent) {
+  assert(len > 0);
+
+  if (len == 1) { // Only (positive) zero is accepted
+    if (bytes[0] != 0x80) return 0;
+    *coeff = 0;
+    *exponent = 0;
+    return 1;
+  }
+
+  uByte neg;
+  switch (bytes[0] & 0xE0) {
+    case 0x20:
+      neg = 1;
+      break;
+    case 0x80:
+      neg = 0;
+      break;
+    default:
+      return 0;
+  }
+
+  switch (bytes[0] & 0xFC) {
+    case 0x8C:
+    case 0x30:
+      return 0;
+    default:
+      break;
+  }
+
+  bitPos p = { .pos = (uByte*)&bytes[0], .free = 5 };
+  uByte const* end = bytes + len;
+  Int adj_exp;
+
+  p = decInfiniteUnpackExponent(&adj_exp, p, end);
+  if (!p.pos) return 0;
+
+  // Number of declets: at most six fit into 18 digits
+  size_t n = (8 * (end - p.pos) - (8 - p.free)) / 10;
+  if (n == 0 || n > 6) return 0;
+
+  dUnit out;
+  uint64_t u = 0;
+  Unit msu = 0;
+  for (size_t i = 0; i < n; ++i) {
+    if (p.free == 0) {
+      ++p.pos;
+      p.free = 8;
+    }
+    DECLET_HI(out) = *p.pos & MASK[p.free];
+    ++p.pos;
+    DECLET_LO(out) = *p.pos;
+    p.free -= 2;
+    out.declet >>= p.free;
+    if (out.declet > 999) return 0; // Invalid unit
+    if (i == 0) msu = out.declet;
+    u = u * 1000 + out.declet;
+  }
+
+  if (u % 1000 == 0) return 0; // The least significant unit cannot be zero
+  if (neg) {
+    if (n > 1 && msu > 899) return 0; // Out of range
+    uint64_t pow = 1;
+    for (size_t i = 0; i < n; ++i) pow *= 1000;
+    *coeff = -(int64_t)(pow - u); // Ten's complement
+  }
+  else {
+    if (msu == 0) return 0; // The most significant unit cannot be zero
+    *coeff = (int64_t)u;
+  }
+  *exponent = adj_exp - 3 * (Int)n + 1;
+
+  return 1;
+}
+
+decInfiniteCheckResult decInfiniteCheck(size_t len, uint8_t const bytes[len]) {
+  if (len == 0) return DECINF_EMPTY;
+  if (len > DECINF_MAXSIZE) return DECINF_TOO_LONG;
+
+  if (len == 1) { // Zero or special number
+    switch (bytes[0]) {
+      case 0x00: case 0x20: case 0x60: case 0x80: case 0xC0: case 0xE0:
+        return DECINF_VALID;
+      default:
+        return DECINF_INVALID_SPECIAL;
+    }
+  }
+
+  uByte neg;
+  switch (bytes[0] & 0xE0) {
+    case 0x20:
+      neg = 1;
+      break;
+    case 0x80:
+      neg = 0;
+      break;
+    default:
+      return DECINF_INVALID_SIGN;
+  }
+
+  switch (bytes[0] & 0xFC) {
+    case 0x8C:
+    case 0x30:
+      return DECINF_INVALID_EXPONENT;
+    default:
+      break;
+  }
+
+  bitPos p = { .pos = (uByte*)&bytes[0], .free = 5 };
+  uByte const* end = bytes + len;
+  Int adj_exp;
+
+  p = decInfiniteUnpackExponent(&adj_exp, p, end);
+  if (!p.pos) return DECINF_INVALID_EXPONENT;
+
+  size_t const nbits = 8 * (size_t)(end - p.pos) - (8 - p.free);
+  size_t const n = nbits / 10; // Number of declets
+  uCount const npad = nbits % 10;
+  if (n == 0) return DECINF_TRUNCATED;
+  if (3 * n > DECNUMDIGITS) return DECINF_TOO_MANY_DIGITS;
+
+  // Read the declets from a window of up to 17 bits, refilled a byte at a time
+  uint64_t window = *p.pos & MASK[p.free];
+  uCount avail = p.free;
+  uByte const* q = p.pos + 1;
+  Unit msu = 0;
+  Unit declet = 0;
+  for (size_t i = 0; i < n; ++i) {
+    while (avail < 10) {
+      window = (window << 8) | *q++;
+      avail += 8;
+    }
+    avail -= 10;
+    declet = (Unit)(window >> avail);
+    window &= MASK[avail];
+    if (declet > 999) return DECINF_INVALID_DECLET;
+    if (i == 0) msu = declet;
+  }
+
+  // A positive significand starts with three digits; a negative one is
+  // complemented, and a single unit is complemented to 1000
+  if (neg) {
+    if (n == 1 ? msu > 900 : msu > 899) return DECINF_INVALID_MSU;
+  }
+  else if (msu < 100) return DECINF_INVALID_MSU;
+  if (declet == 0) return DECINF_INVALID_LSU;
+
+  if (npad >= 8 || (bytes[len - 1] & MASK[npad])) return DECINF_INVALID_PADDING;
+
+  return DECINF_VALID;
+}
+
 int decInfiniteIsSpecial(size_t len, uint8_t const bytes[len]) {
   return (len == 1 && (bytes[0]  == 0x00 || bytes[0] == 0x20 || bytes[0] == 0xC0 || bytes[0] == 0xE0));
 }
@@ -984,6 +1167,28 @@ int32_t decInfiniteExponent(size_t len, uint8_t const bytes[len]) {
   return exponent;
 }
 
+int decInfiniteDigits(size_t len, uint8_t const bytes[len]) {
+  if (decInfiniteIsSpecial(len, bytes)) return 0;
+  if (len == 1) return 1; // Zero
+  bitPos p = { .pos = (uByte*)&bytes[0], .free = 5 };
+  Int exponent;
+  p = decInfiniteUnpackExponent(&exponent, p, bytes + len);
+  if (!p.pos) return 0;
+
+  size_t const start = 8 * (size_t)(p.pos - bytes) + (8 - p.free); // First bit of the significand
+  size_t const n = (8 * len - start) / 10; // Number of declets
+  if (n == 0) return 0;
+  // Read the least significant declet from a 24-bit window. A complemented
+  // (negative) declet has as many trailing zeros as the original one.
+  size_t const bit = start + 10 * (n - 1);
+  size_t const i = bit / 8;
+  uint32_t window = (uint32_t)bytes[i] << 16;
+  if (i + 1 < len) window |= (uint32_t)bytes[i + 1] << 8;
+  if (i + 2 < len) window |= bytes[i + 2];
+  Unit const lsu = (Unit)((window >> (14 - bit % 8)) & 0x3FF);
+  return 3 * (int)n - (lsu % 100 == 0 ? 2 : lsu % 10 == 0 ? 1 : 0);
+}
+
 /**
  * \brief Initializes \a p so that it points to the starting bit of the mantissa.
  *
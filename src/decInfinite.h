@@ -114,6 +114,25 @@
  */
 size_t decInfiniteFromNumber(size_t len, uint8_t result[len], decNumber* decnum);
 
+/**
+ * \brief Encodes a fixed-point number into a stream of bytes.
+ *
+ * The encoded number is `coeff x 10^exponent`. This is equivalent to building
+ * a decNumber from \a coeff and \a exponent and calling
+ * decInfiniteFromNumber(), but it avoids any string conversion and any
+ * arithmetic operation, so it is suitable for generating many values quickly.
+ *
+ * \param len The length of the output stream of bytes
+ * \param result The output stream of bytes
+ * \param coeff The coefficient of the number
+ * \param exponent The (unadjusted) exponent of the number
+ *
+ * \return The size of the result, in bytes
+ *
+ * \note The same assumptions as for decInfiniteFromNumber() apply.
+ */
+size_t decInfiniteFromInt64(size_t len, uint8_t result[len], int64_t coeff, int32_t exponent);
+
 /**
  * \brief Decodes a Decimal Infinite byte stream into a \c decNumber.
  *
@@ -126,6 +145,60 @@ size_t decInfiniteFromNumber(size_t len, uint8_t result[len], decNumber* decnum)
  */
 decNumber* decInfiniteToNumber(size_t len, uint8_t const bytes[len], decNumber* decnum);
 
+/**
+ * \brief Decodes a Decimal Infinite byte stream into a fixed-point number.
+ *
+ * This is the inverse of decInfiniteFromInt64(): on success, the decoded number
+ * is `coeff x 10^exponent`, with the same coefficient and exponent that
+ * decInfiniteToNumber() would produce. Only finite numbers with at most 18
+ * digits, excluding minus zero, can be decoded in this way.
+ *
+ * \param len The number of bytes of the encoded number
+ * \param bytes The encoded number
+ * \param coeff The output coefficient
+ * \param exponent The output (unadjusted) exponent
+ *
+ * \return `1` if the number has been decoded; `0` if it does not fit or
+ *         a decoding error occurs.
+ */
+int decInfiniteToInt64(size_t len, uint8_t const bytes[len], int64_t* coeff, int32_t* exponent);
+
+/**
+ * \brief The outcomes of decInfiniteCheck().
+ */
+typedef enum {
+  DECINF_VALID = 0,          /**< The encoding is valid.                              */
+  DECINF_EMPTY,              /**< The stream of bytes is empty.                       */
+  DECINF_TOO_LONG,           /**< The stream is longer than #DECINF_MAXSIZE bytes.    */
+  DECINF_INVALID_SPECIAL,    /**< A single byte that is not a zero or special number. */
+  DECINF_INVALID_SIGN,       /**< The sign or padding bits are wrong.                 */
+  DECINF_INVALID_EXPONENT,   /**< The exponent is wrongly encoded or out of range.    */
+  DECINF_TRUNCATED,          /**< There are no bits left for the significand.         */
+  DECINF_TOO_MANY_DIGITS,    /**< The significand has more than #DECNUMDIGITS digits. */
+  DECINF_INVALID_DECLET,     /**< A declet encodes a number greater than 999.         */
+  DECINF_INVALID_MSU,        /**< The most significant unit is out of range.          */
+  DECINF_INVALID_LSU,        /**< The least significant unit is zero.                 */
+  DECINF_INVALID_PADDING     /**< The trailing bits are not a zero padding.           */
+} decInfiniteCheckResult;
+
+/**
+ * \brief Checks that a stream of bytes is a valid Decimal Infinite encoding.
+ *
+ * This is the check that decInfiniteToNumber() carries out while decoding,
+ * made stricter where the decoder is lenient: the significand must be
+ * aligned as decInfiniteFromNumber() aligns it and the trailing bits must be
+ * zero. No decNumber is built: the declets are read from a 64-bit window and
+ * only compared, so this function is suitable for checking many values
+ * quickly.
+ *
+ * \param len The number of bytes of the encoded number
+ * \param bytes The encoded number
+ *
+ * \return #DECINF_VALID if the stream is a valid encoding; otherwise, the
+ *         first problem found.
+ */
+decInfiniteCheckResult decInfiniteCheck(size_t len, uint8_t const bytes[len]);
+
 /**
  * \brief Determines whether an encoded number is special.
  *
@@ -164,6 +237,22 @@ int decInfiniteSign(uint8_t const* bytes);
  */
 int32_t decInfiniteExponent(size_t len, uint8_t const bytes[len]);
 
+/**
+ * \brief Returns the number of digits of the significand of a decimal.
+ *
+ * The significand is not decoded: since it is aligned to its most
+ * significant digit, only the number of declets and the trailing zeros of
+ * the least significant one are needed.
+ *
+ * \param len The number of bytes of the encoded decimal number
+ * \param bytes The encoded decimal number, assumed to be valid (see
+ *        decInfiniteCheck())
+ *
+ * \return The number of digits of the significand (`1` for zero), or `0`
+ *         for a special number.
+ */
+int decInfiniteDigits(size_t len, uint8_t const bytes[len]);
+
 /**
  * \brief Returns the significand of a decimal as a string.
  *
@@ -210,7 +210,9 @@ decContext *decContextSetRounding(decContext *context,
 /* ------------------------------------------------------------------ */
 decContext * decContextSetStatus(decContext *context, uInt status) {
   context->status|=status;
+  #if DECTRAPSIG
   if (status & context->traps) raise(SIGFPE);
+  #endif
   return context;} // decContextSetStatus
 
 /* ------------------------------------------------------------------ */
@@ -45,7 +45,15 @@
     #include <stdint.h>            /* C99 standard integers           */
   #endif
   #include <stdio.h>               /* for printf, etc.                */
+
+  /* Trap signal flag -- set this to 0 to check traps from status     */
+  #if !defined(DECTRAPSIG)
+  #define DECTRAPSIG 1             /* 1=raise SIGFPE on traps         */
+  #endif
+
+  #if DECTRAPSIG
   #include <signal.h>              /* for traps                       */
+  #endif
 
   /* Extended flags setting -- set this to 0 to use only IEEE flags   */
   #if !defined(DECEXTFLAG)
@@ -15,17 +15,46 @@
 #include <string.h>
 #include "impl_decimal.h"
 
+#if HAVE_PTHREAD_H && !defined(SQLITE_CORE)
+#include <pthread.h>
+#endif
+
 SQLITE_EXTENSION_INIT1
 
-#pragma mark Macros
+#ifndef SQLITE_RESULT_SUBTYPE
+/**
+ * \brief Flag of the functions that set a subtype on their result.
+ *
+ * Since version 3.45, SQLite drops the subtype set by the functions that are
+ * not registered with this flag. Older versions ignore it.
+ */
+#define SQLITE_RESULT_SUBTYPE 0x001000000
+#endif
 
-#if !defined(SQLITE_DECIMAL_PREFIX)
+#ifndef SQLITE_SUBTYPE
 /**
- * \brief The prefix of all SQL decimal functions.
+ * \brief Flag of the functions that read the subtype of their arguments.
+ *
+ * The decimal64, decimal128 and fixed decimals are recognized by their
+ * subtype, which any function converting its arguments into decimals reads.
  */
-#define SQLITE_DECIMAL_PREFIX "dec"
+#define SQLITE_SUBTYPE 0x000100000
 #endif
 
+#ifndef SQLITE_INNOCUOUS
+/**
+ * \brief Flag of the functions that may be used in triggers and views when
+ *        `trusted_schema` is off.
+ *
+ * Since version 3.31, SQLite refuses to run the functions that are not
+ * registered with this flag in the schema of an untrusted database. Older
+ * versions ignore it.
+ */
+#define SQLITE_INNOCUOUS 0x000200000
+#endif
+
+#pragma mark Macros
+
 /**
  * \brief Checks for `NULL`s and sets the result accordingly.
  **/
@@ -35,19 +64,45 @@ SQLITE_EXTENSION_INIT1
     return;                                     \
   }
 
+/**
+ * \brief Defines the function registered for `fun` as a call to its body,
+ *        which is recorded in the profile of the connection while profiling
+ *        is on.
+ *
+ * Each profiled function gets an entry of the profile, numbered in the order
+ * of definition.
+ *
+ * \param nCheck The number of leading arguments for which a `NULL` makes the
+ *               function return `NULL` (`-1` for all the arguments)
+ *
+ * \see profile.c
+ */
+#define SQLITE_DECIMAL_PROFILED(fun, nCheck)                                                       \
+  enum { decimal ## fun ## Id = __COUNTER__ };                                                     \
+  static void decimal ## fun ## Func(sqlite3_context* context, int argc, sqlite3_value** argv) {  \
+    if (SQLITE_DECIMAL_PROFILE_ACTIVE())                                                           \
+      decimalProfileCall(decimalContextProfile(sqlite3_user_data(context)), decimal ## fun ## Id, \
+                         decimal ## fun ## Func, decimal ## fun ## Body, nCheck, context, argc, argv); \
+    else                                                                                           \
+      decimal ## fun ## Body(context, argc, argv);                                                 \
+  }
+
 #pragma mark Nullary functions
 
 /**
  * \brief Prototype for generating nullary (0-ary) functions.
  */
 #define SQLITE_DECIMAL_OP0(fun)                                                                  \
-  static void decimal ## fun ## Func(sqlite3_context* context, int argc, sqlite3_value** argv) { \
+  static void decimal ## fun ## Body(sqlite3_context* context, int argc, sqlite3_value** argv) { \
     (void)argc;                                                                                  \
     (void)argv;                                                                                  \
     decimal ## fun(context);                                                                     \
-  }
+  }                                                                                              \
+  SQLITE_DECIMAL_PROFILED(fun, 0)
 
 SQLITE_DECIMAL_OP0(ClearStatus)
+SQLITE_DECIMAL_OP0(ProfileReset)
+SQLITE_DECIMAL_OP0(ProfileStop)
 SQLITE_DECIMAL_OP0(Status)
 SQLITE_DECIMAL_OP0(Version)
 
@@ -57,11 +112,12 @@ SQLITE_DECIMAL_OP0(Version)
  * \brief Prototype for generating unary functions.
  */
 #define SQLITE_DECIMAL_OP1(fun)                                                                   \
-  static void decimal ## fun ## Func (sqlite3_context* context, int argc, sqlite3_value** argv) { \
+  static void decimal ## fun ## Body (sqlite3_context* context, int argc, sqlite3_value** argv) { \
     (void) argc;                                                                                  \
     CHECK_NULL(context, argv[0])                                                                  \
     decimal ## fun(context, argv[0]);                                                             \
-  }
+  }                                                                                               \
+  SQLITE_DECIMAL_PROFILED(fun, 1)
 
 SQLITE_DECIMAL_OP1(Abs)
 SQLITE_DECIMAL_OP1(Bits)
@@ -70,6 +126,9 @@ SQLITE_DECIMAL_OP1(Class)
 SQLITE_DECIMAL_OP1(Create)
 SQLITE_DECIMAL_OP1(Digits)
 SQLITE_DECIMAL_OP1(Exp)
+SQLITE_DECIMAL_OP1(FromBID128)
+SQLITE_DECIMAL_OP1(From128)
+SQLITE_DECIMAL_OP1(From64)
 SQLITE_DECIMAL_OP1(GetCoefficient)
 SQLITE_DECIMAL_OP1(GetExponent)
 SQLITE_DECIMAL_OP1(Invert)
@@ -84,6 +143,7 @@ SQLITE_DECIMAL_OP1(IsNormal)
 SQLITE_DECIMAL_OP1(IsPositive)
 SQLITE_DECIMAL_OP1(IsSigned)
 SQLITE_DECIMAL_OP1(IsSubnormal)
+SQLITE_DECIMAL_OP1(IsValid)
 SQLITE_DECIMAL_OP1(IsZero)
 SQLITE_DECIMAL_OP1(Ln)
 SQLITE_DECIMAL_OP1(Log10)
@@ -97,21 +157,46 @@ SQLITE_DECIMAL_OP1(Sqrt)
 SQLITE_DECIMAL_OP1(ToInt32)
 SQLITE_DECIMAL_OP1(ToInt64)
 SQLITE_DECIMAL_OP1(ToIntegral)
+SQLITE_DECIMAL_OP1(ToBID128)
+SQLITE_DECIMAL_OP1(To128)
+SQLITE_DECIMAL_OP1(To64)
+SQLITE_DECIMAL_OP1(ToJson)
 SQLITE_DECIMAL_OP1(ToString)
 SQLITE_DECIMAL_OP1(Trim)
 
+static void decimalTryBody(sqlite3_context* context, int argc, sqlite3_value** argv) {
+  (void)argc;
+  CHECK_NULL(context, argv[0])
+  decimalTry(context, argv[0]);
+}
+
+enum { decimalTryId = __COUNTER__ };
+
+/**
+ * \brief Profiled wrapper of decimalTry(), whose user data are not the decimal
+ *        context, but the counters of the rejected values.
+ */
+static void decimalTryFunc(sqlite3_context* context, int argc, sqlite3_value** argv) {
+  if (SQLITE_DECIMAL_PROFILE_ACTIVE())
+    decimalProfileCall(decimalContextProfile(decimalRejectsContext(sqlite3_user_data(context))), decimalTryId,
+                       decimalTryFunc, decimalTryBody, 1, context, argc, argv);
+  else
+    decimalTryBody(context, argc, argv);
+}
+
 #pragma mark Binary functions
 
 /**
  * \brief Prototype for generating binary functions.
  */
 #define SQLITE_DECIMAL_OP2(fun)                                                                   \
-  static void decimal ## fun ## Func (sqlite3_context* context, int argc, sqlite3_value** argv) { \
+  static void decimal ## fun ## Body (sqlite3_context* context, int argc, sqlite3_value** argv) { \
     (void)argc;                                                                                   \
     CHECK_NULL(context, argv[0])                                                                  \
     CHECK_NULL(context, argv[1])                                                                  \
     decimal ## fun(context, argv[0], argv[1]);                                                    \
-  }
+  }                                                                                               \
+  SQLITE_DECIMAL_PROFILED(fun, 2)
 
 SQLITE_DECIMAL_OP2(And)
 SQLITE_DECIMAL_OP2(Compare)
@@ -120,6 +205,11 @@ SQLITE_DECIMAL_OP2(DivideInteger)
 SQLITE_DECIMAL_OP2(Equal)
 SQLITE_DECIMAL_OP2(GreaterThan)
 SQLITE_DECIMAL_OP2(GreaterThanOrEqual)
+SQLITE_DECIMAL_OP2(Fixed)
+SQLITE_DECIMAL_OP2(FromFixed)
+SQLITE_DECIMAL_OP2(FromPacked)
+SQLITE_DECIMAL_OP2(Json)
+SQLITE_DECIMAL_OP2(JsonSum)
 SQLITE_DECIMAL_OP2(LessThan)
 SQLITE_DECIMAL_OP2(LessThanOrEqual)
 SQLITE_DECIMAL_OP2(NotEqual)
@@ -132,6 +222,8 @@ SQLITE_DECIMAL_OP2(ScaleB)
 SQLITE_DECIMAL_OP2(Shift)
 SQLITE_DECIMAL_OP2(SameQuantum)
 SQLITE_DECIMAL_OP2(Subtract)
+SQLITE_DECIMAL_OP2(ToFixed)
+SQLITE_DECIMAL_OP2(ToScaledInt)
 SQLITE_DECIMAL_OP2(Xor)
 
 #pragma mark Ternary functions
@@ -141,25 +233,28 @@ SQLITE_DECIMAL_OP2(Xor)
  *
  * \see decNumber's manual, p. 36 and p. 56.
  */
-static void decimalFMAFunc(sqlite3_context* context, int argc, sqlite3_value** argv) {
+static void decimalFMABody(sqlite3_context* context, int argc, sqlite3_value** argv) {
   for (int i = 0; i < argc; ++i) {
     CHECK_NULL(context, argv[i])
   }
   decimalFMA(context, argv[0], argv[1], argv[2]);
 }
 
+SQLITE_DECIMAL_PROFILED(FMA, -1)
+
 #pragma mark Variadic functions
 
 /**
  * \brief Prototype for generating variadic functions.
  */
 #define SQLITE_DECIMAL_OPn(fun)                                                                   \
-  static void decimal ## fun ## Func (sqlite3_context* context, int argc, sqlite3_value** argv) { \
+  static void decimal ## fun ## Body (sqlite3_context* context, int argc, sqlite3_value** argv) { \
     for (int i = 0; i < argc; ++i) {                                                              \
       CHECK_NULL(context, argv[i])                                                                \
     }                                                                                             \
     decimal ## fun(context, argc, argv);                                                          \
-  }
+  }                                                                                               \
+  SQLITE_DECIMAL_PROFILED(fun, -1)
 
 SQLITE_DECIMAL_OPn(Add)
 SQLITE_DECIMAL_OPn(Max)
@@ -167,17 +262,28 @@ SQLITE_DECIMAL_OPn(MaxMag)
 SQLITE_DECIMAL_OPn(Min)
 SQLITE_DECIMAL_OPn(MinMag)
 SQLITE_DECIMAL_OPn(Multiply)
+SQLITE_DECIMAL_OPn(RandomValue)
+SQLITE_DECIMAL_OPn(ToPacked)
+SQLITE_DECIMAL_OPn(ColumnarExport)
+SQLITE_DECIMAL_OPn(ArrowExport)
+SQLITE_DECIMAL_OPn(ParallelAgg)
+SQLITE_DECIMAL_OPn(Materialize)
+SQLITE_DECIMAL_OPn(Migrate)
+SQLITE_DECIMAL_OPn(ProfileStart)
 
 #pragma mark Aggregate functions
 
 /**
  * \brief Prototype for generating aggregate functions.
+ *
+ * Only the steps are profiled.
  */
 #define SQLITE_DECIMAL_AGGR(fun)                                                                     \
-  static void decimal ## fun ## StepFunc(sqlite3_context* context, int argc, sqlite3_value** argv) { \
+  static void decimal ## fun ## StepBody(sqlite3_context* context, int argc, sqlite3_value** argv) { \
     CHECK_NULL(context, argv[0]);                                                                    \
     decimal ## fun ## Step(context, argc, argv);                                                     \
   }                                                                                                  \
+  SQLITE_DECIMAL_PROFILED(fun ## Step, 1)                                                            \
   static void decimal ## fun ## FinalFunc(sqlite3_context* context) {                                \
     decimal ## fun ## Final(context);                                                                \
   }
@@ -187,6 +293,11 @@ SQLITE_DECIMAL_AGGR(Min)
 SQLITE_DECIMAL_AGGR(Max)
 SQLITE_DECIMAL_AGGR(Avg)
 
+/**
+ * \brief The number of profiled functions.
+ */
+enum { decimalProfiledCount = __COUNTER__ };
+
 #pragma mark Virtual tables
 
 #ifndef SQLITE_OMIT_VIRTUALTABLE
@@ -712,6 +823,180 @@ SQLITE_DECIMAL_MODULE(Traps)
 
 #endif /* SQLITE_OMIT_VIRTUALTABLE */
 
+#pragma mark Registered functions
+
+/**
+ * \brief Deterministic functions.
+ */
+static const struct {
+  char const* zName;
+  int nArg;
+  void (*xFunc)(sqlite3_context*, int, sqlite3_value**);
+} aFunc[] = {
+  { SQLITE_DECIMAL_PREFIX "",               1, decimalCreateFunc             },
+  { SQLITE_DECIMAL_PREFIX "Abs",            1, decimalAbsFunc                },
+  { SQLITE_DECIMAL_PREFIX "Add",           -1, decimalAddFunc                },
+  { SQLITE_DECIMAL_PREFIX "And",            2, decimalAndFunc                },
+  { SQLITE_DECIMAL_PREFIX "Bits",           1, decimalBitsFunc               },
+  { SQLITE_DECIMAL_PREFIX "Bytes",          1, decimalBytesFunc              },
+  { SQLITE_DECIMAL_PREFIX "Class",          1, decimalClassFunc              },
+  { SQLITE_DECIMAL_PREFIX "ClearStatus",    0, decimalClearStatusFunc        },
+  { SQLITE_DECIMAL_PREFIX "Compare",        2, decimalCompareFunc            },
+  { SQLITE_DECIMAL_PREFIX "Digits",         1, decimalDigitsFunc             },
+  { SQLITE_DECIMAL_PREFIX "Div",            2, decimalDivideFunc             },
+  { SQLITE_DECIMAL_PREFIX "DivInt",         2, decimalDivideIntegerFunc      },
+  { SQLITE_DECIMAL_PREFIX "Eq",             2, decimalEqualFunc              },
+  { SQLITE_DECIMAL_PREFIX "Exp",            1, decimalExpFunc                },
+  { SQLITE_DECIMAL_PREFIX "FMA",            3, decimalFMAFunc                },
+  { SQLITE_DECIMAL_PREFIX "Fixed",          2, decimalFixedFunc              },
+  { SQLITE_DECIMAL_PREFIX "FromBID128",     1, decimalFromBID128Func         },
+  { SQLITE_DECIMAL_PREFIX "From128",        1, decimalFrom128Func            },
+  { SQLITE_DECIMAL_PREFIX "From64",         1, decimalFrom64Func             },
+  { SQLITE_DECIMAL_PREFIX "FromFixed",      2, decimalFromFixedFunc          },
+  { SQLITE_DECIMAL_PREFIX "FromPacked",     2, decimalFromPackedFunc         },
+  { SQLITE_DECIMAL_PREFIX "Ge",             2, decimalGreaterThanOrEqualFunc },
+  { SQLITE_DECIMAL_PREFIX "GetCoeff",       1, decimalGetCoefficientFunc     },
+  { SQLITE_DECIMAL_PREFIX "GetExp",         1, decimalGetExponentFunc        },
+  { SQLITE_DECIMAL_PREFIX "Greatest",      -1, decimalMaxFunc                },
+  { SQLITE_DECIMAL_PREFIX "Gt",             2, decimalGreaterThanFunc        },
+  { SQLITE_DECIMAL_PREFIX "Invert",         1, decimalInvertFunc             },
+  { SQLITE_DECIMAL_PREFIX "IsCanonical",    1, decimalIsCanonicalFunc        },
+  { SQLITE_DECIMAL_PREFIX "IsFinite",       1, decimalIsFiniteFunc           },
+  { SQLITE_DECIMAL_PREFIX "IsInf",          1, decimalIsInfiniteFunc         },
+  { SQLITE_DECIMAL_PREFIX "IsInfinite",     1, decimalIsInfiniteFunc         },
+  { SQLITE_DECIMAL_PREFIX "IsInt",          1, decimalIsIntegerFunc          },
+  { SQLITE_DECIMAL_PREFIX "IsInteger",      1, decimalIsIntegerFunc          },
+  { SQLITE_DECIMAL_PREFIX "IsLogical",      1, decimalIsLogicalFunc          },
+  { SQLITE_DECIMAL_PREFIX "IsNaN",          1, decimalIsNaNFunc              },
+  { SQLITE_DECIMAL_PREFIX "IsNeg",          1, decimalIsNegativeFunc         },
+  { SQLITE_DECIMAL_PREFIX "IsNegative",     1, decimalIsNegativeFunc         },
+  { SQLITE_DECIMAL_PREFIX "IsNormal",       1, decimalIsNormalFunc           },
+  { SQLITE_DECIMAL_PREFIX "IsPos",          1, decimalIsPositiveFunc         },
+  { SQLITE_DECIMAL_PREFIX "IsPositive",     1, decimalIsPositiveFunc         },
+  { SQLITE_DECIMAL_PREFIX "IsSigned",       1, decimalIsSignedFunc           },
+  { SQLITE_DECIMAL_PREFIX "IsSubnormal",    1, decimalIsSubnormalFunc        },
+  { SQLITE_DECIMAL_PREFIX "IsValid",        1, decimalIsValidFunc            },
+  { SQLITE_DECIMAL_PREFIX "IsZero",         1, decimalIsZeroFunc             },
+  { SQLITE_DECIMAL_PREFIX "Json",           2, decimalJsonFunc               },
+  { SQLITE_DECIMAL_PREFIX "JsonSum",        2, decimalJsonSumFunc            },
+  { SQLITE_DECIMAL_PREFIX "Le",             2, decimalLessThanOrEqualFunc    },
+  { SQLITE_DECIMAL_PREFIX "Least",         -1, decimalMinFunc                },
+  { SQLITE_DECIMAL_PREFIX "Log10",          1, decimalLog10Func              },
+  { SQLITE_DECIMAL_PREFIX "LogB",           1, decimalLogBFunc               },
+  { SQLITE_DECIMAL_PREFIX "Ln",             1, decimalLnFunc                 },
+  { SQLITE_DECIMAL_PREFIX "Lt",             2, decimalLessThanFunc           },
+  { SQLITE_DECIMAL_PREFIX "MaxMag",        -1, decimalMaxMagFunc             },
+  { SQLITE_DECIMAL_PREFIX "MinMag",        -1, decimalMinMagFunc             },
+  { SQLITE_DECIMAL_PREFIX "Neg",            1, decimalMinusFunc              },
+  { SQLITE_DECIMAL_PREFIX "Mul",           -1, decimalMultiplyFunc           },
+  { SQLITE_DECIMAL_PREFIX "Ne",             2, decimalNotEqualFunc           },
+  { SQLITE_DECIMAL_PREFIX "NextDown",       1, decimalNextDownFunc           },
+  { SQLITE_DECIMAL_PREFIX "NextUp",         1, decimalNextUpFunc             },
+  { SQLITE_DECIMAL_PREFIX "Or",             2, decimalOrFunc                 },
+  { SQLITE_DECIMAL_PREFIX "Pow",            2, decimalPowerFunc              },
+  { SQLITE_DECIMAL_PREFIX "Plus",           1, decimalPlusFunc               },
+  { SQLITE_DECIMAL_PREFIX "Quantize",       2, decimalQuantizeFunc           },
+  { SQLITE_DECIMAL_PREFIX "RandomValue",    4, decimalRandomValueFunc        },
+  { SQLITE_DECIMAL_PREFIX "Reduce",         1, decimalReduceFunc             },
+  { SQLITE_DECIMAL_PREFIX "Remainder",      2, decimalRemainderFunc          },
+  { SQLITE_DECIMAL_PREFIX "Rotate",         2, decimalRotateFunc             },
+  { SQLITE_DECIMAL_PREFIX "SameQuantum",    2, decimalSameQuantumFunc        },
+  { SQLITE_DECIMAL_PREFIX "ScaleB",         2, decimalScaleBFunc             },
+  { SQLITE_DECIMAL_PREFIX "Shift",          2, decimalShiftFunc              },
+  { SQLITE_DECIMAL_PREFIX "Status",         0, decimalStatusFunc             },
+  { SQLITE_DECIMAL_PREFIX "Str",            1, decimalToStringFunc           },
+  { SQLITE_DECIMAL_PREFIX "Sqrt",           1, decimalSqrtFunc               },
+  { SQLITE_DECIMAL_PREFIX "Sub",            2, decimalSubtractFunc           },
+  { SQLITE_DECIMAL_PREFIX "ToInt32",        1, decimalToInt32Func            },
+  { SQLITE_DECIMAL_PREFIX "ToInt64",        1, decimalToInt64Func            },
+  { SQLITE_DECIMAL_PREFIX "ToBID128",       1, decimalToBID128Func           },
+  { SQLITE_DECIMAL_PREFIX "ToFixed",        2, decimalToFixedFunc            },
+  { SQLITE_DECIMAL_PREFIX "To128",          1, decimalTo128Func              },
+  { SQLITE_DECIMAL_PREFIX "To64",           1, decimalTo64Func               },
+  { SQLITE_DECIMAL_PREFIX "ToIntegral",     1, decimalToIntegralFunc         },
+  { SQLITE_DECIMAL_PREFIX "ToJson",         1, decimalToJsonFunc             },
+  { SQLITE_DECIMAL_PREFIX "ToPacked",       3, decimalToPackedFunc           },
+  { SQLITE_DECIMAL_PREFIX "ToScaledInt",    2, decimalToScaledIntFunc        },
+  { SQLITE_DECIMAL_PREFIX "Trim",           1, decimalTrimFunc               },
+  { SQLITE_DECIMAL_PREFIX "Version",        0, decimalVersionFunc            },
+  { SQLITE_DECIMAL_PREFIX "Xor",            2, decimalXorFunc                },
+};
+
+/**
+ * \brief Functions that are not deterministic or have side effects.
+ */
+static const struct {
+  char const* zName;
+  int nArg;
+  void (*xFunc)(sqlite3_context*, int, sqlite3_value**);
+} aVolatile[] = {
+  { SQLITE_DECIMAL_PREFIX "ArrowExport",    2, decimalArrowExportFunc        },
+  { SQLITE_DECIMAL_PREFIX "ColumnarExport", 3, decimalColumnarExportFunc     },
+  { SQLITE_DECIMAL_PREFIX "ColumnarExport", 4, decimalColumnarExportFunc     },
+  { SQLITE_DECIMAL_PREFIX "Materialize",    4, decimalMaterializeFunc        },
+  { SQLITE_DECIMAL_PREFIX "Migrate",        2, decimalMigrateFunc            },
+  { SQLITE_DECIMAL_PREFIX "Migrate",        3, decimalMigrateFunc            },
+  { SQLITE_DECIMAL_PREFIX "Migrate",        4, decimalMigrateFunc            },
+  { SQLITE_DECIMAL_PREFIX "ParallelAgg",    3, decimalParallelAggFunc        },
+  { SQLITE_DECIMAL_PREFIX "ParallelAgg",    4, decimalParallelAggFunc        },
+  { SQLITE_DECIMAL_PREFIX "ProfileReset",   0, decimalProfileResetFunc       },
+  { SQLITE_DECIMAL_PREFIX "ProfileStart",   0, decimalProfileStartFunc       },
+  { SQLITE_DECIMAL_PREFIX "ProfileStart",   1, decimalProfileStartFunc       },
+  { SQLITE_DECIMAL_PREFIX "ProfileStop",    0, decimalProfileStopFunc        },
+  { SQLITE_DECIMAL_PREFIX "RandomValue",    3, decimalRandomValueFunc        },
+};
+
+/**
+ * \brief Aggregate functions.
+ */
+static const struct {
+  char const* zName;
+  int nArg;
+  void (*xStep)(sqlite3_context*, int, sqlite3_value**);
+  void (*xFinal)(sqlite3_context*);
+} aAgg[] = {
+  { SQLITE_DECIMAL_PREFIX "Sum", 1, decimalSumStepFunc, decimalSumFinalFunc },
+  { SQLITE_DECIMAL_PREFIX "Min", 1, decimalMinStepFunc, decimalMinFinalFunc },
+  { SQLITE_DECIMAL_PREFIX "Max", 1, decimalMaxStepFunc, decimalMaxFinalFunc },
+  { SQLITE_DECIMAL_PREFIX "Avg", 1, decimalAvgStepFunc, decimalAvgFinalFunc },
+};
+
+/**
+ * \brief Additional flags of the functions that set subtypes or that are
+ *        called by the triggers and the view of decMaterialize().
+ */
+static const struct {
+  decimalFunc xFunc;
+  int flags;
+} aFlags[] = {
+  { decimalToJsonFunc,   SQLITE_RESULT_SUBTYPE },
+  { decimalFixedFunc,    SQLITE_RESULT_SUBTYPE },
+  { decimalCreateFunc,   SQLITE_INNOCUOUS      },
+  { decimalAddFunc,      SQLITE_INNOCUOUS      },
+  { decimalSubtractFunc, SQLITE_INNOCUOUS      },
+  { decimalDivideFunc,   SQLITE_INNOCUOUS      },
+};
+
+/**
+ * \brief Returns the additional flags to register a function with.
+ */
+static int decimalFunctionFlags(decimalFunc xFunc) {
+  for (size_t i = 0; i < sizeof(aFlags) / sizeof(aFlags[0]); i++)
+    if (aFlags[i].xFunc == xFunc) return aFlags[i].flags;
+  return 0;
+}
+
+char const* decimalFunctionName(decimalFunc xFunc) {
+  for (size_t i = 0; i < sizeof(aFunc) / sizeof(aFunc[0]); i++)
+    if (aFunc[i].xFunc == xFunc) return aFunc[i].zName;
+  for (size_t i = 0; i < sizeof(aVolatile) / sizeof(aVolatile[0]); i++)
+    if (aVolatile[i].xFunc == xFunc) return aVolatile[i].zName;
+  for (size_t i = 0; i < sizeof(aAgg) / sizeof(aAgg[0]); i++)
+    if (aAgg[i].xStep == xFunc) return aAgg[i].zName;
+  if (xFunc == decimalTryFunc) return SQLITE_DECIMAL_PREFIX "Try";
+  return 0;
+}
+
 #pragma mark Public interface
 
 /**
@@ -726,113 +1011,62 @@ int sqlite3_decimal_init(sqlite3* db, char** pzErrMsg, sqlite3_api_routines cons
   (void)pzErrMsg;
 
   int rc = SQLITE_OK;
+#if HAVE_PTHREAD_H && !defined(SQLITE_CORE)
+  // Connections may load the extension concurrently, while others are
+  // already calling into it: set the (process-wide) API pointer only once,
+  // so that it is never written while being read.
+  static pthread_mutex_t apiMutex = PTHREAD_MUTEX_INITIALIZER;
+  pthread_mutex_lock(&apiMutex);
+  if (sqlite3_api != pApi) SQLITE_EXTENSION_INIT2(pApi);
+  pthread_mutex_unlock(&apiMutex);
+#else
   SQLITE_EXTENSION_INIT2(pApi);
+#endif
 
   void* decimalSharedContext = decimalInitSystem();
   if (decimalSharedContext == 0)
     return SQLITE_NOMEM;
-
-  static const struct {
-    char const* zName;
-    int nArg;
-    void (*xFunc)(sqlite3_context*, int, sqlite3_value**);
-  } aFunc[] = {
-    { SQLITE_DECIMAL_PREFIX "",               1, decimalCreateFunc             },
-    { SQLITE_DECIMAL_PREFIX "Abs",            1, decimalAbsFunc                },
-    { SQLITE_DECIMAL_PREFIX "Add",           -1, decimalAddFunc                },
-    { SQLITE_DECIMAL_PREFIX "And",            2, decimalAndFunc                },
-    { SQLITE_DECIMAL_PREFIX "Bits",           1, decimalBitsFunc               },
-    { SQLITE_DECIMAL_PREFIX "Bytes",          1, decimalBytesFunc              },
-    { SQLITE_DECIMAL_PREFIX "Class",          1, decimalClassFunc              },
-    { SQLITE_DECIMAL_PREFIX "ClearStatus",    0, decimalClearStatusFunc        },
-    { SQLITE_DECIMAL_PREFIX "Compare",        2, decimalCompareFunc            },
-    { SQLITE_DECIMAL_PREFIX "Digits",         1, decimalDigitsFunc             },
-    { SQLITE_DECIMAL_PREFIX "Div",            2, decimalDivideFunc             },
-    { SQLITE_DECIMAL_PREFIX "DivInt",         2, decimalDivideIntegerFunc      },
-    { SQLITE_DECIMAL_PREFIX "Eq",             2, decimalEqualFunc              },
-    { SQLITE_DECIMAL_PREFIX "Exp",            1, decimalExpFunc                },
-    { SQLITE_DECIMAL_PREFIX "FMA",            3, decimalFMAFunc                },
-    { SQLITE_DECIMAL_PREFIX "Ge",             2, decimalGreaterThanOrEqualFunc },
-    { SQLITE_DECIMAL_PREFIX "GetCoeff",       1, decimalGetCoefficientFunc     },
-    { SQLITE_DECIMAL_PREFIX "GetExp",         1, decimalGetExponentFunc        },
-    { SQLITE_DECIMAL_PREFIX "Greatest",      -1, decimalMaxFunc                },
-    { SQLITE_DECIMAL_PREFIX "Gt",             2, decimalGreaterThanFunc        },
-    { SQLITE_DECIMAL_PREFIX "Invert",         1, decimalInvertFunc             },
-    { SQLITE_DECIMAL_PREFIX "IsCanonical",    1, decimalIsCanonicalFunc        },
-    { SQLITE_DECIMAL_PREFIX "IsFinite",       1, decimalIsFiniteFunc           },
-    { SQLITE_DECIMAL_PREFIX "IsInf",          1, decimalIsInfiniteFunc         },
-    { SQLITE_DECIMAL_PREFIX "IsInfinite",     1, decimalIsInfiniteFunc         },
-    { SQLITE_DECIMAL_PREFIX "IsInt",          1, decimalIsIntegerFunc          },
-    { SQLITE_DECIMAL_PREFIX "IsInteger",      1, decimalIsIntegerFunc          },
-    { SQLITE_DECIMAL_PREFIX "IsLogical",      1, decimalIsLogicalFunc          },
-    { SQLITE_DECIMAL_PREFIX "IsNaN",          1, decimalIsNaNFunc              },
-    { SQLITE_DECIMAL_PREFIX "IsNeg",          1, decimalIsNegativeFunc         },
-    { SQLITE_DECIMAL_PREFIX "IsNegative",     1, decimalIsNegativeFunc         },
-    { SQLITE_DECIMAL_PREFIX "IsNormal",       1, decimalIsNormalFunc           },
-    { SQLITE_DECIMAL_PREFIX "IsPos",          1, decimalIsPositiveFunc         },
-    { SQLITE_DECIMAL_PREFIX "IsPositive",     1, decimalIsPositiveFunc         },
-    { SQLITE_DECIMAL_PREFIX "IsSigned",       1, decimalIsSignedFunc           },
-    { SQLITE_DECIMAL_PREFIX "IsSubnormal",    1, decimalIsSubnormalFunc        },
-    { SQLITE_DECIMAL_PREFIX "IsZero",         1, decimalIsZeroFunc             },
-    { SQLITE_DECIMAL_PREFIX "Le",             2, decimalLessThanOrEqualFunc    },
-    { SQLITE_DECIMAL_PREFIX "Least",         -1, decimalMinFunc                },
-    { SQLITE_DECIMAL_PREFIX "Log10",          1, decimalLog10Func              },
-    { SQLITE_DECIMAL_PREFIX "LogB",           1, decimalLogBFunc               },
-    { SQLITE_DECIMAL_PREFIX "Ln",             1, decimalLnFunc                 },
-    { SQLITE_DECIMAL_PREFIX "Lt",             2, decimalLessThanFunc           },
-    { SQLITE_DECIMAL_PREFIX "MaxMag",        -1, decimalMaxMagFunc             },
-    { SQLITE_DECIMAL_PREFIX "MinMag",        -1, decimalMinMagFunc             },
-    { SQLITE_DECIMAL_PREFIX "Neg",            1, decimalMinusFunc              },
-    { SQLITE_DECIMAL_PREFIX "Mul",           -1, decimalMultiplyFunc           },
-    { SQLITE_DECIMAL_PREFIX "Ne",             2, decimalNotEqualFunc           },
-    { SQLITE_DECIMAL_PREFIX "NextDown",       1, decimalNextDownFunc           },
-    { SQLITE_DECIMAL_PREFIX "NextUp",         1, decimalNextUpFunc             },
-    { SQLITE_DECIMAL_PREFIX "Or",             2, decimalOrFunc                 },
-    { SQLITE_DECIMAL_PREFIX "Pow",            2, decimalPowerFunc              },
-    { SQLITE_DECIMAL_PREFIX "Plus",           1, decimalPlusFunc               },
-    { SQLITE_DECIMAL_PREFIX "Quantize",       2, decimalQuantizeFunc           },
-    { SQLITE_DECIMAL_PREFIX "Reduce",         1, decimalReduceFunc             },
-    { SQLITE_DECIMAL_PREFIX "Remainder",      2, decimalRemainderFunc          },
-    { SQLITE_DECIMAL_PREFIX "Rotate",         2, decimalRotateFunc             },
-    { SQLITE_DECIMAL_PREFIX "SameQuantum",    2, decimalSameQuantumFunc        },
-    { SQLITE_DECIMAL_PREFIX "ScaleB",         2, decimalScaleBFunc             },
-    { SQLITE_DECIMAL_PREFIX "Shift",          2, decimalShiftFunc              },
-    { SQLITE_DECIMAL_PREFIX "Status",         0, decimalStatusFunc             },
-    { SQLITE_DECIMAL_PREFIX "Str",            1, decimalToStringFunc           },
-    { SQLITE_DECIMAL_PREFIX "Sqrt",           1, decimalSqrtFunc               },
-    { SQLITE_DECIMAL_PREFIX "Sub",            2, decimalSubtractFunc           },
-    { SQLITE_DECIMAL_PREFIX "ToInt32",        1, decimalToInt32Func            },
-    { SQLITE_DECIMAL_PREFIX "ToInt64",        1, decimalToInt64Func            },
-    { SQLITE_DECIMAL_PREFIX "ToIntegral",     1, decimalToIntegralFunc         },
-    { SQLITE_DECIMAL_PREFIX "Trim",           1, decimalTrimFunc               },
-    { SQLITE_DECIMAL_PREFIX "Version",        0, decimalVersionFunc            },
-    { SQLITE_DECIMAL_PREFIX "Xor",            2, decimalXorFunc                },
-  };
-
-  static const struct {
-    char const* zName;
-    int nArg;
-    void (*xStep)(sqlite3_context*, int, sqlite3_value**);
-    void (*xFinal)(sqlite3_context*);
-  } aAgg[] = {
-    { SQLITE_DECIMAL_PREFIX "Sum", 1, decimalSumStepFunc, decimalSumFinalFunc },
-    { SQLITE_DECIMAL_PREFIX "Min", 1, decimalMinStepFunc, decimalMinFinalFunc },
-    { SQLITE_DECIMAL_PREFIX "Max", 1, decimalMaxStepFunc, decimalMaxFinalFunc },
-    { SQLITE_DECIMAL_PREFIX "Avg", 1, decimalAvgStepFunc, decimalAvgFinalFunc },
-  };
+  decimalProfile* decimalSharedProfile = decimalProfileCreate(decimalProfiledCount);
+  if (decimalSharedProfile == 0) {
+    decimalContextDestroy(decimalSharedContext);
+    return SQLITE_NOMEM;
+  }
+  // Allocated before any function is registered, so that nothing refers to
+  // the context when it is freed
+  void* decimalSharedRejects = decimalRejectsCreate(decimalSharedContext);
+  if (decimalSharedRejects == 0) {
+    decimalProfileDestroy(decimalSharedProfile);
+    decimalContextDestroy(decimalSharedContext);
+    return SQLITE_NOMEM;
+  }
+  decimalContextSetProfile(decimalSharedContext, decimalSharedProfile);
 
   for (size_t i = 0; i < sizeof(aFunc) / sizeof(aFunc[0]) && rc == SQLITE_OK; i++) {
     rc = sqlite3_create_function(db, aFunc[i].zName, aFunc[i].nArg,
-                                 SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+                                 SQLITE_UTF8 | SQLITE_DETERMINISTIC | SQLITE_SUBTYPE | decimalFunctionFlags(aFunc[i].xFunc),
                                  decimalSharedContext,
                                  aFunc[i].xFunc, 0, 0);
   }
   for (size_t i = 0; i < sizeof(aAgg) / sizeof(aAgg[0]) && rc == SQLITE_OK; i++) {
     rc = sqlite3_create_function(db, aAgg[i].zName, aAgg[i].nArg,
-                                 SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+                                 SQLITE_UTF8 | SQLITE_DETERMINISTIC | SQLITE_SUBTYPE,
                                  decimalSharedContext,
                                  0, aAgg[i].xStep, aAgg[i].xFinal);
   }
+  for (size_t i = 0; i < sizeof(aVolatile) / sizeof(aVolatile[0]) && rc == SQLITE_OK; i++) {
+    rc = sqlite3_create_function(db, aVolatile[i].zName, aVolatile[i].nArg,
+                                 SQLITE_UTF8 | SQLITE_SUBTYPE,
+                                 decimalSharedContext,
+                                 aVolatile[i].xFunc, 0, 0);
+  }
+  if (rc == SQLITE_OK) { // On failure, SQLite destroys the rejects
+    rc = sqlite3_create_function_v2(db, SQLITE_DECIMAL_PREFIX "Try", 1, SQLITE_UTF8 | SQLITE_SUBTYPE,
+                                    decimalSharedRejects, decimalTryFunc, 0, 0, decimalRejectsDestroy);
+  }
+  else decimalRejectsDestroy(decimalSharedRejects);
+  if (rc == SQLITE_OK) {
+    rc = sqlite3_create_collation(db, "DECIMAL", SQLITE_UTF8, 0, decimalCollate);
+  }
 
 #ifndef SQLITE_OMIT_VIRTUALTABLE
   if (rc == SQLITE_OK) {
@@ -847,6 +1081,50 @@ int sqlite3_decimal_init(sqlite3* db, char** pzErrMsg, sqlite3_api_routines cons
     rc = sqlite3_create_module_v2(db, SQLITE_DECIMAL_PREFIX "Context",
                                   &decimalContextModule, decimalSharedContext, decimalContextDestroy);
   }
+  if (rc == SQLITE_OK) {
+    rc = sqlite3_create_module(db, SQLITE_DECIMAL_PREFIX "Series",
+                               &decimalSeriesModule, decimalSharedContext);
+  }
+  if (rc == SQLITE_OK) {
+    rc = sqlite3_create_module(db, SQLITE_DECIMAL_PREFIX "Random",
+                               &decimalRandomModule, decimalSharedContext);
+  }
+  if (rc == SQLITE_OK) {
+    rc = sqlite3_create_module(db, SQLITE_DECIMAL_PREFIX "Csv",
+                               &decimalCsvModule, decimalSharedContext);
+  }
+  if (rc == SQLITE_OK) {
+    rc = sqlite3_create_module(db, SQLITE_DECIMAL_PREFIX "Columnar",
+                               &decimalColumnarModule, decimalSharedContext);
+  }
+  if (rc == SQLITE_OK) {
+    rc = sqlite3_create_module(db, SQLITE_DECIMAL_PREFIX "AggScan",
+                               &decimalAggScanModule, decimalSharedContext);
+  }
+  if (rc == SQLITE_OK) {
+    rc = sqlite3_create_module(db, SQLITE_DECIMAL_PREFIX "ArrowScan",
+                               &decimalArrowModule, decimalSharedContext);
+  }
+  if (rc == SQLITE_OK) {
+    rc = sqlite3_create_module(db, SQLITE_DECIMAL_PREFIX "Validate",
+                               &decimalValidateModule, decimalSharedContext);
+  }
+  if (rc == SQLITE_OK) {
+    rc = sqlite3_create_module(db, SQLITE_DECIMAL_PREFIX "EncodingStats",
+                               &decimalEncodingStatsModule, 0);
+  }
+  if (rc == SQLITE_OK) {
+    rc = sqlite3_create_module(db, SQLITE_DECIMAL_PREFIX "Rejects",
+                               &decimalRejectsModule, decimalSharedRejects);
+  }
+  if (rc == SQLITE_OK) {
+    rc = sqlite3_create_module(db, SQLITE_DECIMAL_PREFIX "Profile",
+                               &decimalProfileModule, decimalSharedContext);
+  }
+  if (rc == SQLITE_OK) {
+    rc = sqlite3_create_module(db, SQLITE_DECIMAL_PREFIX "MemStats",
+                               &decimalMemStatsModule, 0);
+  }
 #endif
 
   return rc;
@@ -30,6 +30,191 @@ extern "C" {
 
 int sqlite3_decimal_init(sqlite3* db, char** pzErrMsg, sqlite3_api_routines const* pApi);
 
+/**
+ * \brief Aggregates a decimal column in parallel.
+ *
+ * The rowid range of \a zTable in the main database of \a db is split among
+ * \a nThread threads, each reading the database file through its own
+ * read-only connection. The result of `min` and `max` is the same as the one
+ * of `decMin()` or `decMax()`. Sums are computed with the maximum precision
+ * and rounded once at the end, so the result of `sum` and `avg` does not
+ * depend on the number of threads; it is the same as the one of `decSum()`
+ * or `decAvg()` unless those round an intermediate sum.
+ *
+ * \param db A connection to a database file, on which the extension has been
+ *        loaded. If SQLite is not thread-safe, a single connection
+ *        aggregates the table in the calling thread.
+ * \param zTable The table's name
+ * \param zColumn The column's name
+ * \param zOp The aggregate operation: `sum`, `avg`, `min` or `max`
+ * \param nThread The number of threads, or `0` to use one thread per online
+ *        processor
+ * \param pzResult Receives the result as a string, to be freed with
+ *        `sqlite3_free()`
+ * \param pnCount Receives the number of aggregated (non-NULL) values
+ * \param pzErrMsg If not null, receives an error message, to be freed with
+ *        `sqlite3_free()`
+ *
+ * \return `SQLITE_OK` on success; an error code otherwise.
+ */
+int sqlite3_decimal_parallel_aggregate(sqlite3* db, char const* zTable, char const* zColumn, char const* zOp,
+                                       int nThread, char** pzResult, sqlite3_int64* pnCount, char** pzErrMsg);
+
+/**
+ * \brief Converts packed decimals (COBOL's `COMP-3`) to decimal blobs.
+ *
+ * The result is the same as the one of `decFromPacked()` for each field.
+ *
+ * \param aPacked The packed decimals
+ * \param nLength The length of each packed decimal, in bytes
+ * \param nStride The distance between the start of two consecutive packed
+ *        decimals, in bytes (e.g., the size of a record)
+ * \param nScale The scale of the packed decimals
+ * \param nField The number of packed decimals
+ * \param aOut The output buffer, receiving the decimal blobs one after another
+ * \param nOut The size of \a aOut, in bytes
+ * \param aOffset An array of `nField + 1` integers, receiving the offsets of
+ *        the blobs in \a aOut: the i-th blob spans from `aOffset[i]` to
+ *        `aOffset[i+1]` (excluded)
+ * \param pnDone If not null, receives the number of converted fields
+ *
+ * \return `SQLITE_OK` on success; `SQLITE_MISMATCH` if a field is not a valid
+ *         packed decimal or has too many digits; `SQLITE_FULL` if \a aOut is
+ *         too small; `SQLITE_MISUSE` if the arguments are invalid. On error,
+ *         the fields preceding the offending one have been converted.
+ */
+int sqlite3_decimal_from_packed(unsigned char const* aPacked, int nLength, int nStride, int nScale, int nField,
+                                unsigned char* aOut, int nOut, int* aOffset, int* pnDone);
+
+/**
+ * \brief Converts decimal blobs to packed decimals (COBOL's `COMP-3`).
+ *
+ * The result is the same as the one of `decToPacked()` for each value, with
+ * the default context: values are rounded half up to the given scale.
+ *
+ * \param aIn The decimal blobs, laid out as by sqlite3_decimal_from_packed()
+ * \param aOffset The offsets of the blobs in \a aIn (`nField + 1` integers)
+ * \param nField The number of blobs
+ * \param nLength The length of each packed decimal, in bytes
+ * \param nStride The distance between the start of two consecutive packed
+ *        decimals, in bytes
+ * \param nScale The scale of the packed decimals
+ * \param aPacked The output packed decimals
+ * \param pnDone If not null, receives the number of converted values
+ *
+ * \return `SQLITE_OK` on success; `SQLITE_MISMATCH` if a blob is not a finite
+ *         decimal; `SQLITE_TOOBIG` if a value does not fit into \a nLength
+ *         bytes; `SQLITE_MISUSE` if the arguments are invalid. On error, the
+ *         values preceding the offending one have been converted.
+ */
+int sqlite3_decimal_to_packed(unsigned char const* aIn, int const* aOffset, int nField, int nLength, int nStride,
+                              int nScale, unsigned char* aPacked, int* pnDone);
+
+/**
+ * \brief Converts BID-encoded decimal128 numbers to decimal blobs.
+ *
+ * The result is the same as the one of `decFromBID128()` for each value.
+ *
+ * \param aBid The numbers, 16 bytes each, least significant byte first
+ * \param nValue The number of values
+ * \param aOut The output buffer, receiving the decimal blobs one after another
+ * \param nOut The size of \a aOut, in bytes
+ * \param aOffset An array of `nValue + 1` integers, receiving the offsets of
+ *        the blobs in \a aOut, as for sqlite3_decimal_from_packed()
+ * \param pnDone If not null, receives the number of converted values
+ *
+ * \return `SQLITE_OK` on success; `SQLITE_FULL` if \a aOut is too small;
+ *         `SQLITE_MISUSE` if the arguments are invalid. On error, the values
+ *         preceding the offending one have been converted.
+ */
+int sqlite3_decimal_from_bid128(unsigned char const* aBid, int nValue, unsigned char* aOut, int nOut, int* aOffset,
+                                int* pnDone);
+
+/**
+ * \brief Converts decimal blobs to BID-encoded decimal128 numbers.
+ *
+ * The result is the same as the one of `decToBID128()` for each value, with
+ * the default context: values are rounded half up to 34 digits.
+ *
+ * \param aIn The decimal blobs, laid out as by sqlite3_decimal_from_bid128()
+ * \param aOffset The offsets of the blobs in \a aIn (`nValue + 1` integers)
+ * \param nValue The number of values
+ * \param aBid The output numbers, 16 bytes each, least significant byte first
+ * \param pnDone If not null, receives the number of converted values
+ *
+ * \return `SQLITE_OK` on success; `SQLITE_MISMATCH` if a blob is not a valid
+ *         decimal; `SQLITE_TOOBIG` if a value overflows decimal128;
+ *         `SQLITE_MISUSE` if the arguments are invalid. On error, the values
+ *         preceding the offending one have been converted.
+ */
+int sqlite3_decimal_to_bid128(unsigned char const* aIn, int const* aOffset, int nValue, unsigned char* aBid,
+                              int* pnDone);
+
+/**
+ * \brief Converts a column to decimal blobs, in place.
+ *
+ * The rows of \a zTable in the main database of \a db are converted in rowid
+ * order, \a nChunk rows per transaction, as done by `decMigrate()`, with the
+ * default context. The progress is stored in the `decMigrateProgress` table,
+ * so an interrupted migration resumes where it stopped; the values that
+ * cannot be converted are left unchanged and recorded in the
+ * `decMigrateRejects` table.
+ *
+ * \param db A connection in autocommit mode, on which the extension has been
+ *        loaded
+ * \param zTable The table's name
+ * \param zColumn The column's name
+ * \param nChunk The number of rows per transaction, or `0` for the default
+ * \param nScale The number of fractional digits the values are rounded to
+ *        (half up), or a negative value to keep the values' exponents
+ * \param pnMigrated If not null, receives the number of converted values
+ * \param pzErrMsg If not null, receives an error message, to be freed with
+ *        `sqlite3_free()`
+ *
+ * \return `SQLITE_OK` on success; an error code otherwise. On error, the
+ *         chunks preceding the failed one have been committed.
+ */
+int sqlite3_decimal_migrate(sqlite3* db, char const* zTable, char const* zColumn, int nChunk, int nScale,
+                            sqlite3_int64* pnMigrated, char** pzErrMsg);
+
+/**
+ * \brief Status parameter for sqlite3_decimal_status(): the number of bytes
+ *        of memory currently allocated by the extension.
+ */
+#define SQLITE_DECIMAL_STATUS_MEMORY_USED  0
+
+/**
+ * \brief Status parameter for sqlite3_decimal_status(): the number of
+ *        allocations currently outstanding.
+ */
+#define SQLITE_DECIMAL_STATUS_MALLOC_COUNT 1
+
+/**
+ * \brief Status parameter for sqlite3_decimal_status(): the size of the
+ *        most recent allocation request (the high-water mark is the size of
+ *        the largest one).
+ */
+#define SQLITE_DECIMAL_STATUS_MALLOC_SIZE  2
+
+/**
+ * \brief Returns statistics about the memory allocated by the extension.
+ *
+ * This is the analogue of `sqlite3_status64()` for the memory allocated by
+ * the decimal functions, over all the connections of the process. The same
+ * numbers, broken down by call site, are shown by the `decMemStats` virtual
+ * table.
+ *
+ * \param op One of the `SQLITE_DECIMAL_STATUS_*` parameters
+ * \param pCurrent Receives the current value of the parameter
+ * \param pHighwater Receives the highest value of the parameter
+ * \param resetFlag If non-zero, the high-water mark is reset to the current
+ *        value
+ *
+ * \return `SQLITE_OK` on success; `SQLITE_MISUSE` if \a op is unknown or a
+ *         pointer is null.
+ */
+int sqlite3_decimal_status(int op, sqlite3_int64* pCurrent, sqlite3_int64* pHighwater, int resetFlag);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,137 @@
+/**
+ * \file      dpd.c
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     Conversions between IEEE 754 decimal64/decimal128 and decimals.
+ *
+ * The fixed-width formats use the densely packed decimal (DPD) encoding of
+ * IEEE 754. Their blobs are stored most significant byte first, so that
+ * a database file can be moved between machines of different endianness.
+ *
+ * Unlike decInfinite, these encodings do not preserve the order of numbers,
+ * and a blob of 8 or 16 bytes may be a valid decInfinite encoding as well.
+ * So, decTo64() and decTo128() prefix the number with #DECIMAL_DPD_TAG, a byte
+ * that no decInfinite encoding starts with: their blobs of 9 and 17 bytes can
+ * be stored, and they are recognized by any decimal function. decFrom64() and
+ * decFrom128() also accept untagged IEEE 754 numbers of 8 and 16 bytes, which
+ * other decimal functions would read as decInfinite.
+ */
+#include <string.h>
+#include "impl_decinfinite.h"
+#include "decNumber/decimal64.h"
+#include "decNumber/decimal128.h"
+
+/**
+ * \brief Copies a DPD number, converting it from or to big-endian order.
+ */
+static void dpdCopy(uint8_t* target, uint8_t const* source, size_t n) {
+#if DECLITEND
+  for (size_t i = 0; i < n; i++) target[i] = source[n - 1 - i];
+#else
+  memcpy(target, source, n);
+#endif
+}
+
+/**
+ * \brief Decodes an untagged big-endian decimal64 or decimal128.
+ *
+ * \return \a decnum, or `0` if \a len is not valid.
+ */
+static decNumber* dpdToNumber(size_t len, uint8_t const* bytes, decNumber* decnum) {
+  if (len == DECIMAL64_Bytes) {
+    decimal64 d64;
+    dpdCopy(d64.bytes, bytes, DECIMAL64_Bytes);
+    return decimal64ToNumber(&d64, decnum);
+  }
+  if (len == DECIMAL128_Bytes) {
+    decimal128 d128;
+    dpdCopy(d128.bytes, bytes, DECIMAL128_Bytes);
+    return decimal128ToNumber(&d128, decnum);
+  }
+  return 0;
+}
+
+decNumber* decimalDPDToNumber(size_t len, uint8_t const bytes[len], decNumber* decnum) {
+  if ((len != DECIMAL64_Bytes + 1 && len != DECIMAL128_Bytes + 1) || bytes[0] != DECIMAL_DPD_TAG) return 0;
+  return dpdToNumber(len - 1, bytes + 1, decnum);
+}
+
+/**
+ * \brief Converts a value into a DPD blob of the given size.
+ */
+static void dpdEncode(sqlite3_context* context, sqlite3_value* value, size_t len) {
+  decContext* decCtx = sqlite3_user_data(context);
+  decNumber decnum;
+
+  if (decNumberFromSQLite3Value(&decnum, value, decCtx) == 0) {
+    sqlite3_result_error(context, "Cannot create decimal from the given type", -1);
+    return;
+  }
+
+  // Round with the current rounding mode to the format's precision and range
+  decContext dpdCtx;
+  decContextDefault(&dpdCtx, len == DECIMAL64_Bytes ? DEC_INIT_DECIMAL64 : DEC_INIT_DECIMAL128);
+  dpdCtx.round = decCtx->round;
+  uint8_t bytes[1 + DECIMAL128_Bytes] = { DECIMAL_DPD_TAG };
+  if (len == DECIMAL64_Bytes) {
+    decimal64 d64;
+    decimal64FromNumber(&d64, &decnum, &dpdCtx);
+    dpdCopy(bytes + 1, d64.bytes, len);
+  }
+  else {
+    decimal128 d128;
+    decimal128FromNumber(&d128, &decnum, &dpdCtx);
+    dpdCopy(bytes + 1, d128.bytes, len);
+  }
+  decContextSetStatusQuiet(decCtx, dpdCtx.status);
+
+  char* zErr = 0;
+  if (decimalCheckTraps(decCtx, &zErr) != SQLITE_OK) {
+    sqlite3_result_error(context, zErr ? zErr : "Decimal error", -1);
+    sqlite3_free(zErr);
+    return;
+  }
+  sqlite3_result_blob(context, bytes, (int)len + 1, SQLITE_TRANSIENT);
+}
+
+/**
+ * \brief Converts a DPD blob of the given size, tagged or not, into a decimal.
+ */
+static void dpdDecode(sqlite3_context* context, sqlite3_value* value, size_t len) {
+  decNumber decnum;
+  uint8_t const* bytes = sqlite3_value_blob(value);
+  size_t const n = (size_t)sqlite3_value_bytes(value);
+
+  if (sqlite3_value_type(value) != SQLITE_BLOB ||
+      (n != len && (n != len + 1 || bytes[0] != DECIMAL_DPD_TAG))) {
+    char* zErr = sqlite3_mprintf("A decimal%d number must be a blob of %d bytes", (int)len * 8, (int)len);
+    sqlite3_result_error(context, zErr ? zErr : "Invalid DPD number", -1);
+    sqlite3_free(zErr);
+    return;
+  }
+  dpdToNumber(len, bytes + (n - len), &decnum);
+  decNumberToSQLite3Blob(context, &decnum);
+}
+
+void decimalFrom128(sqlite3_context* context, sqlite3_value* value) {
+  dpdDecode(context, value, DECIMAL128_Bytes);
+}
+
+void decimalFrom64(sqlite3_context* context, sqlite3_value* value) {
+  dpdDecode(context, value, DECIMAL64_Bytes);
+}
+
+void decimalTo128(sqlite3_context* context, sqlite3_value* value) {
+  dpdEncode(context, value, DECIMAL128_Bytes);
+}
+
+void decimalTo64(sqlite3_context* context, sqlite3_value* value) {
+  dpdEncode(context, value, DECIMAL64_Bytes);
+}
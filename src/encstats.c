@@ -0,0 +1,560 @@
+/**
+ * \file      encstats.c
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     Statistics about the encoding of a column.
+ *
+ * `decEncodingStats(table, column)` scans a column of encoded decimals and
+ * returns, as `(kind, value, count, bytes)` rows:
+ *
+ * - the histogram of the encoded lengths (`kind = 'length'`), of the
+ *   exponents (`'exponent'`) and of the number of digits (`'digits'`) of
+ *   the finite values;
+ * - the number of `NaN`, `-NaN`, `Infinity` and `-Infinity` values
+ *   (`'special'`), and of the non-null values that are not valid encoded
+ *   decimals (`'invalid'`);
+ * - for each storage format (`'storage'`), the number of values that it
+ *   represents exactly and the estimated bytes per row if the column were
+ *   stored in that format: `'infinite'` (the current encoding), `'int64'`
+ *   (fixed-scale 64-bit integers, see decToFixed(), with the smallest scale
+ *   that fits all the values), `'decimal64'` and `'decimal128'`.
+ *
+ * Exponents are those of the least significant digit, as in decNumber.
+ * Everything is computed from the encodings (see decInfiniteExponent() and
+ * decInfiniteDigits()): no value is decoded.
+ */
+#include <string.h>
+#include "impl_decinfinite.h"
+
+#ifndef SQLITE_OMIT_VIRTUALTABLE
+
+/** \brief Column index of the `kind` column of decEncodingStats. */
+#define ENCSTATS_COLUMN_KIND  0
+/** \brief Column index of the `value` column of decEncodingStats. */
+#define ENCSTATS_COLUMN_VALUE 1
+/** \brief Column index of the `count` column of decEncodingStats. */
+#define ENCSTATS_COLUMN_COUNT 2
+/** \brief Column index of the `bytes` column of decEncodingStats. */
+#define ENCSTATS_COLUMN_BYTES 3
+/** \brief Column index of the first hidden column of decEncodingStats. */
+#define ENCSTATS_COLUMN_TAB   4
+/** \brief Number of arguments of decEncodingStats. */
+#define ENCSTATS_NARGS        2
+
+/** \brief The largest scale of a fixed-scale integer (see fixed.c). */
+#define ENCSTATS_INT64_MAX_SCALE  18
+/** \brief The number of digits that always fit into a 64-bit integer. */
+#define ENCSTATS_INT64_DIGITS     18
+
+/**
+ * \brief The kinds of rows, in the order in which they are returned.
+ */
+typedef enum {
+  ENCSTATS_LENGTH,
+  ENCSTATS_EXPONENT,
+  ENCSTATS_DIGITS,
+  ENCSTATS_SPECIAL,
+  ENCSTATS_INVALID,
+  ENCSTATS_STORAGE
+} encstatsKind;
+
+/**
+ * \brief Names of the kinds of rows.
+ */
+static char const* const encstatsKindName[] = { "length", "exponent", "digits", "special", "invalid", "storage" };
+
+/**
+ * \brief Special values, in the order in which they are returned.
+ */
+static char const* const encstatsSpecialName[] = { "NaN", "-NaN", "Infinity", "-Infinity" };
+
+/** \brief The number of special values. */
+#define ENCSTATS_NSPECIAL 4
+
+/**
+ * \brief A storage format.
+ */
+typedef struct encstatsFormat {
+  char const* zName;  /**< The name of the format.                              */
+  int nDigit;         /**< The maximum number of digits.                        */
+  int32_t eTiny;      /**< The minimum exponent.                                */
+  int32_t eMax;       /**< The maximum adjusted exponent.                       */
+  double nByte;       /**< The bytes per value.                                 */
+} encstatsFormat;
+
+/**
+ * \brief The storage formats with a fixed size.
+ */
+static encstatsFormat const encstatsFormats[] = {
+  { "decimal64",  16, -398,  384,  8.0 },
+  { "decimal128", 34, -6176, 6144, 16.0 },
+};
+
+/** \brief The number of formats with a fixed size. */
+#define ENCSTATS_NFORMAT 2
+
+/**
+ * \brief The values of the column with a given exponent.
+ */
+typedef struct encstatsExponent {
+  int32_t exponent;                             /**< The exponent.                */
+  sqlite3_int64 aDigits[DECNUMDIGITS + 1];      /**< The counts by digits.        */
+} encstatsExponent;
+
+/**
+ * \brief A row of decEncodingStats.
+ */
+typedef struct encstatsRow {
+  encstatsKind kind;
+  char const* zValue;   /**< The value, if it is a name.     */
+  sqlite3_int64 iValue; /**< The value, if it is a number.   */
+  sqlite3_int64 count;
+  double bytes;         /**< Only for the storage rows.      */
+} encstatsRow;
+
+/**
+ * \brief What has been collected about a column.
+ */
+typedef struct encstatsData {
+  sqlite3_int64 aLength[DECINF_MAXSIZE + 1];  /**< The counts by length.                */
+  sqlite3_int64 aSpecial[ENCSTATS_NSPECIAL];  /**< The counts of special values.        */
+  sqlite3_int64 nInvalid;                     /**< The number of invalid values.        */
+  sqlite3_int64 nValid;                       /**< The number of valid values.          */
+  sqlite3_int64 nByte;                        /**< Their total length.                  */
+  int nExponent;                              /**< The number of distinct exponents.    */
+  int nExponentAlloc;                         /**< The allocated size of aExponent.     */
+  encstatsExponent* aExponent;                /**< Sorted by exponent.                  */
+} encstatsData;
+
+/**
+ * \brief Returns the entry of an exponent, adding it if necessary.
+ *
+ * \return A pointer to the entry, or `0` if there is not enough memory.
+ */
+static encstatsExponent* encstatsFindExponent(encstatsData* data, int32_t exponent) {
+  int lo = 0;
+  int hi = data->nExponent;
+  while (lo < hi) {
+    int const mid = (lo + hi) / 2;
+    if (data->aExponent[mid].exponent < exponent) lo = mid + 1;
+    else hi = mid;
+  }
+  if (lo < data->nExponent && data->aExponent[lo].exponent == exponent) return &data->aExponent[lo];
+
+  if (data->nExponent == data->nExponentAlloc) {
+    int const nAlloc = data->nExponentAlloc ? 2 * data->nExponentAlloc : 16;
+    encstatsExponent* a = sqlite3_realloc64(data->aExponent, sizeof(encstatsExponent) * (sqlite3_uint64)nAlloc);
+    if (a == 0) return 0;
+    data->aExponent = a;
+    data->nExponentAlloc = nAlloc;
+  }
+  memmove(&data->aExponent[lo + 1], &data->aExponent[lo], sizeof(encstatsExponent) * (size_t)(data->nExponent - lo));
+  data->nExponent++;
+  memset(&data->aExponent[lo], 0, sizeof(encstatsExponent));
+  data->aExponent[lo].exponent = exponent;
+  return &data->aExponent[lo];
+}
+
+/**
+ * \brief Adds a value to the statistics.
+ *
+ * \return `SQLITE_OK`, or `SQLITE_NOMEM`.
+ */
+static int encstatsAdd(encstatsData* data, sqlite3_value* value) {
+  if (sqlite3_value_type(value) != SQLITE_BLOB) {
+    data->nInvalid++;
+    return SQLITE_OK;
+  }
+  uint8_t const* bytes = sqlite3_value_blob(value);
+  size_t const len = (size_t)sqlite3_value_bytes(value);
+  if (decInfiniteCheck(len, bytes) != DECINF_VALID) {
+    data->nInvalid++;
+    return SQLITE_OK;
+  }
+  data->nValid++;
+  data->nByte += (sqlite3_int64)len;
+  data->aLength[len]++;
+  if (decInfiniteIsSpecial(len, bytes)) {
+    switch (bytes[0]) {
+      case 0xE0: data->aSpecial[0]++; break;
+      case 0x00: data->aSpecial[1]++; break;
+      case 0xC0: data->aSpecial[2]++; break;
+      default:   data->aSpecial[3]++; break;
+    }
+    return SQLITE_OK;
+  }
+  int const digits = decInfiniteDigits(len, bytes);
+  int32_t const exponent = len == 1 ? 0 : decInfiniteExponent(len, bytes) - digits + 1;
+  encstatsExponent* e = encstatsFindExponent(data, exponent);
+  if (e == 0) return SQLITE_NOMEM;
+  e->aDigits[digits]++;
+  return SQLITE_OK;
+}
+
+/**
+ * \brief Returns the number of finite values that a format represents
+ *        exactly.
+ */
+static sqlite3_int64 encstatsCountFormat(encstatsData const* data, encstatsFormat const* f) {
+  sqlite3_int64 n = 0;
+  for (int i = 0; i < data->nExponent; i++) {
+    encstatsExponent const* e = &data->aExponent[i];
+    if (e->exponent < f->eTiny) continue;
+    for (int d = 1; d <= DECNUMDIGITS && d <= f->nDigit; d++)
+      if (e->exponent + d - 1 <= f->eMax) n += e->aDigits[d];
+  }
+  return n;
+}
+
+/**
+ * \brief Returns the number of finite values that fit into a 64-bit
+ *        integer with the smallest scale that fits them all.
+ */
+static sqlite3_int64 encstatsCountInt64(encstatsData const* data) {
+  sqlite3_int64 n = 0;
+  int32_t scale = data->nExponent > 0 && data->aExponent[0].exponent < 0 ? -data->aExponent[0].exponent : 0;
+  if (scale > ENCSTATS_INT64_MAX_SCALE) scale = ENCSTATS_INT64_MAX_SCALE;
+  for (int i = 0; i < data->nExponent; i++) {
+    encstatsExponent const* e = &data->aExponent[i];
+    if (e->exponent + scale < 0) continue;
+    for (int d = 1; d <= DECNUMDIGITS; d++)
+      if (d + e->exponent + scale <= ENCSTATS_INT64_DIGITS) n += e->aDigits[d];
+  }
+  return n;
+}
+
+/**
+ * \brief Turns the statistics into the rows of the table.
+ *
+ * \return The number of rows, or `-1` if there is not enough memory.
+ */
+static int encstatsRows(encstatsData const* data, encstatsRow** paRow) {
+  // Lengths, exponents, digits, special values, invalid values and formats
+  int const nMax = DECINF_MAXSIZE + data->nExponent + DECNUMDIGITS + ENCSTATS_NSPECIAL + 1 + 2 + ENCSTATS_NFORMAT;
+  encstatsRow* aRow = sqlite3_malloc64(sizeof(encstatsRow) * (sqlite3_uint64)nMax);
+  int n = 0;
+
+  *paRow = aRow;
+  if (aRow == 0) return -1;
+  memset(aRow, 0, sizeof(encstatsRow) * (size_t)nMax);
+
+  for (int len = 1; len <= DECINF_MAXSIZE; len++) {
+    if (data->aLength[len] == 0) continue;
+    aRow[n].kind = ENCSTATS_LENGTH;
+    aRow[n].iValue = len;
+    aRow[n++].count = data->aLength[len];
+  }
+  sqlite3_int64 aDigits[DECNUMDIGITS + 1] = { 0 };
+  sqlite3_int64 nFinite = 0;
+  for (int i = 0; i < data->nExponent; i++) {
+    sqlite3_int64 count = 0;
+    for (int d = 0; d <= DECNUMDIGITS; d++) {
+      count += data->aExponent[i].aDigits[d];
+      aDigits[d] += data->aExponent[i].aDigits[d];
+    }
+    aRow[n].kind = ENCSTATS_EXPONENT;
+    aRow[n].iValue = data->aExponent[i].exponent;
+    aRow[n++].count = count;
+    nFinite += count;
+  }
+  for (int d = 1; d <= DECNUMDIGITS; d++) {
+    if (aDigits[d] == 0) continue;
+    aRow[n].kind = ENCSTATS_DIGITS;
+    aRow[n].iValue = d;
+    aRow[n++].count = aDigits[d];
+  }
+  for (int i = 0; i < ENCSTATS_NSPECIAL; i++) {
+    if (data->aSpecial[i] == 0) continue;
+    aRow[n].kind = ENCSTATS_SPECIAL;
+    aRow[n].zValue = encstatsSpecialName[i];
+    aRow[n++].count = data->aSpecial[i];
+  }
+  if (data->nInvalid > 0) {
+    aRow[n].kind = ENCSTATS_INVALID;
+    aRow[n++].count = data->nInvalid;
+  }
+  if (data->nValid > 0) {
+    sqlite3_int64 const nSpecial = data->nValid - nFinite;
+    aRow[n].kind = ENCSTATS_STORAGE;
+    aRow[n].zValue = "infinite";
+    aRow[n].count = data->nValid;
+    aRow[n++].bytes = (double)data->nByte / (double)data->nValid;
+    aRow[n].kind = ENCSTATS_STORAGE;
+    aRow[n].zValue = "int64";
+    aRow[n].count = encstatsCountInt64(data);
+    aRow[n++].bytes = 8.0;
+    for (int i = 0; i < ENCSTATS_NFORMAT; i++) {
+      aRow[n].kind = ENCSTATS_STORAGE;
+      aRow[n].zValue = encstatsFormats[i].zName;
+      aRow[n].count = encstatsCountFormat(data, &encstatsFormats[i]) + nSpecial;
+      aRow[n++].bytes = encstatsFormats[i].nByte;
+    }
+  }
+  return n;
+}
+
+/**
+ * \brief SQL definition of the decEncodingStats virtual table.
+ */
+#define SQLITE_DECIMAL_ENCSTATS_TABLE "create table x(kind text, value, count integer, bytes real, tab hidden, col hidden)"
+
+typedef struct decimalEncodingStatsVTab decimalEncodingStatsVTab;
+
+/**
+ * \brief A decEncodingStats virtual table.
+ */
+struct decimalEncodingStatsVTab {
+  sqlite3_vtab base;  /**< Base class - must be first. */
+  sqlite3* db;        /**< The database connection.    */
+};
+
+typedef struct decimalEncodingStatsCursor decimalEncodingStatsCursor;
+
+/**
+ * \brief A cursor over decEncodingStats.
+ */
+struct decimalEncodingStatsCursor {
+  sqlite3_vtab_cursor base;             /**< Base class - must be first. */
+  encstatsRow* aRow;                    /**< The rows.                   */
+  int nRow;                             /**< The number of rows.         */
+  int iRow;                             /**< The current row.            */
+  sqlite3_value* aArg[ENCSTATS_NARGS];  /**< The arguments.              */
+};
+
+static int decimalEncodingStatsConnect(sqlite3* db, void* pAux, int argc, char const* const* argv,
+                                       sqlite3_vtab** ppVtab, char** pzErr) {
+  (void)pAux;
+  (void)argc;
+  (void)argv;
+  (void)pzErr;
+
+  decimalEncodingStatsVTab* pVtab;
+  int rc;
+
+  rc = sqlite3_declare_vtab(db, SQLITE_DECIMAL_ENCSTATS_TABLE);
+  if (rc == SQLITE_OK) {
+    pVtab = sqlite3_malloc(sizeof(*pVtab));
+    *ppVtab = (sqlite3_vtab*)pVtab;
+    if (pVtab == 0) return SQLITE_NOMEM;
+    memset(pVtab, 0, sizeof(*pVtab));
+    pVtab->db = db;
+  }
+  return rc;
+}
+
+static int decimalEncodingStatsDisconnect(sqlite3_vtab* pVtab) {
+  sqlite3_free(pVtab);
+  return SQLITE_OK;
+}
+
+static int decimalEncodingStatsOpen(sqlite3_vtab* p, sqlite3_vtab_cursor** ppCursor) {
+  (void)p;
+  decimalEncodingStatsCursor* pCur;
+  pCur = sqlite3_malloc(sizeof(*pCur));
+  if (pCur == 0) return SQLITE_NOMEM;
+  memset(pCur, 0, sizeof(*pCur));
+  *ppCursor = &pCur->base;
+  return SQLITE_OK;
+}
+
+/**
+ * \brief Releases the rows and the arguments of a cursor.
+ */
+static void encstatsReset(decimalEncodingStatsCursor* pCur) {
+  sqlite3_free(pCur->aRow);
+  pCur->aRow = 0;
+  pCur->nRow = 0;
+  pCur->iRow = 0;
+  for (int i = 0; i < ENCSTATS_NARGS; i++) {
+    sqlite3_value_free(pCur->aArg[i]);
+    pCur->aArg[i] = 0;
+  }
+}
+
+static int decimalEncodingStatsClose(sqlite3_vtab_cursor* cur) {
+  decimalEncodingStatsCursor* pCur = (decimalEncodingStatsCursor*)cur;
+  encstatsReset(pCur);
+  sqlite3_free(pCur);
+  return SQLITE_OK;
+}
+
+static int decimalEncodingStatsNext(sqlite3_vtab_cursor* cur) {
+  ((decimalEncodingStatsCursor*)cur)->iRow++;
+  return SQLITE_OK;
+}
+
+static int decimalEncodingStatsEof(sqlite3_vtab_cursor* cur) {
+  decimalEncodingStatsCursor* pCur = (decimalEncodingStatsCursor*)cur;
+  return pCur->iRow >= pCur->nRow;
+}
+
+static int decimalEncodingStatsColumn(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int i) {
+  decimalEncodingStatsCursor* pCur = (decimalEncodingStatsCursor*)cur;
+  encstatsRow const* row = &pCur->aRow[pCur->iRow];
+
+  switch (i) {
+    case ENCSTATS_COLUMN_KIND:
+      sqlite3_result_text(ctx, encstatsKindName[row->kind], -1, SQLITE_STATIC);
+      break;
+    case ENCSTATS_COLUMN_VALUE:
+      if (row->zValue) sqlite3_result_text(ctx, row->zValue, -1, SQLITE_STATIC);
+      else if (row->kind != ENCSTATS_INVALID) sqlite3_result_int64(ctx, row->iValue);
+      break;
+    case ENCSTATS_COLUMN_COUNT:
+      sqlite3_result_int64(ctx, row->count);
+      break;
+    case ENCSTATS_COLUMN_BYTES:
+      if (row->kind == ENCSTATS_STORAGE) sqlite3_result_double(ctx, row->bytes);
+      break;
+    default:
+      if (pCur->aArg[i - ENCSTATS_COLUMN_TAB]) sqlite3_result_value(ctx, pCur->aArg[i - ENCSTATS_COLUMN_TAB]);
+      break;
+  }
+  return SQLITE_OK;
+}
+
+static int decimalEncodingStatsRowid(sqlite3_vtab_cursor* cur, sqlite_int64* pRowid) {
+  *pRowid = ((decimalEncodingStatsCursor*)cur)->iRow + 1;
+  return SQLITE_OK;
+}
+
+static int decimalEncodingStatsFilter(sqlite3_vtab_cursor* cur, int idxNum, char const* idxStr,
+                                      int argc, sqlite3_value** argv) {
+  (void)idxNum;
+  (void)idxStr;
+
+  decimalEncodingStatsCursor* pCur = (decimalEncodingStatsCursor*)cur;
+  decimalEncodingStatsVTab* pVtab = (decimalEncodingStatsVTab*)cur->pVtab;
+  sqlite3_stmt* pStmt;
+  char* zSql;
+  int rc;
+
+  encstatsReset(pCur);
+  for (int i = 0; i < argc && i < ENCSTATS_NARGS; i++) {
+    pCur->aArg[i] = sqlite3_value_dup(argv[i]);
+    if (pCur->aArg[i] == 0) return SQLITE_NOMEM;
+  }
+  if (argc < ENCSTATS_NARGS
+      || sqlite3_value_type(argv[0]) == SQLITE_NULL || sqlite3_value_type(argv[1]) == SQLITE_NULL) {
+    pVtab->base.zErrMsg = sqlite3_mprintf("The table and column of decEncodingStats are required");
+    return SQLITE_ERROR;
+  }
+
+  char const* zTab = (char const*)sqlite3_value_text(argv[0]);
+  char const* zCol = (char const*)sqlite3_value_text(argv[1]);
+  // The column is qualified, so that it cannot be taken for a string
+  zSql = sqlite3_mprintf("select \"%w\".\"%w\" from \"%w\"", zTab, zCol, zTab);
+  if (zSql == 0) return SQLITE_NOMEM;
+  rc = sqlite3_prepare_v2(pVtab->db, zSql, -1, &pStmt, 0);
+  sqlite3_free(zSql);
+  if (rc != SQLITE_OK) {
+    pVtab->base.zErrMsg = sqlite3_mprintf("%s", sqlite3_errmsg(pVtab->db));
+    return rc;
+  }
+
+  encstatsData* data = sqlite3_malloc(sizeof(*data));
+  if (data == 0) {
+    sqlite3_finalize(pStmt);
+    return SQLITE_NOMEM;
+  }
+  memset(data, 0, sizeof(*data));
+  while ((rc = sqlite3_step(pStmt)) == SQLITE_ROW) {
+    sqlite3_value* value = sqlite3_column_value(pStmt, 0);
+    if (sqlite3_value_type(value) == SQLITE_NULL) continue;
+    if (encstatsAdd(data, value) != SQLITE_OK) {
+      rc = SQLITE_NOMEM;
+      break;
+    }
+  }
+  if (rc == SQLITE_DONE) {
+    rc = SQLITE_OK;
+    pCur->nRow = encstatsRows(data, &pCur->aRow);
+    if (pCur->nRow < 0) {
+      pCur->nRow = 0;
+      rc = SQLITE_NOMEM;
+    }
+  }
+  else if (rc != SQLITE_NOMEM)
+    pVtab->base.zErrMsg = sqlite3_mprintf("%s", sqlite3_errmsg(pVtab->db));
+  sqlite3_finalize(pStmt);
+  sqlite3_free(data->aExponent);
+  sqlite3_free(data);
+  return rc;
+}
+
+/**
+ * \brief Implementation of the xBestIndex method for decEncodingStats.
+ *
+ * Both the table and the column are required.
+ */
+static int decimalEncodingStatsBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
+  int aIdx[ENCSTATS_NARGS] = { -1, -1 };
+  int unusable = 0;
+
+  for (int i = 0; i < pIdxInfo->nConstraint; i++) {
+    struct sqlite3_index_constraint const* pCons = &pIdxInfo->aConstraint[i];
+    if (pCons->iColumn < ENCSTATS_COLUMN_TAB) continue;
+    if (pCons->op != SQLITE_INDEX_CONSTRAINT_EQ) continue;
+    int k = pCons->iColumn - ENCSTATS_COLUMN_TAB;
+    if (!pCons->usable) {
+      unusable |= (1 << k);
+      continue;
+    }
+    aIdx[k] = i;
+  }
+
+  if (unusable && (aIdx[0] < 0 || aIdx[1] < 0)) return SQLITE_CONSTRAINT;
+  if (aIdx[0] < 0 || aIdx[1] < 0) {
+    sqlite3_free(tab->zErrMsg);
+    tab->zErrMsg = sqlite3_mprintf("The table and column of decEncodingStats are required");
+    return SQLITE_ERROR;
+  }
+
+  for (int k = 0; k < ENCSTATS_NARGS; k++) {
+    pIdxInfo->aConstraintUsage[aIdx[k]].argvIndex = k + 1;
+    pIdxInfo->aConstraintUsage[aIdx[k]].omit = 1;
+  }
+  pIdxInfo->estimatedCost = 1000000.0;
+  pIdxInfo->estimatedRows = 100;
+  return SQLITE_OK;
+}
+
+/**
+ * \brief An eponymous-only virtual table module that implements the
+ *        decEncodingStats() table-valued function.
+ */
+sqlite3_module decimalEncodingStatsModule = {
+  0,
+  0,
+  decimalEncodingStatsConnect,
+  decimalEncodingStatsBestIndex,
+  decimalEncodingStatsDisconnect,
+  decimalEncodingStatsDisconnect,
+  decimalEncodingStatsOpen,
+  decimalEncodingStatsClose,
+  decimalEncodingStatsFilter,
+  decimalEncodingStatsNext,
+  decimalEncodingStatsEof,
+  decimalEncodingStatsColumn,
+  decimalEncodingStatsRowid,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+};
+
+#endif /* SQLITE_OMIT_VIRTUALTABLE */
@@ -0,0 +1,272 @@
+/**
+ * \file      fixed.c
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     Fixed-scale 64-bit decimals.
+ *
+ * A fixed decimal with scale `s` is a number with at most 18 digits and
+ * exactly `s` fractional digits. decFixed() returns it as an ordinary
+ * decimal with the subtype `#DECIMAL_FIXED_SUBTYPE + s`, which lets decAdd(),
+ * decSub() and decMul() compute with 64-bit integers when all their arguments
+ * are fixed decimals. SQLite does not keep subtypes through subqueries or in tables:
+ * without its subtype, a fixed decimal is read as the plain decimal it is.
+ *
+ * For storage, decToFixed() returns the 64-bit integer `x x 10^s` in 8 bytes,
+ * most significant byte first, with the sign bit flipped. So, the blobs with
+ * the same scale compare with `memcmp()` (hence, with SQLite's comparison of
+ * blobs) as the numbers do. Since the scale is not stored, such blobs must be
+ * converted with decFromFixed().
+ */
+#include "impl_decinfinite.h"
+
+/**
+ * \brief Maximum scale of a fixed decimal.
+ */
+#define FIXED_MAX_SCALE 18
+
+/**
+ * \brief Powers of ten that fit into a 64-bit integer.
+ */
+static const int64_t fixedPower[FIXED_MAX_SCALE + 1] = {
+  1LL, 10LL, 100LL, 1000LL, 10000LL, 100000LL, 1000000LL, 10000000LL, 100000000LL, 1000000000LL,
+  10000000000LL, 100000000000LL, 1000000000000LL, 10000000000000LL, 100000000000000LL,
+  1000000000000000LL, 10000000000000000LL, 100000000000000000LL, 1000000000000000000LL
+};
+
+/**
+ * \brief Decodes the 8 bytes of a fixed decimal.
+ */
+static int64_t fixedDecode(uint8_t const* p) {
+  uint64_t u = 0;
+  for (int i = 0; i < 8; i++) u = (u << 8) | p[i];
+  return (int64_t)(u ^ 0x8000000000000000ull);
+}
+
+/**
+ * \brief Returns the 8 bytes of a fixed decimal as a blob.
+ */
+static void fixedResultAsBlob(sqlite3_context* context, int64_t coeff) {
+  uint64_t u = (uint64_t)coeff ^ 0x8000000000000000ull;
+  uint8_t bytes[8];
+  for (int i = 7; i >= 0; i--, u >>= 8) bytes[i] = (uint8_t)u;
+  sqlite3_result_blob(context, bytes, 8, SQLITE_TRANSIENT);
+}
+
+/**
+ * \brief Returns `coeff x 10^-scale` as a decimal.
+ */
+static void fixedResultAsDecimal(sqlite3_context* context, int64_t coeff, int32_t scale) {
+  uint8_t bytes[DECINF_MAXSIZE];
+  size_t const len = decInfiniteFromInt64(DECINF_MAXSIZE, bytes, coeff, -scale);
+  sqlite3_result_blob(context, bytes, (int)len, SQLITE_TRANSIENT);
+}
+
+/**
+ * \brief Returns a fixed decimal as a decimal with the appropriate subtype.
+ */
+static void fixedResult(sqlite3_context* context, int64_t coeff, int32_t scale) {
+  fixedResultAsDecimal(context, coeff, scale);
+  sqlite3_result_subtype(context, DECIMAL_FIXED_SUBTYPE + (unsigned)scale);
+}
+
+/**
+ * \brief Reads the scale argument of a function.
+ *
+ * \return The scale, or `-1` if it is invalid (and an error has been set).
+ */
+static int32_t fixedScale(sqlite3_context* context, sqlite3_value* value) {
+  sqlite3_int64 const s = sqlite3_value_int64(value);
+  if (sqlite3_value_type(value) != SQLITE_INTEGER || s < 0 || s > FIXED_MAX_SCALE) {
+    sqlite3_result_error(context, "The scale must be an integer between 0 and 18", -1);
+    return -1;
+  }
+  return (int32_t)s;
+}
+
+/**
+ * \brief Rounds a value to the given scale and returns it as a 64-bit
+ *        integer scaled by `10^scale`.
+ *
+ * \return `1` on success; `0` if an error has been set.
+ */
+static int fixedFromValue(sqlite3_context* context, sqlite3_value* value, int32_t scale, int64_t* coeff) {
+  decContext* decCtx = sqlite3_user_data(context);
+  decNumber decnum;
+  decNumber quantum;
+
+  if (decNumberFromSQLite3Value(&decnum, value, decCtx) == 0) {
+    sqlite3_result_error(context, "Cannot create decimal from the given type", -1);
+    return 0;
+  }
+  if (!decNumberIsSpecial(&decnum)) {
+    decNumberZero(&quantum);
+    quantum.exponent = -scale;
+    decNumberQuantize(&decnum, &decnum, &quantum, decCtx);
+  }
+  char* zErr = 0;
+  if (decimalCheckTraps(decCtx, &zErr) != SQLITE_OK) {
+    sqlite3_result_error(context, zErr ? zErr : "Decimal error", -1);
+    sqlite3_free(zErr);
+    return 0;
+  }
+  if (decNumberIsSpecial(&decnum)) {
+    sqlite3_result_error(context, "Only finite decimals can be fixed", -1);
+    return 0;
+  }
+  if (!decNumberToScaledInt64(&decnum, -scale, coeff)) {
+    sqlite3_result_error(context, "The value has more than 18 digits", -1);
+    return 0;
+  }
+  return 1;
+}
+
+int decimalFixedFromSQLite3Value(sqlite3_value* value, int64_t* coeff, int32_t* scale) {
+  unsigned const subtype = sqlite3_value_subtype(value);
+  if (subtype < DECIMAL_FIXED_SUBTYPE || subtype > DECIMAL_FIXED_SUBTYPE + FIXED_MAX_SCALE) return 0;
+  if (sqlite3_value_type(value) != SQLITE_BLOB) return 0;
+  decNumber decnum;
+  if (decInfiniteToNumber((size_t)sqlite3_value_bytes(value), sqlite3_value_blob(value), &decnum) == 0) return 0;
+  *scale = (int32_t)(subtype - DECIMAL_FIXED_SUBTYPE);
+  return decNumberToScaledInt64(&decnum, -*scale, coeff);
+}
+
+/**
+ * \brief Brings \a x to scale \a to, if it fits.
+ */
+static int fixedRescale(int64_t* x, int32_t from, int32_t to) {
+  int64_t const m = fixedPower[to - from];
+  if (*x > INT64_MAX / m || *x < INT64_MIN / m) return 0;
+  *x *= m;
+  return 1;
+}
+
+/**
+ * \brief Adds (or subtracts) \a y to \a x, if the result fits.
+ */
+static int fixedAdd(int64_t* x, int64_t y, int isSubtraction) {
+  if (isSubtraction) {
+    if (y == INT64_MIN) return 0;
+    y = -y;
+  }
+  if ((y > 0 && *x > INT64_MAX - y) || (y < 0 && *x < INT64_MIN - y)) return 0;
+  *x += y;
+  return 1;
+}
+
+/**
+ * \brief Multiplies \a x by \a y, if the result fits.
+ */
+static int fixedMultiply(int64_t* x, int64_t y) {
+  int64_t const a = *x;
+  if (a > 0 ? (y > 0 ? a > INT64_MAX / y : y < INT64_MIN / a)
+            : (y > 0 ? a < INT64_MIN / y : (a != 0 && y < INT64_MAX / a)))
+    return 0;
+  *x = a * y;
+  return 1;
+}
+
+/**
+ * \brief Checks whether `coeff x 10^-scale` is a result that decNumber would
+ *        return as it is in the given context.
+ *
+ * \return `1` if the number has at most as many digits as the precision and
+ *         its exponent is within range, so that no condition is raised;
+ *         `0` otherwise.
+ */
+static int fixedFitsContext(decContext const* decCtx, int64_t coeff, int32_t scale) {
+  uint64_t const u = coeff < 0 ? 0 - (uint64_t)coeff : (uint64_t)coeff;
+  int32_t digits = 1;
+  while (digits <= FIXED_MAX_SCALE && u >= (uint64_t)fixedPower[digits]) digits++;
+  if (digits > decCtx->digits) return 0;
+  if (u == 0) return -scale >= decCtx->emin - decCtx->digits + 1 && -scale <= decCtx->emax;
+  return digits - 1 - scale >= decCtx->emin && digits - 1 - scale <= decCtx->emax;
+}
+
+#pragma mark Fast paths
+
+int decimalFixedAdd(sqlite3_context* context, int argc, sqlite3_value** argv, int isSubtraction) {
+  decContext* decCtx = sqlite3_user_data(context);
+  int64_t sum;
+  int32_t scale;
+
+  if (argc == 0 || !decimalFixedFromSQLite3Value(argv[0], &sum, &scale)) return 0;
+  for (int i = 1; i < argc; i++) {
+    int64_t x;
+    int32_t s;
+    if (!decimalFixedFromSQLite3Value(argv[i], &x, &s)) return 0;
+    if (s > scale) {
+      if (!fixedRescale(&sum, scale, s)) return 0;
+      scale = s;
+    }
+    else if (s < scale && !fixedRescale(&x, s, scale))
+      return 0;
+    if (!fixedAdd(&sum, x, isSubtraction)) return 0;
+  }
+  // x + (-x) is -0 when rounding towards -Infinity: leave it to decNumber
+  if (sum == 0 && argc > 1 && decCtx->round == DEC_ROUND_FLOOR) return 0;
+  if (!fixedFitsContext(decCtx, sum, scale)) return 0; // Rounded by decNumber
+  fixedResultAsDecimal(context, sum, scale);
+  return 1;
+}
+
+int decimalFixedMultiply(sqlite3_context* context, int argc, sqlite3_value** argv) {
+  decContext* decCtx = sqlite3_user_data(context);
+  int64_t product;
+  int32_t scale;
+  int isNegative;
+
+  if (argc == 0 || !decimalFixedFromSQLite3Value(argv[0], &product, &scale)) return 0;
+  isNegative = product < 0;
+  for (int i = 1; i < argc; i++) {
+    int64_t x;
+    int32_t s;
+    if (!decimalFixedFromSQLite3Value(argv[i], &x, &s)) return 0;
+    if (!fixedMultiply(&product, x)) return 0;
+    isNegative ^= (x < 0);
+    scale += s;
+  }
+  if (product == 0 && isNegative) return 0; // -0: leave it to decNumber
+  if (!fixedFitsContext(decCtx, product, scale)) return 0; // Rounded by decNumber
+  fixedResultAsDecimal(context, product, scale);
+  return 1;
+}
+
+#pragma mark SQL functions
+
+void decimalFixed(sqlite3_context* context, sqlite3_value* value, sqlite3_value* scale) {
+  int64_t coeff;
+  int32_t const s = fixedScale(context, scale);
+  if (s >= 0 && fixedFromValue(context, value, s, &coeff))
+    fixedResult(context, coeff, s);
+}
+
+void decimalToFixed(sqlite3_context* context, sqlite3_value* value, sqlite3_value* scale) {
+  int64_t coeff;
+  int32_t const s = fixedScale(context, scale);
+  if (s >= 0 && fixedFromValue(context, value, s, &coeff))
+    fixedResultAsBlob(context, coeff);
+}
+
+void decimalFromFixed(sqlite3_context* context, sqlite3_value* value, sqlite3_value* scale) {
+  int32_t const s = fixedScale(context, scale);
+  if (s < 0) return;
+  if (sqlite3_value_type(value) != SQLITE_BLOB || sqlite3_value_bytes(value) != 8) {
+    sqlite3_result_error(context, "A fixed decimal must be a blob of 8 bytes", -1);
+    return;
+  }
+  fixedResultAsDecimal(context, fixedDecode(sqlite3_value_blob(value)), s);
+}
+
+void decimalToScaledInt(sqlite3_context* context, sqlite3_value* value, sqlite3_value* scale) {
+  int64_t coeff;
+  int32_t const s = fixedScale(context, scale);
+  if (s >= 0 && fixedFromValue(context, value, s, &coeff))
+    sqlite3_result_int64(context, coeff);
+}
@@ -14,6 +14,7 @@
 #ifndef sqlite3_decimal_impl_h
 #define sqlite3_decimal_impl_h
 
+#include <stdint.h>
 #include <stdlib.h>
 #include "sqlite3ext.h"
 #include "decimal.h"
@@ -21,6 +22,13 @@
 // Needed for dynamic linking
 SQLITE_EXTENSION_INIT3
 
+#if !defined(SQLITE_DECIMAL_PREFIX)
+/**
+ * \brief The prefix of all SQL decimal functions.
+ */
+#define SQLITE_DECIMAL_PREFIX "dec"
+#endif
+
 #pragma mark Context functions
 
 /**
@@ -54,6 +62,183 @@ void decimalContextCopy(void* target, void* source);
  */
 void decimalContextDestroy(void* context);
 
+/**
+ * \brief Returns the profile attached to a context by
+ *        decimalContextSetProfile(), or `0`.
+ */
+struct decimalProfile* decimalContextProfile(void* decCtx);
+
+/**
+ * \brief Attaches a profile to a context.
+ *
+ * The profile is destroyed together with the context.
+ */
+void decimalContextSetProfile(void* decCtx, struct decimalProfile* profile);
+
+/**
+ * \brief Creates the counters of the values rejected by decimalTry().
+ *
+ * \param decCtx The context used for conversions
+ *
+ * \return A pointer to the newly allocated counters, or `0` if there is not
+ *         enough memory.
+ */
+void* decimalRejectsCreate(void* decCtx);
+
+/**
+ * \brief Disposes of the counters created by decimalRejectsCreate().
+ */
+void decimalRejectsDestroy(void* rejects);
+
+/**
+ * \brief Returns the context passed to decimalRejectsCreate().
+ */
+void* decimalRejectsContext(void* rejects);
+
+#pragma mark Profiling
+
+/**
+ * \brief The type of the functions registered with SQLite.
+ */
+typedef void (*decimalFunc)(sqlite3_context*, int, sqlite3_value**);
+
+/**
+ * \brief The profile of the decimal functions of a connection.
+ */
+typedef struct decimalProfile decimalProfile;
+
+/** \brief The phase of a call spent decoding arguments. */
+#define SQLITE_DECIMAL_PROFILE_DECODE 0
+/** \brief The phase of a call spent encoding the result. */
+#define SQLITE_DECIMAL_PROFILE_ENCODE 1
+/** \brief The number of phases timed by the decoding and encoding functions. */
+#define SQLITE_DECIMAL_PROFILE_NCODEC 2
+
+#if HAVE_STDATOMIC_H && !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+
+/**
+ * \brief The number of connections on which profiling is on.
+ */
+extern _Atomic int decimalProfileActive;
+
+/**
+ * \brief Tells whether profiling is on for any connection.
+ */
+#define SQLITE_DECIMAL_PROFILE_ACTIVE() (atomic_load_explicit(&decimalProfileActive, memory_order_relaxed) != 0)
+#else
+/**
+ * \brief The number of connections on which profiling is on.
+ *
+ * Without `<stdatomic.h>`, it is updated under a mutex and read without one.
+ */
+extern volatile int decimalProfileActive;
+
+/**
+ * \brief Tells whether profiling is on for any connection.
+ */
+#define SQLITE_DECIMAL_PROFILE_ACTIVE() (decimalProfileActive != 0)
+#endif
+
+/**
+ * \brief Starts timing a decoding or encoding phase of the current call.
+ *
+ * \return A value to be passed to #SQLITE_DECIMAL_PROFILE_END.
+ */
+#define SQLITE_DECIMAL_PROFILE_BEGIN() (SQLITE_DECIMAL_PROFILE_ACTIVE() ? decimalProfileCodecBegin() : 0)
+
+/**
+ * \brief Stops timing a phase started with #SQLITE_DECIMAL_PROFILE_BEGIN.
+ */
+#define SQLITE_DECIMAL_PROFILE_END(phase, start) \
+  do { if (start) decimalProfileCodecEnd(phase, start); } while (0)
+
+/**
+ * \brief Records that the current call has failed.
+ */
+#define SQLITE_DECIMAL_PROFILE_ERROR() \
+  do { if (SQLITE_DECIMAL_PROFILE_ACTIVE()) decimalProfileError(); } while (0)
+
+/**
+ * \brief Creates a profile for \a nEntry functions, with profiling off.
+ *
+ * \return A pointer to the new profile, or `0` if there is not enough memory.
+ */
+decimalProfile* decimalProfileCreate(int nEntry);
+
+/**
+ * \brief Disposes of a profile created by decimalProfileCreate().
+ */
+void decimalProfileDestroy(decimalProfile* profile);
+
+/**
+ * \brief Calls \a xBody and records the call in the entry \a id of the
+ *        profile, if profiling is on.
+ *
+ * \param xFunc The function registered with SQLite, used to name the entry
+ * \param nCheck The number of leading arguments for which a `NULL` makes the
+ *               function return `NULL` (`-1` for all the arguments)
+ */
+void decimalProfileCall(decimalProfile* profile, int id, decimalFunc xFunc, decimalFunc xBody, int nCheck,
+                        sqlite3_context* context, int argc, sqlite3_value** argv);
+
+/**
+ * \brief Returns the current time if the current call is being timed, and `0`
+ *        otherwise.
+ *
+ * \see #SQLITE_DECIMAL_PROFILE_BEGIN
+ */
+uint64_t decimalProfileCodecBegin(void);
+
+/**
+ * \brief Adds the time elapsed since \a start to the given phase of the
+ *        current call.
+ *
+ * \see #SQLITE_DECIMAL_PROFILE_END
+ */
+void decimalProfileCodecEnd(int phase, uint64_t start);
+
+/**
+ * \brief Marks the current call, if any, as failed.
+ *
+ * \see #SQLITE_DECIMAL_PROFILE_ERROR
+ */
+void decimalProfileError(void);
+
+/**
+ * \brief Returns the SQL name of a registered function, or `0` if unknown.
+ *
+ * If a function is registered under several names, the first one is returned.
+ */
+char const* decimalFunctionName(decimalFunc xFunc);
+
+#pragma mark Memory accounting
+
+/**
+ * \brief The call sites whose allocations are accounted for.
+ */
+typedef enum {
+  SQLITE_DECIMAL_MEM_CONTEXT,   /**< Contexts, see decimalContextCreate().  */
+  SQLITE_DECIMAL_MEM_PROFILE,   /**< Profiles and their entries.            */
+  SQLITE_DECIMAL_MEM_PARSE,     /**< Copies of long text arguments.         */
+  SQLITE_DECIMAL_MEM_BYTES,     /**< Results of decBytes().                 */
+  SQLITE_DECIMAL_MEM_BITS,      /**< Results of decBits().                  */
+  SQLITE_DECIMAL_MEM_NSITE
+} decimalMemSite;
+
+/**
+ * \brief Allocates \a n bytes with sqlite3_malloc64() on behalf of \a site.
+ *
+ * \return A pointer to be freed with decimalFree(), or `0` if there is not
+ *         enough memory.
+ */
+void* decimalMalloc(decimalMemSite site, sqlite3_uint64 n);
+
+/**
+ * \brief Frees memory allocated by decimalMalloc() for the same \a site.
+ */
+void decimalFree(decimalMemSite site, void* p);
+
 #pragma mark Helper functions for context virtual table
 
 /**
@@ -217,6 +402,17 @@ void decimal ## fun ## Final(sqlite3_context* context);
  */
 SQLITE_DECIMAL_OP0_DECL(ClearStatus)
 
+  /**
+   * \brief Discards the profile collected so far on the connection.
+   */
+SQLITE_DECIMAL_OP0_DECL(ProfileReset)
+
+  /**
+   * \brief Turns profiling off on the connection, keeping what has been
+   *        collected.
+   */
+SQLITE_DECIMAL_OP0_DECL(ProfileStop)
+
   /**
    * \brief Returns a textual, implementation-defined, representation of the
    *        current status.
@@ -295,6 +491,30 @@ SQLITE_DECIMAL_OP1_DECL(Digits)
    */
 SQLITE_DECIMAL_OP1_DECL(Exp)
 
+  /**
+   * \brief Converts an IEEE 754 decimal128 in the BID encoding (16-byte blob,
+   *        least significant byte first, as used by MongoDB) into a decimal.
+   *
+   * Non-canonical coefficients are read as zero.
+   */
+SQLITE_DECIMAL_OP1_DECL(FromBID128)
+
+  /**
+   * \brief Converts an IEEE 754 decimal128 (16-byte DPD blob, most significant
+   *        byte first) into a decimal.
+   *
+   * The blob may also be the result of decTo128().
+   */
+SQLITE_DECIMAL_OP1_DECL(From128)
+
+  /**
+   * \brief Converts an IEEE 754 decimal64 (8-byte DPD blob, most significant
+   *        byte first) into a decimal.
+   *
+   * The blob may also be the result of decTo64().
+   */
+SQLITE_DECIMAL_OP1_DECL(From64)
+
   /**
    * \brief Returns the coefficient (significand) of the given decimal as text.
    */
@@ -419,6 +639,16 @@ SQLITE_DECIMAL_OP1_DECL(IsSigned)
    */
 SQLITE_DECIMAL_OP1_DECL(IsSubnormal)
 
+  /**
+   * \brief Returns `1` if the argument is a blob that is a valid encoded
+   *        decimal; returns `0` otherwise.
+   *
+   * The encoding is checked without decoding the number.
+   *
+   * \see decInfiniteCheck()
+   */
+SQLITE_DECIMAL_OP1_DECL(IsValid)
+
   /**
    * \brief Returns `1` if the given decimal number is zero; returns `0`
    *        otherwise.
@@ -542,6 +772,43 @@ SQLITE_DECIMAL_OP1_DECL(ToInt64)
    */
 SQLITE_DECIMAL_OP1_DECL(ToIntegral)
 
+  /**
+   * \brief Converts a decimal into an IEEE 754 decimal128 in the BID encoding.
+   *
+   * The result is a 16-byte blob, least significant byte first. The number is
+   * rounded to 34 digits with the current rounding mode.
+   */
+SQLITE_DECIMAL_OP1_DECL(ToBID128)
+
+  /**
+   * \brief Converts a decimal into an IEEE 754 decimal128.
+   *
+   * The result is a 17-byte blob: a tag byte, followed by the 16-byte DPD
+   * number, most significant byte first. The number is rounded to 34 digits
+   * with the current rounding mode. The blob, stored or not, can be passed to
+   * any decimal function, which decodes it as decimal128.
+   */
+SQLITE_DECIMAL_OP1_DECL(To128)
+
+  /**
+   * \brief Converts a decimal into an IEEE 754 decimal64.
+   *
+   * This is like decTo128(), except that the number is 8 bytes long (9 bytes
+   * with the tag) and it is rounded to 16 digits.
+   */
+SQLITE_DECIMAL_OP1_DECL(To64)
+
+  /**
+   * \brief Returns a decimal as a JSON number.
+   *
+   * The result is the text of the trimmed number, marked as JSON, so that it
+   * is embedded as a number (not as a string) by SQLite's JSON functions. The
+   * number is written without an exponent (e.g., `1E+3` as `1000`), unless
+   * that takes more than 64 zeros. NULL is returned for NaNs and infinities,
+   * which JSON cannot represent.
+   */
+SQLITE_DECIMAL_OP1_DECL(ToJson)
+
   /**
    * \brief Returns a textual representation of a decimal blob.
    */
@@ -557,6 +824,19 @@ SQLITE_DECIMAL_OP1_DECL(ToString)
    */
 SQLITE_DECIMAL_OP1_DECL(Trim)
 
+  /**
+   * \brief Converts a value into a decimal, as `dec()` does, or returns
+   *        `NULL` if the value cannot be converted.
+   *
+   * A value is rejected if it is a string that is not a number, a blob that
+   * is not a valid encoded decimal, a real, or if its conversion raises
+   * a trapped condition. Rejected values are counted in the connection's
+   * `decRejects` table and leave the context's status untouched.
+   *
+   * The user data of this function must be created by decimalRejectsCreate().
+   */
+SQLITE_DECIMAL_OP1_DECL(Try)
+
 #pragma mark Binary functions
 
   /**
@@ -630,6 +910,61 @@ SQLITE_DECIMAL_OP2_DECL(GreaterThan)
    */
 SQLITE_DECIMAL_OP2_DECL(GreaterThanOrEqual)
 
+  /**
+   * \brief Converts a packed decimal (COBOL's `COMP-3`) with the given scale
+   *        into a decimal.
+   *
+   * The blob holds two digits per byte, except for the last byte, which holds
+   * a digit and the sign (`C`, `A`, `E`, `F` for positive, `D`, `B` for
+   * negative). The result is the number formed by the digits times
+   * `10^-scale`. A blob with invalid nibbles results in NaN (or in an error, if
+   * the Conversion syntax condition is trapped).
+   */
+SQLITE_DECIMAL_OP2_DECL(FromPacked)
+
+  /**
+   * \brief Returns a decimal rounded to the given scale as a fixed decimal.
+   *
+   * The value is rounded to `s` fractional digits (between `0` and `18`) with
+   * the current rounding mode; the function fails if the result has more than
+   * 18 digits. The result is a decimal whose subtype records the scale:
+   * decAdd(), decSub() and decMul() use integer arithmetic when all their
+   * arguments are fixed decimals. Where SQLite drops the subtype (e.g., in
+   * a subquery or a table), the result is an ordinary decimal.
+   *
+   * \see decToFixed()
+   */
+SQLITE_DECIMAL_OP2_DECL(Fixed)
+
+  /**
+   * \brief Converts an 8-byte fixed decimal with the given scale into
+   *        a decimal.
+   *
+   * \see decToFixed()
+   */
+SQLITE_DECIMAL_OP2_DECL(FromFixed)
+
+  /**
+   * \brief Returns the number at the given path of a JSON text.
+   *
+   * Unlike `json_extract()`, the digits are parsed as they are written in the
+   * JSON text, so no precision is lost to a binary floating-point conversion.
+   * The path is `$` followed by `.key`, `."key"` and `[index]` steps. A string
+   * holding a number is accepted. NULL is returned if the path does not exist
+   * or the value is JSON `null`; other non-numeric values result in NaN (or
+   * in an error, if the Conversion syntax condition is trapped).
+   */
+SQLITE_DECIMAL_OP2_DECL(Json)
+
+  /**
+   * \brief Returns the exact sum of the numbers in the JSON array at the given
+   *        path.
+   *
+   * JSON `null` elements are skipped. If the value at the path is a number, that
+   * number is returned. See decJson() for the syntax of paths.
+   */
+SQLITE_DECIMAL_OP2_DECL(JsonSum)
+
   /**
    * \brief Returns `1` if the first decimal is strictly less than the second;
    *        returns `NaN' if one or both the arguments are NaNs; returns `0`
@@ -711,6 +1046,27 @@ SQLITE_DECIMAL_OP2_DECL(Rotate)
    */
 SQLITE_DECIMAL_OP2_DECL(SameQuantum)
 
+  /**
+   * \brief Returns `x x 10^scale` as a SQLite3 integer.
+   *
+   * The value is first rounded to `scale` fractional digits (between `0` and
+   * `18`) with the current rounding mode. The function fails if the result
+   * has more than 18 digits.
+   */
+SQLITE_DECIMAL_OP2_DECL(ToScaledInt)
+
+  /**
+   * \brief Returns a decimal rounded to the given scale as an 8-byte fixed
+   *        decimal.
+   *
+   * The value is rounded as in decFixed(). The result is the 64-bit integer
+   * `x x 10^scale`, stored in 8 bytes, most significant byte first, with the
+   * sign bit flipped, so that the blobs with the same scale are ordered as
+   * they are as numbers. The scale is not stored: convert the blob with
+   * decFromFixed().
+   */
+SQLITE_DECIMAL_OP2_DECL(ToFixed)
+
   /**
    * \brief Calculates `x times 10^b`, where `x` is the first argument and `y` is the
    *        second argument, which must be an integer.
@@ -825,6 +1181,112 @@ SQLITE_DECIMAL_OPn_DECL(MinMag)
    */
 SQLITE_DECIMAL_OPn_DECL(Multiply)
 
+  /**
+   * \brief Generates a random decimal.
+   *
+   * The arguments are `digits`, `exp_lo`, `exp_hi` and, optionally, `seed`.
+   * The result is `c x 10^e`, where `c` is a uniformly distributed integer
+   * with at most `digits` digits and `e` is uniformly distributed in
+   * `[exp_lo, exp_hi]`. With the same seed, the same value is returned;
+   * without a seed, a fresh seed is drawn at each invocation.
+   */
+SQLITE_DECIMAL_OPn_DECL(RandomValue)
+
+  /**
+   * \brief Converts a decimal into a packed decimal (COBOL's `COMP-3`).
+   *
+   * The arguments are `x`, `length` and `scale`. The decimal is rounded to
+   * `scale` fractional digits with the current rounding mode, and it is
+   * stored into `length` bytes, with sign `C` (positive) or `D` (negative).
+   * The conversion fails if the value is not finite or it needs more than
+   * `2 x length - 1` digits.
+   */
+SQLITE_DECIMAL_OPn_DECL(ToPacked)
+
+  /**
+   * \brief Exports a column to a columnar file.
+   *
+   * The arguments are `table`, `column`, `path` and, optionally, `scale`.
+   * With a scale, values are stored as 64-bit integers scaled by
+   * `10^scale`; otherwise, they are stored as decimal128. The result is the
+   * number of exported rows. The export fails if any value cannot be stored
+   * exactly.
+   *
+   * \see decimalColumnarModule
+   */
+SQLITE_DECIMAL_OPn_DECL(ColumnarExport)
+
+  /**
+   * \brief Exports the result of a query to an Apache Arrow file.
+   *
+   * The arguments are `query` and `path`. Each column of the query is
+   * exported as a `Decimal128` column, or as a `Decimal256` column when its
+   * values need more than 38 digits. The result is the number of exported
+   * rows. The export fails if any value is not a finite decimal.
+   *
+   * \see decimalArrowModule
+   */
+SQLITE_DECIMAL_OPn_DECL(ArrowExport)
+
+  /**
+   * \brief Aggregates a column in parallel.
+   *
+   * The arguments are `table`, `column`, `op` (`sum`, `avg`, `min` or `max`)
+   * and, optionally, the number of threads (by default, one per online
+   * processor). The table is read from the database file by that many
+   * read-only connections, each in its own thread. The result is the same as
+   * the one of the corresponding aggregate function, unless the latter rounds
+   * an intermediate sum (see sqlite3_decimal_parallel_aggregate()).
+   *
+   * \see sqlite3_decimal_parallel_aggregate()
+   */
+SQLITE_DECIMAL_OPn_DECL(ParallelAgg)
+
+  /**
+   * \brief Materializes an aggregate view that is maintained incrementally.
+   *
+   * The arguments are `view`, `table`, `groups` and `aggregates`: `groups` is
+   * a comma-separated list of columns of `table` (possibly empty), and
+   * `aggregates` is a comma-separated list of `sum(c)`, `count(c)`,
+   * `count(*)`, `min(c)`, `max(c)` and `avg(c)`. The function creates the
+   * table `<view>_state` with the state of each group, the view `<view>`,
+   * and triggers on `table` that update the state of a group in constant time
+   * at each change. The result is the number of groups.
+   *
+   * Minima and maxima are compared in the encoded domain, and they are
+   * computed again only when the minimum or the maximum of a group is
+   * deleted.
+   */
+SQLITE_DECIMAL_OPn_DECL(Materialize)
+
+  /**
+   * \brief Converts a column to decimal blobs, in place.
+   *
+   * The arguments are `table`, `column` and, optionally, the number of rows
+   * per chunk (by default, 10000) and a scale. The rows are converted in
+   * rowid order, each chunk in its own transaction on a separate connection
+   * to the database file, so the function fails if it is invoked within
+   * a transaction. Text, integer and real
+   * values are converted with the current context and, if a scale is given,
+   * rounded to it with the current rounding mode; blobs and `NULL`s are left
+   * as they are. The result is the number of converted values.
+   *
+   * The progress is stored in `decMigrateProgress`, so an interrupted
+   * migration resumes where it stopped. The values that cannot be converted
+   * are left unchanged and recorded in `decMigrateRejects`.
+   *
+   * \see sqlite3_decimal_migrate()
+   */
+SQLITE_DECIMAL_OPn_DECL(Migrate)
+
+  /**
+   * \brief Turns profiling on for the connection.
+   *
+   * The optional argument is the sampling interval: one call in so many is
+   * timed (16 by default).
+   */
+SQLITE_DECIMAL_OPn_DECL(ProfileStart)
+
 #pragma mark Aggregate functions
 
   /**
@@ -847,5 +1309,131 @@ SQLITE_DECIMAL_AGGR_DECL(Max)
    */
 SQLITE_DECIMAL_AGGR_DECL(Avg)
 
+#pragma mark Table-valued functions
+
+#ifndef SQLITE_OMIT_VIRTUALTABLE
+
+  /**
+   * \brief Module implementing the `decSeries(start, stop [, step])`
+   *        table-valued function.
+   *
+   * The table has a single visible column, `value`, which contains the terms
+   * `start`, `start + step`, `start + 2 * step`, ..., not beyond `stop`, as
+   * decimals. Constraints on `value` and `order by value` are pushed down to
+   * the module.
+   */
+extern sqlite3_module decimalSeriesModule;
+
+  /**
+   * \brief Module implementing the
+   *        `decRandom(n [, digits [, exp_lo [, exp_hi [, seed]]]])`
+   *        table-valued function.
+   *
+   * The table has a single visible column, `value`, which contains \a n
+   * random decimals generated as by decimalRandomValue(). The values are
+   * reproducible when a seed is given.
+   */
+extern sqlite3_module decimalRandomModule;
+
+  /**
+   * \brief Module implementing the `decCsv(filename, schema [, header])`
+   *        virtual table.
+   *
+   * Columns declared as `DECIMAL` are parsed from the file into decimals;
+   * all the other columns are returned as text.
+   */
+extern sqlite3_module decimalCsvModule;
+
+  /**
+   * \brief Module implementing the `decColumnar(filename)` virtual table.
+   *
+   * The table serves a file written by decimalColumnarExport() from memory.
+   * Constraints on `value` are used to skip blocks of rows using their
+   * minimum and maximum values.
+   */
+extern sqlite3_module decimalColumnarModule;
+
+  /**
+   * \brief Module implementing the
+   *        `decAggScan(table, column, op [, where])` table-valued function.
+   *
+   * The table has one row, with the result of the aggregate operation \a op
+   * (`sum`, `avg`, `min`, or `max`) over \a column (`value`) and the number of
+   * non-null values (`count`). The result is the same as that of the
+   * corresponding aggregate function.
+   */
+extern sqlite3_module decimalAggScanModule;
+
+  /**
+   * \brief Module implementing the `decArrowScan(filename)` virtual table.
+   *
+   * The table has one column for each column of the Arrow file, which must
+   * be a (possibly nullable) decimal column. Values are converted from the
+   * memory-mapped file as they are read.
+   */
+extern sqlite3_module decimalArrowModule;
+
+  /**
+   * \brief Module implementing the `decValidate(table, column)` table-valued
+   *        function.
+   *
+   * The table has one row for each non-null value of \a column that is not
+   * a valid encoded decimal, with the rowid of the value (`row`) and the
+   * reason why it is invalid (`reason`).
+   */
+extern sqlite3_module decimalValidateModule;
+
+  /**
+   * \brief Module implementing the `decEncodingStats` table-valued function.
+   *
+   * The table has the histograms of the encoded lengths, exponents and
+   * digits of the values of \a column, the counts of special and invalid
+   * values, and, for each storage format, the number of values that it
+   * represents exactly and the estimated bytes per row.
+   */
+extern sqlite3_module decimalEncodingStatsModule;
+
+  /**
+   * \brief Module implementing the `decRejects` virtual table.
+   *
+   * The table has one row for each reason why decimalTry() rejects a value,
+   * with the number of rejected values (`count`) and the most recent of them
+   * (`sample`, truncated to 64 bytes). Deleting a row resets its counter.
+   */
+extern sqlite3_module decimalRejectsModule;
+
+  /**
+   * \brief Module implementing the `decProfile` virtual table.
+   *
+   * The table has one row for each decimal function called on the
+   * connection while profiling was on, with the number of calls, failed
+   * calls and calls with a `NULL` argument, the mean time of the phases of
+   * the timed calls, and their histograms.
+   */
+extern sqlite3_module decimalProfileModule;
+
+  /**
+   * \brief Module implementing the `decMemStats` virtual table.
+   *
+   * The table has one row for each call site of the extension that
+   * allocates memory, with the number and total size of the allocations,
+   * the number of deallocations and of failed allocations, and the current
+   * and maximum size of the outstanding allocations.
+   */
+extern sqlite3_module decimalMemStatsModule;
+
+#endif /* SQLITE_OMIT_VIRTUALTABLE */
+
+#pragma mark Collations
+
+/**
+ * \brief The `DECIMAL` collating sequence.
+ *
+ * Text values are ordered by their numeric value. Plain numbers are compared
+ * digit-wise, without being converted into decimals. Values that are not
+ * numbers sort after all numbers, in byte order.
+ */
+int decimalCollate(void* pArg, int n1, void const* z1, int n2, void const* z2);
+
 #endif /* sqlite3_decimal_impl_h */
 
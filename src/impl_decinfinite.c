@@ -13,16 +13,18 @@
  *        decimalInfinite encoding.
  *
  * \todo Optimize comparison functions
- * \todo Use signal handling mechanism instead of checkStatus()?
  * \todo Allow choosing allocation strategy (static vs dynamic) for local variables.
  * \todo Better error reporting for functions using decCheckMath() (currently,
  *       they report Invalid context)
  * \todo Reset context status after each successful operation?
  */
-#include <signal.h>
 #include <string.h>
-#include "decInfinite.h"
-#include "impl_decimal.h"
+#include "impl_decinfinite.h"
+#include "probes.h"
+
+#if DECTRAPSIG
+#error "decNumber must be built with DECTRAPSIG=0: a trapped condition would raise SIGFPE"
+#endif
 
 #pragma mark Helper functions
 
@@ -48,10 +50,12 @@ static decNumber* decNumberFromSQLite3Text(decNumber* result, sqlite3_value* val
 /**
  * \brief Builds a decimal from a blob field.
  *
- * Decimals are stored using the decimalInfinite format. If the blob does not
- * have the correct format, the `DEC_Conversion_syntax` flag is set and the
- * result is a quiet `NaN` or an error depending on whether the error is
- * trapped.
+ * Decimals are stored using the decimalInfinite format, except for the
+ * decimal64 and decimal128 blobs starting with #DECIMAL_DPD_TAG (see decTo64()
+ * and decTo128()). The scale of a fixed decimal (see decFixed()) is taken
+ * from its subtype. If the blob does not have the correct format, the
+ * `DEC_Conversion_syntax` flag is set and the result is a quiet `NaN` or an
+ * error depending on whether the error is trapped.
  *
  * \param result The output decimal
  * \param value A value of type `SQLITE_BLOB`
@@ -64,7 +68,15 @@ static decNumber* decNumberFromSQLite3Text(decNumber* result, sqlite3_value* val
 static decNumber* decNumberFromSQLite3Blob(decNumber* result, sqlite3_value* value, decContext* decCtx) {
   int length = sqlite3_value_bytes(value);
   uint8_t const* bytes = sqlite3_value_blob(value);
-  if (decInfiniteToNumber(length, bytes, result)) return result;
+  int64_t coeff;
+  int32_t scale;
+  if (decimalFixedFromSQLite3Value(value, &coeff, &scale)) {
+    return decNumberFromScaledInt64(result, coeff, -scale);
+  }
+  if (decimalDPDToNumber((size_t)length, bytes, result)) return result;
+  if (length > 0 && decInfiniteToNumber(length, bytes, result)) return result;
+  decNumberZero(result);
+  result->bits = DECNAN;
   decContextSetStatusQuiet(decCtx, DEC_Conversion_syntax);
   return result;
 }
@@ -83,24 +95,13 @@ static decNumber* decNumberFromSQLite3Integer(decNumber* result, sqlite3_value*
   return result;
 }
 
-/**
- * \brief Encodes a decimal value.
- *
- * \param context SQLite3 context
- * \param decnum A decimal value to encode
- *
- * \note This function **modifies** the input \a decnum. If you need to use the
- *       value after calling this function, **make a copy first**.
- */
-static void decNumberToSQLite3Blob(sqlite3_context* context, decNumber* decnum) {
-  uint8_t* bytes = sqlite3_malloc(DECINF_MAXSIZE * sizeof(uint8_t));
-  if (bytes) {
-    size_t length = decInfiniteFromNumber(DECINF_MAXSIZE, bytes, decnum);
-    sqlite3_result_blob(context, bytes, length, SQLITE_TRANSIENT); // FIXME: Use SQLITE_STATIC to avoid copy?
-    sqlite3_free(bytes);
-  }
-  else
-    sqlite3_result_error_nomem(context);
+void decNumberToSQLite3Blob(sqlite3_context* context, decNumber* decnum) {
+  uint64_t const start = SQLITE_DECIMAL_PROFILE_BEGIN();
+  // The encoding is short: encode on the stack and let SQLite copy it.
+  uint8_t bytes[DECINF_MAXSIZE];
+  size_t length = decInfiniteFromNumber(DECINF_MAXSIZE, bytes, decnum);
+  sqlite3_result_blob(context, bytes, length, SQLITE_TRANSIENT);
+  SQLITE_DECIMAL_PROFILE_END(SQLITE_DECIMAL_PROFILE_ENCODE, start);
 }
 
 /**
@@ -116,14 +117,16 @@ static void decNumberToSQLite3Blob(sqlite3_context* context, decNumber* decnum)
  * \see decNumber's manual, p. 29.
  **/
 static int checkStatus(sqlite3_context* sqlCtx, decContext* decCtx, uint32_t mask) {
-  // TODO: use the signal handling mechanism instead of this?
   if (decContextTestStatus(decCtx, mask)) {
     decContext errCtx; // FIXME: reimplement without copying the whole context
     decimalContextCopy(&errCtx, decCtx);
     decContextClearStatus(&errCtx, ~mask);
-    sqlite3_result_error(sqlCtx, decContextStatusToString(&errCtx), -1);
+    char const* zMsg = decContextStatusToString(&errCtx);
+    sqlite3_result_error(sqlCtx, zMsg, -1);
+    SQLITE_DECIMAL_PROBE2(trap, decContextGetStatus(&errCtx), zMsg);
     // Clear the flag(s) that generated the error
     decContextClearStatus(decCtx, mask);
+    SQLITE_DECIMAL_PROFILE_ERROR();
     return 0;
   }
   return 1;
@@ -142,51 +145,205 @@ static int checkStatus(sqlite3_context* sqlCtx, decContext* decCtx, uint32_t mas
  * \return `1` upon success; `0` if an error occurs.
  **/
 static int decode(decNumber* decnum, decContext* decCtx, sqlite3_value* value, sqlite3_context* sqlCtx) {
+  if (decNumberFromSQLite3Value(decnum, value, decCtx) == 0) {
+    sqlite3_result_error(sqlCtx, "Cannot create decimal from the given type", -1);
+    SQLITE_DECIMAL_PROFILE_ERROR();
+    return 0;
+  }
+  return checkStatus(sqlCtx, decCtx, decCtx->traps);
+}
+
+decNumber* decNumberFromSQLite3Value(decNumber* result, sqlite3_value* value, decContext* decCtx) {
+  uint64_t const start = SQLITE_DECIMAL_PROFILE_BEGIN();
+  decNumber* decnum;
   switch (sqlite3_value_type(value)) {
     case SQLITE_BLOB:
-      decNumberFromSQLite3Blob(decnum, value, decCtx);
+      decnum = decNumberFromSQLite3Blob(result, value, decCtx);
       break;
     case SQLITE_TEXT:
-      decNumberFromSQLite3Text(decnum, value, decCtx);
+      decnum = decNumberFromSQLite3Text(result, value, decCtx);
       break;
     case SQLITE_INTEGER:
-      decNumberFromSQLite3Integer(decnum, value);
+      decnum = decNumberFromSQLite3Integer(result, value);
       break;
     default:
-      sqlite3_result_error(sqlCtx, "Cannot create decimal from the given type", -1);
-      return 0;
+      decnum = 0;
+      break;
   }
-  return checkStatus(sqlCtx, decCtx, decCtx->traps);
+  SQLITE_DECIMAL_PROFILE_END(SQLITE_DECIMAL_PROFILE_DECODE, start);
+  return decnum;
 }
 
-#pragma mark Context functions
+int decNumberToScaledInt64(decNumber const* decnum, int32_t exponent, int64_t* result) {
+  if (decNumberIsSpecial(decnum)) return 0;
+  if (decNumberIsZero(decnum)) { *result = 0; return 1; }
+  int32_t scale = decnum->exponent - exponent;
+  // Digits below the exponent must be trailing zeros (decoded decimals have
+  // a multiple of three digits)
+  int32_t const drop = scale < 0 ? -scale : 0;
+  if (drop >= decnum->digits || decnum->digits - drop + (scale > 0 ? scale : 0) > 18) return 0;
+
+  static const uint32_t unitPower[DECDPUN] = { 1, 10, 100 };
+  int64_t c = 0;
+  for (int32_t k = decnum->digits - 1; k >= 0; --k) {
+    int const digit = decnum->lsu[k / DECDPUN] / unitPower[k % DECDPUN] % 10;
+    if (k >= drop) c = c * 10 + digit;
+    else if (digit != 0) return 0;
+  }
+  while (scale-- > 0) c *= 10;
+  *result = decNumberIsNegative(decnum) ? -c : c;
+  return 1;
+}
+
+decNumber* decNumberFromScaledInt64(decNumber* result, int64_t coeff, int32_t exponent) {
+  uint64_t u = coeff < 0 ? -(uint64_t)coeff : (uint64_t)coeff;
+
+  decNumberZero(result);
+  if (coeff < 0) result->bits = DECNEG;
+  result->exponent = exponent;
+  if (u > 0) {
+    Unit* up = result->lsu;
+    for (; u > 0; u /= 1000) *up++ = (Unit)(u % 1000);
+    --up;
+    result->digits = DECDPUN * (int32_t)(up - result->lsu) + (*up > 99 ? 3 : *up > 9 ? 2 : 1);
+  }
+  return result;
+}
+
+int decimalCheckTraps(decContext* decCtx, char** zErrMsg) {
+  uint32_t trapped = decContextGetStatus(decCtx) & decCtx->traps;
+  if (trapped) {
+    decContext errCtx;
+    decimalContextCopy(&errCtx, decCtx);
+    decContextClearStatus(&errCtx, ~trapped);
+    char const* zMsg = decContextStatusToString(&errCtx);
+    *zErrMsg = sqlite3_mprintf("%s", zMsg);
+    SQLITE_DECIMAL_PROBE2(trap, trapped, zMsg);
+    decContextClearStatus(decCtx, trapped);
+    SQLITE_DECIMAL_PROFILE_ERROR();
+    return SQLITE_ERROR;
+  }
+  return SQLITE_OK;
+}
 
 /**
- * \brief Handles `SIGFPE` signals.
+ * \brief Parses a plain number with at most 18 significant digits.
  *
- * Quoting from decNumber's manual, p.14:
+ * Accepted numbers have the form `[sign] digits [. digits] [E [sign] digits]`
+ * and can be represented exactly in \a decCtx.
  *
- * > When one of the decNumber functions sets a bit in the context status, the
- * > bit is compared with the corresponding bit in the traps field. If that bit
- * > is set (is 1) then a C Floating-Point Exception signal (SIGFPE) is raised.
- * > At that point, a signal handler function (previously identified to the
- * > C runtime) is called.
-
- * This function is such a handler. This doesn't do much: it just returns
- * control to the point where the signal was raised.
+ * \return `1` if the number has been parsed into `coeff x 10^exp`; `0` if it
+ *         must be parsed by decNumber (or it is not a valid number).
+ */
+static int decimalScanText(char const* text, size_t n, decContext* decCtx, int64_t* coeff, int32_t* exp) {
+  char const* p = text;
+  char const* const end = text + n;
+  uint64_t c = 0;
+  int32_t e = 0;
+  int32_t nSig = 0;   // Significant digits in the coefficient
+  int32_t scale = 0;  // Digits after the decimal point
+  int isNeg = 0;
+  int seenDigit = 0;
+  int seenDot = 0;
+
+  if (p < end && (*p == '-' || *p == '+')) isNeg = (*p++ == '-');
+  for (; p < end; p++) {
+    if (*p >= '0' && *p <= '9') {
+      seenDigit = 1;
+      if (seenDot) ++scale;
+      if (c == 0 && *p == '0') continue; // Leading zero
+      if (++nSig > 18) return 0;
+      c = c * 10 + (uint64_t)(*p - '0');
+    }
+    else if (*p == '.' && !seenDot)
+      seenDot = 1;
+    else
+      break;
+  }
+  if (!seenDigit) return 0;
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    int expNeg = 0;
+    int nExp = 0;
+    if (++p < end && (*p == '-' || *p == '+')) expNeg = (*p++ == '-');
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+      if (++nExp > 8) return 0;
+      e = e * 10 + (*p - '0');
+    }
+    if (nExp == 0) return 0;
+    if (expNeg) e = -e;
+  }
+  if (p != end) return 0;
+  if (isNeg && c == 0) return 0; // Negative zero
+  if (nSig > decCtx->digits) return 0; // Needs rounding
+  e -= scale;
+  if (e + nSig - 1 > decCtx->emax || e + nSig - 1 < decCtx->emin) return 0;
+
+  *coeff = isNeg ? -(int64_t)c : (int64_t)c;
+  *exp = e;
+  return 1;
+}
+
+/**
+ * \brief Parses a number with decNumber.
  *
- * \see decNumber's manual, pp. 14-15 and p. 23.
+ * \return \a result, or `0` if \a text is not a valid number, in which case
+ *         `Conversion syntax` is set in \a decCtx's status.
  */
-static void signalHandler(int signo) {
-  (void)signo;
-  signal(SIGFPE, signalHandler); // Re-enable
+static decNumber* decimalParseText(char const* text, size_t n, decNumber* result, decContext* decCtx) {
+  char buf[128];
+  char* zNum = (n < sizeof(buf)) ? buf : decimalMalloc(SQLITE_DECIMAL_MEM_PARSE, n + 1);
+  if (zNum == 0) return 0;
+  memcpy(zNum, text, n);
+  zNum[n] = '\0';
+
+  uint32_t status = decContextGetStatus(decCtx);
+  decContextClearStatus(decCtx, DEC_Conversion_syntax);
+  decNumberFromString(result, zNum, decCtx);
+  if (zNum != buf) decimalFree(SQLITE_DECIMAL_MEM_PARSE, zNum);
+  if (decContextTestStatus(decCtx, DEC_Conversion_syntax)) return 0;
+  decContextSetStatusQuiet(decCtx, status);
+  return result;
+}
+
+size_t decimalEncodeText(char const* text, size_t n, size_t len, uint8_t result[len], decContext* decCtx) {
+  int64_t coeff;
+  int32_t exp;
+
+  // Fast path: plain numbers are encoded without building a string or
+  // a decNumber.
+  if (decimalScanText(text, n, decCtx, &coeff, &exp))
+    return decInfiniteFromInt64(len, result, coeff, exp);
+
+  decNumber decnum;
+  if (decimalParseText(text, n, &decnum, decCtx) == 0) return 0;
+  return decInfiniteFromNumber(len, result, &decnum);
 }
 
+decNumber* decimalNumberFromText(char const* text, size_t n, decNumber* result, decContext* decCtx) {
+  int64_t coeff;
+  int32_t exp;
+
+  if (!decimalScanText(text, n, decCtx, &coeff, &exp))
+    return decimalParseText(text, n, result, decCtx);
+
+  uint64_t u = coeff < 0 ? -(uint64_t)coeff : (uint64_t)coeff;
+  decNumberZero(result);
+  if (u == 0) return result;
+  Unit* up = result->lsu;
+  for (; u > 0; u /= 1000) *up++ = (Unit)(u % 1000);
+  --up;
+  result->digits = 3 * (int32_t)(up - result->lsu) + (*up > 99 ? 3 : *up > 9 ? 2 : 1);
+  result->exponent = exp;
+  if (coeff < 0) result->bits = DECNEG;
+  return result;
+}
+
+#pragma mark Context functions
+
 void* decimalInitSystem() {
-  if (signal(SIGFPE, signalHandler) == SIG_ERR) {
-    // Maybe, setting signal handling is disabled?
-    // TODO: should we do something here?
-  }
+  // decNumber is built with DECTRAPSIG=0, so trapped conditions raise no
+  // SIGFPE: they are only status bits, which are checked after each
+  // operation (see checkStatus() and decimalCheckTraps()).
   // TODO: Check endianness (with decContextTestEndian())?
   return decimalContextCreate();
 }
@@ -211,9 +368,23 @@ static decContext* initDefaultContext(decContext* context) {
   return context;
 }
 
+/**
+ * \brief A context allocated by decimalContextCreate().
+ *
+ * decNumber's context comes first, so that a pointer to this structure can
+ * be used wherever a pointer to a `decContext` is expected.
+ */
+typedef struct decimalContext {
+  decContext base;          /**< decNumber's context - must be first. */
+  decimalProfile* profile;  /**< The attached profile, or `0`.        */
+} decimalContext;
+
 void* decimalContextCreate() {
-  decContext* context = sqlite3_malloc(sizeof(decContext));
-  initDefaultContext(context);
+  decimalContext* context = decimalMalloc(SQLITE_DECIMAL_MEM_CONTEXT, sizeof(decimalContext));
+  if (context) {
+    initDefaultContext(&context->base);
+    context->profile = 0;
+  }
   return context;
 }
 
@@ -222,7 +393,18 @@ void decimalContextCopy(void* target, void* source) {
 }
 
 void decimalContextDestroy(void* context) {
-  if (context) sqlite3_free((decContext*)context);
+  if (context) {
+    decimalProfileDestroy(((decimalContext*)context)->profile);
+    decimalFree(SQLITE_DECIMAL_MEM_CONTEXT, context);
+  }
+}
+
+decimalProfile* decimalContextProfile(void* decCtx) {
+  return ((decimalContext*)decCtx)->profile;
+}
+
+void decimalContextSetProfile(void* decCtx, decimalProfile* profile) {
+  ((decimalContext*)decCtx)->profile = profile;
 }
 
 #pragma mark Helper functions for context virtual table
@@ -520,9 +702,24 @@ SQLITE_DECIMAL_OP2(Remainder,     decNumberRemainder)
 SQLITE_DECIMAL_OP2(Rotate,        decNumberRotate)
 SQLITE_DECIMAL_OP2(ScaleB,        decNumberScaleB)
 SQLITE_DECIMAL_OP2(Shift,         decNumberShift)
-SQLITE_DECIMAL_OP2(Subtract,      decNumberSubtract)
 SQLITE_DECIMAL_OP2(Xor,           decNumberXor)
 
+void decimalSubtract(sqlite3_context* context, sqlite3_value* value1, sqlite3_value* value2) {
+  sqlite3_value* argv[2] = { value1, value2 };
+  if (decimalFixedAdd(context, 2, argv, 1)) return;
+
+  decNumber d1;
+  decNumber d2;
+  decContext* decCtx = sqlite3_user_data(context);
+  if (decode(&d1, decCtx, value1, context) && decode(&d2, decCtx, value2, context)) {
+    decNumber result;
+    decNumberSubtract(&result, &d1, &d2, decCtx);
+    if (checkStatus(context, decCtx, decCtx->traps)) {
+      decNumberToSQLite3Blob(context, &result);
+    }
+  }
+}
+
 #pragma mark Dec -> Text
 
 void decimalBytes(sqlite3_context* context, sqlite3_value* value) {
@@ -535,17 +732,17 @@ void decimalBytes(sqlite3_context* context, sqlite3_value* value) {
       sqlite3_result_error(context, "Currently, only blob arguments are accepted", -1);
       return;
   }
-  char* const hexes = sqlite3_malloc(3 * DECINF_MAXSIZE);
+  size_t length = sqlite3_value_bytes(value);
+  if (length > DECINF_MAXSIZE) {
+    sqlite3_result_error(context, "Encoding too long", -1);
+    return;
+  }
+  char* const hexes = decimalMalloc(SQLITE_DECIMAL_MEM_BYTES, 3 * DECINF_MAXSIZE);
   if (hexes) {
-    size_t length = sqlite3_value_bytes(value);
-    if (length > DECINF_MAXSIZE) {
-      sqlite3_result_error(context, "Encoding too long", -1);
-      return;
-    }
     uint8_t const* const bytes = sqlite3_value_blob(value);
     decInfiniteToBytes(length, bytes, hexes);
     sqlite3_result_text(context, hexes, -1, SQLITE_TRANSIENT);
-    sqlite3_free(hexes);
+    decimalFree(SQLITE_DECIMAL_MEM_BYTES, hexes);
   }
   else
     sqlite3_result_error_nomem(context);
@@ -561,17 +758,17 @@ void decimalBits(sqlite3_context* context, sqlite3_value* value) {
       sqlite3_result_error(context, "Currently, only blob arguments are accepted", -1);
       return;
   }
-  char* const bits = sqlite3_malloc(9 * DECINF_MAXSIZE + 1); // Loose upper bound
+  size_t length = sqlite3_value_bytes(value);
+  if (length > DECINF_MAXSIZE) {
+    sqlite3_result_error(context, "Encoding too long", -1);
+    return;
+  }
+  char* const bits = decimalMalloc(SQLITE_DECIMAL_MEM_BITS, 9 * DECINF_MAXSIZE + 1); // Loose upper bound
   if (bits) {
-    size_t length = sqlite3_value_bytes(value);
-    if (length > DECINF_MAXSIZE) {
-      sqlite3_result_error(context, "Encoding too long", -1);
-      return;
-    }
     uint8_t const* const bytes = sqlite3_value_blob(value);
     decInfiniteToBits(length, bytes, bits);
     sqlite3_result_text(context, bits, -1, SQLITE_TRANSIENT);
-    sqlite3_free(bits);
+    decimalFree(SQLITE_DECIMAL_MEM_BITS, bits);
   }
   else
     sqlite3_result_error_nomem(context);
@@ -733,10 +930,11 @@ void decimalFMA(sqlite3_context* context, sqlite3_value* v1, sqlite3_value* v2,
 
 #pragma mark Dec x ... x Dec -> Dec
 
-#define SQLITE_DECIMAL_OPn(fun, op, defaultValue)                                 \
+#define SQLITE_DECIMAL_OPn(fun, op, defaultValue, fastPath)                       \
   void decimal ## fun(sqlite3_context* context, int argc, sqlite3_value** argv) { \
     decContext* decCtx = sqlite3_user_data(context);                              \
     decNumber result;                                                             \
+    if (fastPath(context, argc, argv)) return;                                    \
     if (argc == 0) {                                                              \
       defaultValue(&result, decCtx);                                              \
       decNumberToSQLite3Blob(context, &result);                                   \
@@ -777,12 +975,29 @@ static void decimalMultiplyDefault(decNumber* decnum, decContext* decCtx) {
   decNumberFromString(decnum, "1", decCtx);
 }
 
-SQLITE_DECIMAL_OPn(Add,      decNumberAdd,      decimalAddDefault)
-SQLITE_DECIMAL_OPn(Max,      decNumberMax,      decimalMaxDefault)
-SQLITE_DECIMAL_OPn(MaxMag,   decNumberMaxMag,   decimalMaxDefault)
-SQLITE_DECIMAL_OPn(Min,      decNumberMin,      decimalMinDefault)
-SQLITE_DECIMAL_OPn(MinMag,   decNumberMinMag,   decimalAddDefault)
-SQLITE_DECIMAL_OPn(Multiply, decNumberMultiply, decimalMultiplyDefault)
+/**
+ * \brief Computes a sum of fixed decimals with integers, if possible.
+ */
+static int decimalAddFast(sqlite3_context* context, int argc, sqlite3_value** argv) {
+  return decimalFixedAdd(context, argc, argv, 0);
+}
+
+/**
+ * \brief Used by the functions that have no fast path.
+ */
+static int decimalNoFastPath(sqlite3_context* context, int argc, sqlite3_value** argv) {
+  (void)context;
+  (void)argc;
+  (void)argv;
+  return 0;
+}
+
+SQLITE_DECIMAL_OPn(Add,      decNumberAdd,      decimalAddDefault,      decimalAddFast)
+SQLITE_DECIMAL_OPn(Max,      decNumberMax,      decimalMaxDefault,      decimalNoFastPath)
+SQLITE_DECIMAL_OPn(MaxMag,   decNumberMaxMag,   decimalMaxDefault,      decimalNoFastPath)
+SQLITE_DECIMAL_OPn(Min,      decNumberMin,      decimalMinDefault,      decimalNoFastPath)
+SQLITE_DECIMAL_OPn(MinMag,   decNumberMinMag,   decimalAddDefault,      decimalNoFastPath)
+SQLITE_DECIMAL_OPn(Multiply, decNumberMultiply, decimalMultiplyDefault, decimalFixedMultiply)
 
 /**
  * \brief Holds the cumulative sum computed by decSum().
@@ -837,6 +1052,7 @@ SQLITE_DECIMAL_AGGR_STEP(Avg, decNumberAdd)
     }                                                                                                \
                                                                                                      \
     finalize(data);                                                                                  \
+    SQLITE_DECIMAL_PROBE3(aggregate__final, "dec" #fun, data->count, data->value.digits);            \
                                                                                                      \
     if (checkStatus(context, data->decCtx, data->decCtx->traps))                                     \
     decNumberToSQLite3Blob(context, &(data->value));                                                 \
@@ -0,0 +1,191 @@
+/**
+ * \file      impl_decinfinite.h
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     Helpers shared by the modules built on decNumber and the
+ *            decimalInfinite encoding.
+ */
+#ifndef sqlite3_decimal_impl_decinfinite_h
+#define sqlite3_decimal_impl_decinfinite_h
+
+#include "decInfinite.h"
+#include "impl_decimal.h"
+
+/**
+ * \brief Builds a decimal from a SQLite3 integer, blob, or string.
+ *
+ * \param result The output decimal
+ * \param value A SQLite3 value
+ * \param decCtx decNumber's context
+ *
+ * \return \a result, or `0` if \a value has a type that cannot be converted
+ *         into a decimal.
+ *
+ * Conversion errors do not make this function fail: rather, they set the
+ * corresponding status flag in \a decCtx, as decNumber's functions do. Use
+ * decimalCheckTraps() to find out whether a trapped condition has occurred.
+ */
+decNumber* decNumberFromSQLite3Value(decNumber* result, sqlite3_value* value, decContext* decCtx);
+
+/**
+ * \brief Encodes a decimal value and sets it as the result of a function.
+ *
+ * \param context SQLite3 context
+ * \param decnum A decimal value to encode
+ *
+ * \note This function **modifies** the input \a decnum. If you need to use the
+ *       value after calling this function, **make a copy first**.
+ */
+void decNumberToSQLite3Blob(sqlite3_context* context, decNumber* decnum);
+
+/**
+ * \brief Converts a finite decimal into a fixed-point coefficient.
+ *
+ * \param decnum A decimal
+ * \param exponent The exponent of the fixed-point representation
+ * \param result Receives the coefficient `c` such that
+ *        `decnum = c x 10^exponent`
+ *
+ * \return `1` if \a decnum is finite and can be represented exactly by
+ *         a coefficient with at most 18 digits; `0` otherwise.
+ */
+int decNumberToScaledInt64(decNumber const* decnum, int32_t exponent, int64_t* result);
+
+/**
+ * \brief Converts a fixed-point number into a decimal.
+ *
+ * This is the inverse of decNumberToScaledInt64().
+ *
+ * \param result The output decimal
+ * \param coeff The coefficient
+ * \param exponent The exponent
+ *
+ * \return \a result, which is set to `coeff x 10^exponent`.
+ */
+decNumber* decNumberFromScaledInt64(decNumber* result, int64_t coeff, int32_t exponent);
+
+/**
+ * \brief Checks whether any trapped condition is set in the given context.
+ *
+ * This is meant for code paths that have no SQLite3 function context to
+ * report an error to, such as virtual table methods.
+ *
+ * \param decCtx decNumber's context
+ * \param zErrMsg Receives an error message allocated with `sqlite3_mprintf()`
+ *        if a trapped condition is set
+ *
+ * \return `SQLITE_OK` if no trapped condition is set; `SQLITE_ERROR` otherwise.
+ *         In the latter case, the flags that generated the error are cleared.
+ */
+int decimalCheckTraps(decContext* decCtx, char** zErrMsg);
+
+/**
+ * \brief Parses a decimal from a (not necessarily null-terminated) string and
+ *        encodes it.
+ *
+ * Plain numbers with at most 18 significant digits are encoded directly,
+ * without building a decNumber; anything else is parsed by decNumber.
+ *
+ * \param text The string to parse
+ * \param n The length of \a text, in bytes
+ * \param len The length of the output buffer
+ * \param result The output buffer, which must have space for at least
+ *        #DECINF_MAXSIZE bytes
+ * \param decCtx decNumber's context. Conditions raised by the conversion
+ *        (e.g., `Inexact`) are set in its status quietly.
+ *
+ * \return The length of the encoded number, or `0` if \a text is not
+ *         a valid number, in which case `Conversion syntax` is set in \a
+ *         decCtx's status.
+ */
+size_t decimalEncodeText(char const* text, size_t n, size_t len, uint8_t result[len], decContext* decCtx);
+
+/**
+ * \brief Parses a decimal from a (not necessarily null-terminated) string.
+ *
+ * This is like decimalEncodeText(), except that the result is a decNumber.
+ *
+ * \param text The string to parse
+ * \param n The length of \a text, in bytes
+ * \param result The output decimal
+ * \param decCtx decNumber's context
+ *
+ * \return \a result, or `0` if \a text is not a valid number, in which case
+ *         `Conversion syntax` is set in \a decCtx's status.
+ */
+decNumber* decimalNumberFromText(char const* text, size_t n, decNumber* result, decContext* decCtx);
+
+/**
+ * \brief First byte of the blobs holding an IEEE 754 decimal64 or decimal128.
+ *
+ * The blobs returned by decTo64() and decTo128() are this byte followed by the
+ * number. No decInfinite encoding starts with this byte (the first three bits
+ * of a decInfinite encoding longer than one byte are `001` or `100`), so
+ * decNumberFromSQLite3Value() tells the formats apart, even in a table.
+ */
+#define DECIMAL_DPD_TAG 0x44
+
+/**
+ * \brief Decodes a tagged big-endian IEEE 754 decimal64 or decimal128.
+ *
+ * \param len The length of the blob: 9 or 17 bytes
+ * \param bytes The blob, starting with #DECIMAL_DPD_TAG
+ * \param decnum The output decimal
+ *
+ * \return \a decnum, or `0` if \a bytes is not a tagged DPD number.
+ */
+decNumber* decimalDPDToNumber(size_t len, uint8_t const bytes[len], decNumber* decnum);
+
+/**
+ * \brief Subtype of the decimals returned by decFixed() with scale `0`.
+ *
+ * The subtype of a fixed decimal with scale `s` is this value plus `s`. The
+ * blob itself is an ordinary decimal, so a fixed decimal that has lost its
+ * subtype keeps its value.
+ *
+ * \see fixed.c
+ */
+#define DECIMAL_FIXED_SUBTYPE 0x80
+
+/**
+ * \brief Reads a fixed decimal.
+ *
+ * \param value A SQLite3 value
+ * \param coeff The output coefficient
+ * \param scale The output scale
+ *
+ * \return `1` if \a value is a fixed decimal, that is, `coeff x 10^-scale`;
+ *         `0` otherwise.
+ */
+int decimalFixedFromSQLite3Value(sqlite3_value* value, int64_t* coeff, int32_t* scale);
+
+/**
+ * \brief Adds or subtracts fixed decimals with 64-bit integers.
+ *
+ * \param context The context of a SQL function
+ * \param argc The number of arguments
+ * \param argv The arguments
+ * \param isSubtraction Whether the arguments after the first are subtracted
+ *
+ * \return `1` if the result has been set; `0` if some argument is not a fixed
+ *         decimal or the exact result does not fit into 64 bits or into the
+ *         precision of the context, in which case the operation must be
+ *         performed with decNumber.
+ */
+int decimalFixedAdd(sqlite3_context* context, int argc, sqlite3_value** argv, int isSubtraction);
+
+/**
+ * \brief Multiplies fixed decimals with 64-bit integers.
+ *
+ * This is like decimalFixedAdd(), but for multiplication.
+ */
+int decimalFixedMultiply(sqlite3_context* context, int argc, sqlite3_value** argv);
+
+#endif /* sqlite3_decimal_impl_decinfinite_h */
@@ -0,0 +1,378 @@
+/**
+ * \file      json.c
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     Precision-preserving extraction of numbers from JSON text.
+ *
+ * `json_extract()` converts JSON numbers to `REAL`, so digits are lost
+ * before a decimal function can see them. The functions in this file find
+ * a value with a lightweight scanner and parse the digits of the number as
+ * written in the JSON text:
+ *
+ * - `decJson(json, path)` returns the number at \a path;
+ * - `decJsonSum(json, path)` returns the sum of the numbers in the array at
+ *   \a path;
+ * - `decToJson(x)` returns a decimal as a JSON number, in plain notation
+ *   unless it is very large or very small.
+ *
+ * Paths are a subset of those of SQLite's JSON functions: `$` followed by
+ * any number of `.key`, `."key"` and `[index]` steps. Keys are compared as
+ * they are written in the JSON text (escapes are not decoded). Strings
+ * containing a number (e.g., `"12.50"`) are accepted as numbers.
+ *
+ * The scanner only checks the parts of the text that it traverses: the
+ * members and elements following the requested value are not looked at.
+ */
+#include <string.h>
+#include "impl_decinfinite.h"
+
+/**
+ * \brief Maximum nesting depth of arrays and objects.
+ */
+#define JSON_MAX_DEPTH 1000
+
+/**
+ * \brief Maximum number of zeros that decToJson() adds to write a number
+ *        without an exponent.
+ *
+ * Numbers that need more are written in scientific notation.
+ */
+#define JSON_MAX_PLAIN_ZEROS 64
+
+/**
+ * \brief A JSON value, as it appears in the text.
+ */
+typedef struct jsonToken {
+  char const* z; /**< The first character of the value. */
+  size_t n;      /**< The length of the value.          */
+} jsonToken;
+
+#pragma mark Scanner
+
+static char const* jsonSkipSpace(char const* p, char const* end) {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+  return p;
+}
+
+/**
+ * \brief Skips a string.
+ *
+ * \return A pointer past the closing quote, or `0` if the string is not
+ *         terminated.
+ */
+static char const* jsonSkipString(char const* p, char const* end) {
+  for (++p; p < end; p++) {
+    if (*p == '"') return p + 1;
+    if (*p == '\\') p++;
+  }
+  return 0;
+}
+
+/**
+ * \brief Skips a value.
+ *
+ * \return A pointer past the value, or `0` if the value is malformed.
+ */
+static char const* jsonSkipValue(char const* p, char const* end, int depth) {
+  if (p >= end) return 0;
+  switch (*p) {
+    case '"':
+      return jsonSkipString(p, end);
+    case '{':
+    case '[': {
+      char const close = (*p == '{') ? '}' : ']';
+      int const isObject = (*p == '{');
+      if (depth >= JSON_MAX_DEPTH) return 0;
+      p = jsonSkipSpace(p + 1, end);
+      if (p < end && *p == close) return p + 1;
+      for (;;) {
+        if (isObject) {
+          if (p >= end || *p != '"' || (p = jsonSkipString(p, end)) == 0) return 0;
+          p = jsonSkipSpace(p, end);
+          if (p >= end || *p != ':') return 0;
+          p = jsonSkipSpace(p + 1, end);
+        }
+        if ((p = jsonSkipValue(p, end, depth + 1)) == 0) return 0;
+        p = jsonSkipSpace(p, end);
+        if (p >= end) return 0;
+        if (*p == close) return p + 1;
+        if (*p++ != ',') return 0;
+        p = jsonSkipSpace(p, end);
+      }
+    }
+    case 't':
+      return (end - p >= 4 && memcmp(p, "true", 4) == 0) ? p + 4 : 0;
+    case 'f':
+      return (end - p >= 5 && memcmp(p, "false", 5) == 0) ? p + 5 : 0;
+    case 'n':
+      return (end - p >= 4 && memcmp(p, "null", 4) == 0) ? p + 4 : 0;
+    default: {
+      char const* q = p;
+      while (q < end && ((*q >= '0' && *q <= '9') || *q == '-' || *q == '+' || *q == '.' || *q == 'e' || *q == 'E'))
+        q++;
+      return (q > p) ? q : 0;
+    }
+  }
+}
+
+/**
+ * \brief Finds the value at a path.
+ *
+ * \param zJson The JSON text
+ * \param nJson The length of \a zJson
+ * \param zPath The path
+ * \param pToken Receives the value; its length is zero if the path does not
+ *        exist
+ *
+ * \return `SQLITE_OK`; `SQLITE_ERROR` if the path is invalid;
+ *         `SQLITE_CORRUPT` if the JSON text is malformed.
+ */
+static int jsonLookup(char const* zJson, size_t nJson, char const* zPath, jsonToken* pToken) {
+  char const* const end = zJson + nJson;
+  char const* p = jsonSkipSpace(zJson, end);
+
+  pToken->z = 0;
+  pToken->n = 0;
+  if (*zPath++ != '$') return SQLITE_ERROR;
+  while (*zPath) {
+    if (*zPath == '.') {
+      char const* zKey = ++zPath;
+      size_t nKey;
+      if (*zKey == '"') {
+        char const* q = strchr(++zKey, '"');
+        if (q == 0) return SQLITE_ERROR;
+        nKey = (size_t)(q - zKey);
+        zPath = q + 1;
+      }
+      else {
+        nKey = strcspn(zKey, ".[");
+        zPath += nKey;
+      }
+      if (nKey == 0) return SQLITE_ERROR;
+      if (p >= end || *p != '{') return SQLITE_OK; // No such key
+      p = jsonSkipSpace(p + 1, end);
+      if (p < end && *p == '}') return SQLITE_OK;
+      for (;;) {
+        char const* zName = p;
+        if (p >= end || *p != '"' || (p = jsonSkipString(p, end)) == 0) return SQLITE_CORRUPT;
+        int const isMatch = ((size_t)(p - zName) == nKey + 2 && memcmp(zName + 1, zKey, nKey) == 0);
+        p = jsonSkipSpace(p, end);
+        if (p >= end || *p != ':') return SQLITE_CORRUPT;
+        p = jsonSkipSpace(p + 1, end);
+        if (isMatch) break;
+        if ((p = jsonSkipValue(p, end, 0)) == 0) return SQLITE_CORRUPT;
+        p = jsonSkipSpace(p, end);
+        if (p < end && *p == '}') return SQLITE_OK;
+        if (p >= end || *p++ != ',') return SQLITE_CORRUPT;
+        p = jsonSkipSpace(p, end);
+      }
+    }
+    else if (*zPath == '[') {
+      sqlite3_int64 i = 0;
+      if (*++zPath < '0' || *zPath > '9') return SQLITE_ERROR;
+      for (; *zPath >= '0' && *zPath <= '9'; zPath++)
+        if ((i = i * 10 + (*zPath - '0')) > 0x7fffffff) return SQLITE_ERROR;
+      if (*zPath++ != ']') return SQLITE_ERROR;
+      if (p >= end || *p != '[') return SQLITE_OK; // No such element
+      p = jsonSkipSpace(p + 1, end);
+      if (p < end && *p == ']') return SQLITE_OK;
+      for (; i > 0; i--) {
+        if ((p = jsonSkipValue(p, end, 0)) == 0) return SQLITE_CORRUPT;
+        p = jsonSkipSpace(p, end);
+        if (p < end && *p == ']') return SQLITE_OK;
+        if (p >= end || *p++ != ',') return SQLITE_CORRUPT;
+        p = jsonSkipSpace(p, end);
+      }
+    }
+    else
+      return SQLITE_ERROR;
+  }
+
+  char const* q = jsonSkipValue(p, end, 0);
+  if (q == 0) return SQLITE_CORRUPT;
+  pToken->z = p;
+  pToken->n = (size_t)(q - p);
+  return SQLITE_OK;
+}
+
+/**
+ * \brief Returns the text of a number or of a string token.
+ *
+ * The quotes of a string are removed.
+ */
+static void jsonNumberText(jsonToken const* pToken, char const** pz, size_t* pn) {
+  *pz = pToken->z;
+  *pn = pToken->n;
+  if (pToken->z[0] == '"') {
+    *pz += 1;
+    *pn -= 2;
+  }
+}
+
+/**
+ * \brief Returns whether a token is JSON `null`.
+ */
+static int jsonIsNull(jsonToken const* pToken) {
+  return pToken->n == 4 && pToken->z[0] == 'n';
+}
+
+/**
+ * \brief Finds the value at a path and reports errors.
+ *
+ * \return `1` if the lookup succeeds (even if the path does not exist);
+ *         `0` if an error has been set.
+ */
+static int jsonFind(sqlite3_context* context, sqlite3_value* json, sqlite3_value* path, jsonToken* pToken) {
+  char const* zJson = (char const*)sqlite3_value_text(json);
+  char const* zPath = (char const*)sqlite3_value_text(path);
+  if (zJson == 0 || zPath == 0) {
+    sqlite3_result_error_nomem(context);
+    return 0;
+  }
+  switch (jsonLookup(zJson, (size_t)sqlite3_value_bytes(json), zPath, pToken)) {
+    case SQLITE_OK:
+      return 1;
+    case SQLITE_ERROR: {
+      char* zErr = sqlite3_mprintf("Invalid JSON path: %s", zPath);
+      sqlite3_result_error(context, zErr ? zErr : "Invalid JSON path", -1);
+      sqlite3_free(zErr);
+      return 0;
+    }
+    default:
+      sqlite3_result_error(context, "Malformed JSON", -1);
+      return 0;
+  }
+}
+
+/**
+ * \brief Reports a trapped condition, if any.
+ *
+ * \return `1` if no trapped condition is set; `0` if an error has been set.
+ */
+static int jsonCheckTraps(sqlite3_context* context, decContext* decCtx) {
+  char* zErr = 0;
+  if (decimalCheckTraps(decCtx, &zErr) == SQLITE_OK) return 1;
+  sqlite3_result_error(context, zErr ? zErr : "Decimal error", -1);
+  sqlite3_free(zErr);
+  return 0;
+}
+
+#pragma mark Functions
+
+void decimalJson(sqlite3_context* context, sqlite3_value* json, sqlite3_value* path) {
+  decContext* decCtx = sqlite3_user_data(context);
+  jsonToken token;
+  char const* z;
+  size_t n;
+
+  if (!jsonFind(context, json, path, &token)) return;
+  if (token.n == 0 || jsonIsNull(&token)) return; // NULL
+
+  uint8_t bytes[DECINF_MAXSIZE];
+  jsonNumberText(&token, &z, &n);
+  size_t len = decimalEncodeText(z, n, DECINF_MAXSIZE, bytes, decCtx);
+  if (len == 0) { // Not a number: an error or NaN, as for dec()
+    if (!jsonCheckTraps(context, decCtx)) return;
+    bytes[0] = 0xE0; // NaN
+    len = 1;
+  }
+  sqlite3_result_blob(context, bytes, (int)len, SQLITE_TRANSIENT);
+}
+
+void decimalJsonSum(sqlite3_context* context, sqlite3_value* json, sqlite3_value* path) {
+  decContext* decCtx = sqlite3_user_data(context);
+  jsonToken token;
+  decNumber sum;
+  decNumber x;
+  char const* z;
+  size_t n;
+
+  if (!jsonFind(context, json, path, &token)) return;
+  if (token.n == 0 || jsonIsNull(&token)) return; // NULL
+
+  decNumberZero(&sum);
+  if (token.z[0] != '[') { // A single value
+    jsonNumberText(&token, &z, &n);
+    if (decimalNumberFromText(z, n, &sum, decCtx) == 0) sum.bits = DECNAN;
+  }
+  else {
+    char const* const end = token.z + token.n - 1; // The closing bracket
+    char const* p = jsonSkipSpace(token.z + 1, end);
+    while (p < end) {
+      char const* q = jsonSkipValue(p, end, 0);
+      jsonToken elem = { p, (size_t)(q - p) };
+      if (elem.z[0] == '[' || elem.z[0] == '{') {
+        sqlite3_result_error(context, "Nested arrays and objects cannot be summed", -1);
+        return;
+      }
+      if (!jsonIsNull(&elem)) {
+        jsonNumberText(&elem, &z, &n);
+        if (decimalNumberFromText(z, n, &x, decCtx) == 0) {
+          decNumberZero(&x);
+          x.bits = DECNAN;
+        }
+        decNumberAdd(&sum, &sum, &x, decCtx);
+      }
+      p = jsonSkipSpace(q, end);
+      if (p < end) p = jsonSkipSpace(p + 1, end); // Comma (checked by the scanner)
+    }
+  }
+  if (jsonCheckTraps(context, decCtx))
+    decNumberToSQLite3Blob(context, &sum);
+}
+
+void decimalToJson(sqlite3_context* context, sqlite3_value* value) {
+  decContext* decCtx = sqlite3_user_data(context);
+  decNumber decnum;
+
+  if (decNumberFromSQLite3Value(&decnum, value, decCtx) == 0) {
+    sqlite3_result_error(context, "Cannot create decimal from the given type", -1);
+    return;
+  }
+  if (!jsonCheckTraps(context, decCtx)) return;
+  if (decNumberIsSpecial(&decnum)) return; // NULL: JSON has no NaNs or infinities
+
+  char s[DECNUMDIGITS + JSON_MAX_PLAIN_ZEROS + 14];
+  decNumberTrim(&decnum);
+  if (decNumberIsZero(&decnum)) decnum.exponent = 0;
+  int32_t const exponent = decnum.exponent;
+  int32_t const point = decnum.digits + exponent; // Digits before the decimal point
+  if (exponent > JSON_MAX_PLAIN_ZEROS || point < -JSON_MAX_PLAIN_ZEROS)
+    decNumberToString(&decnum, s); // Scientific notation is valid JSON syntax, too
+  else { // Plain notation, from the digits of the coefficient
+    char zDigits[DECNUMDIGITS + 14];
+    char* p = s;
+    if (decNumberIsNegative(&decnum)) *p++ = '-';
+    decnum.exponent = 0;
+    decnum.bits &= ~DECNEG;
+    decNumberToString(&decnum, zDigits);
+    size_t const n = strlen(zDigits);
+    if (exponent >= 0) {
+      memcpy(p, zDigits, n);
+      memset(p + n, '0', (size_t)exponent);
+      p += n + (size_t)exponent;
+    }
+    else if (point > 0) {
+      memcpy(p, zDigits, (size_t)point);
+      p[point] = '.';
+      memcpy(p + point + 1, zDigits + point, n - (size_t)point);
+      p += n + 1;
+    }
+    else {
+      memcpy(p, "0.", 2);
+      memset(p + 2, '0', (size_t)-point);
+      memcpy(p + 2 - point, zDigits, n);
+      p += 2 - point + n;
+    }
+    *p = 0;
+  }
+  sqlite3_result_text(context, s, -1, SQLITE_TRANSIENT);
+  sqlite3_result_subtype(context, 'J'); // Embedded as a number by SQLite's JSON functions
+}
@@ -0,0 +1,83 @@
+/**
+ * \file      mapfile.c
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     Read-only access to whole files.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "mapfile.h"
+
+#if HAVE_SYS_MMAN_H && HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MAPFILE_USE_MMAP 1
+#endif
+
+int decimalMapFile(char const* zFile, int isSequential, decimalMappedFile* pFile) {
+  memset(pFile, 0, sizeof(*pFile));
+#if MAPFILE_USE_MMAP
+  int fd = open(zFile, O_RDONLY);
+  if (fd < 0) return SQLITE_CANTOPEN;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return SQLITE_IOERR;
+  }
+  pFile->nData = (sqlite3_int64)st.st_size;
+  if (pFile->nData > 0) {
+    void* p = mmap(0, (size_t)pFile->nData, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+      close(fd);
+      pFile->nData = 0;
+      return SQLITE_IOERR;
+    }
+#if HAVE_MADVISE
+    if (isSequential) madvise(p, (size_t)pFile->nData, MADV_SEQUENTIAL);
+#endif
+    pFile->zData = p;
+    pFile->isMapped = 1;
+  }
+  close(fd);
+  return SQLITE_OK;
+#else
+  (void)isSequential;
+  FILE* in = fopen(zFile, "rb");
+  if (in == 0) return SQLITE_CANTOPEN;
+  int rc = SQLITE_OK;
+  long size;
+  if (fseek(in, 0, SEEK_END) == 0 && (size = ftell(in)) >= 0 && fseek(in, 0, SEEK_SET) == 0) {
+    char* z = sqlite3_malloc64((sqlite3_uint64)size + 1);
+    if (z == 0) rc = SQLITE_NOMEM;
+    else if (fread(z, 1, (size_t)size, in) != (size_t)size) {
+      sqlite3_free(z);
+      rc = SQLITE_IOERR;
+    }
+    else {
+      pFile->zData = z;
+      pFile->nData = size;
+    }
+  }
+  else rc = SQLITE_IOERR;
+  fclose(in);
+  return rc;
+#endif
+}
+
+void decimalUnmapFile(decimalMappedFile* pFile) {
+#if MAPFILE_USE_MMAP
+  if (pFile->isMapped) munmap((void*)pFile->zData, (size_t)pFile->nData);
+#else
+  sqlite3_free((void*)pFile->zData);
+#endif
+  memset(pFile, 0, sizeof(*pFile));
+}
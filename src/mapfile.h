@@ -0,0 +1,50 @@
+/**
+ * \file      mapfile.h
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     Read-only access to whole files, for the virtual tables that
+ *            read external files.
+ */
+#ifndef sqlite3_decimal_mapfile_h
+#define sqlite3_decimal_mapfile_h
+
+#include "impl_decimal.h"
+
+/**
+ * \brief The content of a file.
+ */
+typedef struct decimalMappedFile {
+  char const* zData;   /**< The content of the file (`0` if empty). */
+  sqlite3_int64 nData; /**< The size of the file, in bytes.        */
+  int isMapped;        /**< Whether zData is memory-mapped.         */
+} decimalMappedFile;
+
+/**
+ * \brief Makes the content of a file available in memory.
+ *
+ * The file is memory-mapped where `mmap()` is available; otherwise, it is
+ * read into a buffer allocated with `sqlite3_malloc64()`.
+ *
+ * \param zFile The path of the file
+ * \param isSequential Whether the file will be read mostly sequentially, in
+ *        which case the operating system is advised to read ahead
+ * \param pFile Receives the content of the file
+ *
+ * \return `SQLITE_OK` on success; `SQLITE_CANTOPEN`, `SQLITE_IOERR`, or
+ *         `SQLITE_NOMEM` otherwise.
+ */
+int decimalMapFile(char const* zFile, int isSequential, decimalMappedFile* pFile);
+
+/**
+ * \brief Releases the content of a file obtained with decimalMapFile().
+ */
+void decimalUnmapFile(decimalMappedFile* pFile);
+
+#endif /* sqlite3_decimal_mapfile_h */
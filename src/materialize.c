@@ -0,0 +1,463 @@
+/**
+ * \file      materialize.c
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     Incrementally maintained decimal aggregates.
+ *
+ * decMaterialize() stores the state of each group of an aggregate query into
+ * a shadow table, `<view>_state`: the number of rows of the group and, for
+ * each aggregated column `c`, the columns `sum_c`, `count_c`, `min_c` and
+ * `max_c` that the aggregates need. Triggers on the source table update the
+ * state of the affected group at each change, and the view `<view>` computes
+ * the aggregates from the states.
+ *
+ * An inserted value is added to the sum and compared with the minimum and
+ * the maximum; a deleted value is subtracted from the sum. Minima and maxima
+ * are kept as encoded decimals, so they are compared as blobs, without
+ * decoding them. Only when a deleted value is the minimum (or the maximum) of
+ * its group is the minimum (or the maximum) computed again, from the rows of
+ * the group. An update is a deletion followed by an insertion.
+ *
+ * The triggers call decimal functions, so the extension must be loaded by
+ * every connection that modifies the source table. Those functions are
+ * registered as innocuous, so the triggers run with `trusted_schema` off, too.
+ */
+#include <string.h>
+#include "impl_decinfinite.h"
+
+/**
+ * \brief Aggregate operations.
+ */
+typedef enum materializeOp {
+  MATERIALIZE_SUM,
+  MATERIALIZE_COUNT,
+  MATERIALIZE_MIN,
+  MATERIALIZE_MAX,
+  MATERIALIZE_AVG
+} materializeOp;
+
+/**
+ * \brief Names of the aggregate operations, in the order of #materializeOp.
+ */
+static char const* const materializeOpName[] = { "sum", "count", "min", "max", "avg" };
+
+/**
+ * \brief An aggregated column, with the states it needs.
+ */
+typedef struct materializeColumn {
+  char* zName;   /**< The name of the column.                   */
+  int hasSum;    /**< Whether `sum_c` is needed (sum, avg).     */
+  int hasCount;  /**< Whether `count_c` is needed (count, avg). */
+  int hasMin;    /**< Whether `min_c` is needed.                */
+  int hasMax;    /**< Whether `max_c` is needed.                */
+} materializeColumn;
+
+/**
+ * \brief An aggregate of the view.
+ */
+typedef struct materializeAggregate {
+  materializeOp op;  /**< The operation.                                     */
+  int iCol;          /**< The index of the column, or `-1` for `count(*)`. */
+} materializeAggregate;
+
+/**
+ * \brief The arguments of decMaterialize().
+ */
+typedef struct materializeSpec {
+  char const* zView;                /**< The name of the view.        */
+  char const* zSource;              /**< The name of the source table. */
+  int nGroup;                       /**< The number of group columns. */
+  char** azGroup;                   /**< The group columns.           */
+  int nCol;                         /**< The number of columns.       */
+  materializeColumn* aCol;          /**< The aggregated columns.      */
+  int nAgg;                         /**< The number of aggregates.    */
+  materializeAggregate* aAgg;       /**< The aggregates.              */
+} materializeSpec;
+
+/**
+ * \brief Returns the next item of a comma-separated list, trimmed.
+ *
+ * \return `1` if an item was found; `0` at the end of the list.
+ */
+static int materializeNextItem(char const** pz, char const** pzItem, int* pnItem) {
+  char const* z = *pz;
+  if (*z == 0) return 0;
+  char const* end = strchr(z, ',');
+  if (end == 0) end = z + strlen(z);
+  *pz = (*end == ',') ? end + 1 : end;
+  while (z < end && (*z == ' ' || *z == '\t' || *z == '\n')) z++;
+  while (end > z && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\n')) end--;
+  *pzItem = z;
+  *pnItem = (int)(end - z);
+  return 1;
+}
+
+/**
+ * \brief Returns the number of items of a comma-separated list.
+ */
+static int materializeCountItems(char const* z) {
+  int n = (*z != 0);
+  for (; *z; z++) n += (*z == ',');
+  return n;
+}
+
+/**
+ * \brief Returns the index of a column, adding it if needed.
+ *
+ * \return The index, or `-1` if memory is exhausted.
+ */
+static int materializeColumnIndex(materializeSpec* spec, char const* zName, int nName) {
+  for (int i = 0; i < spec->nCol; i++) {
+    if ((int)strlen(spec->aCol[i].zName) == nName && sqlite3_strnicmp(spec->aCol[i].zName, zName, nName) == 0)
+      return i;
+  }
+  materializeColumn* col = &spec->aCol[spec->nCol];
+  memset(col, 0, sizeof(*col));
+  col->zName = sqlite3_mprintf("%.*s", nName, zName);
+  if (col->zName == 0) return -1;
+  return spec->nCol++;
+}
+
+/**
+ * \brief Frees the lists of a specification.
+ */
+static void materializeFree(materializeSpec* spec) {
+  for (int i = 0; i < spec->nGroup; i++) sqlite3_free(spec->azGroup[i]);
+  for (int i = 0; i < spec->nCol; i++) sqlite3_free(spec->aCol[i].zName);
+  sqlite3_free(spec->azGroup);
+  sqlite3_free(spec->aCol);
+  sqlite3_free(spec->aAgg);
+}
+
+/**
+ * \brief Parses the group columns and the aggregate specifications.
+ *
+ * \return `SQLITE_OK` on success; an error code otherwise, with the message
+ *         in \a pzErr.
+ */
+static int materializeParse(materializeSpec* spec, char const* zGroups, char const* zAggs, char** pzErr) {
+  char const* zItem;
+  int nItem;
+
+  int const nGroup = materializeCountItems(zGroups);
+  int const nAgg = materializeCountItems(zAggs);
+  if (nAgg == 0) {
+    *pzErr = sqlite3_mprintf("At least one aggregate is required");
+    return SQLITE_ERROR;
+  }
+  spec->azGroup = sqlite3_malloc64(sizeof(char*) * (size_t)(nGroup + 1));
+  spec->aCol = sqlite3_malloc64(sizeof(materializeColumn) * (size_t)nAgg);
+  spec->aAgg = sqlite3_malloc64(sizeof(materializeAggregate) * (size_t)nAgg);
+  if (spec->azGroup == 0 || spec->aCol == 0 || spec->aAgg == 0) return SQLITE_NOMEM;
+
+  while (materializeNextItem(&zGroups, &zItem, &nItem)) {
+    if (nItem == 0) {
+      *pzErr = sqlite3_mprintf("Empty group column");
+      return SQLITE_ERROR;
+    }
+    if ((spec->azGroup[spec->nGroup] = sqlite3_mprintf("%.*s", nItem, zItem)) == 0) return SQLITE_NOMEM;
+    spec->nGroup++;
+  }
+
+  while (materializeNextItem(&zAggs, &zItem, &nItem)) {
+    char const* zOpen = memchr(zItem, '(', (size_t)nItem);
+    materializeAggregate* agg = &spec->aAgg[spec->nAgg];
+    int nOp;
+    int i;
+
+    if (zOpen == 0 || nItem < 3 || zItem[nItem - 1] != ')') goto invalid_spec;
+    for (nOp = (int)(zOpen - zItem); nOp > 0 && zItem[nOp - 1] == ' '; nOp--) {}
+    for (i = 0; i < (int)(sizeof(materializeOpName) / sizeof(materializeOpName[0])); i++) {
+      if ((int)strlen(materializeOpName[i]) == nOp && sqlite3_strnicmp(materializeOpName[i], zItem, nOp) == 0) break;
+    }
+    if (i == (int)(sizeof(materializeOpName) / sizeof(materializeOpName[0]))) goto invalid_spec;
+    agg->op = (materializeOp)i;
+
+    char const* zArg = zOpen + 1;
+    char const* zEnd = zItem + nItem - 1;
+    while (zArg < zEnd && *zArg == ' ') zArg++;
+    while (zEnd > zArg && zEnd[-1] == ' ') zEnd--;
+    if (zArg == zEnd) goto invalid_spec;
+    if (zEnd - zArg == 1 && *zArg == '*') {
+      if (agg->op != MATERIALIZE_COUNT) goto invalid_spec;
+      agg->iCol = -1;
+    }
+    else {
+      if ((agg->iCol = materializeColumnIndex(spec, zArg, (int)(zEnd - zArg))) < 0) return SQLITE_NOMEM;
+      materializeColumn* col = &spec->aCol[agg->iCol];
+      col->hasSum |= (agg->op == MATERIALIZE_SUM || agg->op == MATERIALIZE_AVG);
+      col->hasCount |= (agg->op == MATERIALIZE_COUNT || agg->op == MATERIALIZE_AVG);
+      col->hasMin |= (agg->op == MATERIALIZE_MIN);
+      col->hasMax |= (agg->op == MATERIALIZE_MAX);
+    }
+    spec->nAgg++;
+    continue;
+
+invalid_spec:
+    *pzErr = sqlite3_mprintf("Invalid aggregate specification: %.*s", nItem, zItem);
+    return SQLITE_ERROR;
+  }
+  return SQLITE_OK;
+}
+
+#pragma mark SQL generation
+
+/**
+ * \brief Appends the condition that matches the group of a row.
+ *
+ * \param zLeft The qualifier of the group columns, or `0`
+ * \param zRight The qualifier of the row (`NEW` or `OLD`)
+ */
+static void materializeAppendMatch(sqlite3_str* s, materializeSpec const* spec, char const* zLeft, char const* zRight) {
+  if (spec->nGroup == 0) {
+    sqlite3_str_appendall(s, "1");
+    return;
+  }
+  for (int i = 0; i < spec->nGroup; i++) {
+    if (i > 0) sqlite3_str_appendall(s, " and ");
+    if (zLeft) sqlite3_str_appendf(s, "\"%w\".", zLeft);
+    sqlite3_str_appendf(s, "\"%w\" is %s.\"%w\"", spec->azGroup[i], zRight, spec->azGroup[i]);
+  }
+}
+
+/**
+ * \brief Appends the statements that add the row `NEW` to the states.
+ */
+static void materializeAppendInsert(sqlite3_str* s, materializeSpec const* spec) {
+  sqlite3_str_appendf(s, "insert into \"%w_state\" (", spec->zView);
+  for (int i = 0; i < spec->nGroup; i++) sqlite3_str_appendf(s, "\"%w\", ", spec->azGroup[i]);
+  sqlite3_str_appendall(s, "\"_n\"");
+  for (int j = 0; j < spec->nCol; j++) {
+    if (spec->aCol[j].hasSum) sqlite3_str_appendf(s, ", \"sum_%w\"", spec->aCol[j].zName);
+    if (spec->aCol[j].hasCount) sqlite3_str_appendf(s, ", \"count_%w\"", spec->aCol[j].zName);
+  }
+  sqlite3_str_appendall(s, ") select ");
+  for (int i = 0; i < spec->nGroup; i++) sqlite3_str_appendf(s, "new.\"%w\", ", spec->azGroup[i]);
+  sqlite3_str_appendall(s, "0");
+  for (int j = 0; j < spec->nCol; j++) {
+    if (spec->aCol[j].hasSum) sqlite3_str_appendall(s, ", " SQLITE_DECIMAL_PREFIX "(0)");
+    if (spec->aCol[j].hasCount) sqlite3_str_appendall(s, ", 0");
+  }
+  sqlite3_str_appendf(s, " where not exists (select 1 from \"%w_state\" where ", spec->zView);
+  materializeAppendMatch(s, spec, 0, "new");
+  sqlite3_str_appendall(s, ");\n");
+
+  sqlite3_str_appendf(s, "update \"%w_state\" set \"_n\" = \"_n\" + 1", spec->zView);
+  for (int j = 0; j < spec->nCol; j++) {
+    char const* c = spec->aCol[j].zName;
+    if (spec->aCol[j].hasSum)
+      sqlite3_str_appendf(s, ", \"sum_%w\" = case when new.\"%w\" is null then \"sum_%w\" "
+                          "else " SQLITE_DECIMAL_PREFIX "Add(\"sum_%w\", new.\"%w\") end", c, c, c, c, c);
+    if (spec->aCol[j].hasCount)
+      sqlite3_str_appendf(s, ", \"count_%w\" = \"count_%w\" + (new.\"%w\" is not null)", c, c, c);
+    if (spec->aCol[j].hasMin)
+      sqlite3_str_appendf(s, ", \"min_%w\" = case when new.\"%w\" is not null and (\"min_%w\" is null or "
+                          SQLITE_DECIMAL_PREFIX "(new.\"%w\") < \"min_%w\") then " SQLITE_DECIMAL_PREFIX
+                          "(new.\"%w\") else \"min_%w\" end", c, c, c, c, c, c, c);
+    if (spec->aCol[j].hasMax)
+      sqlite3_str_appendf(s, ", \"max_%w\" = case when new.\"%w\" is not null and (\"max_%w\" is null or "
+                          SQLITE_DECIMAL_PREFIX "(new.\"%w\") > \"max_%w\") then " SQLITE_DECIMAL_PREFIX
+                          "(new.\"%w\") else \"max_%w\" end", c, c, c, c, c, c, c);
+  }
+  sqlite3_str_appendall(s, " where ");
+  materializeAppendMatch(s, spec, 0, "new");
+  sqlite3_str_appendall(s, ";\n");
+}
+
+/**
+ * \brief Appends the statements that remove the row `OLD` from the states.
+ */
+static void materializeAppendDelete(sqlite3_str* s, materializeSpec const* spec) {
+  sqlite3_str_appendf(s, "update \"%w_state\" set \"_n\" = \"_n\" - 1", spec->zView);
+  for (int j = 0; j < spec->nCol; j++) {
+    char const* c = spec->aCol[j].zName;
+    if (spec->aCol[j].hasSum)
+      sqlite3_str_appendf(s, ", \"sum_%w\" = case when old.\"%w\" is null then \"sum_%w\" "
+                          "else " SQLITE_DECIMAL_PREFIX "Sub(\"sum_%w\", old.\"%w\") end", c, c, c, c, c);
+    if (spec->aCol[j].hasCount)
+      sqlite3_str_appendf(s, ", \"count_%w\" = \"count_%w\" - (old.\"%w\" is not null)", c, c, c);
+    for (int k = 0; k < 2; k++) {
+      char const* zOp = k ? "max" : "min";
+      if (!(k ? spec->aCol[j].hasMax : spec->aCol[j].hasMin)) continue;
+      sqlite3_str_appendf(s, ", \"%s_%w\" = case when old.\"%w\" is not null and " SQLITE_DECIMAL_PREFIX
+                          "(old.\"%w\") = \"%s_%w\" then (select %s(" SQLITE_DECIMAL_PREFIX "(\"%w\".\"%w\")) "
+                          "from \"%w\" where ", zOp, c, c, c, zOp, c, zOp, spec->zSource, c, spec->zSource);
+      materializeAppendMatch(s, spec, spec->zSource, "old");
+      sqlite3_str_appendf(s, ") else \"%s_%w\" end", zOp, c);
+    }
+  }
+  sqlite3_str_appendall(s, " where ");
+  materializeAppendMatch(s, spec, 0, "old");
+  sqlite3_str_appendall(s, ";\n");
+
+  sqlite3_str_appendf(s, "delete from \"%w_state\" where ", spec->zView);
+  materializeAppendMatch(s, spec, 0, "old");
+  sqlite3_str_appendall(s, " and \"_n\" = 0;\n");
+}
+
+/**
+ * \brief Returns the script that creates the state table, fills it, and
+ *        creates the view and the triggers.
+ */
+static char* materializeScript(materializeSpec const* spec) {
+  sqlite3_str* s = sqlite3_str_new(0);
+  char const* zView = spec->zView;
+  char const* zSrc = spec->zSource;
+
+  // State table
+  sqlite3_str_appendf(s, "create table \"%w_state\" (", zView);
+  for (int i = 0; i < spec->nGroup; i++) sqlite3_str_appendf(s, "\"%w\", ", spec->azGroup[i]);
+  sqlite3_str_appendall(s, "\"_n\" integer not null");
+  for (int j = 0; j < spec->nCol; j++) {
+    char const* c = spec->aCol[j].zName;
+    if (spec->aCol[j].hasSum) sqlite3_str_appendf(s, ", \"sum_%w\" blob", c);
+    if (spec->aCol[j].hasCount) sqlite3_str_appendf(s, ", \"count_%w\" integer", c);
+    if (spec->aCol[j].hasMin) sqlite3_str_appendf(s, ", \"min_%w\" blob", c);
+    if (spec->aCol[j].hasMax) sqlite3_str_appendf(s, ", \"max_%w\" blob", c);
+  }
+  sqlite3_str_appendall(s, ");\n");
+  if (spec->nGroup > 0) {
+    sqlite3_str_appendf(s, "create index \"%w_state_group\" on \"%w_state\" (", zView, zView);
+    for (int i = 0; i < spec->nGroup; i++) sqlite3_str_appendf(s, "%s\"%w\"", i ? ", " : "", spec->azGroup[i]);
+    sqlite3_str_appendall(s, ");\n");
+  }
+
+  // Initial states (a query without groups returns one row even if the table is empty)
+  sqlite3_str_appendf(s, "insert into \"%w_state\" select * from (select ", zView);
+  for (int i = 0; i < spec->nGroup; i++) sqlite3_str_appendf(s, "\"%w\", ", spec->azGroup[i]);
+  sqlite3_str_appendall(s, "count(*) as \"_n\"");
+  for (int j = 0; j < spec->nCol; j++) {
+    char const* c = spec->aCol[j].zName;
+    if (spec->aCol[j].hasSum)
+      sqlite3_str_appendf(s, ", coalesce(" SQLITE_DECIMAL_PREFIX "Sum(\"%w\"), " SQLITE_DECIMAL_PREFIX "(0))", c);
+    if (spec->aCol[j].hasCount) sqlite3_str_appendf(s, ", count(\"%w\")", c);
+    if (spec->aCol[j].hasMin) sqlite3_str_appendf(s, ", min(" SQLITE_DECIMAL_PREFIX "(\"%w\"))", c);
+    if (spec->aCol[j].hasMax) sqlite3_str_appendf(s, ", max(" SQLITE_DECIMAL_PREFIX "(\"%w\"))", c);
+  }
+  sqlite3_str_appendf(s, " from \"%w\"", zSrc);
+  for (int i = 0; i < spec->nGroup; i++) sqlite3_str_appendf(s, "%s\"%w\"", i ? ", " : " group by ", spec->azGroup[i]);
+  sqlite3_str_appendall(s, ") where \"_n\" > 0;\n");
+
+  // View
+  sqlite3_str_appendf(s, "create view \"%w\" as select ", zView);
+  for (int i = 0; i < spec->nGroup; i++) sqlite3_str_appendf(s, "\"%w\", ", spec->azGroup[i]);
+  for (int k = 0; k < spec->nAgg; k++) {
+    materializeAggregate const* agg = &spec->aAgg[k];
+    char const* zOp = materializeOpName[agg->op];
+    if (k > 0) sqlite3_str_appendall(s, ", ");
+    if (agg->iCol < 0) {
+      sqlite3_str_appendall(s, "\"_n\" as \"count\"");
+      continue;
+    }
+    char const* c = spec->aCol[agg->iCol].zName;
+    if (agg->op == MATERIALIZE_AVG)
+      sqlite3_str_appendf(s, "case when \"count_%w\" > 0 then " SQLITE_DECIMAL_PREFIX "Div(\"sum_%w\", "
+                          "\"count_%w\") end as \"avg_%w\"", c, c, c, c);
+    else
+      sqlite3_str_appendf(s, "\"%s_%w\"", zOp, c);
+  }
+  sqlite3_str_appendf(s, " from \"%w_state\";\n", zView);
+
+  // Triggers
+  sqlite3_str_appendf(s, "create trigger \"%w_insert\" after insert on \"%w\" begin\n", zView, zSrc);
+  materializeAppendInsert(s, spec);
+  sqlite3_str_appendall(s, "end;\n");
+  sqlite3_str_appendf(s, "create trigger \"%w_delete\" after delete on \"%w\" begin\n", zView, zSrc);
+  materializeAppendDelete(s, spec);
+  sqlite3_str_appendall(s, "end;\n");
+  if (spec->nGroup + spec->nCol > 0) { // Otherwise, an update changes no state
+    sqlite3_str_appendf(s, "create trigger \"%w_update\" after update of ", zView);
+    for (int i = 0; i < spec->nGroup; i++) sqlite3_str_appendf(s, "%s\"%w\"", i ? ", " : "", spec->azGroup[i]);
+    for (int j = 0; j < spec->nCol; j++)
+      sqlite3_str_appendf(s, "%s\"%w\"", spec->nGroup + j ? ", " : "", spec->aCol[j].zName);
+    sqlite3_str_appendf(s, " on \"%w\" begin\n", zSrc);
+    materializeAppendDelete(s, spec);
+    materializeAppendInsert(s, spec);
+    sqlite3_str_appendall(s, "end;\n");
+  }
+
+  return sqlite3_str_finish(s);
+}
+
+/**
+ * \brief Checks that the group columns and the aggregated columns exist.
+ *
+ * Qualified names are used, because an unknown name in double quotes would
+ * be taken as a string.
+ */
+static int materializeCheckColumns(sqlite3* db, materializeSpec const* spec) {
+  sqlite3_str* s = sqlite3_str_new(db);
+  sqlite3_stmt* pStmt = 0;
+  sqlite3_str_appendall(s, "select 1");
+  for (int i = 0; i < spec->nGroup; i++) sqlite3_str_appendf(s, ", \"%w\".\"%w\"", spec->zSource, spec->azGroup[i]);
+  for (int j = 0; j < spec->nCol; j++) sqlite3_str_appendf(s, ", \"%w\".\"%w\"", spec->zSource, spec->aCol[j].zName);
+  sqlite3_str_appendf(s, " from \"%w\"", spec->zSource);
+  char* zSql = sqlite3_str_finish(s);
+  if (zSql == 0) return SQLITE_NOMEM;
+  int const rc = sqlite3_prepare_v2(db, zSql, -1, &pStmt, 0);
+  sqlite3_finalize(pStmt);
+  sqlite3_free(zSql);
+  return rc;
+}
+
+#pragma mark SQL functions
+
+void decimalMaterialize(sqlite3_context* context, int argc, sqlite3_value** argv) {
+  sqlite3* db = sqlite3_context_db_handle(context);
+  materializeSpec spec;
+  char* zScript = 0;
+  char* zErr = 0;
+  int rc;
+  (void)argc;
+
+  memset(&spec, 0, sizeof(spec));
+  spec.zView = (char const*)sqlite3_value_text(argv[0]);
+  spec.zSource = (char const*)sqlite3_value_text(argv[1]);
+  char const* zGroups = (char const*)sqlite3_value_text(argv[2]);
+  char const* zAggs = (char const*)sqlite3_value_text(argv[3]);
+  if (spec.zView == 0 || spec.zSource == 0 || zGroups == 0 || zAggs == 0) {
+    sqlite3_result_error_nomem(context);
+    return;
+  }
+
+  rc = materializeParse(&spec, zGroups, zAggs, &zErr);
+  if (rc == SQLITE_OK) rc = materializeCheckColumns(db, &spec);
+  if (rc == SQLITE_OK) {
+    zScript = materializeScript(&spec);
+    if (zScript == 0) rc = SQLITE_NOMEM;
+  }
+  if (rc == SQLITE_OK) {
+    rc = sqlite3_exec(db, "savepoint decMaterialize", 0, 0, &zErr);
+    if (rc == SQLITE_OK) {
+      rc = sqlite3_exec(db, zScript, 0, 0, &zErr);
+      if (rc != SQLITE_OK) sqlite3_exec(db, "rollback to decMaterialize", 0, 0, 0);
+      sqlite3_exec(db, "release decMaterialize", 0, 0, 0);
+    }
+  }
+
+  if (rc == SQLITE_OK) {
+    sqlite3_stmt* pStmt = 0;
+    char* zSql = sqlite3_mprintf("select count(*) from \"%w_state\"", spec.zView);
+    rc = sqlite3_prepare_v2(db, zSql, -1, &pStmt, 0);
+    if (rc == SQLITE_OK && sqlite3_step(pStmt) == SQLITE_ROW)
+      sqlite3_result_int64(context, sqlite3_column_int64(pStmt, 0));
+    else
+      sqlite3_result_error(context, sqlite3_errmsg(db), -1);
+    sqlite3_finalize(pStmt);
+    sqlite3_free(zSql);
+  }
+  else if (rc == SQLITE_NOMEM)
+    sqlite3_result_error_nomem(context);
+  else
+    sqlite3_result_error(context, zErr ? zErr : sqlite3_errmsg(db), -1);
+  sqlite3_free(zErr);
+  sqlite3_free(zScript);
+  materializeFree(&spec);
+}
@@ -0,0 +1,381 @@
+/**
+ * \file      memstats.c
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     Accounting of the memory allocated by the extension.
+ *
+ * The allocations made by the decimal functions themselves go through
+ * decimalMalloc() and decimalFree(), which count them, and the bytes they
+ * use, by call site. The counters are global to the process, like SQLite's
+ * own `sqlite3_status()` counters, and they are updated with C11 atomics, so
+ * the cost of the accounting is that of a few atomic additions per
+ * allocation. Without `<stdatomic.h>`, the counters are protected by a mutex.
+ *
+ * The eponymous `decMemStats` virtual table shows one row for each call
+ * site, and sqlite3_decimal_status() returns the totals.
+ */
+#include <string.h>
+#include "impl_decimal.h"
+
+#if HAVE_STDATOMIC_H && !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+#define MEM_HAVE_ATOMICS 1
+#elif HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#if MEM_HAVE_ATOMICS
+/**
+ * \brief A counter, updated atomically.
+ */
+typedef _Atomic(sqlite3_int64) memCounter;
+#else
+/**
+ * \brief A counter, updated under #memMutex.
+ */
+typedef sqlite3_int64 memCounter;
+#endif
+
+/**
+ * \brief What has been allocated at a call site.
+ */
+typedef struct memSite {
+  memCounter nAlloc;   /**< The number of allocations.                  */
+  memCounter nByte;    /**< The total size of the allocations.          */
+  memCounter nFree;    /**< The number of deallocations.                */
+  memCounter nFail;    /**< The number of failed allocations.           */
+  memCounter nUsed;    /**< The size of the outstanding allocations.    */
+  memCounter nPeak;    /**< The maximum of nUsed.                       */
+} memSite;
+
+/**
+ * \brief Names of the call sites, as shown by decMemStats.
+ */
+static char const* const memSiteName[SQLITE_DECIMAL_MEM_NSITE] = {
+  "context", "profile", "parse", "bytes", "bits"
+};
+
+/**
+ * \brief The counters of each call site.
+ */
+static memSite memSites[SQLITE_DECIMAL_MEM_NSITE];
+
+/**
+ * \brief The totals reported by sqlite3_decimal_status().
+ */
+static struct {
+  memCounter nUsed;        /**< The size of the outstanding allocations.    */
+  memCounter nUsedPeak;    /**< The maximum of nUsed.                       */
+  memCounter nCount;       /**< The number of outstanding allocations.      */
+  memCounter nCountPeak;   /**< The maximum of nCount.                      */
+  memCounter nSize;        /**< The size of the most recent request.        */
+  memCounter nSizePeak;    /**< The size of the largest request.            */
+} memTotal;
+
+#if MEM_HAVE_ATOMICS
+
+/**
+ * \brief Returns the value of a counter.
+ */
+static inline sqlite3_int64 memLoad(memCounter* pCounter) {
+  return atomic_load_explicit(pCounter, memory_order_relaxed);
+}
+
+/**
+ * \brief Sets a counter to \a n.
+ */
+static inline void memStore(memCounter* pCounter, sqlite3_int64 n) {
+  atomic_store_explicit(pCounter, n, memory_order_relaxed);
+}
+
+/**
+ * \brief Adds \a n to a counter and returns the new value.
+ */
+static inline sqlite3_int64 memAdd(memCounter* pCounter, sqlite3_int64 n) {
+  return atomic_fetch_add_explicit(pCounter, n, memory_order_relaxed) + n;
+}
+
+/**
+ * \brief Raises a high-water mark to \a n, if it is lower.
+ */
+static inline void memRaise(memCounter* pPeak, sqlite3_int64 n) {
+  sqlite3_int64 peak = memLoad(pPeak);
+  while (n > peak && !atomic_compare_exchange_weak_explicit(pPeak, &peak, n, memory_order_relaxed, memory_order_relaxed))
+    ;
+}
+
+#else
+
+#if HAVE_PTHREAD_H
+/**
+ * \brief Protects the counters.
+ */
+static pthread_mutex_t memMutex = PTHREAD_MUTEX_INITIALIZER;
+#define memLock()   pthread_mutex_lock(&memMutex)
+#define memUnlock() pthread_mutex_unlock(&memMutex)
+#else
+#define memLock()   ((void)0)
+#define memUnlock() ((void)0)
+#endif
+
+static sqlite3_int64 memLoad(memCounter* pCounter) {
+  memLock();
+  sqlite3_int64 const n = *pCounter;
+  memUnlock();
+  return n;
+}
+
+static void memStore(memCounter* pCounter, sqlite3_int64 n) {
+  memLock();
+  *pCounter = n;
+  memUnlock();
+}
+
+static sqlite3_int64 memAdd(memCounter* pCounter, sqlite3_int64 n) {
+  memLock();
+  sqlite3_int64 const result = (*pCounter += n);
+  memUnlock();
+  return result;
+}
+
+static void memRaise(memCounter* pPeak, sqlite3_int64 n) {
+  memLock();
+  if (n > *pPeak) *pPeak = n;
+  memUnlock();
+}
+
+#endif
+
+#pragma mark Allocation
+
+void* decimalMalloc(decimalMemSite site, sqlite3_uint64 n) {
+  memSite* s = &memSites[site];
+  void* p = sqlite3_malloc64(n);
+  memStore(&memTotal.nSize, (sqlite3_int64)n);
+  memRaise(&memTotal.nSizePeak, (sqlite3_int64)n);
+  if (p == 0) {
+    memAdd(&s->nFail, 1);
+    return 0;
+  }
+  sqlite3_int64 const size = (sqlite3_int64)sqlite3_msize(p);
+  memAdd(&s->nAlloc, 1);
+  memAdd(&s->nByte, size);
+  memRaise(&s->nPeak, memAdd(&s->nUsed, size));
+  memRaise(&memTotal.nUsedPeak, memAdd(&memTotal.nUsed, size));
+  memRaise(&memTotal.nCountPeak, memAdd(&memTotal.nCount, 1));
+  return p;
+}
+
+void decimalFree(decimalMemSite site, void* p) {
+  if (p == 0) return;
+  memSite* s = &memSites[site];
+  sqlite3_int64 const size = (sqlite3_int64)sqlite3_msize(p);
+  memAdd(&s->nFree, 1);
+  memAdd(&s->nUsed, -size);
+  memAdd(&memTotal.nUsed, -size);
+  memAdd(&memTotal.nCount, -1);
+  sqlite3_free(p);
+}
+
+int sqlite3_decimal_status(int op, sqlite3_int64* pCurrent, sqlite3_int64* pHighwater, int resetFlag) {
+  memCounter* pCur;
+  memCounter* pPeak;
+
+  switch (op) {
+    case SQLITE_DECIMAL_STATUS_MEMORY_USED:
+      pCur = &memTotal.nUsed;
+      pPeak = &memTotal.nUsedPeak;
+      break;
+    case SQLITE_DECIMAL_STATUS_MALLOC_COUNT:
+      pCur = &memTotal.nCount;
+      pPeak = &memTotal.nCountPeak;
+      break;
+    case SQLITE_DECIMAL_STATUS_MALLOC_SIZE:
+      pCur = &memTotal.nSize;
+      pPeak = &memTotal.nSizePeak;
+      break;
+    default:
+      return SQLITE_MISUSE;
+  }
+  if (pCurrent == 0 || pHighwater == 0) return SQLITE_MISUSE;
+  *pCurrent = memLoad(pCur);
+  *pHighwater = memLoad(pPeak);
+  if (resetFlag) memStore(pPeak, *pCurrent);
+  return SQLITE_OK;
+}
+
+#ifndef SQLITE_OMIT_VIRTUALTABLE
+
+/** \brief Column index of the `site` column of decMemStats. */
+#define MEMSTATS_COLUMN_SITE      0
+/** \brief Column index of the `allocs` column of decMemStats. */
+#define MEMSTATS_COLUMN_ALLOCS    1
+/** \brief Column index of the `bytes` column of decMemStats. */
+#define MEMSTATS_COLUMN_BYTES     2
+/** \brief Column index of the `frees` column of decMemStats. */
+#define MEMSTATS_COLUMN_FREES     3
+/** \brief Column index of the `failures` column of decMemStats. */
+#define MEMSTATS_COLUMN_FAILURES  4
+/** \brief Column index of the `current` column of decMemStats. */
+#define MEMSTATS_COLUMN_CURRENT   5
+/** \brief Column index of the `peak` column of decMemStats. */
+#define MEMSTATS_COLUMN_PEAK      6
+
+/**
+ * \brief SQL definition of the decMemStats virtual table.
+ */
+#define SQLITE_DECIMAL_MEMSTATS_TABLE "create table x(site text, allocs integer, bytes integer, frees integer, " \
+                                      "failures integer, current integer, peak integer)"
+
+typedef struct decimalMemStatsCursor decimalMemStatsCursor;
+
+/**
+ * \brief A cursor over decMemStats.
+ */
+struct decimalMemStatsCursor {
+  sqlite3_vtab_cursor base;  /**< Base class - must be first.  */
+  int iSite;                 /**< The current call site.       */
+};
+
+static int decimalMemStatsConnect(sqlite3* db, void* pAux, int argc, char const* const* argv,
+                                  sqlite3_vtab** ppVtab, char** pzErr) {
+  (void)pAux;
+  (void)argc;
+  (void)argv;
+  (void)pzErr;
+
+  sqlite3_vtab* pVtab;
+  int rc;
+
+  rc = sqlite3_declare_vtab(db, SQLITE_DECIMAL_MEMSTATS_TABLE);
+  if (rc == SQLITE_OK) {
+    pVtab = sqlite3_malloc(sizeof(*pVtab));
+    *ppVtab = pVtab;
+    if (pVtab == 0) return SQLITE_NOMEM;
+    memset(pVtab, 0, sizeof(*pVtab));
+  }
+  return rc;
+}
+
+static int decimalMemStatsDisconnect(sqlite3_vtab* pVtab) {
+  sqlite3_free(pVtab);
+  return SQLITE_OK;
+}
+
+static int decimalMemStatsOpen(sqlite3_vtab* p, sqlite3_vtab_cursor** ppCursor) {
+  (void)p;
+  decimalMemStatsCursor* pCur;
+  pCur = sqlite3_malloc(sizeof(*pCur));
+  if (pCur == 0) return SQLITE_NOMEM;
+  memset(pCur, 0, sizeof(*pCur));
+  *ppCursor = &pCur->base;
+  return SQLITE_OK;
+}
+
+static int decimalMemStatsClose(sqlite3_vtab_cursor* cur) {
+  sqlite3_free(cur);
+  return SQLITE_OK;
+}
+
+static int decimalMemStatsNext(sqlite3_vtab_cursor* cur) {
+  ((decimalMemStatsCursor*)cur)->iSite++;
+  return SQLITE_OK;
+}
+
+static int decimalMemStatsEof(sqlite3_vtab_cursor* cur) {
+  return ((decimalMemStatsCursor*)cur)->iSite >= SQLITE_DECIMAL_MEM_NSITE;
+}
+
+static int decimalMemStatsColumn(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int i) {
+  int const iSite = ((decimalMemStatsCursor*)cur)->iSite;
+  memSite* s = &memSites[iSite];
+
+  switch (i) {
+    case MEMSTATS_COLUMN_SITE:
+      sqlite3_result_text(ctx, memSiteName[iSite], -1, SQLITE_STATIC);
+      break;
+    case MEMSTATS_COLUMN_ALLOCS:
+      sqlite3_result_int64(ctx, memLoad(&s->nAlloc));
+      break;
+    case MEMSTATS_COLUMN_BYTES:
+      sqlite3_result_int64(ctx, memLoad(&s->nByte));
+      break;
+    case MEMSTATS_COLUMN_FREES:
+      sqlite3_result_int64(ctx, memLoad(&s->nFree));
+      break;
+    case MEMSTATS_COLUMN_FAILURES:
+      sqlite3_result_int64(ctx, memLoad(&s->nFail));
+      break;
+    case MEMSTATS_COLUMN_CURRENT:
+      sqlite3_result_int64(ctx, memLoad(&s->nUsed));
+      break;
+    case MEMSTATS_COLUMN_PEAK:
+      sqlite3_result_int64(ctx, memLoad(&s->nPeak));
+      break;
+    default:
+      break;
+  }
+  return SQLITE_OK;
+}
+
+static int decimalMemStatsRowid(sqlite3_vtab_cursor* cur, sqlite_int64* pRowid) {
+  *pRowid = ((decimalMemStatsCursor*)cur)->iSite + 1;
+  return SQLITE_OK;
+}
+
+static int decimalMemStatsFilter(sqlite3_vtab_cursor* cur, int idxNum, char const* idxStr,
+                                 int argc, sqlite3_value** argv) {
+  (void)idxNum;
+  (void)idxStr;
+  (void)argc;
+  (void)argv;
+  ((decimalMemStatsCursor*)cur)->iSite = 0;
+  return SQLITE_OK;
+}
+
+static int decimalMemStatsBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
+  (void)tab;
+  pIdxInfo->estimatedCost = (double)SQLITE_DECIMAL_MEM_NSITE;
+  pIdxInfo->estimatedRows = SQLITE_DECIMAL_MEM_NSITE;
+  return SQLITE_OK;
+}
+
+/**
+ * \brief An eponymous-only virtual table module that shows the memory
+ *        allocated by the extension at each call site.
+ */
+sqlite3_module decimalMemStatsModule = {
+  0,
+  0,
+  decimalMemStatsConnect,
+  decimalMemStatsBestIndex,
+  decimalMemStatsDisconnect,
+  decimalMemStatsDisconnect,
+  decimalMemStatsOpen,
+  decimalMemStatsClose,
+  decimalMemStatsFilter,
+  decimalMemStatsNext,
+  decimalMemStatsEof,
+  decimalMemStatsColumn,
+  decimalMemStatsRowid,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+};
+
+#endif /* SQLITE_OMIT_VIRTUALTABLE */
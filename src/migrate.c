@@ -0,0 +1,380 @@
+/**
+ * \file      migrate.c
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     Online migration of a column to decimal blobs.
+ *
+ * A column is converted in place, in chunks of rows in rowid order, each in
+ * its own short transaction, so that other connections can read and write
+ * between chunks. The rowid of the last converted row is stored in the
+ * progress table #MIGRATE_PROGRESS within the same transaction as the chunk,
+ * so an interrupted migration resumes where it stopped.
+ *
+ * Text, integer and real values are converted with a copy of the caller's
+ * context (real values through their text representation, as SQLite's
+ * `CAST(x AS TEXT)` does) and, if a scale is given, rounded to that scale with
+ * the context's rounding mode. Blobs and `NULL`s are left alone, so
+ * migrating a column twice does no harm. A value that cannot be converted
+ * (or whose conversion raises a trapped condition) is left as it is, and it
+ * is recorded in #MIGRATE_REJECTS.
+ *
+ * Since a function cannot commit the transaction of the statement invoking
+ * it, decMigrate() runs the chunks on its own connection to the database
+ * file, on which the extension is loaded as well (for triggers calling
+ * decimal functions).
+ */
+#include <stdarg.h>
+#include <string.h>
+#include "impl_decinfinite.h"
+#include "decimal.h"
+
+/** \brief The name of the progress table. */
+#define MIGRATE_PROGRESS SQLITE_DECIMAL_PREFIX "MigrateProgress"
+/** \brief The name of the table of rejected values. */
+#define MIGRATE_REJECTS SQLITE_DECIMAL_PREFIX "MigrateRejects"
+/** \brief The default number of rows per chunk. */
+#define MIGRATE_CHUNK_ROWS 10000
+/** \brief How long to wait for other connections, in milliseconds. */
+#define MIGRATE_BUSY_TIMEOUT 5000
+
+/**
+ * \brief A converted value, waiting to be written.
+ */
+typedef struct migrateValue {
+  sqlite3_int64 rowid;            /**< The rowid of the row.     */
+  int n;                          /**< The length of the blob.   */
+  uint8_t blob[DECINF_MAXSIZE];   /**< The encoded decimal.      */
+} migrateValue;
+
+/**
+ * \brief The statements of a migration.
+ */
+typedef struct migrateJob {
+  sqlite3* db;             /**< The connection running the migration.   */
+  decContext decCtx;       /**< The conversion context.                 */
+  int32_t scale;           /**< The scale, or `-1` for none.            */
+  int nChunk;              /**< The number of rows per chunk.           */
+  sqlite3_stmt* pSelect;   /**< Reads a chunk.                          */
+  sqlite3_stmt* pUpdate;   /**< Writes a converted value.               */
+  sqlite3_stmt* pReject;   /**< Records a rejected value.               */
+  sqlite3_stmt* pProgress; /**< Records the progress.                   */
+} migrateJob;
+
+/**
+ * \brief Converts a value.
+ *
+ * \return `NULL` on success; the reason why the value is rejected otherwise.
+ */
+static char const* migrateConvert(migrateJob* job, sqlite3_value* value, decNumber* decnum, char** pzFree) {
+  decContext* decCtx = &job->decCtx;
+  decContextZeroStatus(decCtx);
+  if (sqlite3_value_type(value) == SQLITE_INTEGER)
+    decNumberFromScaledInt64(decnum, sqlite3_value_int64(value), 0);
+  else {
+    char const* z = (char const*)sqlite3_value_text(value); // Reals are converted to text
+    if (z == 0) return "Out of memory";
+    if (decimalNumberFromText(z, (size_t)sqlite3_value_bytes(value), decnum, decCtx) == 0) return "Invalid decimal";
+  }
+  if (job->scale >= 0 && !decNumberIsSpecial(decnum)) {
+    decNumber quantum;
+    decNumberZero(&quantum);
+    quantum.exponent = -job->scale;
+    decNumberQuantize(decnum, decnum, &quantum, decCtx);
+  }
+  if (decimalCheckTraps(decCtx, pzFree) != SQLITE_OK) return *pzFree ? *pzFree : "Decimal error";
+  return 0;
+}
+
+/**
+ * \brief Converts the next chunk, in its own transaction.
+ *
+ * \param pFirst The first rowid of the chunk; receives the first rowid of the
+ *        next chunk
+ * \param pIsDone Set to `1` when the end of the table has been reached
+ * \param aValue A buffer for `job->nChunk` values
+ * \param pnMigrated Incremented by the number of converted values
+ *
+ * \return `SQLITE_OK` on success; an error code otherwise, in which case the
+ *         chunk has been rolled back.
+ */
+static int migrateChunk(migrateJob* job, sqlite3_int64* pFirst, int* pIsDone, migrateValue* aValue,
+                        sqlite3_int64* pnMigrated) {
+  sqlite3_int64 last = *pFirst;
+  int nRow = 0;
+  int nValue = 0;
+  int nReject = 0;
+  int rc = sqlite3_exec(job->db, "begin immediate", 0, 0, 0);
+  if (rc != SQLITE_OK) return rc;
+
+  sqlite3_bind_int64(job->pSelect, 1, *pFirst);
+  sqlite3_bind_int(job->pSelect, 2, job->nChunk);
+  while ((rc = sqlite3_step(job->pSelect)) == SQLITE_ROW) {
+    sqlite3_value* value = sqlite3_column_value(job->pSelect, 1);
+    int const type = sqlite3_value_type(value);
+    last = sqlite3_column_int64(job->pSelect, 0);
+    nRow++;
+    if (type == SQLITE_NULL || type == SQLITE_BLOB) continue;
+
+    decNumber decnum;
+    char* zFree = 0;
+    char const* zReason = migrateConvert(job, value, &decnum, &zFree);
+    if (zReason) {
+      sqlite3_bind_int64(job->pReject, 1, last);
+      sqlite3_bind_value(job->pReject, 2, value);
+      sqlite3_bind_text(job->pReject, 3, zReason, -1, SQLITE_TRANSIENT);
+      rc = sqlite3_step(job->pReject);
+      sqlite3_reset(job->pReject);
+      sqlite3_free(zFree);
+      if (rc != SQLITE_DONE) break;
+      nReject++;
+      continue;
+    }
+    aValue[nValue].rowid = last;
+    aValue[nValue].n = (int)decInfiniteFromNumber(DECINF_MAXSIZE, aValue[nValue].blob, &decnum);
+    nValue++;
+  }
+  sqlite3_reset(job->pSelect);
+  if (rc == SQLITE_DONE) rc = SQLITE_OK;
+
+  for (int i = 0; i < nValue && rc == SQLITE_OK; i++) {
+    sqlite3_bind_blob(job->pUpdate, 1, aValue[i].blob, aValue[i].n, SQLITE_STATIC);
+    sqlite3_bind_int64(job->pUpdate, 2, aValue[i].rowid);
+    rc = sqlite3_step(job->pUpdate);
+    sqlite3_reset(job->pUpdate);
+    if (rc == SQLITE_DONE) rc = SQLITE_OK;
+  }
+
+  int const isDone = nRow < job->nChunk || last == INT64_MAX;
+  if (rc == SQLITE_OK) {
+    if (nRow > 0) sqlite3_bind_int64(job->pProgress, 1, last);
+    else if (*pFirst > INT64_MIN) sqlite3_bind_int64(job->pProgress, 1, *pFirst - 1);
+    else sqlite3_bind_null(job->pProgress, 1);
+    sqlite3_bind_int(job->pProgress, 2, nValue);
+    sqlite3_bind_int(job->pProgress, 3, nReject);
+    sqlite3_bind_int(job->pProgress, 4, isDone);
+    rc = sqlite3_step(job->pProgress);
+    sqlite3_reset(job->pProgress);
+    if (rc == SQLITE_DONE) rc = SQLITE_OK;
+  }
+  if (rc == SQLITE_OK) rc = sqlite3_exec(job->db, "commit", 0, 0, 0);
+  if (rc != SQLITE_OK) {
+    sqlite3_exec(job->db, "rollback", 0, 0, 0);
+    return rc;
+  }
+  *pFirst = isDone ? last : last + 1;
+  *pIsDone = isDone;
+  *pnMigrated += nValue;
+  return SQLITE_OK;
+}
+
+/**
+ * \brief Prepares a statement.
+ */
+static int migratePrepare(sqlite3* db, sqlite3_stmt** ppStmt, char const* zFormat, ...) {
+  va_list ap;
+  va_start(ap, zFormat);
+  char* zSql = sqlite3_vmprintf(zFormat, ap);
+  va_end(ap);
+  int const rc = zSql ? sqlite3_prepare_v2(db, zSql, -1, ppStmt, 0) : SQLITE_NOMEM;
+  sqlite3_free(zSql);
+  return rc;
+}
+
+/**
+ * \brief Migrates a column of a table of the main database of \a db.
+ *
+ * \param db A connection in autocommit mode
+ * \param decCtx The context of the conversions, which is copied
+ * \param zTable The table
+ * \param zColumn The column
+ * \param nChunk The number of rows per chunk
+ * \param scale The scale, or `-1` to keep the values' exponents
+ * \param pnMigrated Receives the number of converted values
+ * \param pzErrMsg Receives an error message allocated with
+ *        `sqlite3_mprintf()` in case of error
+ *
+ * \return `SQLITE_OK` on success, an error code otherwise.
+ */
+static int decimalMigrateColumn(sqlite3* db, decContext* decCtx, char const* zTable, char const* zColumn, int nChunk,
+                                int32_t scale, sqlite3_int64* pnMigrated, char** pzErrMsg) {
+  migrateJob job;
+  migrateValue* aValue = 0;
+  sqlite3_stmt* pStart = 0;
+  sqlite3_int64 first = INT64_MIN;
+  int isDone = 0;
+  int rc;
+
+  memset(&job, 0, sizeof(job));
+  job.db = db;
+  job.scale = scale;
+  job.nChunk = nChunk;
+  decimalContextCopy(&job.decCtx, decCtx);
+  *pnMigrated = 0;
+
+  rc = sqlite3_exec(db,
+                    "create table if not exists " MIGRATE_PROGRESS " (tbl text, col text, last_rowid integer, "
+                    "migrated integer not null default 0, rejected integer not null default 0, "
+                    "done integer not null default 0, primary key (tbl, col));"
+                    "create table if not exists " MIGRATE_REJECTS " (tbl text, col text, row integer, "
+                    "value, reason text)", 0, 0, 0);
+  // The column is qualified, so that it cannot be taken for a string
+  if (rc == SQLITE_OK)
+    rc = migratePrepare(db, &job.pSelect, "select rowid, \"%w\".\"%w\" from \"%w\" where rowid >= ?1 "
+                        "order by rowid limit ?2", zTable, zColumn, zTable);
+  if (rc == SQLITE_OK)
+    rc = migratePrepare(db, &job.pUpdate, "update \"%w\" set \"%w\" = ?1 where rowid = ?2", zTable, zColumn);
+  if (rc == SQLITE_OK)
+    rc = migratePrepare(db, &job.pReject, "insert into " MIGRATE_REJECTS " values (%Q, %Q, ?1, ?2, ?3)",
+                        zTable, zColumn);
+  if (rc == SQLITE_OK)
+    rc = migratePrepare(db, &job.pProgress, "update " MIGRATE_PROGRESS " set last_rowid = ?1, "
+                        "migrated = migrated + ?2, rejected = rejected + ?3, done = ?4 "
+                        "where tbl = %Q and col = %Q", zTable, zColumn);
+
+  // Resume an unfinished migration, or start a new one
+  if (rc == SQLITE_OK)
+    rc = migratePrepare(db, &pStart, "select last_rowid, done from " MIGRATE_PROGRESS " where tbl = %Q and col = %Q",
+                        zTable, zColumn);
+  if (rc == SQLITE_OK) {
+    if (sqlite3_step(pStart) == SQLITE_ROW && !sqlite3_column_int(pStart, 1)) {
+      if (sqlite3_column_type(pStart, 0) != SQLITE_NULL) first = sqlite3_column_int64(pStart, 0) + 1;
+    }
+    else {
+      char* zSql = sqlite3_mprintf("begin immediate;"
+                                   "delete from " MIGRATE_REJECTS " where tbl = %Q and col = %Q;"
+                                   "insert or replace into " MIGRATE_PROGRESS " (tbl, col) values (%Q, %Q);"
+                                   "commit", zTable, zColumn, zTable, zColumn);
+      rc = sqlite3_reset(pStart);
+      if (rc == SQLITE_OK) rc = zSql ? sqlite3_exec(db, zSql, 0, 0, 0) : SQLITE_NOMEM;
+      if (rc != SQLITE_OK && !sqlite3_get_autocommit(db)) sqlite3_exec(db, "rollback", 0, 0, 0);
+      sqlite3_free(zSql);
+    }
+    sqlite3_finalize(pStart);
+  }
+
+  if (rc == SQLITE_OK) {
+    aValue = sqlite3_malloc64(sizeof(migrateValue) * (sqlite3_uint64)nChunk);
+    if (aValue == 0) rc = SQLITE_NOMEM;
+  }
+  while (rc == SQLITE_OK && !isDone)
+    rc = migrateChunk(&job, &first, &isDone, aValue, pnMigrated);
+
+  if (rc != SQLITE_OK && rc != SQLITE_NOMEM) *pzErrMsg = sqlite3_mprintf("%s", sqlite3_errmsg(db));
+  sqlite3_free(aValue);
+  sqlite3_finalize(job.pSelect);
+  sqlite3_finalize(job.pUpdate);
+  sqlite3_finalize(job.pReject);
+  sqlite3_finalize(job.pProgress);
+  return rc;
+}
+
+/**
+ * \brief Checks the arguments of a migration.
+ *
+ * \return `SQLITE_OK` if they are valid; an error code otherwise.
+ */
+static int migrateCheck(sqlite3* db, char const* zTable, char const* zColumn, int nChunk, int scale, char** pzErrMsg) {
+  sqlite3_stmt* pStmt = 0;
+  if (nChunk < 1) {
+    *pzErrMsg = sqlite3_mprintf("The number of rows per chunk must be positive");
+    return SQLITE_ERROR;
+  }
+  if (scale < -1 || scale > DECNUMDIGITS) {
+    *pzErrMsg = sqlite3_mprintf("The scale must be between 0 and %d", DECNUMDIGITS);
+    return SQLITE_ERROR;
+  }
+  int const rc = migratePrepare(db, &pStmt, "select \"%w\".\"%w\" from \"%w\"", zTable, zColumn, zTable);
+  if (rc != SQLITE_OK) *pzErrMsg = sqlite3_mprintf("%s", sqlite3_errmsg(db));
+  sqlite3_finalize(pStmt);
+  return rc;
+}
+
+#pragma mark SQL functions
+
+void decimalMigrate(sqlite3_context* context, int argc, sqlite3_value** argv) {
+  decContext* decCtx = sqlite3_user_data(context);
+  sqlite3* db = sqlite3_context_db_handle(context);
+  char const* zTable = (char const*)sqlite3_value_text(argv[0]);
+  char const* zColumn = (char const*)sqlite3_value_text(argv[1]);
+  int const nChunk = argc > 2 ? sqlite3_value_int(argv[2]) : MIGRATE_CHUNK_ROWS;
+  int const scale = argc > 3 ? sqlite3_value_int(argv[3]) : -1;
+  sqlite3_int64 nMigrated = 0;
+  sqlite3* pdb = 0;
+  char* zErrMsg = 0;
+  int rc;
+
+  if (zTable == 0 || zColumn == 0) {
+    sqlite3_result_error_nomem(context);
+    return;
+  }
+  // The migrating connection would wait for the caller's transaction to end
+  if (!sqlite3_get_autocommit(db)) {
+    zErrMsg = sqlite3_mprintf("Migration cannot run within a transaction");
+    rc = SQLITE_MISUSE;
+  }
+  else
+    rc = migrateCheck(db, zTable, zColumn, nChunk, scale, &zErrMsg);
+  if (rc == SQLITE_OK && argc > 3 && sqlite3_value_type(argv[3]) != SQLITE_INTEGER) {
+    zErrMsg = sqlite3_mprintf("The scale must be between 0 and %d", DECNUMDIGITS);
+    rc = SQLITE_ERROR;
+  }
+  if (rc == SQLITE_OK) {
+    char const* zFile = sqlite3_db_filename(db, "main");
+    if (zFile == 0 || zFile[0] == 0) {
+      zErrMsg = sqlite3_mprintf("Migration requires a database file");
+      rc = SQLITE_ERROR;
+    }
+    else {
+      sqlite3_vfs* pVfs = 0;
+      sqlite3_file_control(db, "main", SQLITE_FCNTL_VFS_POINTER, &pVfs);
+      rc = sqlite3_open_v2(zFile, &pdb, SQLITE_OPEN_READWRITE, pVfs ? pVfs->zName : 0);
+      if (rc == SQLITE_OK) rc = sqlite3_decimal_init(pdb, &zErrMsg, sqlite3_api);
+      if (rc == SQLITE_OK) sqlite3_busy_timeout(pdb, MIGRATE_BUSY_TIMEOUT);
+      if (rc == SQLITE_OK)
+        rc = decimalMigrateColumn(pdb, decCtx, zTable, zColumn, nChunk, scale, &nMigrated, &zErrMsg);
+      else if (zErrMsg == 0)
+        zErrMsg = sqlite3_mprintf("%s", pdb ? sqlite3_errmsg(pdb) : sqlite3_errstr(rc));
+      sqlite3_close(pdb);
+    }
+  }
+  if (rc == SQLITE_OK)
+    sqlite3_result_int64(context, nMigrated);
+  else if (rc == SQLITE_NOMEM)
+    sqlite3_result_error_nomem(context);
+  else
+    sqlite3_result_error(context, zErrMsg ? zErrMsg : sqlite3_errstr(rc), -1);
+  sqlite3_free(zErrMsg);
+}
+
+#pragma mark C interface
+
+int sqlite3_decimal_migrate(sqlite3* db, char const* zTable, char const* zColumn, int nChunk, int nScale,
+                            sqlite3_int64* pnMigrated, char** pzErrMsg) {
+  decContext* decCtx = decimalContextCreate();
+  sqlite3_int64 nMigrated = 0;
+  char* zErrMsg = 0;
+  int rc;
+
+  if (decCtx == 0) return SQLITE_NOMEM;
+  if (nChunk <= 0) nChunk = MIGRATE_CHUNK_ROWS;
+  if (nScale < 0) nScale = -1;
+  if (!sqlite3_get_autocommit(db)) {
+    zErrMsg = sqlite3_mprintf("Migration cannot run within a transaction");
+    rc = SQLITE_MISUSE;
+  }
+  else
+    rc = migrateCheck(db, zTable, zColumn, nChunk, nScale, &zErrMsg);
+  if (rc == SQLITE_OK) rc = decimalMigrateColumn(db, decCtx, zTable, zColumn, nChunk, nScale, &nMigrated, &zErrMsg);
+  if (pnMigrated) *pnMigrated = nMigrated;
+  if (pzErrMsg) *pzErrMsg = zErrMsg;
+  else sqlite3_free(zErrMsg);
+  decimalContextDestroy(decCtx);
+  return rc;
+}
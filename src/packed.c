@@ -0,0 +1,279 @@
+/**
+ * \file      packed.c
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     Conversions between packed decimals and decimals.
+ *
+ * A packed decimal (COBOL's `COMP-3`) of `n` bytes holds `2n - 1` digits,
+ * one per nibble, most significant first, followed by a sign nibble (`C`,
+ * `A`, `E` or `F` for positive numbers, `D` or `B` for negative numbers).
+ * The scale is not stored: a field with scale `s` holds `coeff x 10^-s`.
+ *
+ * The digits are moved between the nibbles and the three-digit units of
+ * a decNumber one at a time, so no string conversion takes place. The units
+ * are then encoded by decInfiniteFromNumber(), or decoded by
+ * decInfiniteToNumber().
+ */
+#include <string.h>
+#include "impl_decinfinite.h"
+#include "decimal.h"
+
+/**
+ * \brief Maximum length of a packed decimal that can hold any decimal.
+ */
+#define PACKED_MAX_LENGTH ((DECNUMDIGITS + 2) / 2)
+
+/**
+ * \brief Meaning of the sign nibble: `1` for positive, `-1` for negative, `0`
+ *        for invalid signs.
+ */
+static const int8_t packedSign[16] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, -1, 1, -1, 1, 1 };
+
+/**
+ * \brief Weight of a digit within a unit.
+ */
+static const Unit packedPower[DECDPUN] = { 1, 10, 100 };
+
+/**
+ * \brief Decodes a packed decimal.
+ *
+ * \param n The length of the packed decimal
+ * \param p The packed decimal
+ * \param scale The scale of the packed decimal
+ * \param decnum The output decimal
+ *
+ * \return \a decnum, or `0` if a nibble is invalid or the number has more
+ *         than #DECNUMDIGITS significant digits.
+ */
+static decNumber* packedToNumber(size_t n, uint8_t const p[n], int32_t scale, decNumber* decnum) {
+  int const sign = packedSign[p[n - 1] & 0x0F];
+  if (sign == 0) return 0;
+
+  decNumberZero(decnum);
+  memset(decnum->lsu, 0, sizeof(Unit) * D2U(DECNUMDIGITS));
+  decnum->exponent = -scale;
+  if (sign < 0) decnum->bits = DECNEG;
+
+  // Digits are numbered from the least significant one. The k-th digit goes
+  // into unit k / 3 with weight 10^(k % 3).
+  size_t k = 0;
+  for (size_t i = n; i-- > 0;) {
+    for (int shift = (i == n - 1) ? 4 : 0; shift <= 4; shift += 4, k++) {
+      unsigned const d = (p[i] >> shift) & 0x0F;
+      if (d > 9) return 0;
+      if (d == 0) continue;
+      if (k >= DECNUMDIGITS) return 0; // Too many significant digits
+      decnum->lsu[k / DECDPUN] += (Unit)(d * packedPower[k % DECDPUN]);
+    }
+  }
+
+  Unit const* up = decnum->lsu + D2U(DECNUMDIGITS) - 1;
+  while (up > decnum->lsu && *up == 0) --up;
+  decnum->digits = DECDPUN * (int32_t)(up - decnum->lsu) + (*up > 99 ? 3 : *up > 9 ? 2 : 1);
+  return decnum;
+}
+
+/**
+ * \brief Encodes the coefficient and the sign of a decimal as a packed
+ *        decimal.
+ *
+ * \param decnum A finite decimal
+ * \param n The length of the packed decimal
+ * \param p The output packed decimal
+ *
+ * \return `1` on success; `0` if the coefficient has more than `2n - 1`
+ *         digits.
+ */
+static int packedFromNumber(decNumber const* decnum, size_t n, uint8_t p[n]) {
+  size_t const digits = (decNumberIsZero(decnum)) ? 0 : (size_t)decnum->digits;
+  if (digits > 2 * n - 1) return 0;
+
+  memset(p, 0, n);
+  p[n - 1] = decNumberIsNegative(decnum) ? 0x0D : 0x0C;
+  size_t k = 0;
+  for (size_t i = n; i-- > 0 && k < digits;) {
+    for (int shift = (i == n - 1) ? 4 : 0; shift <= 4 && k < digits; shift += 4, k++) {
+      unsigned const d = (decnum->lsu[k / DECDPUN] / packedPower[k % DECDPUN]) % 10;
+      p[i] |= (uint8_t)(d << shift);
+    }
+  }
+  return 1;
+}
+
+/**
+ * \brief Rounds a decimal to the given scale.
+ *
+ * \return \a decnum
+ */
+static decNumber* packedRescale(decNumber* decnum, int32_t scale, decContext* decCtx) {
+  decNumber quantum;
+  decNumberZero(&quantum);
+  quantum.exponent = -scale;
+  return decNumberQuantize(decnum, decnum, &quantum, decCtx);
+}
+
+/**
+ * \brief Returns whether a scale is within the range of exponents of a context.
+ */
+static int packedIsValidScale(sqlite3_int64 scale, decContext const* decCtx) {
+  return -scale >= decCtx->emin - decCtx->digits + 1 && -scale <= decCtx->emax;
+}
+
+/**
+ * \brief Initializes the context used by the C interface.
+ *
+ * The context is the default context of a connection, without traps.
+ */
+static decContext* packedInitContext(decContext* decCtx) {
+  decContextDefault(decCtx, DEC_INIT_BASE);
+  decCtx->digits = DECNUMDIGITS;
+  decCtx->traps = 0;
+  return decCtx;
+}
+
+#pragma mark SQL functions
+
+void decimalFromPacked(sqlite3_context* context, sqlite3_value* blob, sqlite3_value* scale) {
+  decContext* decCtx = sqlite3_user_data(context);
+  sqlite3_int64 const s = sqlite3_value_int64(scale);
+  decNumber decnum;
+
+  if (sqlite3_value_type(blob) != SQLITE_BLOB || sqlite3_value_bytes(blob) == 0) {
+    sqlite3_result_error(context, "A packed decimal must be a non-empty blob", -1);
+    return;
+  }
+  if (!packedIsValidScale(s, decCtx)) {
+    sqlite3_result_error(context, "Invalid scale", -1);
+    return;
+  }
+  if (packedToNumber((size_t)sqlite3_value_bytes(blob), sqlite3_value_blob(blob), (int32_t)s, &decnum) == 0) {
+    decContextSetStatus(decCtx, DEC_Conversion_syntax);
+    decNumberZero(&decnum);
+    decnum.bits = DECNAN;
+  }
+  char* zErr = 0;
+  if (decimalCheckTraps(decCtx, &zErr) != SQLITE_OK) {
+    sqlite3_result_error(context, zErr ? zErr : "Decimal error", -1);
+    sqlite3_free(zErr);
+    return;
+  }
+  decNumberToSQLite3Blob(context, &decnum);
+}
+
+void decimalToPacked(sqlite3_context* context, int argc, sqlite3_value** argv) {
+  decContext* decCtx = sqlite3_user_data(context);
+  sqlite3_int64 const n = sqlite3_value_int64(argv[1]);
+  sqlite3_int64 const s = sqlite3_value_int64(argv[2]);
+  uint8_t bytes[PACKED_MAX_LENGTH];
+  decNumber decnum;
+  (void)argc;
+
+  if (n < 1 || n > PACKED_MAX_LENGTH) {
+    char* zErr = sqlite3_mprintf("The length of a packed decimal must be between 1 and %d", PACKED_MAX_LENGTH);
+    sqlite3_result_error(context, zErr ? zErr : "Invalid length", -1);
+    sqlite3_free(zErr);
+    return;
+  }
+  if (!packedIsValidScale(s, decCtx)) {
+    sqlite3_result_error(context, "Invalid scale", -1);
+    return;
+  }
+  if (decNumberFromSQLite3Value(&decnum, argv[0], decCtx) == 0) {
+    sqlite3_result_error(context, "Cannot create decimal from the given type", -1);
+    return;
+  }
+  if (!decNumberIsSpecial(&decnum)) packedRescale(&decnum, (int32_t)s, decCtx);
+
+  char* zErr = 0;
+  if (decimalCheckTraps(decCtx, &zErr) != SQLITE_OK) {
+    sqlite3_result_error(context, zErr ? zErr : "Decimal error", -1);
+    sqlite3_free(zErr);
+    return;
+  }
+  if (decNumberIsSpecial(&decnum)) {
+    sqlite3_result_error(context, "Only finite decimals can be packed", -1);
+    return;
+  }
+  if (!packedFromNumber(&decnum, (size_t)n, bytes)) {
+    zErr = sqlite3_mprintf("The value does not fit in a packed decimal of %lld bytes", n);
+    sqlite3_result_error(context, zErr ? zErr : "The value does not fit", -1);
+    sqlite3_free(zErr);
+    return;
+  }
+  sqlite3_result_blob(context, bytes, (int)n, SQLITE_TRANSIENT);
+}
+
+#pragma mark C interface
+
+int sqlite3_decimal_from_packed(unsigned char const* aPacked, int nLength, int nStride, int nScale, int nField,
+                                unsigned char* aOut, int nOut, int* aOffset, int* pnDone) {
+  decContext decCtx;
+  decNumber decnum;
+  int i = 0;
+  int rc = SQLITE_OK;
+
+  packedInitContext(&decCtx);
+  if (nLength < 1 || nStride < nLength || nField < 0 || nOut < 0 || !packedIsValidScale(nScale, &decCtx))
+    rc = SQLITE_MISUSE;
+  else {
+    aOffset[0] = 0;
+    for (; i < nField; i++) {
+      if (packedToNumber((size_t)nLength, aPacked + (size_t)i * (size_t)nStride, nScale, &decnum) == 0) {
+        rc = SQLITE_MISMATCH;
+        break;
+      }
+      if (nOut - aOffset[i] < DECINF_MAXSIZE) { // Encode into a buffer large enough
+        uint8_t bytes[DECINF_MAXSIZE];
+        size_t const len = decInfiniteFromNumber(DECINF_MAXSIZE, bytes, &decnum);
+        if ((size_t)(nOut - aOffset[i]) < len) {
+          rc = SQLITE_FULL;
+          break;
+        }
+        memcpy(aOut + aOffset[i], bytes, len);
+        aOffset[i + 1] = aOffset[i] + (int)len;
+      }
+      else
+        aOffset[i + 1] = aOffset[i] + (int)decInfiniteFromNumber(DECINF_MAXSIZE, aOut + aOffset[i], &decnum);
+    }
+  }
+  if (pnDone) *pnDone = i;
+  return rc;
+}
+
+int sqlite3_decimal_to_packed(unsigned char const* aIn, int const* aOffset, int nField, int nLength, int nStride,
+                              int nScale, unsigned char* aPacked, int* pnDone) {
+  decContext decCtx;
+  decNumber decnum;
+  int i = 0;
+  int rc = SQLITE_OK;
+
+  packedInitContext(&decCtx);
+  if (nLength < 1 || nLength > PACKED_MAX_LENGTH || nStride < nLength || nField < 0 ||
+      !packedIsValidScale(nScale, &decCtx))
+    rc = SQLITE_MISUSE;
+  else {
+    for (; i < nField; i++) {
+      int const len = aOffset[i + 1] - aOffset[i];
+      if (len <= 0 || len > DECINF_MAXSIZE ||
+          decInfiniteToNumber((size_t)len, aIn + aOffset[i], &decnum) == 0 || decNumberIsSpecial(&decnum)) {
+        rc = SQLITE_MISMATCH;
+        break;
+      }
+      packedRescale(&decnum, nScale, &decCtx);
+      if (decNumberIsSpecial(&decnum) ||
+          !packedFromNumber(&decnum, (size_t)nLength, aPacked + (size_t)i * (size_t)nStride)) {
+        rc = SQLITE_TOOBIG;
+        break;
+      }
+    }
+  }
+  if (pnDone) *pnDone = i;
+  return rc;
+}
@@ -0,0 +1,550 @@
+/**
+ * \file      parallel.c
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     Parallel aggregation of a decimal column.
+ *
+ * The rowid range of the table is split evenly among a number of workers,
+ * each running in its own thread on its own read-only connection to the
+ * database file. A worker consumes its range from the front, one chunk of
+ * #PARALLEL_CHUNK_SIZE rowids at a time; when its range is exhausted, it
+ * steals the back half of the range of another worker, until no work is
+ * left. Sparse or skewed rowids therefore do not leave threads idle.
+ *
+ * Each worker reduces its values into a partial result (a decimal and
+ * a count) with a private copy of the caller's context. Sums, though, are
+ * computed with #DECNUMDIGITS digits, so that the partial sums are exact
+ * unless the values span more than #DECNUMDIGITS digits. The partial results
+ * are merged at the end: sums are added, again with #DECNUMDIGITS digits,
+ * minima and maxima are compared, and the total sum is rounded once, in the
+ * caller's context (the average is the total sum divided by the total
+ * count). So, the result does not depend on how the rows are split, and it
+ * is the one of the corresponding aggregate function unless the latter
+ * rounds an intermediate sum.
+ *
+ * \note Each connection reads from its own snapshot: if another connection
+ *       commits while the workers are starting, some of them may see the
+ *       change and some may not.
+ */
+#include <string.h>
+#include "impl_decinfinite.h"
+#include "decimal.h"
+
+#if HAVE_PTHREAD_H && HAVE_PTHREAD_CREATE
+#include <pthread.h>
+#include <unistd.h>
+/**
+ * \brief Whether parallel aggregation is supported.
+ */
+#define PARALLEL_HAVE_THREADS 1
+#endif
+
+/**
+ * \brief The number of rowids a worker takes at a time.
+ */
+#define PARALLEL_CHUNK_SIZE 16384
+
+/**
+ * \brief The maximum number of worker threads.
+ */
+#define PARALLEL_MAX_THREADS 256
+
+/**
+ * \brief The aggregate operations.
+ */
+typedef enum {
+  PARALLEL_SUM,
+  PARALLEL_AVG,
+  PARALLEL_MIN,
+  PARALLEL_MAX
+} parallelOp;
+
+/**
+ * \brief The (partial) result of an aggregation.
+ */
+typedef struct parallelPartial {
+  decNumber value;     /**< The aggregate of the values seen so far. */
+  sqlite3_int64 count; /**< The number of such values.                */
+} parallelPartial;
+
+#pragma mark Reduction
+
+/**
+ * \brief Combines a decimal into an aggregate, as the aggregate functions do.
+ */
+static void parallelCombine(parallelOp op, decNumber* acc, decNumber const* dn, decContext* decCtx) {
+  switch (op) {
+    case PARALLEL_SUM:
+    case PARALLEL_AVG:
+      decNumberAdd(acc, acc, dn, decCtx);
+      break;
+    case PARALLEL_MIN:
+      decNumberMin(acc, acc, dn, decCtx);
+      break;
+    case PARALLEL_MAX:
+      decNumberMax(acc, acc, dn, decCtx);
+      break;
+  }
+}
+
+/**
+ * \brief Initializes the context that sums are computed with.
+ *
+ * This is \a decCtx with #DECNUMDIGITS digits and a clear status.
+ */
+static void parallelSumContext(decContext* sumCtx, decContext* decCtx) {
+  decimalContextCopy(sumCtx, decCtx);
+  sumCtx->digits = DECNUMDIGITS;
+  decContextZeroStatus(sumCtx);
+}
+
+/**
+ * \brief Merges a partial result into another.
+ *
+ * \param sumCtx The context for sums (see parallelSumContext())
+ */
+static void parallelMerge(parallelOp op, parallelPartial* acc, parallelPartial const* p, decContext* sumCtx) {
+  if (p->count == 0) return;
+  if (acc->count == 0)
+    acc->value = p->value;
+  else
+    parallelCombine(op, &acc->value, &p->value, sumCtx);
+  acc->count += p->count;
+}
+
+/**
+ * \brief Computes the result of an aggregation from the merged partial
+ *        results.
+ *
+ * The total sum is rounded in \a decCtx.
+ */
+static void parallelFinalize(parallelOp op, parallelPartial* acc, decContext* decCtx) {
+  if (op == PARALLEL_SUM && acc->count > 0 && !decNumberIsZero(&acc->value)) // Keep the sign of -0
+    decNumberPlus(&acc->value, &acc->value, decCtx);
+  if (acc->count == 0) {
+    decNumberZero(&acc->value);
+    switch (op) {
+      case PARALLEL_SUM: break;
+      case PARALLEL_AVG: acc->value.bits = DECNAN; break;
+      case PARALLEL_MIN: acc->value.bits = DECNEG | DECINF; break;
+      case PARALLEL_MAX: acc->value.bits = DECINF; break;
+    }
+  }
+  else if (op == PARALLEL_AVG) {
+    char zCount[24];
+    decNumber count;
+    sqlite3_snprintf(sizeof(zCount), zCount, "%lld", acc->count);
+    decNumberFromString(&count, zCount, decCtx);
+    decNumberDivide(&acc->value, &acc->value, &count, decCtx);
+  }
+}
+
+#pragma mark Workers
+
+#if PARALLEL_HAVE_THREADS
+
+typedef struct parallelJob parallelJob;
+
+/**
+ * \brief A worker thread and the range of rowids it still has to aggregate.
+ */
+typedef struct parallelWorker {
+  parallelJob* job;        /**< The job the worker belongs to.                */
+  pthread_t thread;        /**< The thread running the worker.               */
+  pthread_mutex_t mutex;   /**< Protects next, last and hasMore.             */
+  sqlite3_int64 next;      /**< The first rowid left to aggregate.           */
+  sqlite3_int64 last;      /**< The last rowid left to aggregate.            */
+  int hasMore;             /**< Whether [next, last] is still to aggregate.  */
+  decContext decCtx;       /**< The worker's copy of the caller's context.   */
+  decContext sumCtx;       /**< The context for sums.                        */
+  parallelPartial partial; /**< The worker's partial result.                 */
+  int rc;                  /**< The worker's result code.                    */
+  char* zErrMsg;           /**< The worker's error message, if any.          */
+} parallelWorker;
+
+/**
+ * \brief A parallel aggregation.
+ */
+struct parallelJob {
+  char const* zFile;       /**< The database file.                           */
+  char const* zVfs;        /**< The VFS of the caller's connection.          */
+  char const* zSql;        /**< The query that reads a range of rowids.      */
+  parallelOp op;           /**< The aggregate operation.                     */
+  int nWorker;             /**< The number of workers.                       */
+  parallelWorker* aWorker; /**< The workers.                                 */
+  pthread_mutex_t mutex;   /**< Protects isAborted.                          */
+  int isAborted;           /**< Whether a worker has failed.                 */
+};
+
+/**
+ * \brief Takes the next chunk of the worker's own range.
+ *
+ * \return `1` if a chunk has been taken; `0` if the range is exhausted.
+ */
+static int parallelTake(parallelWorker* w, sqlite3_int64* pFirst, sqlite3_int64* pLast) {
+  int found = 0;
+  pthread_mutex_lock(&w->mutex);
+  if (w->hasMore) {
+    *pFirst = w->next;
+    if ((sqlite3_uint64)w->last - (sqlite3_uint64)w->next >= PARALLEL_CHUNK_SIZE) {
+      *pLast = w->next + (PARALLEL_CHUNK_SIZE - 1);
+      w->next = *pLast + 1;
+    }
+    else {
+      *pLast = w->last;
+      w->hasMore = 0;
+    }
+    found = 1;
+  }
+  pthread_mutex_unlock(&w->mutex);
+  return found;
+}
+
+/**
+ * \brief Steals the back half of the range of another worker.
+ *
+ * \return `1` if some work has been stolen; `0` if no work is left.
+ */
+static int parallelSteal(parallelWorker* w) {
+  parallelJob* job = w->job;
+  int self = (int)(w - job->aWorker);
+
+  for (int k = 1; k < job->nWorker; k++) {
+    parallelWorker* victim = &job->aWorker[(self + k) % job->nWorker];
+    sqlite3_int64 first = 0;
+    sqlite3_int64 last = 0;
+    int found = 0;
+
+    pthread_mutex_lock(&victim->mutex);
+    if (victim->hasMore) {
+      sqlite3_uint64 n = (sqlite3_uint64)victim->last - (sqlite3_uint64)victim->next;
+      last = victim->last;
+      if (n == 0) { // A single rowid is left
+        first = victim->next;
+        victim->hasMore = 0;
+      }
+      else {
+        first = (sqlite3_int64)((sqlite3_uint64)victim->next + n / 2 + 1);
+        victim->last = first - 1;
+      }
+      found = 1;
+    }
+    pthread_mutex_unlock(&victim->mutex);
+
+    if (found) {
+      pthread_mutex_lock(&w->mutex);
+      w->next = first;
+      w->last = last;
+      w->hasMore = 1;
+      pthread_mutex_unlock(&w->mutex);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static int parallelIsAborted(parallelJob* job) {
+  pthread_mutex_lock(&job->mutex);
+  int isAborted = job->isAborted;
+  pthread_mutex_unlock(&job->mutex);
+  return isAborted;
+}
+
+static void parallelAbort(parallelJob* job) {
+  pthread_mutex_lock(&job->mutex);
+  job->isAborted = 1;
+  pthread_mutex_unlock(&job->mutex);
+}
+
+/**
+ * \brief Aggregates the values in a range of rowids into the worker's
+ *        partial result.
+ */
+static int parallelAggregateRange(parallelWorker* w, sqlite3_stmt* pStmt, sqlite3_int64 first, sqlite3_int64 last) {
+  parallelPartial* p = &w->partial;
+  decContext* decCtx = &w->decCtx;
+  parallelOp const op = w->job->op;
+  int rc;
+
+  sqlite3_bind_int64(pStmt, 1, first);
+  sqlite3_bind_int64(pStmt, 2, last);
+  while ((rc = sqlite3_step(pStmt)) == SQLITE_ROW) {
+    sqlite3_value* value = sqlite3_column_value(pStmt, 0);
+    decNumber dn;
+
+    if (sqlite3_value_type(value) == SQLITE_NULL) continue;
+    if (decNumberFromSQLite3Value(&dn, value, decCtx) == 0) {
+      w->zErrMsg = sqlite3_mprintf("Cannot create decimal from the given type");
+      rc = SQLITE_ERROR;
+      break;
+    }
+    if (decimalCheckTraps(decCtx, &w->zErrMsg) != SQLITE_OK) {
+      rc = SQLITE_ERROR;
+      break;
+    }
+    if (p->count == 0)
+      p->value = dn;
+    else
+      parallelCombine(op, &p->value, &dn, (op == PARALLEL_SUM || op == PARALLEL_AVG) ? &w->sumCtx : decCtx);
+    if (decimalCheckTraps(&w->sumCtx, &w->zErrMsg) != SQLITE_OK) {
+      rc = SQLITE_ERROR;
+      break;
+    }
+    p->count++;
+  }
+  sqlite3_reset(pStmt);
+  return rc == SQLITE_DONE ? SQLITE_OK : rc;
+}
+
+/**
+ * \brief The body of a worker thread.
+ */
+static void* parallelWorkerMain(void* arg) {
+  parallelWorker* w = arg;
+  parallelJob* job = w->job;
+  sqlite3* db = 0;
+  sqlite3_stmt* pStmt = 0;
+  sqlite3_int64 first;
+  sqlite3_int64 last;
+  int rc;
+
+  rc = sqlite3_open_v2(job->zFile, &db, SQLITE_OPEN_READONLY, job->zVfs);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_prepare_v2(db, job->zSql, -1, &pStmt, 0);
+
+  while (rc == SQLITE_OK && !parallelIsAborted(job)
+         && (parallelTake(w, &first, &last) || (parallelSteal(w) && parallelTake(w, &first, &last))))
+    rc = parallelAggregateRange(w, pStmt, first, last);
+
+  if (rc != SQLITE_OK) {
+    if (w->zErrMsg == 0)
+      w->zErrMsg = sqlite3_mprintf("%s", db ? sqlite3_errmsg(db) : sqlite3_errstr(rc));
+    parallelAbort(job);
+  }
+  sqlite3_finalize(pStmt);
+  sqlite3_close(db);
+  w->rc = rc;
+  return 0;
+}
+
+/**
+ * \brief Runs the workers of a job and merges their partial results.
+ */
+static int parallelRun(parallelJob* job, sqlite3_int64 minRowid, sqlite3_int64 maxRowid, decContext* decCtx,
+                       parallelPartial* result, char** pzErrMsg) {
+  sqlite3_uint64 span = (sqlite3_uint64)maxRowid - (sqlite3_uint64)minRowid;
+  sqlite3_uint64 step;
+  int nStarted = 0;
+  int rc = SQLITE_OK;
+
+  if (span < (sqlite3_uint64)job->nWorker) job->nWorker = (int)span + 1;
+  step = span / (sqlite3_uint64)job->nWorker;
+
+  job->aWorker = sqlite3_malloc64(sizeof(parallelWorker) * (sqlite3_uint64)job->nWorker);
+  if (job->aWorker == 0) return SQLITE_NOMEM;
+  memset(job->aWorker, 0, sizeof(parallelWorker) * (size_t)job->nWorker);
+  pthread_mutex_init(&job->mutex, 0);
+
+  for (int i = 0; i < job->nWorker; i++) {
+    parallelWorker* w = &job->aWorker[i];
+    w->job = job;
+    pthread_mutex_init(&w->mutex, 0);
+    w->next = (sqlite3_int64)((sqlite3_uint64)minRowid + step * (sqlite3_uint64)i);
+    w->last = (i == job->nWorker - 1) ? maxRowid : (sqlite3_int64)((sqlite3_uint64)w->next + step - 1);
+    w->hasMore = 1;
+    decimalContextCopy(&w->decCtx, decCtx);
+    decContextZeroStatus(&w->decCtx);
+    parallelSumContext(&w->sumCtx, decCtx);
+  }
+
+  // A single-threaded SQLite cannot be used by other threads
+  for (; nStarted < job->nWorker && sqlite3_threadsafe() != 0; nStarted++) {
+    if (pthread_create(&job->aWorker[nStarted].thread, 0, parallelWorkerMain, &job->aWorker[nStarted]) != 0)
+      break;
+  }
+  if (nStarted == 0) { // Run in the current thread
+    parallelWorkerMain(&job->aWorker[0]);
+  }
+  for (int i = 0; i < nStarted; i++)
+    pthread_join(job->aWorker[i].thread, 0);
+
+  decContext sumCtx;
+  parallelSumContext(&sumCtx, decCtx);
+  for (int i = 0; i < job->nWorker; i++) {
+    parallelWorker* w = &job->aWorker[i];
+    if (rc == SQLITE_OK && w->rc != SQLITE_OK) {
+      rc = w->rc;
+      *pzErrMsg = w->zErrMsg;
+      w->zErrMsg = 0;
+    }
+    if (rc == SQLITE_OK) {
+      parallelMerge(job->op, result, &w->partial, &sumCtx);
+      decContextSetStatusQuiet(decCtx, decContextGetStatus(&w->decCtx) | decContextGetStatus(&w->sumCtx));
+    }
+    sqlite3_free(w->zErrMsg);
+    pthread_mutex_destroy(&w->mutex);
+  }
+  decContextSetStatusQuiet(decCtx, decContextGetStatus(&sumCtx));
+  pthread_mutex_destroy(&job->mutex);
+  sqlite3_free(job->aWorker);
+  return rc;
+}
+
+#endif /* PARALLEL_HAVE_THREADS */
+
+#pragma mark Public interface
+
+/**
+ * \brief Aggregates a column of a table of the main database of \a db in
+ *        parallel.
+ *
+ * \param db A database connection on which the extension is loaded
+ * \param decCtx The context for the aggregation; conditions that are set by
+ *        the aggregation are added to its status
+ * \param zTable The table's name
+ * \param zColumn The column's name
+ * \param zOp The aggregate operation (`sum`, `avg`, `min` or `max`)
+ * \param nThread The number of threads, or a non-positive value to use as
+ *        many threads as there are online processors
+ * \param result The result
+ * \param pnCount The number of aggregated values
+ * \param pzErrMsg Receives an error message allocated with
+ *        `sqlite3_mprintf()` in case of error
+ *
+ * \return `SQLITE_OK` on success, an error code otherwise.
+ */
+static int decimalParallelAggregate(sqlite3* db, decContext* decCtx, char const* zTable, char const* zColumn,
+                                    char const* zOp, int nThread, decNumber* result, sqlite3_int64* pnCount,
+                                    char** pzErrMsg) {
+#if PARALLEL_HAVE_THREADS
+  parallelJob job;
+  parallelPartial acc;
+  sqlite3_stmt* pStmt = 0;
+  char* zSql;
+  int rc;
+
+  memset(&job, 0, sizeof(job));
+  memset(&acc, 0, sizeof(acc));
+
+  if (sqlite3_stricmp(zOp, "sum") == 0) job.op = PARALLEL_SUM;
+  else if (sqlite3_stricmp(zOp, "avg") == 0) job.op = PARALLEL_AVG;
+  else if (sqlite3_stricmp(zOp, "min") == 0) job.op = PARALLEL_MIN;
+  else if (sqlite3_stricmp(zOp, "max") == 0) job.op = PARALLEL_MAX;
+  else {
+    *pzErrMsg = sqlite3_mprintf("Unknown aggregate operation: %s", zOp);
+    return SQLITE_ERROR;
+  }
+
+  job.zFile = sqlite3_db_filename(db, "main");
+  if (job.zFile == 0 || job.zFile[0] == 0) {
+    *pzErrMsg = sqlite3_mprintf("Parallel aggregation requires a database file");
+    return SQLITE_ERROR;
+  }
+  sqlite3_vfs* pVfs = 0;
+  sqlite3_file_control(db, "main", SQLITE_FCNTL_VFS_POINTER, &pVfs);
+  job.zVfs = pVfs ? pVfs->zName : 0;
+
+  if (nThread <= 0) nThread = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (nThread <= 0) nThread = 1;
+  if (nThread > PARALLEL_MAX_THREADS) nThread = PARALLEL_MAX_THREADS;
+  if (sqlite3_threadsafe() == 0) nThread = 1; // See parallelRun()
+  job.nWorker = nThread;
+
+  // Find the range of rowids
+  zSql = sqlite3_mprintf("select min(rowid), max(rowid) from \"%w\"", zTable);
+  if (zSql == 0) return SQLITE_NOMEM;
+  rc = sqlite3_prepare_v2(db, zSql, -1, &pStmt, 0);
+  sqlite3_free(zSql);
+  if (rc == SQLITE_OK && (rc = sqlite3_step(pStmt)) == SQLITE_ROW) {
+    rc = SQLITE_OK;
+    if (sqlite3_column_type(pStmt, 0) != SQLITE_NULL) {
+      sqlite3_int64 minRowid = sqlite3_column_int64(pStmt, 0);
+      sqlite3_int64 maxRowid = sqlite3_column_int64(pStmt, 1);
+      // The column is qualified, so that it cannot be taken for a string
+      zSql = sqlite3_mprintf("select \"%w\".\"%w\" from \"%w\" where rowid between ?1 and ?2",
+                             zTable, zColumn, zTable);
+      if (zSql == 0) rc = SQLITE_NOMEM;
+      else {
+        // Check the query on the caller's connection, for a better error message
+        sqlite3_stmt* pCheck = 0;
+        rc = sqlite3_prepare_v2(db, zSql, -1, &pCheck, 0);
+        sqlite3_finalize(pCheck);
+        if (rc == SQLITE_OK) {
+          job.zSql = zSql;
+          rc = parallelRun(&job, minRowid, maxRowid, decCtx, &acc, pzErrMsg);
+        }
+        sqlite3_free(zSql);
+      }
+    }
+  }
+  if (rc != SQLITE_OK && *pzErrMsg == 0)
+    *pzErrMsg = sqlite3_mprintf("%s", sqlite3_errmsg(db));
+  sqlite3_finalize(pStmt);
+  if (rc != SQLITE_OK) return rc;
+
+  parallelFinalize(job.op, &acc, decCtx);
+  *result = acc.value;
+  *pnCount = acc.count;
+  return decimalCheckTraps(decCtx, pzErrMsg);
+#else
+  (void)db;
+  (void)decCtx;
+  (void)zTable;
+  (void)zColumn;
+  (void)zOp;
+  (void)nThread;
+  (void)result;
+  (void)pnCount;
+  *pzErrMsg = sqlite3_mprintf("Parallel aggregation is not supported on this platform");
+  return SQLITE_ERROR;
+#endif
+}
+
+void decimalParallelAgg(sqlite3_context* context, int argc, sqlite3_value** argv) {
+  decContext* decCtx = sqlite3_user_data(context);
+  decNumber result;
+  sqlite3_int64 count;
+  char* zErrMsg = 0;
+  int nThread = argc > 3 ? sqlite3_value_int(argv[3]) : 0;
+
+  int rc = decimalParallelAggregate(sqlite3_context_db_handle(context), decCtx,
+                                    (char const*)sqlite3_value_text(argv[0]),
+                                    (char const*)sqlite3_value_text(argv[1]),
+                                    (char const*)sqlite3_value_text(argv[2]),
+                                    nThread, &result, &count, &zErrMsg);
+  if (rc == SQLITE_OK)
+    decNumberToSQLite3Blob(context, &result);
+  else if (rc == SQLITE_NOMEM)
+    sqlite3_result_error_nomem(context);
+  else
+    sqlite3_result_error(context, zErrMsg ? zErrMsg : sqlite3_errstr(rc), -1);
+  sqlite3_free(zErrMsg);
+}
+
+int sqlite3_decimal_parallel_aggregate(sqlite3* db, char const* zTable, char const* zColumn, char const* zOp,
+                                       int nThread, char** pzResult, sqlite3_int64* pnCount, char** pzErrMsg) {
+  decContext* decCtx = decimalContextCreate();
+  decNumber result;
+  char* zErrMsg = 0;
+  int rc;
+
+  if (decCtx == 0) return SQLITE_NOMEM;
+  rc = decimalParallelAggregate(db, decCtx, zTable, zColumn, zOp, nThread, &result, pnCount, &zErrMsg);
+  if (rc == SQLITE_OK) {
+    char zResult[DECNUMDIGITS + 14];
+    decNumberToString(&result, zResult);
+    *pzResult = sqlite3_mprintf("%s", zResult);
+    if (*pzResult == 0) rc = SQLITE_NOMEM;
+  }
+  if (pzErrMsg) *pzErrMsg = zErrMsg;
+  else sqlite3_free(zErrMsg);
+  decimalContextDestroy(decCtx);
+  return rc;
+}
@@ -0,0 +1,65 @@
+/**
+ * \file      probes.h
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     Static tracepoints (USDT probes).
+ *
+ * When `<sys/sdt.h>` is available (it is provided by SystemTap's SDT
+ * headers, e.g., the `systemtap-sdt-dev` package), the extension is built
+ * with the following probes, under the `sqlite3decimal` provider:
+ *
+ * - `decode(len, digits)`: an encoded decimal of `len` bytes has been
+ *   decoded into a number with `digits` digits (`len` is 0 if the blob is
+ *   not a valid encoding);
+ * - `encode(len, digits)`: a number with `digits` digits has been encoded
+ *   into `len` bytes;
+ * - `trap(status, message)`: an operation has failed because of the trapped
+ *   conditions in `status`, described by the string `message`;
+ * - `aggregate__final(name, count, digits)`: the aggregate function `name`
+ *   (a string, e.g. `"decSum"`) has finished over `count` non-null values
+ *   with a result of `digits` digits.
+ *
+ * A probe compiles to a single `nop` and a note in the ELF file, so it costs
+ * nothing measurable until a tracer attaches to it. For example:
+ *
+ *     bpftrace -e 'usdt:./libsqlite3decimal.so:sqlite3decimal:encode { @len = hist(arg0); }'
+ *     perf probe -x ./libsqlite3decimal.so sdt_sqlite3decimal:trap
+ *
+ * Without `<sys/sdt.h>`, or if #SQLITE_DECIMAL_OMIT_PROBES is defined, the
+ * probes expand to nothing.
+ */
+#ifndef sqlite3_decimal_probes_h
+#define sqlite3_decimal_probes_h
+
+#include "autoconfig.h"
+
+#if HAVE_SYS_SDT_H && !defined(SQLITE_DECIMAL_OMIT_PROBES)
+
+#include <sys/sdt.h>
+
+/**
+ * \brief Fires a probe with two arguments.
+ */
+#define SQLITE_DECIMAL_PROBE2(name, a1, a2)     DTRACE_PROBE2(sqlite3decimal, name, a1, a2)
+
+/**
+ * \brief Fires a probe with three arguments.
+ */
+#define SQLITE_DECIMAL_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(sqlite3decimal, name, a1, a2, a3)
+
+#else
+
+// The arguments are not evaluated, only marked as used
+#define SQLITE_DECIMAL_PROBE2(name, a1, a2)     ((void)sizeof(a1), (void)sizeof(a2))
+#define SQLITE_DECIMAL_PROBE3(name, a1, a2, a3) ((void)sizeof(a1), (void)sizeof(a2), (void)sizeof(a3))
+
+#endif
+
+#endif /* sqlite3_decimal_probes_h */
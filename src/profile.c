@@ -0,0 +1,600 @@
+/**
+ * \file      profile.c
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     Profiling of the decimal functions.
+ *
+ * Profiling is off by default. `decProfileStart([interval])` turns it on for
+ * the current connection, `decProfileStop()` turns it off, and
+ * `decProfileReset()` discards what has been collected so far. While it is
+ * on, each call of a decimal function is counted, together with the calls
+ * that fail and those that return `NULL` because of a `NULL` argument.
+ *
+ * One call in \a interval (16 by default) is also timed, and its time is
+ * split into phases: decoding the arguments into decimals, computing, and
+ * encoding the result. The times of each phase are kept in histograms whose
+ * buckets are powers of two of the clock's ticks. Timing uses the processor's
+ * time-stamp counter where available (x86-64) and `clock_gettime()`
+ * elsewhere; ticks are converted into nanoseconds when they are shown, by
+ * comparing the two clocks over the time elapsed since profiling started.
+ *
+ * The eponymous `decProfile` virtual table shows one row for each function
+ * that has been called since the last reset.
+ *
+ * When profiling is off on all connections, the overhead of each call is the
+ * test of a global counter. The decoding and encoding functions find the
+ * call being timed through a thread-local pointer, so they need no access to
+ * the connection.
+ */
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "impl_decimal.h"
+
+#if !(HAVE_STDATOMIC_H && !defined(__STDC_NO_ATOMICS__)) && HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <x86intrin.h>
+/**
+ * \brief Whether the time-stamp counter is used as the clock.
+ */
+#define PROFILE_HAVE_TSC 1
+#endif
+
+#if defined(__GNUC__)
+/**
+ * \brief Storage class of the pointer to the call being profiled.
+ *
+ * The initial-exec model avoids a call to `__tls_get_addr()` at each access
+ * from a shared library.
+ */
+#define PROFILE_THREAD_LOCAL __thread __attribute__((tls_model("initial-exec")))
+#else
+#define PROFILE_THREAD_LOCAL _Thread_local
+#endif
+
+/**
+ * \brief The number of buckets of a histogram.
+ *
+ * Bucket `k` counts the times from `2^k` to `2^(k+1) - 1` ticks (bucket 0
+ * also counts times of zero ticks, and the last bucket longer times).
+ */
+#define PROFILE_NBUCKETS 32
+
+/**
+ * \brief The default sampling interval.
+ */
+#define PROFILE_INTERVAL 16
+
+/**
+ * \brief The phases of a call.
+ */
+typedef enum {
+  PROFILE_DECODE  = SQLITE_DECIMAL_PROFILE_DECODE,  /**< Decoding the arguments. */
+  PROFILE_ENCODE  = SQLITE_DECIMAL_PROFILE_ENCODE,  /**< Encoding the result.    */
+  PROFILE_COMPUTE,                                  /**< Everything else.        */
+  PROFILE_TOTAL,                                    /**< The whole call.         */
+  PROFILE_NPHASES
+} profilePhase;
+
+/**
+ * \brief Names of the phases, as shown in the histograms.
+ */
+static char const* const profilePhaseName[PROFILE_NPHASES] = { "decode", "encode", "compute", "total" };
+
+/**
+ * \brief What has been collected about a function.
+ */
+typedef struct profileEntry {
+  decimalFunc xFunc;                                  /**< The function (0 if never called).  */
+  sqlite3_int64 nCall;                                /**< The number of calls.               */
+  sqlite3_int64 nError;                               /**< The number of failed calls.        */
+  sqlite3_int64 nNull;                                /**< The calls with a `NULL` argument.  */
+  sqlite3_int64 nSample;                              /**< The number of timed calls.         */
+  uint64_t aTicks[PROFILE_NPHASES];                   /**< Total ticks of the timed calls.    */
+  sqlite3_int64 aHist[PROFILE_NPHASES][PROFILE_NBUCKETS]; /**< The histograms of the phases.  */
+} profileEntry;
+
+/**
+ * \brief The profile of a connection.
+ */
+struct decimalProfile {
+  int isEnabled;          /**< Whether profiling is on.                    */
+  int nInterval;          /**< One call in nInterval is timed.             */
+  int nCountdown;         /**< The number of calls until the next timing.  */
+  int nEntry;             /**< The number of profiled functions.           */
+  uint64_t tick0;         /**< The clock's ticks when profiling started.   */
+  uint64_t ns0;           /**< The time (ns) when profiling started.       */
+  profileEntry* aEntry;   /**< Allocated when profiling is first started.  */
+};
+
+/**
+ * \brief A call in progress.
+ */
+typedef struct profileCall {
+  int isTimed;                                  /**< Whether the call is timed.          */
+  int isError;                                  /**< Whether the call has failed.        */
+  uint64_t aTicks[SQLITE_DECIMAL_PROFILE_NCODEC]; /**< Ticks spent decoding and encoding. */
+} profileCall;
+
+#if HAVE_STDATOMIC_H && !defined(__STDC_NO_ATOMICS__)
+_Atomic int decimalProfileActive = 0;
+
+/**
+ * \brief Adds \a n to #decimalProfileActive.
+ */
+static void profileAddActive(int n) {
+  atomic_fetch_add_explicit(&decimalProfileActive, n, memory_order_relaxed);
+}
+#else
+volatile int decimalProfileActive = 0;
+
+#if HAVE_PTHREAD_H
+static pthread_mutex_t profileMutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static void profileAddActive(int n) {
+#if HAVE_PTHREAD_H
+  pthread_mutex_lock(&profileMutex);
+#endif
+  decimalProfileActive += n;
+#if HAVE_PTHREAD_H
+  pthread_mutex_unlock(&profileMutex);
+#endif
+}
+#endif
+
+/**
+ * \brief The call being profiled in the current thread, or `0`.
+ */
+static PROFILE_THREAD_LOCAL profileCall* profileCurrent = 0;
+
+#pragma mark Clock
+
+/**
+ * \brief Returns the value of a monotonic clock, in nanoseconds.
+ */
+static uint64_t profileNanoseconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * \brief Returns the value of the clock used for timing calls.
+ */
+static inline uint64_t profileTicks(void) {
+#if PROFILE_HAVE_TSC
+  return __rdtsc();
+#else
+  return profileNanoseconds();
+#endif
+}
+
+/**
+ * \brief Returns the number of nanoseconds in a tick of the clock.
+ */
+static double profileNsPerTick(decimalProfile const* p) {
+#if PROFILE_HAVE_TSC
+  uint64_t const ticks = profileTicks() - p->tick0;
+  uint64_t const ns = profileNanoseconds() - p->ns0;
+  return ticks > 0 && ns > 0 ? (double)ns / (double)ticks : 1.0;
+#else
+  (void)p;
+  return 1.0;
+#endif
+}
+
+/**
+ * \brief Returns the bucket of the histograms for the given time.
+ */
+static int profileBucket(uint64_t ticks) {
+  int k = 0;
+#if defined(__GNUC__)
+  if (ticks > 1) k = 63 - __builtin_clzll(ticks);
+#else
+  while (ticks > 1) { ticks >>= 1; k++; }
+#endif
+  return k < PROFILE_NBUCKETS ? k : PROFILE_NBUCKETS - 1;
+}
+
+#pragma mark Profiling
+
+decimalProfile* decimalProfileCreate(int nEntry) {
+  decimalProfile* p = decimalMalloc(SQLITE_DECIMAL_MEM_PROFILE, sizeof(*p));
+  if (p) {
+    memset(p, 0, sizeof(*p));
+    p->nEntry = nEntry;
+  }
+  return p;
+}
+
+void decimalProfileDestroy(decimalProfile* p) {
+  if (p == 0) return;
+  if (p->isEnabled) profileAddActive(-1);
+  decimalFree(SQLITE_DECIMAL_MEM_PROFILE, p->aEntry);
+  decimalFree(SQLITE_DECIMAL_MEM_PROFILE, p);
+}
+
+void decimalProfileCall(decimalProfile* p, int id, decimalFunc xFunc, decimalFunc xBody, int nCheck,
+                        sqlite3_context* context, int argc, sqlite3_value** argv) {
+  if (p == 0 || !p->isEnabled) {
+    xBody(context, argc, argv);
+    return;
+  }
+  profileEntry* e = &p->aEntry[id];
+  e->xFunc = xFunc;
+  e->nCall++;
+  if (nCheck < 0 || nCheck > argc) nCheck = argc;
+  for (int i = 0; i < nCheck; i++) {
+    if (sqlite3_value_type(argv[i]) == SQLITE_NULL) {
+      e->nNull++;
+      xBody(context, argc, argv);
+      return;
+    }
+  }
+  profileCall call = { 0, 0, { 0, 0 } };
+  profileCall* outer = profileCurrent; // Functions may be called while executing a function
+  if (--p->nCountdown <= 0) {
+    p->nCountdown = p->nInterval;
+    call.isTimed = 1;
+  }
+  profileCurrent = &call;
+  uint64_t const start = call.isTimed ? profileTicks() : 0;
+  xBody(context, argc, argv);
+  uint64_t const total = call.isTimed ? profileTicks() - start : 0;
+  profileCurrent = outer;
+
+  if (call.isError) e->nError++;
+  if (call.isTimed) {
+    uint64_t aTicks[PROFILE_NPHASES];
+    aTicks[PROFILE_DECODE] = call.aTicks[PROFILE_DECODE];
+    aTicks[PROFILE_ENCODE] = call.aTicks[PROFILE_ENCODE];
+    aTicks[PROFILE_TOTAL] = total;
+    uint64_t const codec = aTicks[PROFILE_DECODE] + aTicks[PROFILE_ENCODE];
+    aTicks[PROFILE_COMPUTE] = total > codec ? total - codec : 0;
+    e->nSample++;
+    for (int i = 0; i < PROFILE_NPHASES; i++) {
+      e->aTicks[i] += aTicks[i];
+      e->aHist[i][profileBucket(aTicks[i])]++;
+    }
+  }
+}
+
+uint64_t decimalProfileCodecBegin(void) {
+  return profileCurrent && profileCurrent->isTimed ? profileTicks() : 0;
+}
+
+void decimalProfileCodecEnd(int phase, uint64_t start) {
+  if (start && profileCurrent) profileCurrent->aTicks[phase] += profileTicks() - start;
+}
+
+void decimalProfileError(void) {
+  if (profileCurrent) profileCurrent->isError = 1;
+}
+
+#pragma mark Functions
+
+void decimalProfileStart(sqlite3_context* context, int argc, sqlite3_value** argv) {
+  decimalProfile* p = decimalContextProfile(sqlite3_user_data(context));
+  sqlite3_int64 nInterval = PROFILE_INTERVAL;
+
+  if (argc > 0) {
+    nInterval = sqlite3_value_int64(argv[0]);
+    if (nInterval <= 0 || nInterval > INT32_MAX) {
+      sqlite3_result_error(context, "The sampling interval must be a positive integer", -1);
+      return;
+    }
+  }
+  if (p->aEntry == 0) {
+    p->aEntry = decimalMalloc(SQLITE_DECIMAL_MEM_PROFILE, sizeof(profileEntry) * (sqlite3_uint64)p->nEntry);
+    if (p->aEntry == 0) {
+      sqlite3_result_error_nomem(context);
+      return;
+    }
+    memset(p->aEntry, 0, sizeof(profileEntry) * (size_t)p->nEntry);
+    p->tick0 = profileTicks();
+    p->ns0 = profileNanoseconds();
+  }
+  p->nInterval = (int)nInterval;
+  p->nCountdown = 1;
+  if (!p->isEnabled) {
+    p->isEnabled = 1;
+    profileAddActive(1);
+  }
+}
+
+void decimalProfileStop(sqlite3_context* context) {
+  decimalProfile* p = decimalContextProfile(sqlite3_user_data(context));
+  if (p->isEnabled) {
+    p->isEnabled = 0;
+    profileAddActive(-1);
+  }
+}
+
+void decimalProfileReset(sqlite3_context* context) {
+  decimalProfile* p = decimalContextProfile(sqlite3_user_data(context));
+  if (p->aEntry) memset(p->aEntry, 0, sizeof(profileEntry) * (size_t)p->nEntry);
+  p->nCountdown = 1;
+}
+
+#ifndef SQLITE_OMIT_VIRTUALTABLE
+
+/** \brief Column index of the `function` column of decProfile. */
+#define PROFILE_COLUMN_FUNCTION   0
+/** \brief Column index of the `calls` column of decProfile. */
+#define PROFILE_COLUMN_CALLS      1
+/** \brief Column index of the `errors` column of decProfile. */
+#define PROFILE_COLUMN_ERRORS     2
+/** \brief Column index of the `nulls` column of decProfile. */
+#define PROFILE_COLUMN_NULLS      3
+/** \brief Column index of the `samples` column of decProfile. */
+#define PROFILE_COLUMN_SAMPLES    4
+/** \brief Column index of the `decode_ns` column of decProfile. */
+#define PROFILE_COLUMN_DECODE_NS  5
+/** \brief Column index of the `compute_ns` column of decProfile. */
+#define PROFILE_COLUMN_COMPUTE_NS 6
+/** \brief Column index of the `encode_ns` column of decProfile. */
+#define PROFILE_COLUMN_ENCODE_NS  7
+/** \brief Column index of the `total_ns` column of decProfile. */
+#define PROFILE_COLUMN_TOTAL_NS   8
+/** \brief Column index of the `p50_ns` column of decProfile. */
+#define PROFILE_COLUMN_P50_NS     9
+/** \brief Column index of the `p99_ns` column of decProfile. */
+#define PROFILE_COLUMN_P99_NS     10
+/** \brief Column index of the `histogram` column of decProfile. */
+#define PROFILE_COLUMN_HISTOGRAM  11
+
+/**
+ * \brief SQL definition of the decProfile virtual table.
+ */
+#define SQLITE_DECIMAL_PROFILE_TABLE "create table x(function text, calls integer, errors integer, nulls integer, " \
+                                     "samples integer, decode_ns real, compute_ns real, encode_ns real, "         \
+                                     "total_ns real, p50_ns real, p99_ns real, histogram text)"
+
+typedef struct decimalProfileVTab decimalProfileVTab;
+
+/**
+ * \brief A decProfile virtual table.
+ */
+struct decimalProfileVTab {
+  sqlite3_vtab base;  /**< Base class - must be first.  */
+  void* decCtx;       /**< The shared decimal context.  */
+};
+
+typedef struct decimalProfileCursor decimalProfileCursor;
+
+/**
+ * \brief A cursor over decProfile.
+ */
+struct decimalProfileCursor {
+  sqlite3_vtab_cursor base;  /**< Base class - must be first.               */
+  decimalProfile* profile;   /**< The profile of the connection.            */
+  int iEntry;                /**< The current entry.                        */
+  double nsPerTick;          /**< Fixed when the cursor is (re)positioned.  */
+};
+
+/**
+ * \brief Moves the cursor to the first called function from the current one.
+ */
+static void profileSkipUncalled(decimalProfileCursor* pCur) {
+  decimalProfile const* p = pCur->profile;
+  if (p->aEntry == 0) pCur->iEntry = p->nEntry;
+  while (pCur->iEntry < p->nEntry && p->aEntry[pCur->iEntry].nCall == 0) pCur->iEntry++;
+}
+
+/**
+ * \brief Returns the upper bound of a bucket, in nanoseconds.
+ */
+static double profileBucketNs(int k, double nsPerTick) {
+  return (double)((uint64_t)1 << (k + 1)) * nsPerTick;
+}
+
+/**
+ * \brief Returns the upper bound (ns) of the bucket containing the given
+ *        quantile of the total times.
+ */
+static double profileQuantileNs(profileEntry const* e, double q, double nsPerTick) {
+  sqlite3_int64 const rank = (sqlite3_int64)(q * (double)e->nSample + 0.5);
+  sqlite3_int64 n = 0;
+  for (int k = 0; k < PROFILE_NBUCKETS; k++) {
+    n += e->aHist[PROFILE_TOTAL][k];
+    if (n >= rank && n > 0) return profileBucketNs(k, nsPerTick);
+  }
+  return profileBucketNs(PROFILE_NBUCKETS - 1, nsPerTick);
+}
+
+/**
+ * \brief Formats the histograms of an entry as a JSON object.
+ *
+ * Each phase is an array of `[upper bound (ns), count]` pairs, one for each
+ * non-empty bucket.
+ *
+ * \return A string to be freed with sqlite3_free(), or `0` if there is not
+ *         enough memory.
+ */
+static char* profileHistogramJson(profileEntry const* e, double nsPerTick) {
+  static int const aOrder[PROFILE_NPHASES] = { PROFILE_DECODE, PROFILE_COMPUTE, PROFILE_ENCODE, PROFILE_TOTAL };
+  sqlite3_str* s = sqlite3_str_new(0);
+  sqlite3_str_appendchar(s, 1, '{');
+  for (int i = 0; i < PROFILE_NPHASES; i++) {
+    int const phase = aOrder[i];
+    sqlite3_str_appendf(s, "%s\"%s\":[", i ? "," : "", profilePhaseName[phase]);
+    int isFirst = 1;
+    for (int k = 0; k < PROFILE_NBUCKETS; k++) {
+      if (e->aHist[phase][k] == 0) continue;
+      sqlite3_str_appendf(s, "%s[%.1f,%lld]", isFirst ? "" : ",", profileBucketNs(k, nsPerTick), e->aHist[phase][k]);
+      isFirst = 0;
+    }
+    sqlite3_str_appendchar(s, 1, ']');
+  }
+  sqlite3_str_appendchar(s, 1, '}');
+  return sqlite3_str_finish(s);
+}
+
+static int decimalProfileConnect(sqlite3* db, void* pAux, int argc, char const* const* argv,
+                                 sqlite3_vtab** ppVtab, char** pzErr) {
+  (void)argc;
+  (void)argv;
+  (void)pzErr;
+
+  decimalProfileVTab* pVtab;
+  int rc;
+
+  rc = sqlite3_declare_vtab(db, SQLITE_DECIMAL_PROFILE_TABLE);
+  if (rc == SQLITE_OK) {
+    pVtab = sqlite3_malloc(sizeof(*pVtab));
+    *ppVtab = (sqlite3_vtab*)pVtab;
+    if (pVtab == 0) return SQLITE_NOMEM;
+    memset(pVtab, 0, sizeof(*pVtab));
+    pVtab->decCtx = pAux;
+  }
+  return rc;
+}
+
+static int decimalProfileDisconnect(sqlite3_vtab* pVtab) {
+  sqlite3_free(pVtab);
+  return SQLITE_OK;
+}
+
+static int decimalProfileOpen(sqlite3_vtab* p, sqlite3_vtab_cursor** ppCursor) {
+  decimalProfileCursor* pCur;
+  pCur = sqlite3_malloc(sizeof(*pCur));
+  if (pCur == 0) return SQLITE_NOMEM;
+  memset(pCur, 0, sizeof(*pCur));
+  pCur->profile = decimalContextProfile(((decimalProfileVTab*)p)->decCtx);
+  *ppCursor = &pCur->base;
+  return SQLITE_OK;
+}
+
+static int decimalProfileClose(sqlite3_vtab_cursor* cur) {
+  sqlite3_free(cur);
+  return SQLITE_OK;
+}
+
+static int decimalProfileNext(sqlite3_vtab_cursor* cur) {
+  decimalProfileCursor* pCur = (decimalProfileCursor*)cur;
+  pCur->iEntry++;
+  profileSkipUncalled(pCur);
+  return SQLITE_OK;
+}
+
+static int decimalProfileEof(sqlite3_vtab_cursor* cur) {
+  decimalProfileCursor* pCur = (decimalProfileCursor*)cur;
+  return pCur->iEntry >= pCur->profile->nEntry;
+}
+
+static int decimalProfileColumn(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int i) {
+  decimalProfileCursor* pCur = (decimalProfileCursor*)cur;
+  profileEntry const* e = &pCur->profile->aEntry[pCur->iEntry];
+  double const nsPerSample = e->nSample > 0 ? pCur->nsPerTick / (double)e->nSample : 0.0;
+
+  switch (i) {
+    case PROFILE_COLUMN_FUNCTION:
+      sqlite3_result_text(ctx, decimalFunctionName(e->xFunc), -1, SQLITE_STATIC);
+      break;
+    case PROFILE_COLUMN_CALLS:
+      sqlite3_result_int64(ctx, e->nCall);
+      break;
+    case PROFILE_COLUMN_ERRORS:
+      sqlite3_result_int64(ctx, e->nError);
+      break;
+    case PROFILE_COLUMN_NULLS:
+      sqlite3_result_int64(ctx, e->nNull);
+      break;
+    case PROFILE_COLUMN_SAMPLES:
+      sqlite3_result_int64(ctx, e->nSample);
+      break;
+    case PROFILE_COLUMN_DECODE_NS:
+    case PROFILE_COLUMN_COMPUTE_NS:
+    case PROFILE_COLUMN_ENCODE_NS:
+    case PROFILE_COLUMN_TOTAL_NS:
+      if (e->nSample > 0) {
+        static int const aPhase[] = { PROFILE_DECODE, PROFILE_COMPUTE, PROFILE_ENCODE, PROFILE_TOTAL };
+        sqlite3_result_double(ctx, (double)e->aTicks[aPhase[i - PROFILE_COLUMN_DECODE_NS]] * nsPerSample);
+      }
+      break;
+    case PROFILE_COLUMN_P50_NS:
+      if (e->nSample > 0) sqlite3_result_double(ctx, profileQuantileNs(e, 0.50, pCur->nsPerTick));
+      break;
+    case PROFILE_COLUMN_P99_NS:
+      if (e->nSample > 0) sqlite3_result_double(ctx, profileQuantileNs(e, 0.99, pCur->nsPerTick));
+      break;
+    case PROFILE_COLUMN_HISTOGRAM: {
+      char* zJson = profileHistogramJson(e, pCur->nsPerTick);
+      if (zJson == 0) return SQLITE_NOMEM;
+      sqlite3_result_text(ctx, zJson, -1, sqlite3_free);
+      break;
+    }
+    default:
+      break;
+  }
+  return SQLITE_OK;
+}
+
+static int decimalProfileRowid(sqlite3_vtab_cursor* cur, sqlite_int64* pRowid) {
+  *pRowid = ((decimalProfileCursor*)cur)->iEntry + 1;
+  return SQLITE_OK;
+}
+
+static int decimalProfileFilter(sqlite3_vtab_cursor* cur, int idxNum, char const* idxStr,
+                                int argc, sqlite3_value** argv) {
+  (void)idxNum;
+  (void)idxStr;
+  (void)argc;
+  (void)argv;
+  decimalProfileCursor* pCur = (decimalProfileCursor*)cur;
+  pCur->iEntry = 0;
+  pCur->nsPerTick = profileNsPerTick(pCur->profile);
+  profileSkipUncalled(pCur);
+  return SQLITE_OK;
+}
+
+static int decimalProfileBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
+  (void)tab;
+  pIdxInfo->estimatedCost = 100.0;
+  pIdxInfo->estimatedRows = 100;
+  return SQLITE_OK;
+}
+
+/**
+ * \brief An eponymous-only virtual table module that shows the profile of
+ *        the decimal functions.
+ */
+sqlite3_module decimalProfileModule = {
+  0,
+  0,
+  decimalProfileConnect,
+  decimalProfileBestIndex,
+  decimalProfileDisconnect,
+  decimalProfileDisconnect,
+  decimalProfileOpen,
+  decimalProfileClose,
+  decimalProfileFilter,
+  decimalProfileNext,
+  decimalProfileEof,
+  decimalProfileColumn,
+  decimalProfileRowid,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+};
+
+#endif /* SQLITE_OMIT_VIRTUALTABLE */
@@ -0,0 +1,399 @@
+/**
+ * \file      random.c
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     Generators of random decimals.
+ *
+ * A random decimal is `c x 10^e`, where the coefficient `c` is an integer
+ * with at most a given number of digits and `e` is drawn from a given range.
+ * Both are uniformly distributed, so the values are uniformly distributed
+ * when the range of exponents is a single value (e.g., amounts with two
+ * decimal places), and approximately log-uniformly distributed otherwise.
+ *
+ * The coefficient is generated one unit (three digits) at a time directly
+ * into a decNumber, which is then encoded: no text conversion and no
+ * decimal arithmetic is involved. The pseudo-random generator is
+ * xoshiro256**, seeded through splitmix64, so a given seed always produces
+ * the same sequence of values.
+ *
+ * \see http://prng.di.unimi.it/
+ */
+#include <string.h>
+#include "impl_decinfinite.h"
+
+/**
+ * \brief Largest absolute value of an exponent accepted by the generators.
+ *
+ * This guarantees that the adjusted exponent of any generated number is
+ * within the range supported by decNumber.
+ */
+#define RANDOM_EXP_MAX (999999999 - DECNUMDIGITS)
+
+/**
+ * \brief State of the xoshiro256** generator.
+ */
+typedef struct randomState {
+  uint64_t s[4];
+} randomState;
+
+/**
+ * \brief Generates the next number in a splitmix64 sequence.
+ */
+static uint64_t splitmix64(uint64_t* x) {
+  uint64_t z = (*x += UINT64_C(0x9E3779B97F4A7C15));
+  z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+  z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+  return z ^ (z >> 31);
+}
+
+/**
+ * \brief Initializes the state of the generator from a seed.
+ */
+static void randomSeed(randomState* state, uint64_t seed) {
+  for (int i = 0; i < 4; i++)
+    state->s[i] = splitmix64(&seed);
+}
+
+static inline uint64_t rotl(uint64_t x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+/**
+ * \brief Returns the next 64-bit output of xoshiro256**.
+ */
+static inline uint64_t randomNext(randomState* state) {
+  uint64_t* s = state->s;
+  uint64_t const result = rotl(s[1] * 5, 7) * 9;
+  uint64_t const t = s[1] << 17;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotl(s[3], 45);
+
+  return result;
+}
+
+/**
+ * \brief Maps 32 random bits to the range `[0, bound)`.
+ */
+#define RANDOM_BELOW(r32, bound) ((uint32_t)(((uint64_t)(uint32_t)(r32) * (bound)) >> 32))
+
+/**
+ * \brief Generates a random decimal.
+ *
+ * \param decnum The output decimal
+ * \param state The state of the generator
+ * \param digits The maximum number of digits of the coefficient
+ * \param expLo The minimum exponent
+ * \param expHi The maximum exponent
+ *
+ * \return \a decnum
+ */
+static decNumber* randomNumber(decNumber* decnum, randomState* state, int digits, int32_t expLo, int32_t expHi) {
+  static uint32_t const pow10[] = { 1, 10, 100, 1000 };
+  int nUnits = D2U(digits);
+  uint32_t msuBound = pow10[digits - DECDPUN * (nUnits - 1)];
+  uint64_t r = 0;
+
+  decNumberZero(decnum);
+  for (int i = 0; i < nUnits; i++) {
+    if (i % 2 == 0) r = randomNext(state); // Two units per output
+    decnum->lsu[i] = (Unit)RANDOM_BELOW(r, i == nUnits - 1 ? msuBound : 1000);
+    r >>= 32;
+  }
+
+  int top = nUnits - 1;
+  while (top > 0 && decnum->lsu[top] == 0) --top;
+  Unit msu = decnum->lsu[top];
+  decnum->digits = DECDPUN * top + (msu > 99 ? 3 : msu > 9 ? 2 : 1);
+
+  decnum->exponent = expLo;
+  if (expHi > expLo)
+    decnum->exponent += (int32_t)RANDOM_BELOW(randomNext(state) >> 32, (uint32_t)(expHi - expLo) + 1);
+
+  return decnum;
+}
+
+/**
+ * \brief Validates the parameters of a generator.
+ *
+ * \return A (static) error message, or `0` if the parameters are valid.
+ */
+static char const* randomCheckParams(sqlite3_int64 digits, sqlite3_int64 expLo, sqlite3_int64 expHi) {
+  if (digits < 1 || digits > DECNUMDIGITS)
+    return "The number of digits is out of range";
+  if (expLo < -RANDOM_EXP_MAX || expHi > RANDOM_EXP_MAX)
+    return "Exponent value out of range";
+  if (expLo > expHi)
+    return "The minimum exponent cannot be greater than the maximum exponent";
+  return 0;
+}
+
+/**
+ * \brief Returns a random 64-bit seed.
+ */
+static uint64_t randomFreshSeed(void) {
+  uint64_t seed;
+  sqlite3_randomness(sizeof(seed), &seed);
+  return seed;
+}
+
+#pragma mark Scalar function
+
+void decimalRandomValue(sqlite3_context* context, int argc, sqlite3_value** argv) {
+  randomState state;
+  decNumber decnum;
+
+  if (argc < 3) {
+    sqlite3_result_error(context, "Wrong number of arguments", -1);
+    return;
+  }
+  sqlite3_int64 digits = sqlite3_value_int64(argv[0]);
+  sqlite3_int64 expLo = sqlite3_value_int64(argv[1]);
+  sqlite3_int64 expHi = sqlite3_value_int64(argv[2]);
+  char const* zErr = randomCheckParams(digits, expLo, expHi);
+  if (zErr) {
+    sqlite3_result_error(context, zErr, -1);
+    return;
+  }
+  randomSeed(&state, argc > 3 ? (uint64_t)sqlite3_value_int64(argv[3]) : randomFreshSeed());
+  randomNumber(&decnum, &state, (int)digits, (int32_t)expLo, (int32_t)expHi);
+  decNumberToSQLite3Blob(context, &decnum);
+}
+
+#pragma mark Virtual table
+
+#ifndef SQLITE_OMIT_VIRTUALTABLE
+
+/** \brief Column index of the `value` column of decRandom. */
+#define RANDOM_COLUMN_VALUE  0
+/** \brief Column index of the (hidden) `n` column of decRandom. */
+#define RANDOM_COLUMN_N      1
+/** \brief Column index of the (hidden) `digits` column of decRandom. */
+#define RANDOM_COLUMN_DIGITS 2
+/** \brief Column index of the (hidden) `exp_lo` column of decRandom. */
+#define RANDOM_COLUMN_EXP_LO 3
+/** \brief Column index of the (hidden) `exp_hi` column of decRandom. */
+#define RANDOM_COLUMN_EXP_HI 4
+/** \brief Column index of the (hidden) `seed` column of decRandom. */
+#define RANDOM_COLUMN_SEED   5
+/** \brief Number of arguments of decRandom. */
+#define RANDOM_NARGS         5
+
+/**
+ * \brief SQL definition of the decRandom virtual table.
+ */
+#define SQLITE_DECIMAL_RANDOM_TABLE                                                           \
+  "create table x(value blob, n hidden, digits hidden, exp_lo hidden, exp_hi hidden, seed hidden)"
+
+typedef struct decimalRandomCursor decimalRandomCursor;
+
+/**
+ * \brief A cursor over decRandom.
+ */
+struct decimalRandomCursor {
+  sqlite3_vtab_cursor base; /**< Base class - must be first.       */
+  randomState state;        /**< State of the generator.           */
+  decNumber value;          /**< The current value.                */
+  sqlite3_int64 row;        /**< Current row number (from 1).      */
+  sqlite3_int64 n;          /**< Number of rows to generate.       */
+  sqlite3_int64 args[RANDOM_NARGS]; /**< Values of the hidden columns. */
+};
+
+static int decimalRandomConnect(sqlite3* db, void* pAux, int argc, char const* const* argv,
+                                sqlite3_vtab** ppVtab, char** pzErr) {
+  (void)pAux;
+  (void)argc;
+  (void)argv;
+  (void)pzErr;
+
+  sqlite3_vtab* pVtab;
+  int rc;
+
+  rc = sqlite3_declare_vtab(db, SQLITE_DECIMAL_RANDOM_TABLE);
+  if (rc == SQLITE_OK) {
+    pVtab = sqlite3_malloc(sizeof(*pVtab));
+    *ppVtab = pVtab;
+    if (pVtab == 0) return SQLITE_NOMEM;
+    memset(pVtab, 0, sizeof(*pVtab));
+  }
+  return rc;
+}
+
+static int decimalRandomDisconnect(sqlite3_vtab* pVtab) {
+  sqlite3_free(pVtab);
+  return SQLITE_OK;
+}
+
+static int decimalRandomOpen(sqlite3_vtab* p, sqlite3_vtab_cursor** ppCursor) {
+  (void)p;
+  decimalRandomCursor* pCur;
+  pCur = sqlite3_malloc(sizeof(*pCur));
+  if (pCur == 0) return SQLITE_NOMEM;
+  memset(pCur, 0, sizeof(*pCur));
+  *ppCursor = &pCur->base;
+  return SQLITE_OK;
+}
+
+static int decimalRandomClose(sqlite3_vtab_cursor* cur) {
+  sqlite3_free(cur);
+  return SQLITE_OK;
+}
+
+static int decimalRandomNext(sqlite3_vtab_cursor* cur) {
+  decimalRandomCursor* pCur = (decimalRandomCursor*)cur;
+  if (++pCur->row <= pCur->n) {
+    randomNumber(&pCur->value, &pCur->state, (int)pCur->args[1],
+                 (int32_t)pCur->args[2], (int32_t)pCur->args[3]);
+  }
+  return SQLITE_OK;
+}
+
+static int decimalRandomEof(sqlite3_vtab_cursor* cur) {
+  decimalRandomCursor* pCur = (decimalRandomCursor*)cur;
+  return pCur->row > pCur->n;
+}
+
+static int decimalRandomColumn(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int i) {
+  decimalRandomCursor* pCur = (decimalRandomCursor*)cur;
+  if (i == RANDOM_COLUMN_VALUE) {
+    uint8_t bytes[DECINF_MAXSIZE];
+    decNumber decnum = pCur->value; // Encoding modifies its input
+    size_t len = decInfiniteFromNumber(DECINF_MAXSIZE, bytes, &decnum);
+    sqlite3_result_blob(ctx, bytes, len, SQLITE_TRANSIENT);
+  }
+  else
+    sqlite3_result_int64(ctx, pCur->args[i - RANDOM_COLUMN_N]);
+  return SQLITE_OK;
+}
+
+static int decimalRandomRowid(sqlite3_vtab_cursor* cur, sqlite_int64* pRowid) {
+  *pRowid = ((decimalRandomCursor*)cur)->row;
+  return SQLITE_OK;
+}
+
+/**
+ * \brief Implementation of the xFilter method for decRandom.
+ *
+ * The bits of \a idxNum tell which of the hidden columns have a value, in
+ * column order.
+ */
+static int decimalRandomFilter(sqlite3_vtab_cursor* cur, int idxNum, char const* idxStr,
+                               int argc, sqlite3_value** argv) {
+  (void)idxStr;
+  (void)argc;
+
+  decimalRandomCursor* pCur = (decimalRandomCursor*)cur;
+  sqlite3_vtab* pVtab = cur->pVtab;
+  sqlite3_int64 defaults[RANDOM_NARGS] = { 0, 9, 0, 0, 0 };
+  int j = 0;
+
+  for (int i = 0; i < RANDOM_NARGS; i++) {
+    if (idxNum & (1 << i)) {
+      if (sqlite3_value_type(argv[j]) == SQLITE_NULL) { pCur->n = 0; pCur->row = 1; return SQLITE_OK; }
+      pCur->args[i] = sqlite3_value_int64(argv[j++]);
+    }
+    else if (i == RANDOM_COLUMN_EXP_HI - RANDOM_COLUMN_N) // Defaults to exp_lo
+      pCur->args[i] = pCur->args[i - 1];
+    else if (i == RANDOM_COLUMN_SEED - RANDOM_COLUMN_N)
+      pCur->args[i] = (sqlite3_int64)randomFreshSeed();
+    else
+      pCur->args[i] = defaults[i];
+  }
+
+  char const* zErr = randomCheckParams(pCur->args[1], pCur->args[2], pCur->args[3]);
+  if (zErr) {
+    pVtab->zErrMsg = sqlite3_mprintf("%s", zErr);
+    return SQLITE_ERROR;
+  }
+
+  randomSeed(&pCur->state, (uint64_t)pCur->args[4]);
+  pCur->n = pCur->args[0];
+  pCur->row = 0;
+  return decimalRandomNext(cur);
+}
+
+/**
+ * \brief Implementation of the xBestIndex method for decRandom.
+ *
+ * The number of rows is mandatory; all the other arguments are optional.
+ */
+static int decimalRandomBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
+  int aIdx[RANDOM_NARGS] = { -1, -1, -1, -1, -1 };
+  int idxNum = 0;
+  int unusable = 0;
+
+  for (int i = 0; i < pIdxInfo->nConstraint; i++) {
+    struct sqlite3_index_constraint const* pCons = &pIdxInfo->aConstraint[i];
+    if (pCons->iColumn < RANDOM_COLUMN_N) continue;
+    if (pCons->op != SQLITE_INDEX_CONSTRAINT_EQ) continue;
+    int k = pCons->iColumn - RANDOM_COLUMN_N;
+    if (!pCons->usable) {
+      unusable |= (1 << k);
+      continue;
+    }
+    aIdx[k] = i;
+    idxNum |= (1 << k);
+  }
+
+  if (unusable & ~idxNum) return SQLITE_CONSTRAINT;
+  if (!(idxNum & 1)) {
+    sqlite3_free(tab->zErrMsg);
+    tab->zErrMsg = sqlite3_mprintf("The number of rows to generate is required");
+    return SQLITE_ERROR;
+  }
+
+  int nArg = 0;
+  for (int k = 0; k < RANDOM_NARGS; k++) {
+    if (aIdx[k] < 0) continue;
+    pIdxInfo->aConstraintUsage[aIdx[k]].argvIndex = ++nArg;
+    pIdxInfo->aConstraintUsage[aIdx[k]].omit = 1;
+  }
+  pIdxInfo->idxNum = idxNum;
+  pIdxInfo->estimatedCost = 1000.0;
+  pIdxInfo->estimatedRows = 1000;
+  return SQLITE_OK;
+}
+
+/**
+ * \brief An eponymous-only virtual table module that implements the
+ *        decRandom() table-valued function.
+ */
+sqlite3_module decimalRandomModule = {
+  0,
+  0,
+  decimalRandomConnect,
+  decimalRandomBestIndex,
+  decimalRandomDisconnect,
+  decimalRandomDisconnect,
+  decimalRandomOpen,
+  decimalRandomClose,
+  decimalRandomFilter,
+  decimalRandomNext,
+  decimalRandomEof,
+  decimalRandomColumn,
+  decimalRandomRowid,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+};
+
+#endif /* SQLITE_OMIT_VIRTUALTABLE */
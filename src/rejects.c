@@ -0,0 +1,349 @@
+/**
+ * \file      rejects.c
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     Lenient conversion into decimals.
+ *
+ * `decTry(x)` is like `dec(x)`, except that it returns `NULL` instead of an
+ * error or a `NaN` when \a x cannot be converted. The context's traps are
+ * disabled during the conversion, so that a failure is only a status bit to
+ * test: no signal is raised, no message is formatted and the context is not
+ * copied. Conditions raised by a failed conversion are cleared from the
+ * status.
+ *
+ * Each connection counts the values rejected by decTry() by reason, and
+ * keeps the most recent rejected value for each reason. The `decRejects`
+ * virtual table shows them; deleting a row resets its counter.
+ */
+#include <string.h>
+#include "impl_decinfinite.h"
+
+/**
+ * \brief Maximum number of bytes kept of a rejected value.
+ */
+#define REJECTS_SAMPLE_SIZE 64
+
+/**
+ * \brief Reasons for rejecting a value.
+ */
+typedef enum {
+  REJECTS_SYNTAX,          /**< A string that is not a number.             */
+  REJECTS_ENCODING,        /**< A blob that is not an encoded decimal.     */
+  REJECTS_TYPE,            /**< A value of a type that is not converted.   */
+  REJECTS_TRAPPED,         /**< The conversion raised a trapped condition. */
+  REJECTS_NREASONS
+} rejectsReason;
+
+/**
+ * \brief Names of the reasons for rejecting a value.
+ */
+static char const* const rejectsReasonName[REJECTS_NREASONS] = {
+  "Conversion syntax",
+  "Invalid encoding",
+  "Unsupported type",
+  "Trapped condition",
+};
+
+/**
+ * \brief The counter and the most recent sample of a reason.
+ */
+typedef struct rejectsCounter {
+  sqlite3_int64 count;                     /**< Number of rejected values.        */
+  int type;                                /**< Type of the sample (0 if none).   */
+  int n;                                   /**< Length of the sample.             */
+  unsigned char sample[REJECTS_SAMPLE_SIZE]; /**< The sample, possibly truncated. */
+} rejectsCounter;
+
+/**
+ * \brief The per-connection state of decTry().
+ */
+typedef struct decimalRejects {
+  decContext* decCtx;                          /**< The shared context.    */
+  rejectsCounter aCounter[REJECTS_NREASONS];   /**< One for each reason.   */
+} decimalRejects;
+
+void* decimalRejectsCreate(void* decCtx) {
+  decimalRejects* p = sqlite3_malloc(sizeof(*p));
+  if (p) {
+    memset(p, 0, sizeof(*p));
+    p->decCtx = decCtx;
+  }
+  return p;
+}
+
+void decimalRejectsDestroy(void* p) {
+  sqlite3_free(p);
+}
+
+void* decimalRejectsContext(void* p) {
+  return ((decimalRejects*)p)->decCtx;
+}
+
+/**
+ * \brief Counts a rejected value and keeps it as the sample of its reason.
+ */
+static void rejectsAdd(decimalRejects* p, rejectsReason reason, sqlite3_value* value) {
+  rejectsCounter* c = &p->aCounter[reason];
+  void const* z;
+  int n;
+
+  c->count++;
+  c->type = sqlite3_value_type(value);
+  if (c->type == SQLITE_BLOB) {
+    z = sqlite3_value_blob(value);
+    n = sqlite3_value_bytes(value);
+  }
+  else {
+    z = sqlite3_value_text(value);
+    n = sqlite3_value_bytes(value);
+    c->type = SQLITE_TEXT;
+  }
+  c->n = (n < REJECTS_SAMPLE_SIZE) ? n : REJECTS_SAMPLE_SIZE;
+  if (c->n > 0) memcpy(c->sample, z, (size_t)c->n);
+}
+
+void decimalTry(sqlite3_context* context, sqlite3_value* value) {
+  decimalRejects* p = sqlite3_user_data(context);
+  decContext* decCtx = p->decCtx;
+  uint32_t const status = decContextGetStatus(decCtx);
+  uint32_t const traps = decCtx->traps;
+  uint8_t bytes[DECINF_MAXSIZE];
+  size_t len = 0;
+  rejectsReason reason = REJECTS_NREASONS;
+  decNumber decnum;
+
+  decCtx->traps = 0; // Failures are detected from the status
+  switch (sqlite3_value_type(value)) {
+    case SQLITE_TEXT:
+      len = decimalEncodeText((char const*)sqlite3_value_text(value), (size_t)sqlite3_value_bytes(value),
+                              DECINF_MAXSIZE, bytes, decCtx);
+      if (len == 0) reason = REJECTS_SYNTAX;
+      break;
+    case SQLITE_INTEGER:
+      len = decInfiniteFromInt64(DECINF_MAXSIZE, bytes, sqlite3_value_int64(value), 0);
+      break;
+    case SQLITE_BLOB:
+      if (sqlite3_value_subtype(value) == 0) { // Encoded decimals are returned as they are
+        uint8_t const* blob = sqlite3_value_blob(value);
+        int const n = sqlite3_value_bytes(value);
+        if (decInfiniteCheck((size_t)n, blob) == DECINF_VALID) {
+          decCtx->traps = traps;
+          sqlite3_result_blob(context, blob, n, SQLITE_TRANSIENT);
+          return;
+        }
+        if (decimalDPDToNumber((size_t)n, blob, &decnum)) // decimal64 and decimal128
+          len = decInfiniteFromNumber(DECINF_MAXSIZE, bytes, &decnum);
+        else
+          reason = REJECTS_ENCODING;
+      }
+      else { // Fixed decimals
+        decContextClearStatus(decCtx, DEC_Conversion_syntax);
+        decNumberFromSQLite3Value(&decnum, value, decCtx);
+        if (decContextTestStatus(decCtx, DEC_Conversion_syntax)) reason = REJECTS_ENCODING;
+        else len = decInfiniteFromNumber(DECINF_MAXSIZE, bytes, &decnum);
+      }
+      break;
+    default:
+      reason = REJECTS_TYPE;
+      break;
+  }
+  decCtx->traps = traps;
+
+  if (reason == REJECTS_NREASONS && (decContextGetStatus(decCtx) & ~status & traps))
+    reason = REJECTS_TRAPPED;
+  if (reason != REJECTS_NREASONS) decContextClearStatus(decCtx, ~status);
+  decContextSetStatusQuiet(decCtx, status); // The conversion may clear Conversion syntax
+  if (reason != REJECTS_NREASONS) {
+    rejectsAdd(p, reason, value);
+    return; // The result is NULL
+  }
+  sqlite3_result_blob(context, bytes, (int)len, SQLITE_TRANSIENT);
+}
+
+#ifndef SQLITE_OMIT_VIRTUALTABLE
+
+/** \brief Column index of the `reason` column of decRejects. */
+#define REJECTS_COLUMN_REASON 0
+/** \brief Column index of the `count` column of decRejects. */
+#define REJECTS_COLUMN_COUNT  1
+/** \brief Column index of the `sample` column of decRejects. */
+#define REJECTS_COLUMN_SAMPLE 2
+
+/**
+ * \brief SQL definition of the decRejects virtual table.
+ */
+#define SQLITE_DECIMAL_REJECTS_TABLE "create table x(reason text, count integer, sample)"
+
+typedef struct decimalRejectsVTab decimalRejectsVTab;
+
+/**
+ * \brief A decRejects virtual table.
+ */
+struct decimalRejectsVTab {
+  sqlite3_vtab base;        /**< Base class - must be first.  */
+  decimalRejects* rejects;  /**< The counters of decTry().    */
+};
+
+typedef struct decimalRejectsCursor decimalRejectsCursor;
+
+/**
+ * \brief A cursor over decRejects.
+ */
+struct decimalRejectsCursor {
+  sqlite3_vtab_cursor base;  /**< Base class - must be first. */
+  int iReason;               /**< The current reason.         */
+};
+
+static int decimalRejectsConnect(sqlite3* db, void* pAux, int argc, char const* const* argv,
+                                 sqlite3_vtab** ppVtab, char** pzErr) {
+  (void)argc;
+  (void)argv;
+  (void)pzErr;
+
+  decimalRejectsVTab* pVtab;
+  int rc;
+
+  rc = sqlite3_declare_vtab(db, SQLITE_DECIMAL_REJECTS_TABLE);
+  if (rc == SQLITE_OK) {
+    pVtab = sqlite3_malloc(sizeof(*pVtab));
+    *ppVtab = (sqlite3_vtab*)pVtab;
+    if (pVtab == 0) return SQLITE_NOMEM;
+    memset(pVtab, 0, sizeof(*pVtab));
+    pVtab->rejects = pAux;
+  }
+  return rc;
+}
+
+static int decimalRejectsDisconnect(sqlite3_vtab* pVtab) {
+  sqlite3_free(pVtab);
+  return SQLITE_OK;
+}
+
+static int decimalRejectsOpen(sqlite3_vtab* p, sqlite3_vtab_cursor** ppCursor) {
+  (void)p;
+  decimalRejectsCursor* pCur;
+  pCur = sqlite3_malloc(sizeof(*pCur));
+  if (pCur == 0) return SQLITE_NOMEM;
+  memset(pCur, 0, sizeof(*pCur));
+  *ppCursor = &pCur->base;
+  return SQLITE_OK;
+}
+
+static int decimalRejectsClose(sqlite3_vtab_cursor* cur) {
+  sqlite3_free(cur);
+  return SQLITE_OK;
+}
+
+static int decimalRejectsNext(sqlite3_vtab_cursor* cur) {
+  ((decimalRejectsCursor*)cur)->iReason++;
+  return SQLITE_OK;
+}
+
+static int decimalRejectsEof(sqlite3_vtab_cursor* cur) {
+  return ((decimalRejectsCursor*)cur)->iReason >= REJECTS_NREASONS;
+}
+
+static int decimalRejectsColumn(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int i) {
+  decimalRejectsCursor* pCur = (decimalRejectsCursor*)cur;
+  decimalRejectsVTab* pVtab = (decimalRejectsVTab*)cur->pVtab;
+  rejectsCounter const* c = &pVtab->rejects->aCounter[pCur->iReason];
+
+  switch (i) {
+    case REJECTS_COLUMN_REASON:
+      sqlite3_result_text(ctx, rejectsReasonName[pCur->iReason], -1, SQLITE_STATIC);
+      break;
+    case REJECTS_COLUMN_COUNT:
+      sqlite3_result_int64(ctx, c->count);
+      break;
+    case REJECTS_COLUMN_SAMPLE:
+      if (c->type == SQLITE_BLOB)
+        sqlite3_result_blob(ctx, c->sample, c->n, SQLITE_TRANSIENT);
+      else if (c->type == SQLITE_TEXT)
+        sqlite3_result_text(ctx, (char const*)c->sample, c->n, SQLITE_TRANSIENT);
+      break;
+    default:
+      break;
+  }
+  return SQLITE_OK;
+}
+
+static int decimalRejectsRowid(sqlite3_vtab_cursor* cur, sqlite_int64* pRowid) {
+  *pRowid = ((decimalRejectsCursor*)cur)->iReason + 1;
+  return SQLITE_OK;
+}
+
+static int decimalRejectsFilter(sqlite3_vtab_cursor* cur, int idxNum, char const* idxStr,
+                                int argc, sqlite3_value** argv) {
+  (void)idxNum;
+  (void)idxStr;
+  (void)argc;
+  (void)argv;
+  ((decimalRejectsCursor*)cur)->iReason = 0;
+  return SQLITE_OK;
+}
+
+static int decimalRejectsBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
+  (void)tab;
+  pIdxInfo->estimatedCost = (double)REJECTS_NREASONS;
+  pIdxInfo->estimatedRows = REJECTS_NREASONS;
+  return SQLITE_OK;
+}
+
+/**
+ * \brief Resets the counter of a reason when its row is deleted.
+ *
+ * Rows cannot be inserted or updated.
+ */
+static int decimalRejectsUpdate(sqlite3_vtab* pVtab, int argc, sqlite3_value** argv, sqlite_int64* pRowid) {
+  (void)pRowid;
+  decimalRejectsVTab* p = (decimalRejectsVTab*)pVtab;
+
+  if (argc == 1) { // Deletion
+    sqlite3_int64 const rowid = sqlite3_value_int64(argv[0]);
+    if (rowid >= 1 && rowid <= REJECTS_NREASONS)
+      memset(&p->rejects->aCounter[rowid - 1], 0, sizeof(rejectsCounter));
+    return SQLITE_OK;
+  }
+  pVtab->zErrMsg = sqlite3_mprintf("Rows can only be deleted from decRejects");
+  return SQLITE_ERROR;
+}
+
+/**
+ * \brief An eponymous-only virtual table module that shows the values
+ *        rejected by decTry().
+ */
+sqlite3_module decimalRejectsModule = {
+  0,
+  0,
+  decimalRejectsConnect,
+  decimalRejectsBestIndex,
+  decimalRejectsDisconnect,
+  decimalRejectsDisconnect,
+  decimalRejectsOpen,
+  decimalRejectsClose,
+  decimalRejectsFilter,
+  decimalRejectsNext,
+  decimalRejectsEof,
+  decimalRejectsColumn,
+  decimalRejectsRowid,
+  decimalRejectsUpdate,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+};
+
+#endif /* SQLITE_OMIT_VIRTUALTABLE */
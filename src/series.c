@@ -0,0 +1,510 @@
+/**
+ * \file      series.c
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     The decSeries() table-valued function.
+ *
+ * `decSeries(start, stop [, step])` is the decimal counterpart of SQLite's
+ * `generate_series()`: it returns the encoded decimals `start`, `start+step`,
+ * `start+2*step`, ..., up to and including `stop`. The step defaults to `1`
+ * and may be negative.
+ *
+ * The series is modelled as the set of term indexes `k` such that
+ * `start + k * step` is within the bounds, so that constraints on `value`
+ * (`=`, `<`, `<=`, `>`, `>=`) are turned into bounds on `k` and the cursor
+ * seeks directly to the first matching term. When the terms can be
+ * represented as 64-bit fixed-point numbers (which is the case for rate grids,
+ * price ladders and the like), each term is computed with integer arithmetic
+ * and encoded by decInfiniteFromInt64(); otherwise, the cursor falls back to
+ * decNumber arithmetic.
+ */
+#include <string.h>
+#include "impl_decinfinite.h"
+
+#ifndef SQLITE_OMIT_VIRTUALTABLE
+
+/** \brief Column index of the `value` column of decSeries. */
+#define SERIES_COLUMN_VALUE 0
+/** \brief Column index of the (hidden) `start` column of decSeries. */
+#define SERIES_COLUMN_START 1
+/** \brief Column index of the (hidden) `stop` column of decSeries. */
+#define SERIES_COLUMN_STOP  2
+/** \brief Column index of the (hidden) `step` column of decSeries. */
+#define SERIES_COLUMN_STEP  3
+
+/**
+ * \brief SQL definition of the decSeries virtual table.
+ */
+#define SQLITE_DECIMAL_SERIES_TABLE \
+  "create table x(value blob, start hidden, stop hidden, step hidden)"
+
+/**
+ * \name Bits of the `idxNum` value passed from xBestIndex to xFilter.
+ *
+ * The arguments passed to xFilter appear in the same order as the bits.
+ */
+/**@{*/
+#define SERIES_START 0x0001 /**< `start` is given.             */
+#define SERIES_STOP  0x0002 /**< `stop` is given.              */
+#define SERIES_STEP  0x0004 /**< `step` is given.              */
+#define SERIES_EQ    0x0008 /**< There is a `value =` term.    */
+#define SERIES_GT    0x0010 /**< There is a `value >` term.    */
+#define SERIES_GE    0x0020 /**< There is a `value >=` term.   */
+#define SERIES_LT    0x0040 /**< There is a `value <` term.    */
+#define SERIES_LE    0x0080 /**< There is a `value <=` term.   */
+#define SERIES_ASC   0x0100 /**< Output by ascending `value`.  */
+#define SERIES_DESC  0x0200 /**< Output by descending `value`. */
+/**@}*/
+
+/**
+ * \brief Largest term index handled by the cursor.
+ *
+ * Keeping well below `INT64_MAX` allows the cursor to add or subtract one
+ * without overflowing.
+ */
+#define SERIES_KMAX (INT64_MAX / 4)
+
+/**
+ * \brief Largest fixed-point coefficient used by the integer fast path.
+ */
+#define SERIES_CMAX INT64_C(999999999999999999)
+
+typedef struct decimalSeriesVTab decimalSeriesVTab;
+
+/**
+ * \brief The decSeries virtual table.
+ */
+struct decimalSeriesVTab {
+  sqlite3_vtab base;   /**< Base class - must be first. */
+  decContext* decCtx;  /**< Shared decimal context.     */
+};
+
+typedef struct decimalSeriesCursor decimalSeriesCursor;
+
+/**
+ * \brief A cursor over decSeries.
+ */
+struct decimalSeriesCursor {
+  sqlite3_vtab_cursor base; /**< Base class - must be first.                  */
+  decNumber start;          /**< First term of the series.                    */
+  decNumber stop;           /**< Upper (or lower, if step < 0) bound.         */
+  decNumber step;           /**< Difference between two consecutive terms.    */
+  decNumber value;          /**< Current term (decNumber path only).          */
+  sqlite3_int64 k;          /**< Index of the current term.                   */
+  sqlite3_int64 kFirst;     /**< Index of the first term in output order.     */
+  sqlite3_int64 kLast;      /**< Index of the last term in output order.      */
+  int dir;                  /**< `+1` or `-1`, the direction of `k`.          */
+  int isEof;                /**< Set when there are no more terms.            */
+  int isFixed;              /**< Set if the fixed-point fast path is used.    */
+  int64_t startCoeff;       /**< Coefficient of `start` (fixed-point path).   */
+  int64_t stepCoeff;        /**< Coefficient of `step` (fixed-point path).    */
+  int32_t exponent;         /**< Common exponent (fixed-point path).          */
+};
+
+#pragma mark Helper functions
+
+/**
+ * \brief Computes the position of \a x in the series.
+ *
+ * \param pCur The cursor
+ * \param x A finite decimal
+ * \param roundUp If nonzero, returns the ceiling of `(x - start) / step`;
+ *        otherwise, returns its floor.
+ * \param decCtx decNumber's context
+ *
+ * \return The index, clamped to `[-SERIES_KMAX, SERIES_KMAX]`.
+ */
+static sqlite3_int64 seriesIndexOf(decimalSeriesCursor* pCur, decNumber const* x, int roundUp, decContext* decCtx) {
+  decContext ctx = *decCtx;
+  ctx.traps = 0;
+  ctx.status = 0;
+
+  decNumber diff, quot, rem;
+  decNumberSubtract(&diff, x, &pCur->start, &ctx);
+  decNumberDivideInteger(&quot, &diff, &pCur->step, &ctx);
+  int sign = (decNumberIsNegative(&diff) != decNumberIsNegative(&pCur->step)) ? -1 : 1;
+  int64_t k;
+
+  if (decNumberIsZero(&diff)) return 0;
+  if ((ctx.status & DEC_Errors) || !decNumberToScaledInt64(&quot, 0, &k) || k > SERIES_KMAX || k < -SERIES_KMAX)
+    return sign > 0 ? SERIES_KMAX : -SERIES_KMAX;
+
+  decNumberRemainder(&rem, &diff, &pCur->step, &ctx);
+  if (!decNumberIsZero(&rem)) {
+    // The exact quotient is k + rem/step, and rem has the sign of diff
+    if (roundUp && sign > 0) ++k;
+    if (!roundUp && sign < 0) --k;
+  }
+  return k;
+}
+
+/**
+ * \brief Sets up the fixed-point fast path, if possible.
+ *
+ * The fast path is used when `start` and `step` can be aligned to a common
+ * exponent and all the terms in the cursor's range have coefficients with at
+ * most 18 digits.
+ */
+static void seriesSetupFixed(decimalSeriesCursor* pCur) {
+  int32_t e = pCur->start.exponent < pCur->step.exponent ? pCur->start.exponent : pCur->step.exponent;
+  int64_t s, d;
+
+  pCur->isFixed = 0;
+  if (!decNumberToScaledInt64(&pCur->start, e, &s) || !decNumberToScaledInt64(&pCur->step, e, &d))
+    return;
+
+  sqlite3_int64 ends[2] = { pCur->kFirst, pCur->kLast };
+  for (int i = 0; i < 2; i++) {
+    uint64_t k = ends[i] < 0 ? -(uint64_t)ends[i] : (uint64_t)ends[i];
+    uint64_t absd = d < 0 ? -(uint64_t)d : (uint64_t)d;
+    uint64_t abss = s < 0 ? -(uint64_t)s : (uint64_t)s;
+    if (k != 0 && absd > (SERIES_CMAX - abss) / k) return;
+  }
+  pCur->startCoeff = s;
+  pCur->stepCoeff = d;
+  pCur->exponent = e;
+  pCur->isFixed = 1;
+}
+
+/**
+ * \brief Computes the current term in the decNumber domain.
+ */
+static void seriesSetValue(decimalSeriesCursor* pCur, decContext* decCtx) {
+  decNumber k;
+  char buf[24];
+  sqlite3_snprintf(sizeof(buf), buf, "%lld", pCur->k);
+  decNumberFromString(&k, buf, decCtx);
+  // decNumberFMA() would reject the extended exponent range of the context
+  decNumberMultiply(&pCur->value, &k, &pCur->step, decCtx);
+  decNumberAdd(&pCur->value, &pCur->value, &pCur->start, decCtx);
+}
+
+/**
+ * \brief Reads an argument of decSeries.
+ *
+ * \return `SQLITE_OK` upon success; `SQLITE_ERROR` if the argument cannot be
+ *         converted into a finite decimal.
+ */
+static int seriesArgument(decNumber* result, sqlite3_value* value, char const* name, decContext* decCtx, char** zErrMsg) {
+  if (decNumberFromSQLite3Value(result, value, decCtx) == 0) {
+    *zErrMsg = sqlite3_mprintf("Cannot create decimal from the given type");
+    return SQLITE_ERROR;
+  }
+  if (decimalCheckTraps(decCtx, zErrMsg) != SQLITE_OK)
+    return SQLITE_ERROR;
+  if (name && decNumberIsSpecial(result)) {
+    *zErrMsg = sqlite3_mprintf("The %s of a series must be a finite number", name);
+    return SQLITE_ERROR;
+  }
+  return SQLITE_OK;
+}
+
+#pragma mark Virtual table methods
+
+static int decimalSeriesConnect(sqlite3* db, void* pAux, int argc, char const* const* argv,
+                                sqlite3_vtab** ppVtab, char** pzErr) {
+  (void)argc;
+  (void)argv;
+  (void)pzErr;
+
+  decimalSeriesVTab* pVtab;
+  int rc;
+
+  rc = sqlite3_declare_vtab(db, SQLITE_DECIMAL_SERIES_TABLE);
+  if (rc == SQLITE_OK) {
+    pVtab = sqlite3_malloc(sizeof(*pVtab));
+    *ppVtab = (sqlite3_vtab*)pVtab;
+    if (pVtab == 0) return SQLITE_NOMEM;
+    memset(pVtab, 0, sizeof(*pVtab));
+    pVtab->decCtx = pAux;
+  }
+  return rc;
+}
+
+static int decimalSeriesDisconnect(sqlite3_vtab* pVtab) {
+  sqlite3_free(pVtab);
+  return SQLITE_OK;
+}
+
+static int decimalSeriesOpen(sqlite3_vtab* p, sqlite3_vtab_cursor** ppCursor) {
+  (void)p;
+  decimalSeriesCursor* pCur;
+  pCur = sqlite3_malloc(sizeof(*pCur));
+  if (pCur == 0) return SQLITE_NOMEM;
+  memset(pCur, 0, sizeof(*pCur));
+  pCur->isEof = 1;
+  *ppCursor = &pCur->base;
+  return SQLITE_OK;
+}
+
+static int decimalSeriesClose(sqlite3_vtab_cursor* cur) {
+  sqlite3_free(cur);
+  return SQLITE_OK;
+}
+
+static int decimalSeriesNext(sqlite3_vtab_cursor* cur) {
+  decimalSeriesCursor* pCur = (decimalSeriesCursor*)cur;
+  decContext* decCtx = ((decimalSeriesVTab*)cur->pVtab)->decCtx;
+
+  if (pCur->k == pCur->kLast) {
+    pCur->isEof = 1;
+    return SQLITE_OK;
+  }
+  pCur->k += pCur->dir;
+  if (!pCur->isFixed) {
+    if (pCur->dir > 0)
+      decNumberAdd(&pCur->value, &pCur->value, &pCur->step, decCtx);
+    else
+      decNumberSubtract(&pCur->value, &pCur->value, &pCur->step, decCtx);
+  }
+  return SQLITE_OK;
+}
+
+static int decimalSeriesEof(sqlite3_vtab_cursor* cur) {
+  return ((decimalSeriesCursor*)cur)->isEof;
+}
+
+static int decimalSeriesColumn(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int i) {
+  decimalSeriesCursor* pCur = (decimalSeriesCursor*)cur;
+  decNumber decnum;
+
+  switch (i) {
+    case SERIES_COLUMN_VALUE:
+      if (pCur->isFixed) {
+        uint8_t bytes[DECINF_MAXSIZE];
+        size_t len = decInfiniteFromInt64(DECINF_MAXSIZE, bytes, pCur->startCoeff + pCur->k * pCur->stepCoeff, pCur->exponent);
+        sqlite3_result_blob(ctx, bytes, len, SQLITE_TRANSIENT);
+        return SQLITE_OK;
+      }
+      decnum = pCur->value;
+      break;
+    case SERIES_COLUMN_START:
+      decnum = pCur->start;
+      break;
+    case SERIES_COLUMN_STOP:
+      decnum = pCur->stop;
+      break;
+    case SERIES_COLUMN_STEP:
+      decnum = pCur->step;
+      break;
+    default:
+      return SQLITE_OK;
+  }
+  decNumberToSQLite3Blob(ctx, &decnum);
+  return SQLITE_OK;
+}
+
+static int decimalSeriesRowid(sqlite3_vtab_cursor* cur, sqlite_int64* pRowid) {
+  *pRowid = ((decimalSeriesCursor*)cur)->k + 1;
+  return SQLITE_OK;
+}
+
+static int decimalSeriesFilter(sqlite3_vtab_cursor* cur, int idxNum, char const* idxStr,
+                               int argc, sqlite3_value** argv) {
+  (void)idxStr;
+  (void)argc;
+
+  decimalSeriesCursor* pCur = (decimalSeriesCursor*)cur;
+  sqlite3_vtab* pVtab = cur->pVtab;
+  decContext* decCtx = ((decimalSeriesVTab*)pVtab)->decCtx;
+  int i = 0;
+
+  pCur->isEof = 1;
+
+  if (!(idxNum & SERIES_START) || !(idxNum & SERIES_STOP)) {
+    pVtab->zErrMsg = sqlite3_mprintf("The start and stop arguments of a series are required");
+    return SQLITE_ERROR;
+  }
+
+  // NULL arguments and NULL constraints select nothing
+  for (i = 0; i < argc; i++)
+    if (sqlite3_value_type(argv[i]) == SQLITE_NULL) return SQLITE_OK;
+
+  i = 0;
+  if (seriesArgument(&pCur->start, argv[i++], "start", decCtx, &pVtab->zErrMsg) != SQLITE_OK)
+    return SQLITE_ERROR;
+  if (seriesArgument(&pCur->stop, argv[i++], "stop", decCtx, &pVtab->zErrMsg) != SQLITE_OK)
+    return SQLITE_ERROR;
+  if (idxNum & SERIES_STEP) {
+    if (seriesArgument(&pCur->step, argv[i++], "step", decCtx, &pVtab->zErrMsg) != SQLITE_OK)
+      return SQLITE_ERROR;
+  }
+  else
+    decNumberFromInt32(&pCur->step, 1);
+
+  if (decNumberIsZero(&pCur->step)) {
+    pVtab->zErrMsg = sqlite3_mprintf("The step of a series cannot be zero");
+    return SQLITE_ERROR;
+  }
+
+  // The series is start + k * step, for k in [kFirst, kLast]
+  pCur->kFirst = 0;
+  pCur->kLast = seriesIndexOf(pCur, &pCur->stop, 0, decCtx);
+
+  static int const ops[] = { SERIES_EQ, SERIES_GT, SERIES_GE, SERIES_LT, SERIES_LE };
+  int stepIsNeg = decNumberIsNegative(&pCur->step);
+
+  for (size_t j = 0; j < sizeof(ops) / sizeof(ops[0]); j++) {
+    if (!(idxNum & ops[j])) continue;
+    sqlite3_value* arg = argv[i++];
+    // Only a decimal compares numerically with the terms (see xBestIndex)
+    if (sqlite3_value_type(arg) != SQLITE_BLOB ||
+        decInfiniteCheck((size_t)sqlite3_value_bytes(arg), sqlite3_value_blob(arg)) != DECINF_VALID)
+      continue;
+    decNumber x;
+    if (seriesArgument(&x, arg, 0, decCtx, &pVtab->zErrMsg) != SQLITE_OK)
+      return SQLITE_ERROR;
+    if (decNumberIsSpecial(&x)) { // Either everything or nothing satisfies the constraint
+      int below = decNumberIsNegative(&x); // -NaN sorts first and NaN last
+      if (ops[j] == SERIES_EQ) return SQLITE_OK;
+      if ((ops[j] & (SERIES_GT | SERIES_GE)) && !below) return SQLITE_OK;
+      if ((ops[j] & (SERIES_LT | SERIES_LE)) && below) return SQLITE_OK;
+      continue;
+    }
+    // Lower bounds on value are lower bounds on k iff step > 0
+    int isLower = (ops[j] & (SERIES_GT | SERIES_GE)) ? !stepIsNeg : stepIsNeg;
+    int isStrict = (ops[j] & (SERIES_GT | SERIES_LT));
+    if (ops[j] == SERIES_EQ || isLower) {
+      sqlite3_int64 k = isStrict ? seriesIndexOf(pCur, &x, 0, decCtx) + 1 : seriesIndexOf(pCur, &x, 1, decCtx);
+      if (k > pCur->kFirst) pCur->kFirst = k;
+    }
+    if (ops[j] == SERIES_EQ || !isLower) {
+      sqlite3_int64 k = isStrict ? seriesIndexOf(pCur, &x, 1, decCtx) - 1 : seriesIndexOf(pCur, &x, 0, decCtx);
+      if (k < pCur->kLast) pCur->kLast = k;
+    }
+  }
+
+  if (pCur->kFirst > pCur->kLast) return SQLITE_OK; // Empty series
+
+  seriesSetupFixed(pCur);
+
+  // Ascending values correspond to increasing k iff step > 0
+  pCur->dir = 1;
+  if ((idxNum & SERIES_ASC) && stepIsNeg) pCur->dir = -1;
+  if ((idxNum & SERIES_DESC) && !stepIsNeg) pCur->dir = -1;
+  if (pCur->dir < 0) {
+    sqlite3_int64 tmp = pCur->kFirst;
+    pCur->kFirst = pCur->kLast;
+    pCur->kLast = tmp;
+  }
+  pCur->k = pCur->kFirst;
+  if (!pCur->isFixed) seriesSetValue(pCur, decCtx);
+  pCur->isEof = 0;
+
+  return decimalCheckTraps(decCtx, &pVtab->zErrMsg);
+}
+
+/**
+ * \brief Implementation of the xBestIndex method for decSeries.
+ *
+ * The `start` and `stop` arguments are mandatory. Constraints on `value` are
+ * passed to xFilter, which uses them to seek to the first matching term and
+ * stop after the last one. They are not omitted, because xFilter can use
+ * only those compared with a decimal: SQLite always sorts a blob after
+ * numbers and text, so the others are left for SQLite to check. An
+ * `order by value` clause is always satisfied.
+ */
+static int decimalSeriesBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
+  int aIdx[8] = { -1, -1, -1, -1, -1, -1, -1, -1 }; // Constraint for each bit, in idxNum order
+  int idxNum = 0;
+  int unusable = 0;
+  double nRow = 1000.0;
+
+  for (int i = 0; i < pIdxInfo->nConstraint; i++) {
+    struct sqlite3_index_constraint const* pCons = &pIdxInfo->aConstraint[i];
+    int bit;
+
+    if (pCons->iColumn == SERIES_COLUMN_VALUE) {
+      switch (pCons->op) {
+        case SQLITE_INDEX_CONSTRAINT_EQ: bit = 3; break;
+        case SQLITE_INDEX_CONSTRAINT_GT: bit = 4; break;
+        case SQLITE_INDEX_CONSTRAINT_GE: bit = 5; break;
+        case SQLITE_INDEX_CONSTRAINT_LT: bit = 6; break;
+        case SQLITE_INDEX_CONSTRAINT_LE: bit = 7; break;
+        default: continue;
+      }
+    }
+    else {
+      if (pCons->op != SQLITE_INDEX_CONSTRAINT_EQ) continue;
+      bit = pCons->iColumn - SERIES_COLUMN_START;
+    }
+    if (!pCons->usable) {
+      if (bit < 3) unusable = 1;
+      continue;
+    }
+    if (aIdx[bit] < 0) {
+      aIdx[bit] = i;
+      idxNum |= (1 << bit);
+    }
+  }
+
+  if ((idxNum & (SERIES_START | SERIES_STOP)) != (SERIES_START | SERIES_STOP)) {
+    if (unusable) return SQLITE_CONSTRAINT;
+    sqlite3_free(tab->zErrMsg);
+    tab->zErrMsg = sqlite3_mprintf("The start and stop arguments of a series are required");
+    return SQLITE_ERROR;
+  }
+
+  int nArg = 0;
+  for (int bit = 0; bit < 8; bit++) {
+    if (aIdx[bit] < 0) continue;
+    pIdxInfo->aConstraintUsage[aIdx[bit]].argvIndex = ++nArg;
+    pIdxInfo->aConstraintUsage[aIdx[bit]].omit = (bit < 3);
+    if (bit >= 4) nRow /= 4.0; // Range constraints
+  }
+
+  if (idxNum & SERIES_EQ) {
+    nRow = 1.0;
+    pIdxInfo->idxFlags |= SQLITE_INDEX_SCAN_UNIQUE;
+  }
+
+  if (pIdxInfo->nOrderBy == 1 && pIdxInfo->aOrderBy[0].iColumn == SERIES_COLUMN_VALUE) {
+    idxNum |= pIdxInfo->aOrderBy[0].desc ? SERIES_DESC : SERIES_ASC;
+    pIdxInfo->orderByConsumed = 1;
+  }
+
+  pIdxInfo->idxNum = idxNum;
+  pIdxInfo->estimatedCost = nRow;
+  pIdxInfo->estimatedRows = (sqlite3_int64)nRow;
+  return SQLITE_OK;
+}
+
+/**
+ * \brief An eponymous-only virtual table module that implements the
+ *        decSeries() table-valued function.
+ */
+sqlite3_module decimalSeriesModule = {
+  0,
+  0,
+  decimalSeriesConnect,
+  decimalSeriesBestIndex,
+  decimalSeriesDisconnect,
+  decimalSeriesDisconnect,
+  decimalSeriesOpen,
+  decimalSeriesClose,
+  decimalSeriesFilter,
+  decimalSeriesNext,
+  decimalSeriesEof,
+  decimalSeriesColumn,
+  decimalSeriesRowid,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+};
+
+#endif /* SQLITE_OMIT_VIRTUALTABLE */
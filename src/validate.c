@@ -0,0 +1,387 @@
+/**
+ * \file      validate.c
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     Validation of stored decimals.
+ *
+ * `decIsValid(x)` tells whether a blob is a valid encoded decimal, and
+ * `decValidate(table, column)` returns the rowid of each non-null value of a
+ * column that is not, with the reason. Encodings are checked by
+ * decInfiniteCheck(), which never builds a decNumber.
+ *
+ * decValidate() reads the column in batches of #VALIDATE_BATCH_SIZE values,
+ * checks each batch in a tight loop, and returns the offending rows of a
+ * batch before reading the next one, so that a large table is streamed.
+ */
+#include <string.h>
+#include "impl_decinfinite.h"
+
+/**
+ * \brief Result of the check of a value that is not a blob.
+ */
+#define VALIDATE_NOT_A_BLOB (DECINF_INVALID_PADDING + 1)
+
+/**
+ * \brief Reasons for rejecting a value, indexed by the result of its check.
+ */
+static char const* const validateReason[] = {
+  0,
+  "Empty blob",
+  "Too long",
+  "Invalid special value",
+  "Invalid sign",
+  "Invalid exponent",
+  "Missing significand",
+  "Too many digits",
+  "Invalid declet",
+  "Invalid most significant unit",
+  "Invalid least significant unit",
+  "Invalid padding",
+  "Not a blob",
+};
+
+void decimalIsValid(sqlite3_context* context, sqlite3_value* value) {
+  if (sqlite3_value_type(value) != SQLITE_BLOB) {
+    sqlite3_result_int(context, 0);
+    return;
+  }
+  uint8_t const* bytes = sqlite3_value_blob(value);
+  size_t const len = (size_t)sqlite3_value_bytes(value);
+  sqlite3_result_int(context, decInfiniteCheck(len, bytes) == DECINF_VALID);
+}
+
+#ifndef SQLITE_OMIT_VIRTUALTABLE
+
+/**
+ * \brief The number of values checked at a time.
+ */
+#define VALIDATE_BATCH_SIZE 1024
+
+/** \brief Column index of the `row` column of decValidate. */
+#define VALIDATE_COLUMN_ROW    0
+/** \brief Column index of the `reason` column of decValidate. */
+#define VALIDATE_COLUMN_REASON 1
+/** \brief Column index of the first hidden column of decValidate. */
+#define VALIDATE_COLUMN_TAB    2
+/** \brief Number of arguments of decValidate. */
+#define VALIDATE_NARGS         2
+
+/**
+ * \brief A batch of values read from a column.
+ *
+ * Values longer than #DECINF_MAXSIZE are not copied: their length is enough
+ * to reject them.
+ */
+typedef struct validateBatch {
+  int n;                                              /**< Number of values.        */
+  sqlite3_int64 aRowid[VALIDATE_BATCH_SIZE];          /**< Their rowids.            */
+  int aLen[VALIDATE_BATCH_SIZE];                      /**< Lengths (-1: no blob).   */
+  uint8_t aResult[VALIDATE_BATCH_SIZE];               /**< The results of checks.   */
+  uint8_t aBytes[VALIDATE_BATCH_SIZE][DECINF_MAXSIZE]; /**< The values.            */
+} validateBatch;
+
+/**
+ * \brief Checks all the values of a batch.
+ */
+static void validateCheckBatch(validateBatch* batch) {
+  for (int i = 0; i < batch->n; i++) {
+    int const len = batch->aLen[i];
+    batch->aResult[i] = len < 0 ? VALIDATE_NOT_A_BLOB : (uint8_t)decInfiniteCheck((size_t)len, batch->aBytes[i]);
+  }
+}
+
+/**
+ * \brief SQL definition of the decValidate virtual table.
+ */
+#define SQLITE_DECIMAL_VALIDATE_TABLE "create table x(row integer, reason text, tab hidden, col hidden)"
+
+typedef struct decimalValidateVTab decimalValidateVTab;
+
+/**
+ * \brief A decValidate virtual table.
+ */
+struct decimalValidateVTab {
+  sqlite3_vtab base;  /**< Base class - must be first. */
+  sqlite3* db;        /**< The database connection.    */
+};
+
+typedef struct decimalValidateCursor decimalValidateCursor;
+
+/**
+ * \brief A cursor over decValidate.
+ */
+struct decimalValidateCursor {
+  sqlite3_vtab_cursor base;                 /**< Base class - must be first.       */
+  sqlite3_stmt* pStmt;                      /**< The scan of the column.           */
+  validateBatch* batch;                     /**< The batch being returned.         */
+  int iValue;                               /**< The current value in the batch.   */
+  int isEof;                                /**< Whether the scan is over.         */
+  sqlite3_int64 iRowid;                     /**< The rowid of the cursor.          */
+  sqlite3_value* aArg[VALIDATE_NARGS];      /**< The arguments.                    */
+};
+
+static int decimalValidateConnect(sqlite3* db, void* pAux, int argc, char const* const* argv,
+                                  sqlite3_vtab** ppVtab, char** pzErr) {
+  (void)pAux;
+  (void)argc;
+  (void)argv;
+  (void)pzErr;
+
+  decimalValidateVTab* pVtab;
+  int rc;
+
+  rc = sqlite3_declare_vtab(db, SQLITE_DECIMAL_VALIDATE_TABLE);
+  if (rc == SQLITE_OK) {
+    pVtab = sqlite3_malloc(sizeof(*pVtab));
+    *ppVtab = (sqlite3_vtab*)pVtab;
+    if (pVtab == 0) return SQLITE_NOMEM;
+    memset(pVtab, 0, sizeof(*pVtab));
+    pVtab->db = db;
+  }
+  return rc;
+}
+
+static int decimalValidateDisconnect(sqlite3_vtab* pVtab) {
+  sqlite3_free(pVtab);
+  return SQLITE_OK;
+}
+
+static int decimalValidateOpen(sqlite3_vtab* p, sqlite3_vtab_cursor** ppCursor) {
+  (void)p;
+  decimalValidateCursor* pCur;
+  pCur = sqlite3_malloc(sizeof(*pCur));
+  if (pCur == 0) return SQLITE_NOMEM;
+  memset(pCur, 0, sizeof(*pCur));
+  pCur->isEof = 1;
+  *ppCursor = &pCur->base;
+  return SQLITE_OK;
+}
+
+/**
+ * \brief Releases the scan and the arguments of a cursor.
+ */
+static void validateReset(decimalValidateCursor* pCur) {
+  sqlite3_finalize(pCur->pStmt);
+  pCur->pStmt = 0;
+  for (int i = 0; i < VALIDATE_NARGS; i++) {
+    sqlite3_value_free(pCur->aArg[i]);
+    pCur->aArg[i] = 0;
+  }
+}
+
+static int decimalValidateClose(sqlite3_vtab_cursor* cur) {
+  decimalValidateCursor* pCur = (decimalValidateCursor*)cur;
+  validateReset(pCur);
+  sqlite3_free(pCur->batch);
+  sqlite3_free(pCur);
+  return SQLITE_OK;
+}
+
+/**
+ * \brief Reads and checks the next batch of values.
+ *
+ * \return `SQLITE_OK`, or an error code if the scan fails.
+ */
+static int validateNextBatch(decimalValidateCursor* pCur) {
+  validateBatch* batch = pCur->batch;
+  int rc = SQLITE_ROW;
+
+  batch->n = 0;
+  pCur->iValue = 0;
+  while (pCur->pStmt && batch->n < VALIDATE_BATCH_SIZE && (rc = sqlite3_step(pCur->pStmt)) == SQLITE_ROW) {
+    sqlite3_value* value = sqlite3_column_value(pCur->pStmt, 1);
+    int const type = sqlite3_value_type(value);
+    if (type == SQLITE_NULL) continue;
+    int const i = batch->n++;
+    batch->aRowid[i] = sqlite3_column_int64(pCur->pStmt, 0);
+    if (type == SQLITE_BLOB) {
+      void const* bytes = sqlite3_value_blob(value);
+      batch->aLen[i] = sqlite3_value_bytes(value);
+      if (batch->aLen[i] <= DECINF_MAXSIZE) memcpy(batch->aBytes[i], bytes, (size_t)batch->aLen[i]);
+    }
+    else
+      batch->aLen[i] = -1;
+  }
+  if (rc == SQLITE_DONE) {
+    sqlite3_finalize(pCur->pStmt);
+    pCur->pStmt = 0;
+  }
+  else if (rc != SQLITE_ROW) {
+    sqlite3_vtab* pVtab = pCur->base.pVtab;
+    sqlite3_free(pVtab->zErrMsg);
+    pVtab->zErrMsg = sqlite3_mprintf("%s", sqlite3_errmsg(((decimalValidateVTab*)pVtab)->db));
+    return rc;
+  }
+  validateCheckBatch(batch);
+  return SQLITE_OK;
+}
+
+/**
+ * \brief Moves the cursor to the next offending value, starting from the
+ *        current one.
+ */
+static int validateSeek(decimalValidateCursor* pCur) {
+  validateBatch* batch = pCur->batch;
+  for (;;) {
+    while (pCur->iValue < batch->n) {
+      if (batch->aResult[pCur->iValue] != DECINF_VALID) return SQLITE_OK;
+      pCur->iValue++;
+    }
+    if (pCur->pStmt == 0) {
+      pCur->isEof = 1;
+      return SQLITE_OK;
+    }
+    int rc = validateNextBatch(pCur);
+    if (rc != SQLITE_OK) return rc;
+  }
+}
+
+static int decimalValidateNext(sqlite3_vtab_cursor* cur) {
+  decimalValidateCursor* pCur = (decimalValidateCursor*)cur;
+  pCur->iValue++;
+  pCur->iRowid++;
+  return validateSeek(pCur);
+}
+
+static int decimalValidateEof(sqlite3_vtab_cursor* cur) {
+  return ((decimalValidateCursor*)cur)->isEof;
+}
+
+static int decimalValidateColumn(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int i) {
+  decimalValidateCursor* pCur = (decimalValidateCursor*)cur;
+  validateBatch* batch = pCur->batch;
+  if (i == VALIDATE_COLUMN_ROW)
+    sqlite3_result_int64(ctx, batch->aRowid[pCur->iValue]);
+  else if (i == VALIDATE_COLUMN_REASON)
+    sqlite3_result_text(ctx, validateReason[batch->aResult[pCur->iValue]], -1, SQLITE_STATIC);
+  else if (pCur->aArg[i - VALIDATE_COLUMN_TAB])
+    sqlite3_result_value(ctx, pCur->aArg[i - VALIDATE_COLUMN_TAB]);
+  return SQLITE_OK;
+}
+
+static int decimalValidateRowid(sqlite3_vtab_cursor* cur, sqlite_int64* pRowid) {
+  *pRowid = ((decimalValidateCursor*)cur)->iRowid;
+  return SQLITE_OK;
+}
+
+static int decimalValidateFilter(sqlite3_vtab_cursor* cur, int idxNum, char const* idxStr,
+                                 int argc, sqlite3_value** argv) {
+  (void)idxNum;
+  (void)idxStr;
+
+  decimalValidateCursor* pCur = (decimalValidateCursor*)cur;
+  decimalValidateVTab* pVtab = (decimalValidateVTab*)cur->pVtab;
+  char* zSql;
+  int rc;
+
+  validateReset(pCur);
+  pCur->isEof = 1;
+  pCur->iRowid = 1;
+  for (int i = 0; i < argc && i < VALIDATE_NARGS; i++) {
+    pCur->aArg[i] = sqlite3_value_dup(argv[i]);
+    if (pCur->aArg[i] == 0) return SQLITE_NOMEM;
+  }
+  if (argc < VALIDATE_NARGS
+      || sqlite3_value_type(argv[0]) == SQLITE_NULL || sqlite3_value_type(argv[1]) == SQLITE_NULL) {
+    pVtab->base.zErrMsg = sqlite3_mprintf("The table and column of decValidate are required");
+    return SQLITE_ERROR;
+  }
+
+  if (pCur->batch == 0) {
+    pCur->batch = sqlite3_malloc(sizeof(*pCur->batch));
+    if (pCur->batch == 0) return SQLITE_NOMEM;
+  }
+  pCur->batch->n = 0;
+  pCur->iValue = 0;
+
+  char const* zTab = (char const*)sqlite3_value_text(argv[0]);
+  char const* zCol = (char const*)sqlite3_value_text(argv[1]);
+  // The column is qualified, so that it cannot be taken for a string
+  zSql = sqlite3_mprintf("select rowid, \"%w\".\"%w\" from \"%w\"", zTab, zCol, zTab);
+  if (zSql == 0) return SQLITE_NOMEM;
+  rc = sqlite3_prepare_v2(pVtab->db, zSql, -1, &pCur->pStmt, 0);
+  sqlite3_free(zSql);
+  if (rc != SQLITE_OK) {
+    pVtab->base.zErrMsg = sqlite3_mprintf("%s", sqlite3_errmsg(pVtab->db));
+    return rc;
+  }
+
+  pCur->isEof = 0;
+  return validateSeek(pCur);
+}
+
+/**
+ * \brief Implementation of the xBestIndex method for decValidate.
+ *
+ * Both the table and the column are required.
+ */
+static int decimalValidateBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
+  int aIdx[VALIDATE_NARGS] = { -1, -1 };
+  int unusable = 0;
+
+  for (int i = 0; i < pIdxInfo->nConstraint; i++) {
+    struct sqlite3_index_constraint const* pCons = &pIdxInfo->aConstraint[i];
+    if (pCons->iColumn < VALIDATE_COLUMN_TAB) continue;
+    if (pCons->op != SQLITE_INDEX_CONSTRAINT_EQ) continue;
+    int k = pCons->iColumn - VALIDATE_COLUMN_TAB;
+    if (!pCons->usable) {
+      unusable |= (1 << k);
+      continue;
+    }
+    aIdx[k] = i;
+  }
+
+  if (unusable && (aIdx[0] < 0 || aIdx[1] < 0)) return SQLITE_CONSTRAINT;
+  if (aIdx[0] < 0 || aIdx[1] < 0) {
+    sqlite3_free(tab->zErrMsg);
+    tab->zErrMsg = sqlite3_mprintf("The table and column of decValidate are required");
+    return SQLITE_ERROR;
+  }
+
+  for (int k = 0; k < VALIDATE_NARGS; k++) {
+    pIdxInfo->aConstraintUsage[aIdx[k]].argvIndex = k + 1;
+    pIdxInfo->aConstraintUsage[aIdx[k]].omit = 1;
+  }
+  pIdxInfo->estimatedCost = 1000000.0;
+  return SQLITE_OK;
+}
+
+/**
+ * \brief An eponymous-only virtual table module that implements the
+ *        decValidate() table-valued function.
+ */
+sqlite3_module decimalValidateModule = {
+  0,
+  0,
+  decimalValidateConnect,
+  decimalValidateBestIndex,
+  decimalValidateDisconnect,
+  decimalValidateDisconnect,
+  decimalValidateOpen,
+  decimalValidateClose,
+  decimalValidateFilter,
+  decimalValidateNext,
+  decimalValidateEof,
+  decimalValidateColumn,
+  decimalValidateRowid,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+  0,
+};
+
+#endif /* SQLITE_OMIT_VIRTUALTABLE */
@@ -1,6 +1,6 @@
-#define MANIFEST_UUID "38bcc18b58d9028f03b9db87c0c45b8df7339a44f7ec95f602b646c85025a3fb"
-#define MANIFEST_VERSION "[38bcc18b58]"
-#define MANIFEST_DATE "2019-07-08 13:33:56"
+#define MANIFEST_UUID "124d11c40e23f7101df99102f994fdc667e0233afcb38cc155c18d6e7bd9adcc"
+#define MANIFEST_VERSION "[124d11c40e]"
+#define MANIFEST_DATE "2019-07-09 13:32:22"
 #define MANIFEST_YEAR "2019"
 
 /**
@@ -10,4 +10,3 @@
 
 #define RELEASE_VERSION_NUMBER 1
 #define RELEASE_RESOURCE_VERSION 0,0,1,0
-#define COMPILER_VERSION "10.0.1"
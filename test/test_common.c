@@ -36,6 +36,11 @@
  *   information as possible should be preserved in NaN results of
  *   operations.")
  */
+#include "autoconfig.h"
+#if HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
 static sqlite3* db;
 
 #pragma mark Test functions
@@ -306,6 +311,77 @@ static void sqlite_decimal_test_decfromint(void) {
   mu_assert_query(db, "select decStr(dec(-2147483649))", "2147483647"); // Wrap around, no error
 }
 
+static void sqlite_decimal_test_decfixed(void) {
+  mu_assert_query(db, "select decStr(decFixed('1.5', 2)), decStr(decFixed('-123.456', 2)), decStr(decFixed(7, 0))",
+                  "1.5", "-123.46", "7");
+  // Without its subtype, a fixed decimal is an ordinary decimal
+  mu_assert_query(db, "select decStr(v) from (select decFixed('1.25', 2) v union all select 1)", "1.25", "1");
+  mu_db_execute(db, "drop table if exists t;");
+  mu_db_execute(db, "create table t(n blob);");
+  mu_db_execute(db, "insert into t(n) values (decFixed('1.5', 2));");
+  mu_assert_query(db, "select decStr(n), decStr(decAdd(n, decFixed('1', 1))) from t", "1.5", "2.5");
+  mu_db_execute(db, "drop table t;");
+  mu_assert_query(db, "select hex(decToFixed('12.34', 2)), hex(decToFixed('-0.01', 2)), hex(decToFixed(0, 0))",
+                  "80000000000004D2", "7FFFFFFFFFFFFFFF", "8000000000000000");
+  mu_assert_query(db, "select decToFixed('1.5', 2) < decToFixed('-1.5', 2), decToFixed('-2', 2) < decToFixed('-1.5', 2)", "0", "1");
+  mu_assert_query(db, "select decStr(decFromFixed(decToFixed('-123.456', 2), 2))", "-123.46");
+  // Integer arithmetic when all the arguments are fixed decimals
+  mu_assert_query(db, "select decStr(decAdd(decFixed('1.25', 2), decFixed('2.5', 1), decFixed('3', 0))), "
+                      "decStr(decSub(decFixed('1', 2), decFixed('1.5', 1)))", "6.75", "-0.5");
+  mu_assert_query(db, "select decStr(decMul(decFixed('1.5', 1), decFixed('-2.25', 2))), "
+                      "decStr(decMul(decFixed('0', 1), decFixed('-2', 0)))", "-3.375", "-0");
+  mu_assert_query(db, "select decStr(decMul(decFixed('999999999999999999', 0), decFixed('999999999999999999', 0)))",
+                  "999999999999999998000000000000000001");
+  mu_assert_query(db, "select decStr(decAdd(decFixed('1.5', 1), '1.25'))", "2.75");
+  // Results with more digits than the precision are rounded by decNumber
+  mu_db_execute(db, "delete from decStatus");
+  mu_db_execute(db, "update decContext set prec = 6");
+  mu_assert_query(db, "select decStr(decAdd(decFixed('99999.9', 1), decFixed('1.01', 2))), "
+                      "decStr(decMul(decFixed('1234.56', 2), decFixed('1.01', 2)))", "100001", "1246.91");
+  mu_assert_query(db, "select group_concat(flag, ', ') from (select flag from decStatus order by flag)",
+                  "Inexact result, Rounded result");
+  mu_db_execute(db, "delete from decStatus");
+  mu_assert_query(db, "select decStr(decAdd(decFixed('9999.9', 1), decFixed('0.01', 2)))", "9999.91");
+  mu_assert_query(db, "select count(*) from decStatus", "0");
+  mu_db_execute(db, "update decContext set prec = 39");
+  mu_assert_query_fails(db, "select decFixed('1E+18', 0)", "The value has more than 18 digits");
+  mu_assert_query_fails(db, "select decFixed('NaN', 0)", "Only finite decimals can be fixed");
+  mu_assert_query_fails(db, "select decFixed(1, 19)", "The scale must be an integer between 0 and 18");
+  mu_assert_query_fails(db, "select decToFixed('1E+18', 0)", "The value has more than 18 digits");
+  mu_assert_query_fails(db, "select decFromFixed(x'00', 2)", "A fixed decimal must be a blob of 8 bytes");
+}
+
+static void sqlite_decimal_test_decfrombid128(void) {
+  mu_assert_query(db, "select decStr(decFromBID128(x'01000000000000000000000000004030')), "
+                      "decStr(decFromBID128(x'0F000000000000000000000000003EB0'))", "1", "-1.5");
+  mu_assert_query(db, "select decStr(decFromBID128(decToBID128('-123456789012345678901234567890.1234')))",
+                  "-123456789012345678901234567890.1234");
+  mu_assert_query(db, "select decStr(decFromBID128(decToBID128('NaN'))), decStr(decFromBID128(decToBID128('-Inf')))",
+                  "NaN", "-Infinity");
+  // Non-canonical coefficients are zeros
+  mu_assert_query(db, "select decStr(decFromBID128(x'FFFFFFFFFFFFFFFFFFFFFFFFFFFF0130'))", "0");
+  mu_assert_query_fails(db, "select decFromBID128(x'00')", "A BID decimal128 number must be a blob of 16 bytes");
+}
+
+static void sqlite_decimal_test_decfromdpd(void) {
+  mu_assert_query(db, "select decStr(decFrom64(x'2238000000000015')), decStr(decFrom128(x'A207C000000000000000000000000015'))",
+                  "15", "-1.5");
+  mu_assert_query(db, "select decStr(decFrom128(decTo128('-123456789012345678901234567890.1234')))",
+                  "-123456789012345678901234567890.1234");
+  mu_assert_query(db, "select decStr(decFrom128(decTo128('NaN'))), decStr(decFrom64(decTo64('-Inf')))", "NaN", "-Infinity");
+  mu_assert_query_fails(db, "select decFrom64(x'00')", "A decimal64 number must be a blob of 8 bytes");
+  mu_assert_query_fails(db, "select decFrom128(decTo64(1))", "A decimal128 number must be a blob of 16 bytes");
+}
+
+static void sqlite_decimal_test_decfrompacked(void) {
+  mu_assert_query(db, "select decStr(decFromPacked(x'12345C', 2)), decStr(decFromPacked(x'12345D', 0))", "123.45", "-12345");
+  mu_assert_query(db, "select decStr(decFromPacked(x'0000000000000000000000123456789012345678901234567890123456789F', 5))",
+                  "1234567890123456789012345678901234.56789");
+  mu_assert_query(db, "select decStr(decFromPacked(x'0C', -3)), decStr(decFromPacked(x'001B', 1))", "0", "-0.1");
+  mu_assert_query_fails(db, "select decFromPacked(x'1234', 0)", "Conversion syntax");
+  mu_assert_query_fails(db, "select decFromPacked('12', 0)", "A packed decimal must be a non-empty blob");
+}
+
 static void sqlite_decimal_test_decgetexponent(void) {
   mu_skip_if(1, "Currently not implemented");
   mu_assert_query(db, "select decGetExp(dec('-12.345'))", "-3");
@@ -458,6 +534,24 @@ static void sqlite_decimal_test_deciszero(void) {
   mu_assert_query(db, "select decIsZero('-NaN')", "0");
 }
 
+static void sqlite_decimal_test_decjson(void) {
+  mu_assert_query(db, "select decStr(decJson('{\"a\":{\"b\":[1, 12345678901234567890.123456789]}}', '$.a.b[1]'))",
+                  "12345678901234567890.123456789");
+  mu_assert_query(db, "select decStr(decJson('{\"a\": \"-1.25E+3\"}', '$.a'))", "-1.25E+3");
+  mu_assert_query(db, "select decStr(decJson('{\"k.x\": 3}', '$.\"k.x\"'))", "3");
+  mu_assert_query(db, "select decJson('{\"a\": null}', '$.a') is null, decJson('[1]', '$[1]') is null", "1", "1");
+  mu_assert_query_fails(db, "select decJson('{\"a\": true}', '$.a')", "Conversion syntax");
+  mu_assert_query_fails(db, "select decJson('{\"a\":', '$.a')", "Malformed JSON");
+  mu_assert_query_fails(db, "select decJson('{\"a\": 1}', 'a')", "Invalid JSON path: a");
+}
+
+static void sqlite_decimal_test_decjsonsum(void) {
+  mu_assert_query(db, "select decStr(decJsonSum('{\"x\": [0.1, 0.2, null, \"0.3\", 1E-30]}', '$.x'))",
+                  "0.600000000000000000000000000001");
+  mu_assert_query(db, "select decStr(decJsonSum('[]', '$')), decStr(decJsonSum('[7]', '$[0]'))", "0", "7");
+  mu_assert_query_fails(db, "select decJsonSum('[[1]]', '$')", "Nested arrays and objects cannot be summed");
+}
+
 static void sqlite_decimal_test_decleast(void) {
   mu_assert_query(db, "select decStr(decLeast(dec('1.0'), dec('2.0')))", "1");
   mu_assert_query(db, "select decStr(decLeast(dec('1.0'), dec('2.0'), dec('3.0')))", "1");
@@ -815,6 +909,60 @@ static void sqlite_decimal_test_dectointegral(void) {
   mu_assert_query(db, "select decStr(decToIntegral('1.49'))", "1");
 }
 
+static void sqlite_decimal_test_dectojson(void) {
+  mu_assert_query(db, "select decToJson('1.500'), decToJson('-1E+50'), decToJson('NaN') is null",
+                  "1.5", "-100000000000000000000000000000000000000000000000000", "1");
+  mu_assert_query(db, "select decToJson('1E+3'), decToJson('1.234567890123456789E+22'), decToJson('-0.00E+5')",
+                  "1000", "12345678901234567890000", "-0");
+  mu_assert_query(db, "select decToJson('1.5E-10'), decToJson('-123.45E-1'), decToJson('0.000001'), decToJson('12E-2')",
+                  "0.00000000015", "-12.345", "0.000001", "0.12");
+  // Numbers that would need too many zeros are written in scientific notation
+  mu_assert_query(db, "select decToJson('1E+100'), decToJson('-2.5E-100')", "1E+100", "-2.5E-100");
+}
+
+static void sqlite_decimal_test_dectobid128(void) {
+  mu_assert_query(db, "select hex(decToBID128(dec(1))), hex(decToBID128('9999999999999999999999999999999999'))",
+                  "01000000000000000000000000004030", "FFFFFFFF638E8D37C087ADBE09ED4130");
+  mu_assert_query(db, "select decStr(decFromBID128(decToBID128('1.23456789012345678901234567890123456789')))",
+                  "1.234567890123456789012345678901235");
+  mu_assert_query(db, "select decStr(decFromBID128(decToBID128('1E+6144'))), decStr(decFromBID128(decToBID128('1E-6176')))",
+                  "1E+6144", "1E-6176");
+}
+
+static void sqlite_decimal_test_dectodpd(void) {
+  mu_assert_query(db, "select hex(decTo64('1.5')), hex(decTo128('-1.5'))", "442234000000000015", "44A207C000000000000000000000000015");
+  // DPD blobs are accepted by the other functions
+  mu_assert_query(db, "select decStr(decAdd(decTo64('1.25'), decTo128('2.5'), dec('0.25')))", "4");
+  mu_assert_query(db, "select decStr(decTo64('12345678901234567890'))", "1.234567890123457E+19");
+  mu_assert_query(db, "select hex(decTo64('1E+1000'))", "447800000000000000");
+  mu_assert_query(db, "select flag from decStatus where flag = 'Overflow'", "Overflow");
+  // Stored DPD blobs are still recognized, even if their DPD bytes are a valid decInfinite encoding
+  mu_db_execute(db, "drop table if exists t;");
+  mu_db_execute(db, "create table t(a blob, b blob, c blob);");
+  mu_db_execute(db, "insert into t(a, b, c) values (decTo64('1.5'), decTo128('-1.5'), decTo64('370.10'));");
+  mu_assert_query(db, "select hex(c) from t", "44223000000000DC10");
+  mu_assert_query(db, "select decStr(a), decStr(b), decStr(decAdd(c, 0)) from t", "1.5", "-1.5", "370.1");
+  mu_assert_query(db, "select decStr(decFrom64(a)), decStr(decFrom128(b)) from t", "1.5", "-1.5");
+  mu_db_execute(db, "drop table t;");
+}
+
+static void sqlite_decimal_test_dectopacked(void) {
+  mu_assert_query(db, "select hex(decToPacked('123.45', 3, 2)), hex(decToPacked('-1.005', 4, 2)), hex(decToPacked(0, 1, 0))",
+                  "12345C", "0000101D", "0C");
+  mu_assert_query(db, "select hex(decToPacked('123456789012345678901234567890123456789', 20, 0))",
+                  "123456789012345678901234567890123456789C");
+  mu_assert_query(db, "select decStr(decFromPacked(decToPacked('-98765.4321', 6, 4), 4))", "-98765.4321");
+  mu_assert_query_fails(db, "select decToPacked('1234', 2, 0)", "The value does not fit in a packed decimal of 2 bytes");
+  mu_assert_query_fails(db, "select decToPacked('Inf', 2, 0)", "Only finite decimals can be packed");
+  mu_assert_query_fails(db, "select decToPacked(1, 21, 0)", "The length of a packed decimal must be between 1 and 20");
+}
+
+static void sqlite_decimal_test_dectoscaledint(void) {
+  mu_assert_query(db, "select decToScaledInt('1.005', 2), decToScaledInt(decFixed('7.5', 1), 3), decToScaledInt(-12, 0)",
+                  "101", "7500", "-12");
+  mu_assert_query_fails(db, "select decToScaledInt('1', 18)", "The value has more than 18 digits");
+}
+
 static void sqlite_decimal_test_decxor(void) {
   mu_assert_query(db, "select decStr(decXor('010', '110'))", "100");
   // decOr() works with sequences of different lengths. The result has the
@@ -823,6 +971,27 @@ static void sqlite_decimal_test_decxor(void) {
   mu_assert_query_fails(db, "select decXor('1001', '012')", "Invalid operation");
 }
 
+static void sqlite_decimal_test_collation(void) {
+  mu_db_execute(db, "create temp table coltext(x text)");
+  mu_db_execute(db, "insert into coltext values ('10'), ('9'), ('-1.5'), ('-10'), ('0'), ('-0.0'), ('1e1'), ('abc'), "
+                    "('NaN'), ('0.10'), ('.1'), ('+2'), ('-Inf'), ('123456789012345678901234567890123456789012345'), "
+                    "('00009.5'), ('1E-2')");
+  mu_assert_query(db, "select group_concat(x, ' ') from (select x from coltext order by x collate decimal, rowid)",
+                  "-Inf -10 -1.5 0 -0.0 1E-2 0.10 .1 +2 9 00009.5 10 1e1 123456789012345678901234567890123456789012345 NaN abc");
+  mu_db_execute(db, "create index temp.coltext_idx on coltext(x collate decimal)");
+  mu_assert_query(db, "select group_concat(x, ' ') from (select x from coltext where x > '9.5' collate decimal order by x collate decimal)",
+                  "10 1e1 123456789012345678901234567890123456789012345 NaN abc");
+  mu_assert_query(db, "select '1.0' = '1' collate decimal, '-0' = '0' collate decimal, '2' < '10' collate decimal", "1", "1", "1");
+  // Exponents are compared exactly, beyond the precision of decNumber
+  mu_assert_query(db, "select '1.00000000000000000000000000000000000000001' > '1E0' collate decimal, "
+                      "'1E0' = '1' collate decimal, '1.00000000000000000000000000000000000000001' > '1' collate decimal",
+                  "1", "1", "1");
+  mu_assert_query(db, "select '100000000000000000000000000000000000000001E-41' > '1' collate decimal, "
+                      "'0.0012e3' = '1.2' collate decimal, '-1E+1000000' < '-Infinity' collate decimal, '1E+1000000' < 'inf' collate decimal",
+                  "1", "1", "0", "1");
+  mu_db_execute(db, "drop table temp.coltext");
+}
+
 static void sqlite_decimal_test_rounding_modes(void) {
   mu_db_execute(db, "update decContext set round = 'ROUND_CEILING'");
   mu_assert_query(db, "select decStr(decQuantize('1.005', '1.00'))", "1.01");
@@ -998,6 +1167,632 @@ static void sqlite_decimal_test_traps_insert_null_fails(void) {
   mu_assert_query_fails(db, "insert into decTraps values (null)", "Value cannot be NULL");
 }
 
+#pragma mark Test table-valued functions
+
+static void sqlite_decimal_test_series(void) {
+  mu_assert_query(db, "select group_concat(decStr(value), ',') from decSeries('1.00', '2', '0.25')", "1,1.25,1.5,1.75,2");
+  mu_assert_query(db, "select group_concat(decStr(value), ',') from decSeries(5, 1, -2)", "5,3,1");
+  mu_assert_query(db, "select group_concat(decStr(value), ',') from decSeries('1e-30', '3e-30', '1e-30')", "1E-30,2E-30,3E-30");
+  mu_assert_query(db, "select group_concat(decStr(value), ',') from decSeries(1, '1.0000000000000000000000002', '1e-25')",
+                  "1,1.0000000000000000000000001,1.0000000000000000000000002");
+  mu_assert_query(db, "select count(*) from decSeries(1, 0)", "0");
+  mu_assert_query(db, "select count(*) from decSeries(1, null)", "0");
+  mu_assert_query(db, "select decStr(start), decStr(stop), decStr(step) from decSeries(1, 2)", "1", "2", "1");
+}
+
+static void sqlite_decimal_test_series_constraints(void) {
+  mu_assert_query(db, "select group_concat(decStr(value), ',') from decSeries(1, 10) where value >= dec('3.5') and value < dec(7)", "4,5,6");
+  mu_assert_query(db, "select group_concat(decStr(value), ',') from decSeries(1, 10, 3) where value > dec(4)", "7,10");
+  mu_assert_query(db, "select group_concat(decStr(value), ',') from decSeries(10, 1, -3) where value <= dec(7)", "7,4,1");
+  mu_assert_query(db, "select decStr(value) from decSeries(1, 10, 3) where value = dec(7)", "7");
+  mu_assert_query(db, "select count(*) from decSeries(1, 10, 3) where value = dec(8)", "0");
+  mu_assert_query(db, "select count(*) from decSeries(1, 10) where value < dec('-Inf')", "0");
+  mu_assert_query(db, "select count(*) from decSeries(1, 10) where value < dec('NaN')", "10");
+  // A blob sorts after numbers and text, whether the constraint is used or not
+  mu_assert_query(db, "select count(*) from decSeries(1, 10) where value >= '3.5'", "10");
+  mu_assert_query(db, "select count(*) from decSeries(1, 10) where +value >= '3.5'", "10");
+  mu_assert_query(db, "select count(*) from decSeries(1, 10) where value >= 3", "10");
+  mu_assert_query(db, "select count(*) from decSeries(1, 10) where value < 3", "0");
+}
+
+static void sqlite_decimal_test_series_order_by(void) {
+  mu_assert_query(db, "select group_concat(decStr(value), ',') from (select value from decSeries(0, '0.3', '0.1') order by value desc)", "0.3,0.2,0.1,0");
+  mu_assert_query(db, "select group_concat(decStr(value), ',') from (select value from decSeries(3, -3, -2) order by value)", "-3,-1,1,3");
+}
+
+static void sqlite_decimal_test_series_errors(void) {
+  mu_assert_query_fails(db, "select * from decSeries(1, 2, 0)", "The step of a series cannot be zero");
+  mu_assert_query_fails(db, "select * from decSeries(1, 'Inf')", "The stop of a series must be a finite number");
+  mu_assert_query_fails(db, "select * from decSeries", "The start and stop arguments of a series are required");
+}
+
+static void sqlite_decimal_test_random(void) {
+  mu_assert_query(db, "select count(*) from decRandom(1000, 8, -2, -2, 42)", "1000");
+  mu_assert_query(db, "select count(*) from decRandom(1000, 8, -2, -2, 42) where "
+                      "value < dec(0) or value > dec('999999.99') or value <> decQuantize(value, '0.00')", "0");
+  mu_assert_query(db, "select count(*) from decRandom(100, 3, -5, 5, 1) where "
+                      "value <> decQuantize(value, '1E-5') or value < dec(0) or value > dec('999E5')", "0");
+  mu_assert_query(db, "select count(*) from decRandom(0)", "0");
+  mu_assert_query(db, "select count(*) from decRandom(null)", "0");
+  mu_assert_query(db, "select count(*) from (select value from decRandom(100, 39, 0, 0, 7) "
+                      "except select value from decRandom(100, 39, 0, 0, 7))", "0");
+  mu_assert_query(db, "select decRandomValue(6, 0, 0, 3) = decRandomValue(6, 0, 0, 3)", "1");
+  mu_assert_query(db, "select decRandomValue(6, 0, 0, null) is null", "1");
+  mu_assert_query(db, "select decRandomValue(30, -3, -3) between dec(0) and dec('1E27')", "1");
+}
+
+static void sqlite_decimal_test_random_errors(void) {
+  mu_assert_query_fails(db, "select * from decRandom(3, 0)", "The number of digits is out of range");
+  mu_assert_query_fails(db, "select * from decRandom(3, 40)", "The number of digits is out of range");
+  mu_assert_query_fails(db, "select * from decRandom(3, 2, 5, 1)", "The minimum exponent cannot be greater than the maximum exponent");
+  mu_assert_query_fails(db, "select * from decRandom where digits = 3", "The number of rows to generate is required");
+  mu_assert_query_fails(db, "select decRandomValue(2, 0, 1000000000)", "Exponent value out of range");
+}
+
+static void sqlite_decimal_test_csv(void) {
+  mu_db_execute(db, "create virtual table temp.prices using decCsv('test/prices.csv', "
+                    "'sym text, px decimal(18,4), qty integer, note text', header)");
+  mu_assert_query(db, "select count(*) from prices", "6");
+  mu_assert_query(db, "select decStr(px), note from prices where sym = 'AAPL'", "123.45", "hello, world");
+  mu_assert_query(db, "select decStr(px), note from prices where sym = 'MSFT'", "-0.001", "say \"hi\"");
+  mu_assert_query(db, "select decStr(px), note from prices where sym = 'GOOG'", "123456.78901234567890123", "multi\nline");
+  mu_assert_query(db, "select decStr(px), note from prices where sym = 'Z'", "1E+3", "z");
+  mu_assert_query(db, "select px is null, qty is null from prices where sym = 'SHORT'", "1", "1");
+  mu_assert_query(db, "select decStr(decSum(px)), max(rejects) from prices", "124580.23801234567890123", "2");
+  mu_assert_query(db, "select max(rejects) from prices", "0"); // px is never parsed
+  mu_db_execute(db, "drop table temp.prices");
+}
+
+static void sqlite_decimal_test_csv_errors(void) {
+  mu_assert_query_fails(db, "create virtual table temp.t using decCsv('test/no such file.csv', 'a text')",
+                        "Cannot read test/no such file.csv");
+  mu_assert_query_fails(db, "create virtual table temp.t using decCsv('test/prices.csv')",
+                        "Usage: decCsv(filename, schema [, header])");
+  mu_assert_query_fails(db, "create virtual table temp.t using decCsv('test/prices.csv', 'a text', foo)",
+                        "Unknown option: foo");
+}
+
+static void sqlite_decimal_test_columnar(void) {
+  mu_db_execute(db, "create temp table colsrc(id integer primary key, px blob)");
+  mu_db_execute(db, "insert into colsrc(px) select value from decRandom(10000, 6, -2, -2, 11)");
+  mu_db_execute(db, "insert into colsrc(px) values (null), (dec('1.50')), (dec('-3'))");
+  mu_assert_query(db, "select decColumnarExport('colsrc', 'px', 'test_columnar.i64', 2)", "10003");
+  mu_assert_query(db, "select decColumnarExport('colsrc', 'px', 'test_columnar.d128')", "10003");
+  mu_db_execute(db, "create virtual table temp.coli using decColumnar('test_columnar.i64')");
+  mu_db_execute(db, "create virtual table temp.cold using decColumnar('test_columnar.d128')");
+  mu_assert_query(db, "select count(*), count(value) from coli", "10003", "10002");
+  mu_assert_query(db, "select count(*), count(value) from cold", "10003", "10002");
+  mu_assert_query(db, "select (select decSum(value) from coli) = (select decSum(px) from colsrc)", "1");
+  mu_assert_query(db, "select (select decSum(value) from cold) = (select decSum(px) from colsrc)", "1");
+  mu_assert_query(db, "select (select count(*) from coli where value between dec(100) and dec('2000.005')) = "
+                      "(select count(*) from colsrc where px between dec(100) and dec('2000.005'))", "1");
+  mu_assert_query(db, "select (select count(*) from cold where value > dec('9900')) = "
+                      "(select count(*) from colsrc where px > dec('9900'))", "1");
+  mu_assert_query(db, "select rowid, decStr(value) from coli where value = dec('1.5')", "10002", "1.5");
+  mu_assert_query(db, "select rowid, decStr(value) from cold where value = dec(-3)", "10003", "-3");
+  mu_assert_query(db, "select count(*) from coli where value < dec('-Inf')", "0");
+  mu_assert_query(db, "select count(*) from coli where value = null", "0");
+  mu_assert_query_fails(db, "select decColumnarExport('colsrc', 'px', 'test_columnar.bad', 1)",
+                        "The value at rowid 1 cannot be stored exactly");
+  mu_assert_query_fails(db, "create virtual table temp.colbad using decColumnar('test/prices.csv')",
+                        "Not a columnar decimal file: test/prices.csv");
+  // A zone map claiming more rows than a block holds
+  FILE* in = fopen("test_columnar.i64", "rb");
+  FILE* out = fopen("test_columnar.bad", "wb");
+  mu_assert(in && out, "Cannot copy test_columnar.i64");
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), in)) > 0) fwrite(buf, 1, n, out);
+  char const nRows[4] = { '\xff', '\xff', '\xff', '\xff' };
+  fseek(out, 40, SEEK_SET); // The first zone map follows the header
+  fwrite(nRows, sizeof(nRows), 1, out);
+  fclose(in);
+  fclose(out);
+  mu_assert_query_fails(db, "create virtual table temp.colbad using decColumnar('test_columnar.bad')",
+                        "Corrupt columnar decimal file: test_columnar.bad");
+  remove("test_columnar.bad");
+  mu_db_execute(db, "drop table temp.coli");
+  mu_db_execute(db, "drop table temp.cold");
+  mu_db_execute(db, "drop table temp.colsrc");
+  remove("test_columnar.i64");
+  remove("test_columnar.d128");
+}
+
+static void sqlite_decimal_test_aggscan(void) {
+  mu_db_execute(db, "create temp table aggsrc(g integer, x blob)");
+  mu_db_execute(db, "insert into aggsrc(x) select value from decRandom(5000, 12, -4, 2, 5)");
+  mu_db_execute(db, "update aggsrc set g = rowid %% 3");
+  mu_db_execute(db, "insert into aggsrc values (0, null), (1, dec('-0.001')), (2, dec('123456789012345678901234567890')), (1, 42), (2, '-7.25')");
+  mu_assert_query(db, "select count, value = (select decSum(x) from aggsrc) from decAggScan('aggsrc', 'x', 'sum')", "5004", "1");
+  mu_assert_query(db, "select value = (select decAvg(x) from aggsrc) from decAggScan('aggsrc', 'x', 'avg')", "1");
+  mu_assert_query(db, "select value = (select decMin(x) from aggsrc) from decAggScan('aggsrc', 'x', 'min')", "1");
+  mu_assert_query(db, "select value = (select decMax(x) from aggsrc) from decAggScan('aggsrc', 'x', 'max')", "1");
+  mu_assert_query(db, "select count, value = (select decSum(x) from aggsrc where g = 1) "
+                      "from decAggScan('aggsrc', 'x', 'SUM', 'g = 1')", "1669", "1");
+  mu_assert_query(db, "select decStr(value) from decAggScan('aggsrc', 'x', 'min', 'g = 1 and x < dec(0)')", "-0.001");
+  mu_assert_query(db, "select count, decStr(value) from decAggScan('aggsrc', 'x', 'sum', 'g > 2')", "0", "0");
+  mu_assert_query(db, "select decStr(value) from decAggScan('aggsrc', 'x', 'avg', 'g > 2')", "NaN");
+  mu_assert_query(db, "select decStr(value) from decAggScan('aggsrc', 'x', 'min', 'g > 2')", "-Infinity");
+  mu_assert_query(db, "select decStr(value) from decAggScan('aggsrc', 'x', 'max', 'g > 2')", "Infinity");
+  mu_db_execute(db, "insert into aggsrc values (3, dec('NaN')), (3, dec(1)), (3, dec('-0')), (3, dec('-0'))");
+  mu_assert_query(db, "select decStr(value) from decAggScan('aggsrc', 'x', 'max', 'g = 3')", "1");
+  mu_assert_query(db, "select decStr(value) from decAggScan('aggsrc', 'x', 'sum', 'g = 3 and x < dec(1)')", "-0");
+  mu_db_execute(db, "drop table temp.aggsrc");
+}
+
+static void sqlite_decimal_test_aggscan_errors(void) {
+  mu_db_execute(db, "create temp table aggsrc(x)");
+  mu_db_execute(db, "insert into aggsrc values ('1'), ('abc')");
+  mu_assert_query_fails(db, "select * from decAggScan('aggsrc', 'x')", "The table, column and operation of decAggScan are required");
+  mu_assert_query_fails(db, "select * from decAggScan('aggsrc', 'x', 'median')", "Unknown aggregate operation: median");
+  mu_assert_query_fails(db, "select * from decAggScan('aggsrc', 'y', 'sum')", "no such column: aggsrc.y");
+  mu_assert_query_fails(db, "select * from decAggScan('aggsrc', 'x', 'sum')", "Conversion syntax");
+  // Blobs that are too short or too long are reported as decSum() does
+  mu_db_execute(db, "delete from aggsrc");
+  mu_db_execute(db, "insert into aggsrc values (dec(1)), (x'')");
+  mu_assert_query_fails(db, "select decSum(x) from aggsrc", "Conversion syntax");
+  mu_assert_query_fails(db, "select * from decAggScan('aggsrc', 'x', 'sum')", "Conversion syntax");
+  mu_db_execute(db, "update aggsrc set x = zeroblob(100) where length(x) = 0");
+  mu_assert_query_fails(db, "select * from decAggScan('aggsrc', 'x', 'sum')", "Conversion syntax");
+  mu_assert_query_fails(db, "select * from decAggScan('aggsrc', 'x', 'max')", "Conversion syntax");
+  // Stored DPD blobs are decoded
+  mu_db_execute(db, "delete from aggsrc");
+  mu_db_execute(db, "insert into aggsrc values (decTo64('370.10')), (decTo128('-0.1')), (dec(1))");
+  mu_assert_query(db, "select decStr(value), value = (select decSum(x) from aggsrc) from decAggScan('aggsrc', 'x', 'sum')",
+                  "371", "1");
+  mu_assert_query(db, "select decStr(value) from decAggScan('aggsrc', 'x', 'max')", "370.1");
+  mu_db_execute(db, "drop table temp.aggsrc");
+}
+
+static void sqlite_decimal_test_arrow(void) {
+  mu_db_execute(db, "create temp table arrsrc(a, b)");
+  mu_db_execute(db, "insert into arrsrc values ('1.25', 3), (null, '-12345678901234567890123.5'), "
+                    "(dec('99999999999999999999'), '0.000'), ('-0.001', null)");
+  mu_assert_query(db, "select decArrowExport('select a, b, dec(''1E+40'') as c from arrsrc', 'test_arrow.arrow')", "4");
+  mu_db_execute(db, "create virtual table temp.arr using decArrowScan('test_arrow.arrow')");
+  mu_assert_query(db, "select decStr(a), decStr(b), decStr(c) from arr where rowid = 1", "1.25", "3", "1E+40");
+  mu_db_execute(db, "update decContext set prec = 6");
+  mu_db_execute(db, "delete from decStatus");
+  mu_assert_query(db, "select decStr(b) from arr where rowid = 2", "-1.23457E+22");
+  mu_assert_query(db, "select group_concat(flag, ', ') from (select flag from decStatus order by flag)",
+                  "Inexact result, Rounded result");
+  mu_db_execute(db, "insert into decTraps values ('Inexact result')");
+  mu_assert_query_fails(db, "select decStr(b) from arr where rowid = 2", "Inexact");
+  mu_db_execute(db, "delete from decTraps where flag = 'Inexact result'");
+  mu_db_execute(db, "update decContext set prec = 39");
+  mu_db_execute(db, "delete from decStatus");
+  mu_assert_query(db, "select count(*) from arr a join arrsrc s on a.rowid = s.rowid "
+                      "where a.a is s.a or decCompare(a.a, s.a) = dec(0)", "4");
+  mu_assert_query(db, "select count(*) from arr a join arrsrc s on a.rowid = s.rowid "
+                      "where a.b is s.b or decCompare(a.b, s.b) = dec(0)", "4");
+  mu_db_execute(db, "drop table temp.arr");
+  mu_assert_query(db, "select decArrowExport('select value from decSeries(1, 100000, ''0.5'')', 'test_arrow.arrow')", "199999");
+  mu_db_execute(db, "create virtual table temp.arr using decArrowScan('test_arrow.arrow')");
+  mu_assert_query(db, "select count(*), decSum(value) = (select decSum(value) from decSeries(1, 100000, '0.5')) from arr", "199999", "1");
+  mu_db_execute(db, "drop table temp.arr");
+  mu_assert_query(db, "select decArrowExport('select a from arrsrc where 0', 'test_arrow.arrow')", "0");
+  mu_db_execute(db, "create virtual table temp.arr using decArrowScan('test_arrow.arrow')");
+  mu_assert_query(db, "select count(*) from arr", "0");
+  mu_db_execute(db, "drop table temp.arr");
+  mu_db_execute(db, "drop table temp.arrsrc");
+  remove("test_arrow.arrow");
+}
+
+static void sqlite_decimal_test_arrow_errors(void) {
+  mu_assert_query_fails(db, "select decArrowExport('select dec(''NaN'') as n', 'test_arrow.arrow')",
+                        "The value in column n of row 1 is not finite");
+  mu_assert_query_fails(db, "select decArrowExport('select ''abc'' as x', 'test_arrow.arrow')",
+                        "Invalid decimal in column x of row 1");
+  mu_assert_query_fails(db, "select decArrowExport('select dec(''1E-40'') as x union all select dec(''1E+40'')', 'test_arrow.arrow')",
+                        "The values of column x need 81 digits, but at most 76 can be stored");
+  mu_assert_query_fails(db, "create virtual table temp.arrbad using decArrowScan('test/prices.csv')",
+                        "Not an Arrow file: test/prices.csv");
+  remove("test_arrow.arrow");
+}
+
+static void sqlite_decimal_test_parallel(void) {
+  sqlite3* pdb;
+  remove("test_parallel.db");
+  mu_assert(sqlite3_open("test_parallel.db", &pdb) == SQLITE_OK, "Cannot open test_parallel.db");
+  sqlite3_db_config(pdb, SQLITE_DBCONFIG_ENABLE_LOAD_EXTENSION, 1, NULL);
+  mu_assert(sqlite3_load_extension(pdb, "./libsqlite3decimal", "sqlite3_decimal_init", NULL) == SQLITE_OK,
+            "Cannot load the extension");
+  mu_db_execute(pdb, "create table t(x)");
+  mu_db_execute(pdb, "insert into t select value from decRandom(50000, 15, -6, 2, 3)");
+  mu_db_execute(pdb, "delete from t where rowid %% 5 = 0 or rowid between 20000 and 39000");
+  mu_db_execute(pdb, "insert into t(rowid, x) values (-100, null), (1000000, '1.25'), (1000001, 7)");
+  mu_assert_query(pdb, "select decParallelAgg('t', 'x', 'sum', 4) = decSum(x) from t", "1");
+  mu_assert_query(pdb, "select decParallelAgg('t', 'x', 'avg', 3) = decAvg(x) from t", "1");
+  mu_assert_query(pdb, "select decParallelAgg('t', 'x', 'min', 8) = decMin(x) from t", "1");
+  mu_assert_query(pdb, "select decParallelAgg('t', 'x', 'max') = decMax(x) from t", "1");
+  mu_db_execute(pdb, "delete from decStatus");
+  mu_assert_query(pdb, "select decParallelAgg('t', 'x', 'sum', 1) = decSum(x) from t", "1");
+  mu_assert_query(pdb, "select count(*) from decStatus where flag = 'Inexact result'", "0");
+  // Partial sums are exact, and the total is rounded once, whatever the
+  // number of threads
+  mu_db_execute(pdb, "create table r(x)");
+  mu_db_execute(pdb, "with recursive n(i) as (select 1 union all select i + 1 from n where i < 99) "
+                     "insert into r select dec('0.5') from n");
+  mu_db_execute(pdb, "insert into r values ('950.25')");
+  mu_db_execute(pdb, "update decContext set prec = 3");
+  mu_assert_query(pdb, "select decStr(decSum(x)) from r", "1E+3");
+  for (int nThread = 1; nThread <= 4; nThread++) {
+    char zSql[128];
+    snprintf(zSql, sizeof(zSql), "select decParallelAgg('r', 'x', 'sum', %d) = decSum(x), "
+                                 "decParallelAgg('r', 'x', 'avg', %d) = decAvg(x) from r", nThread, nThread);
+    mu_assert_query(pdb, zSql, "1", "1");
+  }
+  mu_assert_query(pdb, "select group_concat(flag, ', ') from (select flag from decStatus order by flag)",
+                  "Inexact result, Rounded result");
+  mu_db_execute(pdb, "update decContext set prec = 39");
+  mu_db_execute(pdb, "delete from decStatus");
+  mu_db_execute(pdb, "create table e(x)");
+  mu_assert_query(pdb, "select decStr(decParallelAgg('e', 'x', 'sum')), decStr(decParallelAgg('e', 'x', 'avg'))", "0", "NaN");
+  mu_assert_query_fails(pdb, "select decParallelAgg('t', 'x', 'median')", "Unknown aggregate operation: median");
+  mu_assert_query_fails(pdb, "select decParallelAgg('t', 'y', 'sum')", "no such column: t.y");
+  mu_db_execute(pdb, "insert into t values ('abc')");
+  mu_assert_query_fails(pdb, "select decParallelAgg('t', 'x', 'sum', 2)", "Conversion syntax");
+  sqlite3_close(pdb);
+  remove("test_parallel.db");
+  mu_assert_query_fails(db, "select decParallelAgg('t', 'x', 'sum')", "Parallel aggregation requires a database file");
+}
+
+static void sqlite_decimal_test_decload(void) {
+  sqlite3* ldb;
+  char zSql[128];
+  long long nCents = 0;
+  int const nRow = 300000; // Several chunks of util/decload
+  FILE* f = fopen("test_decload.csv", "w");
+  mu_assert(f != 0, "Cannot create test_decload.csv");
+  fputs("id,amount\n", f);
+  for (int i = 1; i <= nRow; i++) {
+    fprintf(f, "%d,%d.%02d\n", i, i % 1000, i % 100);
+    nCents += (i % 1000) * 100 + i % 100;
+  }
+  fclose(f);
+  remove("test_decload.db");
+  mu_assert(sqlite3_open("test_decload.db", &ldb) == SQLITE_OK, "Cannot open test_decload.db");
+  mu_db_execute(ldb, "create table t(id integer, amount decimal)");
+  sqlite3_close(ldb);
+  mu_assert(system("util/decload -H -j 4 test_decload.db t test_decload.csv >/dev/null 2>&1") == 0,
+            "util/decload failed");
+  mu_assert(sqlite3_open("test_decload.db", &ldb) == SQLITE_OK, "Cannot open test_decload.db");
+  sqlite3_db_config(ldb, SQLITE_DBCONFIG_ENABLE_LOAD_EXTENSION, 1, NULL);
+  mu_assert(sqlite3_load_extension(ldb, "./libsqlite3decimal", "sqlite3_decimal_init", NULL) == SQLITE_OK,
+            "Cannot load the extension");
+  mu_assert_query(ldb, "select count(*), min(id), max(id) from t", "300000", "1", "300000");
+  snprintf(zSql, sizeof(zSql), "select decSum(amount) = dec('%lld.%02lld') from t", nCents / 100, nCents % 100);
+  mu_assert_query(ldb, zSql, "1");
+  // Values that cannot be loaded exactly are rejected
+  f = fopen("test_decload.csv", "w");
+  mu_assert(f != 0, "Cannot create test_decload.csv");
+  fputs("1,1.5\n2,1E+9999999999\n3,1234567890123456789012345678901234567890.5\n4,abc\n5,-2\n", f);
+  fclose(f);
+  mu_db_execute(ldb, "delete from t");
+  sqlite3_close(ldb);
+  mu_assert(system("util/decload -j 2 test_decload.db t test_decload.csv >test_decload.log 2>&1") == 0,
+            "util/decload failed");
+  f = fopen("test_decload.log", "r");
+  mu_assert(f != 0, "Cannot open test_decload.log");
+  char zLog[1024];
+  size_t nLog = fread(zLog, 1, sizeof(zLog) - 1, f);
+  zLog[nLog] = 0;
+  fclose(f);
+  mu_assert(strstr(zLog, "invalid decimal in column amount (Overflow)") != 0, "Overflow not rejected");
+  mu_assert(strstr(zLog, "invalid decimal in column amount (Inexact)") != 0, "Inexact not rejected");
+  mu_assert(strstr(zLog, "2 rows loaded, 3 rejected") != 0, "Wrong number of rejected rows");
+  mu_assert(sqlite3_open("test_decload.db", &ldb) == SQLITE_OK, "Cannot open test_decload.db");
+  sqlite3_db_config(ldb, SQLITE_DBCONFIG_ENABLE_LOAD_EXTENSION, 1, NULL);
+  mu_assert(sqlite3_load_extension(ldb, "./libsqlite3decimal", "sqlite3_decimal_init", NULL) == SQLITE_OK,
+            "Cannot load the extension");
+  mu_assert_query(ldb, "select group_concat(id || ':' || decStr(amount)) from t", "1:1.5,5:-2");
+  sqlite3_close(ldb);
+  remove("test_decload.db");
+  remove("test_decload.csv");
+  remove("test_decload.log");
+}
+
+static void sqlite_decimal_test_profile(void) {
+  mu_assert_query(db, "select count(*) from decProfile", "0");
+  mu_db_execute(db, "select decProfileStart(1)");
+  mu_db_execute(db, "select decAdd(1, 2), decAdd(3, null), decDiv(4, 2)");
+  mu_assert_query_fails(db, "select decDiv(1, 0)", "Division by zero");
+  mu_db_execute(db, "select decSum(x) from (select '1.5' as x union all select 2 union all select null)");
+  mu_assert_query(db, "select calls, errors, nulls, samples from decProfile where function = 'decAdd'", "2", "0", "1", "1");
+  mu_assert_query(db, "select calls, errors, nulls, samples from decProfile where function = 'decDiv'", "2", "1", "0", "2");
+  mu_assert_query(db, "select calls, nulls from decProfile where function = 'decSum'", "3", "1");
+  mu_assert_query(db, "select total_ns > 0, decode_ns > 0, total_ns >= decode_ns + encode_ns, p50_ns <= p99_ns "
+                      "from decProfile where function = 'decDiv'", "1", "1", "1", "1");
+  mu_assert_query(db, "select histogram like '{\"decode\":[[%%],\"compute\":[%%],\"encode\":[%%],\"total\":[[%%]}' "
+                      "from decProfile where function = 'decAdd'", "1");
+  mu_db_execute(db, "select decProfileStop()");
+  mu_db_execute(db, "select decAdd(1, 2)");
+  mu_assert_query(db, "select calls from decProfile where function = 'decAdd'", "2");
+  mu_db_execute(db, "select decProfileStart()");
+  mu_db_execute(db, "select decAdd(1, 2)");
+  mu_assert_query(db, "select calls from decProfile where function = 'decAdd'", "3");
+  mu_db_execute(db, "select decProfileStop()");
+  mu_db_execute(db, "select decProfileReset()");
+  mu_assert_query(db, "select count(*) from decProfile", "0");
+  mu_assert_query_fails(db, "select decProfileStart(0)", "The sampling interval must be a positive integer");
+}
+
+static void sqlite_decimal_test_memstats(void) {
+  mu_assert_query(db, "select group_concat(site) from decMemStats", "context,profile,parse,bytes,bits");
+  mu_assert_query(db, "select count(*) from decMemStats where allocs < frees or current < 0 or peak < current", "0");
+  mu_db_execute(db, "create table memstats_t(x)");
+  mu_db_execute(db, "with recursive n(i) as (select 1 union all select i + 1 from n where i < 1000) "
+                    "insert into memstats_t select dec(i || '.' || (i %% 97)) from n");
+  mu_db_execute(db, "create temp table memstats_0 as select site, allocs, frees, current from decMemStats");
+  // The result path of the functions must not allocate: the budget is zero
+  // allocations per row.
+  mu_db_execute(db, "select decStr(decAdd(x, 1)), decMul(x, x), decDiv(x, 7), dec(decStr(x)) "
+                    "from memstats_t");
+  mu_db_execute(db, "select decSum(x), decAvg(x), decMin(x), decMax(x) from memstats_t group by rowid %% 10");
+  mu_assert_query(db, "select sum(s.allocs - m.allocs) from decMemStats s join memstats_0 m using (site)", "0");
+  // Text longer than the parser's buffer is copied once per row...
+  mu_db_execute(db, "select decTry('0.' || printf('%%.150c', '1') || rowid) from memstats_t limit 100");
+  mu_assert_query(db, "select s.allocs - m.allocs, s.frees - m.frees, s.current - m.current "
+                      "from decMemStats s join memstats_0 m using (site) where site = 'parse'", "100", "100", "0");
+  // ...and so are the diagnostics, which must not leak.
+  mu_db_execute(db, "select decBytes(x), decBits(x) from memstats_t limit 10");
+  mu_assert_query(db, "select s.allocs - m.allocs, s.current - m.current "
+                      "from decMemStats s join memstats_0 m using (site) where site = 'bytes'", "10", "0");
+  mu_assert_query_fails(db, "select decBytes(zeroblob(1000))", "Encoding too long");
+  mu_assert_query(db, "select s.allocs - m.allocs, s.current - m.current "
+                      "from decMemStats s join memstats_0 m using (site) where site = 'bytes'", "10", "0");
+  mu_db_execute(db, "drop table memstats_0");
+  mu_db_execute(db, "drop table memstats_t");
+}
+
+#if HAVE_PTHREAD_H
+/**
+ * \brief State of one thread of sqlite_decimal_test_threads().
+ */
+typedef struct threadsWorker {
+  pthread_t thread;
+  int prec;           /**< The precision set on the thread's connection. */
+  char const* zSum;   /**< The expected sum of t.x.                      */
+  int nFailed;        /**< The number of failed checks.                  */
+} threadsWorker;
+
+static void* threadsWorkerMain(void* pArg) {
+  threadsWorker* w = (threadsWorker*)pArg;
+  sqlite3* wdb;
+  sqlite3_stmt* pStmt;
+  char zSql[64];
+
+  snprintf(zSql, sizeof(zSql), "update decContext set prec = %d", w->prec);
+  if (sqlite3_open_v2("test_threads.db", &wdb, SQLITE_OPEN_READWRITE, NULL) != SQLITE_OK ||
+      sqlite3_busy_timeout(wdb, 5000) != SQLITE_OK || // Connections opened together may find the database locked
+      sqlite3_db_config(wdb, SQLITE_DBCONFIG_ENABLE_LOAD_EXTENSION, 1, NULL) != SQLITE_OK ||
+      sqlite3_load_extension(wdb, "./libsqlite3decimal", "sqlite3_decimal_init", NULL) != SQLITE_OK ||
+      sqlite3_exec(wdb, zSql, 0, 0, 0) != SQLITE_OK ||
+      sqlite3_prepare_v2(wdb, "select decStr(decSum(x)), length(decStr(decDiv(1, 3))) from t", -1, &pStmt, 0) != SQLITE_OK) {
+    w->nFailed++;
+    sqlite3_close(wdb);
+    return 0;
+  }
+  // Each connection has its own context: a precision set by another thread
+  // must not leak into this one.
+  for (int i = 0; i < 20; i++) {
+    if (sqlite3_step(pStmt) != SQLITE_ROW ||
+        strcmp((char const*)sqlite3_column_text(pStmt, 0), w->zSum) != 0 ||
+        sqlite3_column_int(pStmt, 1) != w->prec + 2)
+      w->nFailed++;
+    sqlite3_reset(pStmt);
+  }
+  sqlite3_finalize(pStmt);
+  sqlite3_close(wdb);
+  return 0;
+}
+
+static void sqlite_decimal_test_threads(void) {
+  threadsWorker aWorker[8];
+  sqlite3* pdb;
+
+  remove("test_threads.db");
+  mu_assert(sqlite3_open("test_threads.db", &pdb) == SQLITE_OK, "Cannot open test_threads.db");
+  sqlite3_db_config(pdb, SQLITE_DBCONFIG_ENABLE_LOAD_EXTENSION, 1, NULL);
+  mu_assert(sqlite3_load_extension(pdb, "./libsqlite3decimal", "sqlite3_decimal_init", NULL) == SQLITE_OK,
+            "Cannot load the extension");
+  mu_db_execute(pdb, "pragma journal_mode = wal");
+  mu_db_execute(pdb, "create table t(x)");
+  mu_db_execute(pdb, "with recursive n(i) as (select 1 union all select i + 1 from n where i < 5000) "
+                     "insert into t select dec(i || '.25') from n");
+  mu_assert_query(pdb, "select decStr(decSum(x)) from t", "12503750");
+  int nStarted = 0;
+  for (; nStarted < 8; nStarted++) {
+    aWorker[nStarted] = (threadsWorker){ .prec = 12 + 3 * nStarted, .zSum = "12503750", .nFailed = 0 };
+    if (pthread_create(&aWorker[nStarted].thread, 0, threadsWorkerMain, &aWorker[nStarted]) != 0) break;
+  }
+  int nFailed = 0;
+  for (int i = 0; i < nStarted; i++) {
+    pthread_join(aWorker[i].thread, 0);
+    nFailed += aWorker[i].nFailed;
+  }
+  mu_assert(nStarted == 8, "Cannot start the threads");
+  mu_assert(nFailed == 0, "A thread got a wrong result");
+  mu_assert_query(pdb, "select prec from decContext", "39");
+  sqlite3_close(pdb);
+  remove("test_threads.db");
+  remove("test_threads.db-wal");
+  remove("test_threads.db-shm");
+}
+#endif
+
+static void sqlite_decimal_test_materialize(void) {
+  mu_db_execute(db, "create table matsrc(acct, amt)");
+  mu_db_execute(db, "insert into matsrc values ('a', '1.50'), ('a', '2.25'), ('b', -3), ('b', null)");
+  mu_assert_query(db, "select decMaterialize('matview', 'matsrc', 'acct', "
+                      "'sum(amt), count(*), count(amt), min(amt), max(amt), avg(amt)')", "2");
+  mu_assert_query(db, "select decStr(sum_amt), count, count_amt, decStr(min_amt), decStr(max_amt), decStr(avg_amt) "
+                      "from matview where acct = 'a'", "3.75", "2", "2", "1.5", "2.25", "1.875");
+  mu_assert_query(db, "select decStr(sum_amt), count, count_amt, decStr(avg_amt) from matview where acct = 'b'",
+                  "-3", "2", "1", "-3");
+  mu_db_execute(db, "insert into matsrc values ('a', '0.5'), ('c', 7)");
+  mu_assert_query(db, "select decStr(min_amt), count from matview where acct = 'a'", "0.5", "3");
+  mu_db_execute(db, "delete from matsrc where amt = '0.5'"); // The minimum of the group
+  mu_assert_query(db, "select decStr(sum_amt), decStr(min_amt), count from matview where acct = 'a'", "3.75", "1.5", "2");
+  mu_db_execute(db, "update matsrc set amt = '10' where amt = '2.25'"); // The maximum of the group
+  mu_assert_query(db, "select decStr(sum_amt), decStr(max_amt) from matview where acct = 'a'", "11.5", "10");
+  mu_db_execute(db, "update matsrc set acct = 'b' where amt = '1.50'");
+  mu_assert_query(db, "select decStr(sum_amt), count, decStr(min_amt), decStr(max_amt) from matview where acct = 'b'",
+                  "-1.5", "3", "-3", "1.5");
+  mu_db_execute(db, "delete from matsrc where acct = 'c'");
+  mu_assert_query(db, "select count(*) from matview_state", "2");
+  mu_assert_query(db, "select count(*) from matview v where v.sum_amt is not "
+                      "(select decSum(amt) from matsrc s where s.acct = v.acct)", "0");
+  mu_assert_query(db, "select decMaterialize('mattotal', 'matsrc', '', 'sum(amt), count(*)')", "1");
+  mu_assert_query(db, "select decStr(sum_amt), count from mattotal", "8.5", "4");
+  // Without aggregated columns, no update trigger is needed
+  mu_assert_query(db, "select decMaterialize('matcount', 'matsrc', '', 'count(*)')", "1");
+  mu_assert_query(db, "select count(*) from sqlite_master where name = 'matcount_update'", "0");
+  mu_assert_query(db, "select decMaterialize('matgroup', 'matsrc', 'acct', 'count(*)')", "2");
+  mu_db_execute(db, "update matsrc set acct = 'a'");
+  mu_assert_query(db, "select acct, count from matgroup", "a", "4");
+  // The triggers and the views work with an untrusted schema
+  mu_db_execute(db, "pragma trusted_schema = off");
+  mu_db_execute(db, "insert into matsrc values ('a', '0.25')");
+  mu_assert_query(db, "select decStr(sum_amt), count, decStr(avg_amt) from matview where acct = 'a'", "8.75", "5", "2.1875");
+  mu_db_execute(db, "pragma trusted_schema = on");
+  mu_db_execute(db, "delete from matsrc");
+  mu_assert_query(db, "select count(*) from mattotal", "0");
+  mu_assert_query(db, "select count(*) from matcount", "0");
+  mu_assert_query_fails(db, "select decMaterialize('matbad', 'matsrc', 'acct', 'median(amt)')",
+                        "Invalid aggregate specification: median(amt)");
+  mu_assert_query_fails(db, "select decMaterialize('matbad', 'matsrc', 'acct', 'sum(nope)')", "no such column: matsrc.nope");
+  mu_assert_query_fails(db, "select decMaterialize('matview', 'matsrc', 'acct', 'sum(amt)')",
+                        "table \"matview_state\" already exists");
+  mu_assert_query(db, "select count(*) from sqlite_master where name like 'matbad%%'", "0");
+  mu_db_execute(db, "drop table matsrc");
+  mu_db_execute(db, "drop view matview");
+  mu_db_execute(db, "drop table matview_state");
+  mu_db_execute(db, "drop view mattotal");
+  mu_db_execute(db, "drop table mattotal_state");
+  mu_db_execute(db, "drop view matcount");
+  mu_db_execute(db, "drop table matcount_state");
+  mu_db_execute(db, "drop view matgroup");
+  mu_db_execute(db, "drop table matgroup_state");
+}
+
+static void sqlite_decimal_test_migrate(void) {
+  sqlite3* pdb;
+  remove("test_migrate.db");
+  mu_assert(sqlite3_open("test_migrate.db", &pdb) == SQLITE_OK, "Cannot open test_migrate.db");
+  sqlite3_db_config(pdb, SQLITE_DBCONFIG_ENABLE_LOAD_EXTENSION, 1, NULL);
+  mu_assert(sqlite3_load_extension(pdb, "./libsqlite3decimal", "sqlite3_decimal_init", NULL) == SQLITE_OK,
+            "Cannot load the extension");
+  mu_db_execute(pdb, "create table t(x)");
+  mu_db_execute(pdb, "insert into t values ('1.50'), (2), (2.5), ('abc'), (null), (dec('7')), "
+                     "(9223372036854775807), (0.1)");
+  mu_assert_query(pdb, "select decMigrate('t', 'x', 3)", "5");
+  mu_assert_query(pdb, "select group_concat(decStr(x), ' ') from t where typeof(x) = 'blob'",
+                  "1.5 2 2.5 7 9223372036854775807 0.1");
+  mu_assert_query(pdb, "select x from t where rowid = 4", "abc");
+  mu_assert_query(pdb, "select last_rowid, migrated, rejected, done from decMigrateProgress where tbl = 't'",
+                  "8", "5", "1", "1");
+  mu_assert_query(pdb, "select row, value, reason from decMigrateRejects", "4", "abc", "Invalid decimal");
+  // Resume an interrupted migration
+  mu_db_execute(pdb, "insert into t values ('3.14159'), (10)");
+  mu_db_execute(pdb, "update t set x = '0.5' where rowid = 1");
+  mu_db_execute(pdb, "update decMigrateProgress set last_rowid = 8, done = 0");
+  mu_assert_query(pdb, "select decMigrate('t', 'x', 1)", "2");
+  mu_assert_query(pdb, "select typeof(x) from t where rowid = 1", "text");
+  mu_assert_query(pdb, "select last_rowid, migrated, done from decMigrateProgress", "10", "7", "1");
+  // A finished migration starts over, rounding to the given scale
+  mu_db_execute(pdb, "update decContext set round = 'ROUND_DOWN'");
+  mu_db_execute(pdb, "update t set x = '3.14159' where rowid = 9");
+  mu_assert_query(pdb, "select decMigrate('t', 'x', 100, 3)", "2");
+  mu_assert_query(pdb, "select decStr(x) from t where rowid = 9", "3.141");
+  mu_assert_query(pdb, "select count(*) from decMigrateRejects", "1");
+  mu_assert_query_fails(pdb, "select decMigrate('t', 'y')", "no such column: t.y");
+  mu_assert_query_fails(pdb, "select decMigrate('t', 'x', 0)", "The number of rows per chunk must be positive");
+  mu_assert_query_fails(pdb, "select decMigrate('t', 'x', 10, 40)", "The scale must be between 0 and 39");
+  mu_db_execute(pdb, "begin");
+  mu_assert_query_fails(pdb, "select decMigrate('t', 'x')", "Migration cannot run within a transaction");
+  mu_db_execute(pdb, "rollback");
+  sqlite3_close(pdb);
+  remove("test_migrate.db");
+  mu_db_execute(db, "create temp table migsrc(x)");
+  mu_assert_query_fails(db, "select decMigrate('migsrc', 'x')", "Migration requires a database file");
+  mu_db_execute(db, "drop table temp.migsrc");
+}
+
+static void sqlite_decimal_test_validate(void) {
+  mu_assert_query(db, "select decIsValid(dec('-123.456e-7')), decIsValid(dec('NaN')), decIsValid(x'80')", "1", "1", "1");
+  mu_assert_query(db, "select decIsValid(x'81'), decIsValid(x''), decIsValid(x'4000'), decIsValid('1.5')", "0", "0", "0", "0");
+  mu_assert_query(db, "select decIsValid(x'9096'), decIsValid(x'210005'), decIsValid(x'2be8'), decIsValid(x'2800')", "1", "0", "0", "0");
+  mu_assert_query(db, "select decIsValid(null) is null", "1");
+  mu_db_execute(db, "create temp table valsrc(x)");
+  mu_db_execute(db, "insert into valsrc select value from decRandom(3000, 30, -40, 40, 7)");
+  mu_db_execute(db, "insert into valsrc values (null), (dec('-0')), (dec('Infinity'))");
+  mu_assert_query(db, "select count(*) from valsrc where decIsValid(x)", "3002");
+  mu_assert_query(db, "select count(*) from decValidate('valsrc', 'x')", "0");
+  mu_db_execute(db, "update valsrc set x = x'2be8' where rowid = 7");
+  mu_db_execute(db, "update valsrc set x = x'2800' where rowid = 2048");
+  mu_db_execute(db, "update valsrc set x = x'' where rowid = 2500");
+  mu_db_execute(db, "update valsrc set x = x'210005' where rowid = 2501");
+  mu_db_execute(db, "update valsrc set x = '1.5' where rowid = 2999");
+  mu_db_execute(db, "update valsrc set x = x'c1' where rowid = 3003");
+  mu_assert_query(db, "select group_concat(row || ':' || reason, ', ') from decValidate('valsrc', 'x')",
+                  "7:Invalid declet, 2048:Invalid least significant unit, 2500:Empty blob, 2501:Invalid padding, 2999:Not a blob, 3003:Invalid special value");
+  mu_assert_query_fails(db, "select * from decValidate('valsrc')", "The table and column of decValidate are required");
+  mu_assert_query_fails(db, "select * from decValidate('valsrc', 'y')", "no such column: valsrc.y");
+  mu_db_execute(db, "drop table temp.valsrc");
+}
+
+static void sqlite_decimal_test_encstats(void) {
+  mu_db_execute(db, "create temp table encsrc(x)");
+  mu_db_execute(db, "insert into encsrc values (dec('1.5')), (dec('-1.5')), (dec('100')), (dec('0')), (dec('-0.001')), "
+                    "(dec('123456789012345678901')), (dec('1E+400')), (dec('NaN')), (dec('-Inf')), (null), ('1.5')");
+  mu_assert_query(db, "select group_concat(value || ':' || count, ' ') from decEncodingStats('encsrc', 'x') "
+                      "where kind = 'length'", "1:3 2:2 3:2 4:1 11:1");
+  mu_assert_query(db, "select group_concat(value || ':' || count, ' ') from decEncodingStats('encsrc', 'x') "
+                      "where kind = 'exponent'", "-3:1 -1:2 0:2 2:1 400:1");
+  mu_assert_query(db, "select group_concat(value || ':' || count, ' ') from decEncodingStats('encsrc', 'x') "
+                      "where kind = 'digits'", "1:4 2:2 21:1");
+  mu_assert_query(db, "select group_concat(value || ':' || count, ' ') from decEncodingStats('encsrc', 'x') "
+                      "where kind in ('special', 'invalid')", "NaN:1 -Infinity:1");
+  mu_assert_query(db, "select count from decEncodingStats('encsrc', 'x') where kind = 'invalid'", "1");
+  mu_assert_query(db, "select group_concat(value || ':' || count || ':' || bytes, ' ') "
+                      "from decEncodingStats('encsrc', 'x') where kind = 'storage'",
+                  "infinite:9:3.11111111111111 int64:5:8.0 decimal64:7:8.0 decimal128:9:16.0");
+  // Every value is counted, with the length of its encoding
+  mu_db_execute(db, "delete from encsrc");
+  mu_db_execute(db, "insert into encsrc select value from decRandom(2000, 39, -50, 50, 11)");
+  mu_assert_query(db, "select sum(count) from decEncodingStats('encsrc', 'x') where kind = 'digits'", "2000");
+  mu_assert_query(db, "select sum(value * count) = (select sum(length(decBytes(x)) + 1) / 3 from encsrc) "
+                      "from decEncodingStats('encsrc', 'x') where kind = 'length'", "1");
+  mu_assert_query_fails(db, "select * from decEncodingStats('encsrc')", "The table and column of decEncodingStats are required");
+  mu_assert_query_fails(db, "select * from decEncodingStats('encsrc', 'y')", "no such column: encsrc.y");
+  mu_db_execute(db, "drop table temp.encsrc");
+}
+
+static void sqlite_decimal_test_try(void) {
+  mu_db_execute(db, "delete from decRejects");
+  mu_db_execute(db, "delete from decStatus");
+  mu_assert_query(db, "select decStr(decTry('1.25')), decStr(decTry(dec('-7'))), decStr(decTry(12345678901234))",
+                  "1.25", "-7", "12345678901234");
+  mu_assert_query(db, "select decStr(decTry(decFixed('3.14', 2))), decStr(decTry(decTo64(dec('2.5'))))", "3.14", "2.5");
+  mu_assert_query(db, "select decTry(null) is null, decTry('abc') is null, decTry('') is null, decTry(1.5) is null", "1", "1", "1", "1");
+  mu_db_execute(db, "insert into decTraps values ('Overflow')");
+  mu_assert_query(db, "select decTry(x'81') is null, decTry('1e999999999999') is null", "1", "1");
+  mu_db_execute(db, "delete from decTraps where flag = 'Overflow'");
+  mu_assert_query(db, "select count(*) from decStatus", "0");
+  mu_assert_query(db, "select group_concat(reason || ':' || count || ':' || coalesce(quote(sample), '-'), ', ') from decRejects",
+                  "Conversion syntax:2:'', Invalid encoding:1:X'81', Unsupported type:1:'1.5', Trapped condition:1:'1e999999999999'");
+  mu_db_execute(db, "create temp table trysrc(x)");
+  mu_db_execute(db, "insert into trysrc select decStr(value) from decRandom(990, 12, -4, 4, 11)");
+  mu_db_execute(db, "with recursive n(i) as (select 1 union all select i + 1 from n where i < 10) "
+                    "insert into trysrc select 'bad' || i from n");
+  mu_assert_query(db, "select count(decTry(x)), count(*) from trysrc", "990", "1000");
+  mu_assert_query(db, "select count, sample from decRejects where reason = 'Conversion syntax'", "12", "bad10");
+  mu_db_execute(db, "delete from decRejects where reason = 'Conversion syntax'");
+  mu_assert_query(db, "select sum(count) from decRejects", "3");
+  mu_assert_query_fails(db, "insert into decRejects values ('x', 1, 2)", "Rows can only be deleted from decRejects");
+  mu_db_execute(db, "drop table temp.trysrc");
+}
 
 #pragma mark Test runner
 
@@ -1055,6 +1850,10 @@ static void sqlite_decimal_func_tests(void) {
   mu_test(sqlite_decimal_test_direct_equality);
   mu_test(sqlite_decimal_test_decfma);
   mu_test(sqlite_decimal_test_decfromint);
+  mu_test(sqlite_decimal_test_decfixed);
+  mu_test(sqlite_decimal_test_decfrombid128);
+  mu_test(sqlite_decimal_test_decfromdpd);
+  mu_test(sqlite_decimal_test_decfrompacked);
   mu_test(sqlite_decimal_test_decgetexponent);
   mu_test(sqlite_decimal_test_decgreatest);
   mu_test(sqlite_decimal_test_decinvert);
@@ -1070,6 +1869,8 @@ static void sqlite_decimal_func_tests(void) {
   mu_test(sqlite_decimal_test_decissubnormal);
   mu_test(sqlite_decimal_test_deciszero);
   mu_test(sqlite_decimal_test_decisnan);
+  mu_test(sqlite_decimal_test_decjson);
+  mu_test(sqlite_decimal_test_decjsonsum);
   mu_test(sqlite_decimal_test_decleast);
   mu_test(sqlite_decimal_test_dec_less_than);
   mu_test(sqlite_decimal_test_direct_less_than);
@@ -1097,8 +1898,14 @@ static void sqlite_decimal_func_tests(void) {
   mu_test(sqlite_decimal_test_decsum_null);
   mu_test(sqlite_decimal_test_dectoint32);
   mu_test(sqlite_decimal_test_dectointegral);
+  mu_test(sqlite_decimal_test_dectojson);
+  mu_test(sqlite_decimal_test_dectobid128);
+  mu_test(sqlite_decimal_test_dectodpd);
+  mu_test(sqlite_decimal_test_dectopacked);
+  mu_test(sqlite_decimal_test_dectoscaledint);
   mu_test(sqlite_decimal_test_decxor);
   mu_test(sqlite_decimal_test_rounding_modes);
+  mu_test(sqlite_decimal_test_collation);
 }
 
 static void sqlite_decimal_vtab_tests(void) {
@@ -1119,5 +1926,30 @@ static void sqlite_decimal_vtab_tests(void) {
   mu_test(sqlite_decimal_test_traps_default);
   mu_test(sqlite_decimal_test_traps_division_impossible_flag);
   mu_test(sqlite_decimal_test_traps_insert_null_fails);
+  mu_test(sqlite_decimal_test_series);
+  mu_test(sqlite_decimal_test_series_constraints);
+  mu_test(sqlite_decimal_test_series_order_by);
+  mu_test(sqlite_decimal_test_series_errors);
+  mu_test(sqlite_decimal_test_random);
+  mu_test(sqlite_decimal_test_random_errors);
+  mu_test(sqlite_decimal_test_csv);
+  mu_test(sqlite_decimal_test_csv_errors);
+  mu_test(sqlite_decimal_test_columnar);
+  mu_test(sqlite_decimal_test_aggscan);
+  mu_test(sqlite_decimal_test_aggscan_errors);
+  mu_test(sqlite_decimal_test_arrow);
+  mu_test(sqlite_decimal_test_arrow_errors);
+  mu_test(sqlite_decimal_test_parallel);
+  mu_test(sqlite_decimal_test_decload);
+#if HAVE_PTHREAD_H
+  mu_test(sqlite_decimal_test_threads);
+#endif
+  mu_test(sqlite_decimal_test_materialize);
+  mu_test(sqlite_decimal_test_migrate);
+  mu_test(sqlite_decimal_test_validate);
+  mu_test(sqlite_decimal_test_encstats);
+  mu_test(sqlite_decimal_test_try);
+  mu_test(sqlite_decimal_test_profile);
+  mu_test(sqlite_decimal_test_memstats);
 }
 
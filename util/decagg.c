@@ -0,0 +1,79 @@
+/**
+ * \file      decagg.c
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     Aggregates a decimal column of a database file in parallel.
+ *
+ * Usage:
+ *
+ *     decagg [-j threads] [-x extension] database table column op
+ *
+ * where `op` is one of `sum`, `avg`, `min` or `max`. The program loads the
+ * extension (by default, `./libsqlite3decimal`) and prints the result of
+ * `decParallelAgg()` followed by the elapsed time on standard error. By
+ * default, one thread per online processor is used.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sqlite3.h"
+
+static void usage(char const* zProg) {
+  fprintf(stderr, "Usage: %s [-j threads] [-x extension] database table column op\n", zProg);
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char* argv[]) {
+  char const* zExt = "./libsqlite3decimal";
+  int nThread = 0;
+  int i;
+
+  for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) nThread = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-x") == 0 && i + 1 < argc) zExt = argv[++i];
+    else usage(argv[0]);
+  }
+  if (argc - i != 4) usage(argv[0]);
+
+  sqlite3* db;
+  sqlite3_stmt* pStmt = 0;
+  char* zErrMsg = 0;
+  int rc = sqlite3_open_v2(argv[i], &db, SQLITE_OPEN_READONLY, 0);
+
+  if (rc == SQLITE_OK)
+    rc = sqlite3_db_config(db, SQLITE_DBCONFIG_ENABLE_LOAD_EXTENSION, 1, 0);
+  if (rc == SQLITE_OK && sqlite3_load_extension(db, zExt, "sqlite3_decimal_init", &zErrMsg) != SQLITE_OK) {
+    fprintf(stderr, "Cannot load %s: %s\n", zExt, zErrMsg);
+    sqlite3_free(zErrMsg);
+    sqlite3_close(db);
+    return EXIT_FAILURE;
+  }
+  if (rc == SQLITE_OK)
+    rc = sqlite3_prepare_v2(db, "select decStr(decParallelAgg(?1, ?2, ?3, ?4))", -1, &pStmt, 0);
+  if (rc == SQLITE_OK) {
+    struct timespec start, end;
+
+    sqlite3_bind_text(pStmt, 1, argv[i + 1], -1, SQLITE_STATIC);
+    sqlite3_bind_text(pStmt, 2, argv[i + 2], -1, SQLITE_STATIC);
+    sqlite3_bind_text(pStmt, 3, argv[i + 3], -1, SQLITE_STATIC);
+    sqlite3_bind_int(pStmt, 4, nThread);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (sqlite3_step(pStmt) == SQLITE_ROW) {
+      clock_gettime(CLOCK_MONOTONIC, &end);
+      printf("%s\n", (char const*)sqlite3_column_text(pStmt, 0));
+      fprintf(stderr, "%.3fs\n", (double)(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+    }
+    rc = sqlite3_finalize(pStmt);
+  }
+  if (rc != SQLITE_OK) fprintf(stderr, "%s\n", sqlite3_errmsg(db));
+  sqlite3_close(db);
+  return rc == SQLITE_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,769 @@
+/**
+ * \file      decload.c
+ * \author    Lifepillar
+ * \copyright Copyright (c) 2019 Lifepillar.
+ *            This program is free software; you can redistribute it and/or
+ *            modify it under the terms of the Simplified BSD License (also
+ *            known as the "2-Clause License" or "FreeBSD License".)
+ * \copyright This program is distributed in the hope that it will be useful,
+ *            but without any warranty; without even the implied warranty of
+ *            merchantability or fitness for a particular purpose.
+ *
+ * \brief     Loads a CSV or TSV file into a table with decimal columns.
+ *
+ * Usage:
+ *
+ *     decload [-t] [-d delimiter] [-H] [-j threads] [-b rows]
+ *             [-m journal_mode] [-s synchronous] [-x extension]
+ *             database table file
+ *
+ * The table must exist. Each record of the file (`-` for standard input)
+ * must have one field per column of the table. The fields of the columns
+ * declared as `decimal` are encoded by the program and inserted as blobs;
+ * the other fields are inserted as text, and empty fields as `NULL`. With
+ * `-t` the file is tab-separated, without quoting; otherwise, it is
+ * a comma-separated (or `-d`-separated) file with optional double quotes.
+ * `-H` skips the header.
+ *
+ * The file is read in chunks of whole records by a reader thread, and the
+ * chunks are parsed and encoded by `-j` worker threads (by default, one per
+ * online processor, less one for the writer; with `-j 0`, the main thread
+ * reads and parses the chunks itself). The main thread inserts the
+ * parsed rows in order, with a single prepared statement, committing every
+ * `-b` rows. `-m` and `-s` set the `journal_mode` and `synchronous` pragmas
+ * for the load. `-x` loads an extension, which is needed when the table has
+ * triggers calling decimal functions.
+ *
+ * Records that cannot be parsed or inserted are rejected: the first ones are
+ * reported on standard error, followed by the number of loaded and rejected
+ * records and the throughput.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sqlite3.h"
+#include "decInfinite.h"
+
+#if HAVE_PTHREAD_H && HAVE_PTHREAD_CREATE
+#include <pthread.h>
+#include <unistd.h>
+#define LOAD_HAVE_THREADS 1
+#endif
+
+/**
+ * \brief The conditions that reject a decimal field.
+ *
+ * These are the conditions that the extension traps by default and
+ * `Inexact`, since a loaded value must be the one in the file.
+ */
+#define LOAD_REJECTED_CONDITIONS (DEC_Errors | DEC_Inexact)
+/** \brief The size of the chunks the file is read in. */
+#define LOAD_CHUNK_SIZE (1 << 20)
+/** \brief The maximum number of worker threads. */
+#define LOAD_MAX_THREADS 256
+/** \brief The maximum number of rejected records that are reported. */
+#define LOAD_MAX_REPORTED 10
+
+/**
+ * \brief The state of a chunk.
+ */
+typedef enum {
+  LOAD_EMPTY,    /**< The chunk can be filled by the reader. */
+  LOAD_READ,     /**< The chunk waits for a worker.          */
+  LOAD_PARSING,  /**< A worker is parsing the chunk.         */
+  LOAD_PARSED    /**< The chunk waits for the writer.        */
+} loadState;
+
+/**
+ * \brief A parsed field.
+ */
+typedef struct loadCell {
+  int type;    /**< `SQLITE_NULL`, `SQLITE_TEXT` or `SQLITE_BLOB`.         */
+  int n;       /**< The length of the value.                               */
+  size_t off;  /**< The offset of the value into the text or the blobs. */
+} loadCell;
+
+/**
+ * \brief A rejected record.
+ */
+typedef struct loadRejected {
+  sqlite3_int64 iRecord;  /**< The number of the record. */
+  char zReason[96];       /**< Why it was rejected.      */
+} loadRejected;
+
+/**
+ * \brief A chunk of whole records, and its parsed rows.
+ */
+typedef struct loadChunk {
+  loadState state;                           /**< The state of the chunk.                */
+  sqlite3_int64 seq;                         /**< The position of the chunk in the file. */
+  char* zText;                               /**< The records (dequoted in place).      */
+  size_t nText;                              /**< The length of zText.                  */
+  size_t nTextAlloc;                         /**< The allocated size of zText.          */
+  sqlite3_int64 iFirst;                      /**< The number of the first record.       */
+  int nRow;                                  /**< The number of parsed rows.            */
+  int nRowAlloc;                             /**< The rows that aCell and aRecord fit.  */
+  loadCell* aCell;                           /**< The fields, nCol per row.             */
+  sqlite3_int64* aRecord;                    /**< The number of the record of each row.  */
+  uint8_t* aBlob;                            /**< The encoded decimals.                 */
+  size_t nBlob;                              /**< The length of aBlob.                  */
+  size_t nBlobAlloc;                         /**< The allocated size of aBlob.          */
+  sqlite3_int64 nReject;                     /**< The number of rejected records.       */
+  int nReported;                             /**< The number of entries of aReport.     */
+  loadRejected aReport[LOAD_MAX_REPORTED];   /**< The first rejected records.           */
+} loadChunk;
+
+/**
+ * \brief The state of a load.
+ */
+typedef struct loadJob {
+  FILE* in;                  /**< The input file.                                   */
+  char cDelim;               /**< The field delimiter.                              */
+  int useQuotes;             /**< Whether fields may be double-quoted.              */
+  int hasHeader;             /**< Whether the first record must be skipped.        */
+  int nCol;                  /**< The number of columns of the table.               */
+  char** azCol;              /**< The names of the columns.                         */
+  uint8_t* aDecimal;         /**< Whether each column is a decimal column.          */
+  char* zCarry;              /**< The partial record following the last chunk.      */
+  size_t nCarry;             /**< The length of zCarry.                             */
+  size_t nCarryAlloc;        /**< The allocated size of zCarry.                     */
+  sqlite3_int64 nRecord;     /**< The number of records read so far.                */
+  int isInputEof;            /**< Whether the reader has reached the end of the file. */
+  int isEof;                 /**< Whether all the chunks have been read.            */
+  int isAborted;             /**< Whether the load has been aborted.                */
+  int nChunk;                /**< The number of chunks.                             */
+  loadChunk* aChunk;         /**< The chunks, used as a ring.                       */
+  sqlite3_int64 nRead;       /**< The number of chunks read.                        */
+  sqlite3_int64 nParse;      /**< The number of chunks taken by the workers.        */
+#if LOAD_HAVE_THREADS
+  pthread_mutex_t mutex;     /**< Protects the states of the chunks and the counters. */
+  pthread_cond_t cond;       /**< Signals any change of state.                      */
+#endif
+} loadJob;
+
+static void usage(char const* zProg) {
+  fprintf(stderr, "Usage: %s [-t] [-d delimiter] [-H] [-j threads] [-b rows] [-m journal_mode] [-s synchronous] "
+                  "[-x extension] database table file\n", zProg);
+  exit(EXIT_FAILURE);
+}
+
+/**
+ * \brief Grows a buffer, if needed, so that it fits \a n bytes.
+ *
+ * \return `1` on success; `0` if memory is exhausted.
+ */
+static int loadReserve(void** pBuf, size_t* pnAlloc, size_t n) {
+  if (n <= *pnAlloc) return 1;
+  size_t nAlloc = *pnAlloc ? *pnAlloc : 4096;
+  while (nAlloc < n) nAlloc *= 2;
+  void* p = realloc(*pBuf, nAlloc);
+  if (p == 0) return 0;
+  *pBuf = p;
+  *pnAlloc = nAlloc;
+  return 1;
+}
+
+#pragma mark Reading
+
+/**
+ * \brief Returns the end of the last whole record of a chunk, and counts its
+ *        records.
+ *
+ * \return The length of the whole records, or `0` if there are none.
+ */
+static size_t loadLastRecord(loadJob const* job, char const* z, size_t n, sqlite3_int64* pnRecord) {
+  size_t end = 0;
+  sqlite3_int64 nRecord = 0;
+  int inQuotes = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (z[i] == '"' && job->useQuotes) inQuotes = !inQuotes;
+    else if (z[i] == '\n' && !inQuotes) {
+      end = i + 1;
+      nRecord++;
+    }
+  }
+  *pnRecord = nRecord;
+  return end;
+}
+
+/**
+ * \brief Fills a chunk with the next whole records of the file.
+ *
+ * Only the reader calls this function, and only the reader sees
+ * `isInputEof`: the other threads learn about the end of the file from
+ * `isEof`, which is set under the mutex after the last chunk is published.
+ *
+ * \return `1` if the chunk has records; `0` at the end of the file; `-1` on
+ *         error.
+ */
+static int loadRead(loadJob* job, loadChunk* chunk) {
+  sqlite3_int64 nRecord = 0;
+  size_t nWhole = 0;
+  chunk->nText = 0;
+  if (!loadReserve((void**)&chunk->zText, &chunk->nTextAlloc, job->nCarry + LOAD_CHUNK_SIZE)) goto read_error;
+  memcpy(chunk->zText, job->zCarry, job->nCarry);
+  chunk->nText = job->nCarry;
+  job->nCarry = 0;
+
+  while (!job->isInputEof) {
+    if (!loadReserve((void**)&chunk->zText, &chunk->nTextAlloc, chunk->nText + LOAD_CHUNK_SIZE)) goto read_error;
+    size_t const nGot = fread(chunk->zText + chunk->nText, 1, LOAD_CHUNK_SIZE, job->in);
+    chunk->nText += nGot;
+    if (nGot < LOAD_CHUNK_SIZE) {
+      if (ferror(job->in)) goto read_error;
+      job->isInputEof = 1;
+    }
+    nWhole = loadLastRecord(job, chunk->zText, chunk->nText, &nRecord);
+    if (nWhole > 0) break; // Otherwise, a record is longer than a chunk
+  }
+  if (job->isInputEof) { // The last record may not end with a newline
+    if (nWhole < chunk->nText) nRecord++;
+    nWhole = chunk->nText;
+  }
+  else {
+    job->nCarry = chunk->nText - nWhole;
+    if (!loadReserve((void**)&job->zCarry, &job->nCarryAlloc, job->nCarry)) goto read_error;
+    memcpy(job->zCarry, chunk->zText + nWhole, job->nCarry);
+    chunk->nText = nWhole;
+  }
+  chunk->iFirst = job->nRecord + 1;
+  job->nRecord += nRecord;
+  return chunk->nText > 0;
+
+read_error:
+  fprintf(stderr, "Cannot read the input file\n");
+  return -1;
+}
+
+#pragma mark Parsing
+
+/**
+ * \brief Records a rejected record.
+ */
+static void loadReject(loadChunk* chunk, sqlite3_int64 iRecord, char const* zReason) {
+  if (chunk->nReported < LOAD_MAX_REPORTED) {
+    chunk->aReport[chunk->nReported].iRecord = iRecord;
+    snprintf(chunk->aReport[chunk->nReported].zReason, sizeof(chunk->aReport[0].zReason), "%s", zReason);
+    chunk->nReported++;
+  }
+  chunk->nReject++;
+}
+
+/**
+ * \brief Returns the name of the condition that rejects a decimal field.
+ *
+ * An error is reported rather than the `Inexact` condition that comes with it.
+ */
+static char const* loadConditionName(uint32_t status) {
+  decContext ctx;
+  uint32_t const flags = (status & DEC_Errors) ? (status & DEC_Errors) : DEC_Inexact;
+  decContextDefault(&ctx, DEC_INIT_BASE);
+  ctx.status = flags & (~flags + 1); // A single one
+  return decContextStatusToString(&ctx);
+}
+
+/**
+ * \brief Encodes the text of a decimal field.
+ *
+ * \return `1` on success; `0` if the text is not a number, or if it cannot be
+ *         encoded exactly (see #LOAD_REJECTED_CONDITIONS), in which case the
+ *         status of \a decCtx tells why; `-1` if memory is exhausted.
+ */
+static int loadEncode(loadChunk* chunk, char const* z, int n, decContext* decCtx, loadCell* cell) {
+  char zBuf[128];
+  char* zNum = zBuf;
+  decNumber decnum;
+
+  while (n > 0 && (*z == ' ' || *z == '\t')) {
+    z++;
+    n--;
+  }
+  while (n > 0 && (z[n - 1] == ' ' || z[n - 1] == '\t')) n--;
+  if (n >= (int)sizeof(zBuf) && (zNum = malloc((size_t)n + 1)) == 0) return -1;
+  memcpy(zNum, z, (size_t)n);
+  zNum[n] = 0;
+  decContextZeroStatus(decCtx);
+  decNumberFromString(&decnum, zNum, decCtx);
+  if (zNum != zBuf) free(zNum);
+  if (decCtx->status & LOAD_REJECTED_CONDITIONS) return 0;
+  if (!loadReserve((void**)&chunk->aBlob, &chunk->nBlobAlloc, chunk->nBlob + DECINF_MAXSIZE)) return -1;
+  cell->type = SQLITE_BLOB;
+  cell->off = chunk->nBlob;
+  cell->n = (int)decInfiniteFromNumber(DECINF_MAXSIZE, chunk->aBlob + chunk->nBlob, &decnum);
+  chunk->nBlob += (size_t)cell->n;
+  return 1;
+}
+
+/**
+ * \brief Splits the records of a chunk into fields and encodes the decimal
+ *        fields.
+ *
+ * \return `1` on success; `0` if memory is exhausted.
+ */
+static int loadParse(loadJob const* job, loadChunk* chunk) {
+  char* p = chunk->zText;
+  char* const end = chunk->zText + chunk->nText;
+  sqlite3_int64 iRecord = chunk->iFirst;
+  char const cDelim = job->cDelim;
+  decContext decCtx;
+
+  decContextDefault(&decCtx, DEC_INIT_BASE);
+  decCtx.digits = DECNUMDIGITS;
+  decCtx.traps = 0;
+  chunk->nRow = 0;
+  chunk->nBlob = 0;
+  chunk->nReject = 0;
+  chunk->nReported = 0;
+  if (chunk->iFirst == 1 && job->hasHeader) { // Skip the header
+    int inQuotes = 0;
+    while (p < end && (*p != '\n' || inQuotes)) {
+      if (*p == '"' && job->useQuotes) inQuotes = !inQuotes;
+      p++;
+    }
+    if (p < end) p++;
+    iRecord++;
+  }
+
+  for (; p < end; iRecord++) {
+    char const* zError = 0;
+    char zReason[96];
+    int nField = 0;
+    size_t const nBlob = chunk->nBlob;
+
+    if (*p == '\n' || (*p == '\r' && p + 1 < end && p[1] == '\n')) { // Empty line
+      p += (*p == '\r') ? 2 : 1;
+      continue;
+    }
+    if (chunk->nRow == chunk->nRowAlloc) {
+      int const nAlloc = chunk->nRowAlloc ? 2 * chunk->nRowAlloc : 1024;
+      loadCell* aCell = realloc(chunk->aCell, sizeof(loadCell) * (size_t)nAlloc * (size_t)job->nCol);
+      if (aCell) chunk->aCell = aCell;
+      sqlite3_int64* aRecord = realloc(chunk->aRecord, sizeof(sqlite3_int64) * (size_t)nAlloc);
+      if (aRecord) chunk->aRecord = aRecord;
+      if (aCell == 0 || aRecord == 0) return 0;
+      chunk->nRowAlloc = nAlloc;
+    }
+    loadCell* aCell = chunk->aCell + (size_t)chunk->nRow * (size_t)job->nCol;
+
+    for (;;) {
+      char* z = p;
+      int n;
+      int isQuoted = 0;
+      if (job->useQuotes && *p == '"') {
+        char* out = z;
+        isQuoted = 1;
+        for (p++;; p++) {
+          if (p == end) {
+            zError = "unterminated quoted field";
+            break;
+          }
+          if (*p == '"') {
+            if (p + 1 < end && p[1] == '"') p++;
+            else {
+              p++;
+              break;
+            }
+          }
+          *out++ = *p;
+        }
+        n = (int)(out - z);
+        if (p < end && *p == '\r') p++;
+        if (zError == 0 && p < end && *p != cDelim && *p != '\n') zError = "unexpected character after a quoted field";
+      }
+      else {
+        while (p < end && *p != cDelim && *p != '\n') p++;
+        n = (int)(p - z);
+        if (n > 0 && z[n - 1] == '\r' && (p == end || *p == '\n')) n--;
+      }
+      if (zError) break;
+      if (nField < job->nCol) {
+        loadCell* cell = &aCell[nField];
+        if (n == 0 && (!isQuoted || job->aDecimal[nField]))
+          cell->type = SQLITE_NULL;
+        else if (job->aDecimal[nField]) {
+          int const ok = loadEncode(chunk, z, n, &decCtx, cell);
+          if (ok < 0) return 0;
+          if (ok == 0 && zError == 0) {
+            snprintf(zReason, sizeof(zReason), "invalid decimal in column %s (%s)", job->azCol[nField],
+                     loadConditionName(decCtx.status));
+            zError = zReason;
+          }
+        }
+        else {
+          cell->type = SQLITE_TEXT;
+          cell->off = (size_t)(z - chunk->zText);
+          cell->n = n;
+        }
+      }
+      nField++;
+      if (p < end && *p == cDelim) p++;
+      else break;
+    }
+    // Skip the rest of a malformed record
+    int inQuotes = 0;
+    while (p < end && (*p != '\n' || inQuotes)) {
+      if (*p == '"' && job->useQuotes) inQuotes = !inQuotes;
+      p++;
+    }
+    if (p < end) p++;
+
+    if (zError == 0 && nField != job->nCol) {
+      snprintf(zReason, sizeof(zReason), "expected %d fields, found %d", job->nCol, nField);
+      zError = zReason;
+    }
+    if (zError) {
+      chunk->nBlob = nBlob;
+      loadReject(chunk, iRecord, zError);
+      continue;
+    }
+    chunk->aRecord[chunk->nRow++] = iRecord;
+  }
+  return 1;
+}
+
+#pragma mark Pipeline
+
+#if LOAD_HAVE_THREADS
+/**
+ * \brief Reads the file into the chunks, in order.
+ */
+static void* loadReaderMain(void* pArg) {
+  loadJob* job = pArg;
+  for (sqlite3_int64 seq = 0;; seq++) {
+    loadChunk* chunk = &job->aChunk[seq % job->nChunk];
+    pthread_mutex_lock(&job->mutex);
+    while (chunk->state != LOAD_EMPTY && !job->isAborted) pthread_cond_wait(&job->cond, &job->mutex);
+    int const isAborted = job->isAborted;
+    pthread_mutex_unlock(&job->mutex);
+    if (isAborted) break;
+
+    int const hasRecords = loadRead(job, chunk);
+    int const isDone = hasRecords <= 0 || job->isInputEof;
+    pthread_mutex_lock(&job->mutex);
+    if (hasRecords > 0) {
+      chunk->seq = seq;
+      chunk->state = LOAD_READ;
+      job->nRead++;
+    }
+    if (hasRecords < 0)
+      job->isAborted = 1;
+    else if (isDone) // Only once the last chunk has been published
+      job->isEof = 1;
+    pthread_cond_broadcast(&job->cond);
+    pthread_mutex_unlock(&job->mutex);
+    if (isDone) break;
+  }
+  return 0;
+}
+
+/**
+ * \brief Parses the chunks that have been read, in any order.
+ */
+static void* loadWorkerMain(void* pArg) {
+  loadJob* job = pArg;
+  for (;;) {
+    pthread_mutex_lock(&job->mutex);
+    while (job->nParse == job->nRead && !job->isEof && !job->isAborted) pthread_cond_wait(&job->cond, &job->mutex);
+    if (job->nParse == job->nRead || job->isAborted) {
+      pthread_mutex_unlock(&job->mutex);
+      break;
+    }
+    loadChunk* chunk = &job->aChunk[job->nParse++ % job->nChunk];
+    chunk->state = LOAD_PARSING;
+    pthread_mutex_unlock(&job->mutex);
+
+    int const ok = loadParse(job, chunk);
+    pthread_mutex_lock(&job->mutex);
+    chunk->state = LOAD_PARSED;
+    if (!ok) {
+      fprintf(stderr, "Out of memory\n");
+      job->isAborted = 1;
+    }
+    pthread_cond_broadcast(&job->cond);
+    pthread_mutex_unlock(&job->mutex);
+  }
+  return 0;
+}
+#endif
+
+/**
+ * \brief Returns the next chunk in file order, once it has been parsed.
+ *
+ * \return The chunk, or `0` at the end of the file or if the load has been
+ *         aborted.
+ */
+static loadChunk* loadNextChunk(loadJob* job, sqlite3_int64 seq, int nThread) {
+  loadChunk* chunk = &job->aChunk[seq % job->nChunk];
+  if (nThread == 0) {
+    int const hasRecords = loadRead(job, chunk);
+    if (hasRecords < 0) job->isAborted = 1;
+    if (hasRecords <= 0) return 0;
+    if (!loadParse(job, chunk)) {
+      fprintf(stderr, "Out of memory\n");
+      job->isAborted = 1;
+      return 0;
+    }
+    return chunk;
+  }
+#if LOAD_HAVE_THREADS
+  pthread_mutex_lock(&job->mutex);
+  while (!(chunk->state == LOAD_PARSED && chunk->seq == seq) && !(job->isEof && seq == job->nRead) && !job->isAborted)
+    pthread_cond_wait(&job->cond, &job->mutex);
+  if (!(chunk->state == LOAD_PARSED && chunk->seq == seq) || job->isAborted) chunk = 0;
+  pthread_mutex_unlock(&job->mutex);
+#endif
+  return chunk;
+}
+
+/**
+ * \brief Gives a chunk back to the reader.
+ */
+static void loadReleaseChunk(loadJob* job, loadChunk* chunk, int nThread) {
+  (void)nThread;
+#if LOAD_HAVE_THREADS
+  if (nThread > 0) {
+    pthread_mutex_lock(&job->mutex);
+    chunk->state = LOAD_EMPTY;
+    pthread_cond_broadcast(&job->cond);
+    pthread_mutex_unlock(&job->mutex);
+    return;
+  }
+#endif
+  (void)job;
+  chunk->state = LOAD_EMPTY;
+}
+
+#pragma mark Writing
+
+/**
+ * \brief Reads the columns of the table.
+ *
+ * Declared types are read from `table_info`, because the bundled SQLite is
+ * compiled without sqlite3_column_decltype().
+ */
+static int loadColumns(sqlite3* db, char const* zTable, loadJob* job) {
+  sqlite3_stmt* pStmt = 0;
+  int rc = sqlite3_prepare_v2(db, "select name, type from pragma_table_info(?1) order by cid", -1, &pStmt, 0);
+  if (rc != SQLITE_OK) return rc;
+  sqlite3_bind_text(pStmt, 1, zTable, -1, SQLITE_STATIC);
+  while (rc == SQLITE_OK && sqlite3_step(pStmt) == SQLITE_ROW) {
+    char const* zType = (char const*)sqlite3_column_text(pStmt, 1);
+    char** azCol = realloc(job->azCol, sizeof(char*) * (size_t)(job->nCol + 1));
+    if (azCol) job->azCol = azCol;
+    uint8_t* aDecimal = realloc(job->aDecimal, (size_t)(job->nCol + 1));
+    if (aDecimal) job->aDecimal = aDecimal;
+    if (azCol == 0 || aDecimal == 0 || (azCol[job->nCol] = sqlite3_mprintf("%s", sqlite3_column_text(pStmt, 0))) == 0)
+      rc = SQLITE_NOMEM;
+    else
+      aDecimal[job->nCol++] = zType && sqlite3_strnicmp(zType, "decimal", 7) == 0;
+  }
+  if (rc == SQLITE_OK) rc = sqlite3_finalize(pStmt);
+  else
+    sqlite3_finalize(pStmt);
+  if (rc == SQLITE_OK && job->nCol == 0) {
+    fprintf(stderr, "No such table: %s\n", zTable);
+    rc = SQLITE_ERROR;
+  }
+  return rc;
+}
+
+/**
+ * \brief Prepares the insert statement.
+ */
+static int loadPrepareInsert(sqlite3* db, char const* zTable, int nCol, sqlite3_stmt** ppStmt) {
+  sqlite3_str* s = sqlite3_str_new(db);
+  sqlite3_str_appendf(s, "insert into \"%w\" values (", zTable);
+  for (int i = 0; i < nCol; i++) sqlite3_str_appendall(s, i ? ", ?" : "?");
+  sqlite3_str_appendall(s, ")");
+  char* zSql = sqlite3_str_finish(s);
+  int const rc = zSql ? sqlite3_prepare_v2(db, zSql, -1, ppStmt, 0) : SQLITE_NOMEM;
+  sqlite3_free(zSql);
+  return rc;
+}
+
+/**
+ * \brief Inserts the rows of a chunk.
+ *
+ * \return `SQLITE_OK` on success; an error code if the load must stop.
+ */
+static int loadWrite(sqlite3* db, sqlite3_stmt* pStmt, loadJob const* job, loadChunk* chunk, int nBatch,
+                     sqlite3_int64* pnRow) {
+  int rc = SQLITE_OK;
+  for (int r = 0; r < chunk->nRow && rc == SQLITE_OK; r++) {
+    loadCell const* aCell = chunk->aCell + (size_t)r * (size_t)job->nCol;
+    for (int i = 0; i < job->nCol; i++) {
+      if (aCell[i].type == SQLITE_BLOB)
+        sqlite3_bind_blob(pStmt, i + 1, chunk->aBlob + aCell[i].off, aCell[i].n, SQLITE_STATIC);
+      else if (aCell[i].type == SQLITE_TEXT)
+        sqlite3_bind_text(pStmt, i + 1, chunk->zText + aCell[i].off, aCell[i].n, SQLITE_STATIC);
+      else
+        sqlite3_bind_null(pStmt, i + 1);
+    }
+    rc = sqlite3_step(pStmt);
+    sqlite3_reset(pStmt);
+    if (rc == SQLITE_DONE) {
+      rc = SQLITE_OK;
+      if (++*pnRow % nBatch == 0) {
+        rc = sqlite3_exec(db, "commit", 0, 0, 0);
+        if (rc == SQLITE_OK) rc = sqlite3_exec(db, "begin", 0, 0, 0);
+      }
+    }
+    else if ((rc & 0xFF) == SQLITE_CONSTRAINT || rc == SQLITE_MISMATCH || rc == SQLITE_TOOBIG) {
+      loadReject(chunk, chunk->aRecord[r], sqlite3_errmsg(db));
+      rc = SQLITE_OK;
+    }
+  }
+  return rc;
+}
+
+int main(int argc, char* argv[]) {
+  char const* zExt = 0;
+  char const* zJournal = 0;
+  char const* zSync = 0;
+  int nThread = -1;
+  int nBatch = 100000;
+  int i;
+  loadJob job;
+
+  memset(&job, 0, sizeof(job));
+  job.cDelim = ',';
+  job.useQuotes = 1;
+  for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1] != 0; i++) {
+    if (strcmp(argv[i], "-t") == 0) {
+      job.cDelim = '\t';
+      job.useQuotes = 0;
+    }
+    else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc && strlen(argv[i + 1]) == 1) job.cDelim = argv[++i][0];
+    else if (strcmp(argv[i], "-H") == 0) job.hasHeader = 1;
+    else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) nThread = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) nBatch = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) zJournal = argv[++i];
+    else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) zSync = argv[++i];
+    else if (strcmp(argv[i], "-x") == 0 && i + 1 < argc) zExt = argv[++i];
+    else usage(argv[0]);
+  }
+  if (argc - i != 3 || nBatch < 1 || job.cDelim == '"' || job.cDelim == '\n') usage(argv[0]);
+#if LOAD_HAVE_THREADS
+  if (nThread < 0) nThread = (int)sysconf(_SC_NPROCESSORS_ONLN) - 1;
+  if (nThread < 0) nThread = 1;
+  if (nThread > LOAD_MAX_THREADS) nThread = LOAD_MAX_THREADS;
+#else
+  nThread = 0;
+#endif
+
+  char const* zTable = argv[i + 1];
+  job.in = strcmp(argv[i + 2], "-") == 0 ? stdin : fopen(argv[i + 2], "rb");
+  if (job.in == 0) {
+    fprintf(stderr, "Cannot open %s\n", argv[i + 2]);
+    return EXIT_FAILURE;
+  }
+
+  sqlite3* db;
+  sqlite3_stmt* pStmt = 0;
+  char* zErrMsg = 0;
+  int rc = sqlite3_open(argv[i], &db);
+
+  if (rc == SQLITE_OK && zExt) {
+    sqlite3_db_config(db, SQLITE_DBCONFIG_ENABLE_LOAD_EXTENSION, 1, 0);
+    if (sqlite3_load_extension(db, zExt, "sqlite3_decimal_init", &zErrMsg) != SQLITE_OK) {
+      fprintf(stderr, "Cannot load %s: %s\n", zExt, zErrMsg);
+      sqlite3_free(zErrMsg);
+      sqlite3_close(db);
+      return EXIT_FAILURE;
+    }
+  }
+  if (rc == SQLITE_OK && zJournal) {
+    char* zSql = sqlite3_mprintf("pragma journal_mode = %s", zJournal);
+    rc = sqlite3_exec(db, zSql, 0, 0, 0);
+    sqlite3_free(zSql);
+  }
+  if (rc == SQLITE_OK && zSync) {
+    char* zSql = sqlite3_mprintf("pragma synchronous = %s", zSync);
+    rc = sqlite3_exec(db, zSql, 0, 0, 0);
+    sqlite3_free(zSql);
+  }
+  if (rc == SQLITE_OK) rc = loadColumns(db, zTable, &job);
+  if (rc == SQLITE_OK) rc = loadPrepareInsert(db, zTable, job.nCol, &pStmt);
+
+  job.nChunk = nThread > 0 ? 2 * nThread + 2 : 1;
+  job.aChunk = calloc((size_t)job.nChunk, sizeof(loadChunk));
+  if (job.aChunk == 0) rc = SQLITE_NOMEM;
+
+  sqlite3_int64 nRow = 0;
+  sqlite3_int64 nReject = 0;
+  int nReported = 0;
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+#if LOAD_HAVE_THREADS
+  pthread_t reader;
+  pthread_t aWorker[LOAD_MAX_THREADS];
+  int nStarted = 0;
+  int hasReader = 0;
+  pthread_mutex_init(&job.mutex, 0);
+  pthread_cond_init(&job.cond, 0);
+  if (rc == SQLITE_OK && nThread > 0) {
+    hasReader = pthread_create(&reader, 0, loadReaderMain, &job) == 0;
+    for (; hasReader && nStarted < nThread; nStarted++)
+      if (pthread_create(&aWorker[nStarted], 0, loadWorkerMain, &job) != 0) break;
+    if (!hasReader || nStarted == 0) {
+      fprintf(stderr, "Cannot start the threads\n");
+      rc = SQLITE_ERROR;
+    }
+  }
+#endif
+
+  if (rc == SQLITE_OK) rc = sqlite3_exec(db, "begin", 0, 0, 0);
+  for (sqlite3_int64 seq = 0; rc == SQLITE_OK; seq++) {
+    loadChunk* chunk = loadNextChunk(&job, seq, nThread);
+    if (chunk == 0) break;
+    rc = loadWrite(db, pStmt, &job, chunk, nBatch, &nRow);
+    for (int k = 0; k < chunk->nReported && nReported < LOAD_MAX_REPORTED; k++, nReported++)
+      fprintf(stderr, "Record %lld rejected: %s\n", chunk->aReport[k].iRecord, chunk->aReport[k].zReason);
+    nReject += chunk->nReject;
+    loadReleaseChunk(&job, chunk, nThread);
+  }
+  if (rc != SQLITE_OK && sqlite3_errcode(db) != SQLITE_OK) fprintf(stderr, "%s\n", sqlite3_errmsg(db));
+  if (rc == SQLITE_OK && job.isAborted) rc = SQLITE_ABORT;
+  if (!sqlite3_get_autocommit(db)) {
+    int const rc2 = sqlite3_exec(db, rc == SQLITE_OK ? "commit" : "rollback", 0, 0, 0);
+    if (rc == SQLITE_OK && rc2 != SQLITE_OK) {
+      rc = rc2;
+      fprintf(stderr, "%s\n", sqlite3_errmsg(db));
+    }
+  }
+
+#if LOAD_HAVE_THREADS
+  pthread_mutex_lock(&job.mutex);
+  job.isAborted = 1; // Stops the threads if the writer has stopped early
+  pthread_cond_broadcast(&job.cond);
+  pthread_mutex_unlock(&job.mutex);
+  if (hasReader) pthread_join(reader, 0);
+  for (int k = 0; k < nStarted; k++) pthread_join(aWorker[k], 0);
+  pthread_cond_destroy(&job.cond);
+  pthread_mutex_destroy(&job.mutex);
+#endif
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double const elapsed = (double)(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  if (nReject > nReported) fprintf(stderr, "...\n");
+  fprintf(stderr, "%lld rows loaded, %lld rejected in %.3fs (%.0f rows/s)\n", nRow, nReject, elapsed,
+          elapsed > 0 ? (double)nRow / elapsed : 0.0);
+
+  sqlite3_finalize(pStmt);
+  sqlite3_close(db);
+  if (job.in != stdin) fclose(job.in);
+  for (int k = 0; k < job.nChunk && job.aChunk; k++) {
+    free(job.aChunk[k].zText);
+    free(job.aChunk[k].aCell);
+    free(job.aChunk[k].aRecord);
+    free(job.aChunk[k].aBlob);
+  }
+  for (int k = 0; k < job.nCol && job.azCol; k++) sqlite3_free(job.azCol[k]);
+  free(job.aChunk);
+  free(job.azCol);
+  free(job.aDecimal);
+  free(job.zCarry);
+  return rc == SQLITE_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+}